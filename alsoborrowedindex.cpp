@@ -0,0 +1,137 @@
+#include "alsoborrowedindex.hpp"
+#include <algorithm>
+
+namespace {
+// xorshift64; each thread has its own, so updates need no shared state
+quint64 nextRandom()
+{
+    thread_local quint64 state = 0x9E3779B97F4A7C15ull;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+} // namespace
+
+void AlsoBorrowedIndex::recordBorrow(int patronId, int itemId)
+{
+    if (patronId <= 0 || itemId <= 0)
+        return;
+
+    // Take the patron's earlier borrows and add this one
+    std::array<int, RecentLoans> earlier{};
+    int n = 0;
+    {
+        Stripe &s = stripeOf(patronId);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        Recent &recent = s.patrons[patronId];
+        bool seen = false;
+        for (int id : recent.items)
+        {
+            if (id == itemId)
+                seen = true;
+            else if (id != 0)
+                earlier[n++] = id;
+        }
+        // Borrowing the same item again pairs it again but does not push
+        // the others out
+        if (!seen)
+        {
+            recent.items[recent.next] = itemId;
+            recent.next = (recent.next + 1) % RecentLoans;
+        }
+    }
+    if (n == 0)
+        return;
+
+    {
+        Stripe &s = stripeOf(itemId);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        Table &table = s.items[itemId];
+        for (int i = 0; i < n; ++i)
+            count(table, earlier[i]);
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        Stripe &s = stripeOf(earlier[i]);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        count(s.items[earlier[i]], itemId);
+    }
+}
+
+void AlsoBorrowedIndex::count(Table &table, int neighbourId)
+{
+    int lowest = 0;
+    for (int i = 0; i < table.used; ++i)
+    {
+        if (table.entries[i].itemId == neighbourId)
+        {
+            ++table.entries[i].count;
+            return;
+        }
+        if (table.entries[i].count < table.entries[lowest].count)
+            lowest = i;
+    }
+    if (table.used < Neighbours)
+    {
+        table.entries[table.used++] = Neighbour{neighbourId, 1};
+        return;
+    }
+    // Admit the newcomer over the lowest entry with probability 1/(m + 1),
+    // else drop the arrival. The lowest count only grows when an entry is
+    // taken over, so a pair seen once keeps the same small chance while a
+    // neighbour that keeps coming back soon gets in and then climbs
+    Neighbour &entry = table.entries[lowest];
+    if (nextRandom() % (quint64(entry.count) + 1) == 0)
+        entry = Neighbour{neighbourId, entry.count + 1};
+}
+
+std::vector<int> AlsoBorrowedIndex::alsoBorrowed(int itemId, int limit) const
+{
+    std::vector<int> out;
+    if (limit <= 0)
+        return out;
+
+    std::array<Neighbour, Neighbours> entries;
+    int used = 0;
+    {
+        Stripe &s = stripeOf(itemId);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        const auto it = s.items.find(itemId);
+        if (it == s.items.end())
+            return out;
+        entries = it->second.entries;
+        used = it->second.used;
+    }
+    const int shown = std::min(used, limit);
+    std::partial_sort(entries.begin(), entries.begin() + shown, entries.begin() + used,
+                      [](const Neighbour &a, const Neighbour &b) {
+                          return a.count != b.count ? a.count > b.count : a.itemId < b.itemId;
+                      });
+    out.reserve(std::size_t(shown));
+    for (int i = 0; i < shown; ++i)
+        out.push_back(entries[i].itemId);
+    return out;
+}
+
+std::size_t AlsoBorrowedIndex::itemCount() const
+{
+    std::size_t n = 0;
+    for (Stripe &s : m_stripes)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        n += s.items.size();
+    }
+    return n;
+}
+
+void AlsoBorrowedIndex::clear()
+{
+    for (Stripe &s : m_stripes)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.items.clear();
+        s.patrons.clear();
+        s.pool.release();
+    }
+}
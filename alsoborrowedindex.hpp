@@ -0,0 +1,77 @@
+#pragma once
+#include <QtGlobal>
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// ---------------------------------------------
+// AlsoBorrowedIndex: "patrons who borrowed this also borrowed"
+// ---------------------------------------------
+// Every borrow pairs the item with the patron's RecentLoans previous
+// borrows and counts the pair both ways. Each item keeps a fixed table of
+// Neighbours co-borrowed items, updated by a Space-Saving variant with
+// probabilistic admission: a neighbour already in the table counts up; a
+// new one takes a free entry, or else replaces the entry with the lowest
+// count m with probability 1/(m + 1), starting from m + 1, and is dropped
+// otherwise. Counts are a ranking, not pair frequencies: arrivals that are
+// dropped are not counted anywhere, which keeps the lowest count low, but
+// one-off pairs, most of a popular item's, then rarely push out a neighbour
+// seen again and again. (The unbiased rule, where the lowest entry counts
+// every arrival, keeps true counts in expectation but churns the table
+// far more.) So memory is one table per item ever
+// borrowed plus one short list per patron, however long the history, and
+// a lookup reads a single table.
+//
+// Items and patrons are spread over Stripes, each with its own mutex and
+// a pool for its tables. An update holds one stripe lock at a time, so it
+// can be called under DataStore's locks.
+class AlsoBorrowedIndex
+{
+public:
+    static constexpr int Neighbours = 16;   // kept per item
+    static constexpr int RecentLoans = 4;   // earlier borrows a new one is paired with
+    static constexpr int Stripes = 64;
+
+    AlsoBorrowedIndex() = default;
+    AlsoBorrowedIndex(const AlsoBorrowedIndex &) = delete;
+    AlsoBorrowedIndex &operator=(const AlsoBorrowedIndex &) = delete;
+
+    //The patron just borrowed the item
+    void recordBorrow(int patronId, int itemId);
+
+    //Up to limit item ids borrowed by the same patrons, most often first
+    std::vector<int> alsoBorrowed(int itemId, int limit) const;
+
+    //Items with a table (each costs about Neighbours * 8 bytes)
+    std::size_t itemCount() const;
+    void clear();
+
+private:
+    struct Neighbour {
+        int itemId = 0;
+        quint32 count = 0;
+    };
+    struct Table {
+        std::array<Neighbour, Neighbours> entries;
+        int used = 0;
+    };
+    // The patron's last distinct borrows, as a ring (0 = empty)
+    struct Recent {
+        std::array<int, RecentLoans> items{};
+        int next = 0;
+    };
+    struct Stripe {
+        std::mutex mutex;
+        std::pmr::unsynchronized_pool_resource pool;
+        std::pmr::unordered_map<int, Table> items{&pool};
+        std::pmr::unordered_map<int, Recent> patrons{&pool};
+    };
+
+    Stripe &stripeOf(int id) const { return m_stripes[std::size_t(id) % Stripes]; }
+    static void count(Table &table, int neighbourId);
+
+    mutable std::array<Stripe, Stripes> m_stripes;
+};
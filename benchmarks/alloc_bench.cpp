@@ -0,0 +1,190 @@
+// Heap use of a large in-memory catalogue: seeds items one addItem at a
+// time (every format), then patrons with loans and items with hold
+// queues, then tears the store down. Reports the heap allocations made
+// inside store calls, the blocks still live once seeding is done, peak
+// RSS, and seeding and teardown times. Allocations are counted at malloc
+// (glibc), so Qt's string buffers count as well as operator new.
+// Build: qmake benchmarks.pro && make && ./alloc_bench [items]
+#include "datastore.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <sys/resource.h>
+
+namespace {
+
+std::atomic<long long> g_allocations{0};
+std::atomic<long long> g_frees{0};
+
+} // namespace
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(std::size_t);
+void *__libc_calloc(std::size_t, std::size_t);
+void *__libc_realloc(void *, std::size_t);
+void *__libc_memalign(std::size_t, std::size_t);
+void __libc_free(void *);
+
+void *malloc(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t n, std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, std::size_t size)
+{
+    // A move is a free and an allocation; growing in place is neither
+    void *q = __libc_realloc(p, size);
+    if (!p || q != p)
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (p && q != p)
+        g_frees.fetch_add(1, std::memory_order_relaxed);
+    return q;
+}
+
+void *memalign(std::size_t alignment, std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **out, std::size_t alignment, std::size_t size)
+{
+    void *p = memalign(alignment, size);
+    if (!p)
+        return 12;   // ENOMEM
+    *out = p;
+    return 0;
+}
+
+void free(void *p)
+{
+    if (p)
+        g_frees.fetch_add(1, std::memory_order_relaxed);
+    __libc_free(p);
+}
+}
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int Patrons = 100000;
+constexpr int HeldItems = 50000;
+
+double secondsSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+long peakRssKb()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;   // KB on Linux
+}
+
+Item makeItem(int i)
+{
+    // Real titles and names outgrow any small-string buffer
+    Item item{i, QString("The Collected Title No. %1").arg(i), QString("Creator Surname %1").arg(i % 50000),
+              ItemFormat(i % 5), {}, "", "", "", "", ""};
+    switch (item.format)
+    {
+        case ItemFormat::FictionBook:
+            break;
+        case ItemFormat::NonFictionBook:
+            item.dewey = QString("%1.%2").arg(100 + i % 900).arg(i % 97);
+            break;
+        case ItemFormat::Magazine:
+            item.issue = QString("Issue %1").arg(i % 300);
+            item.pubDate = "2024-05";
+            break;
+        case ItemFormat::Movie:
+        case ItemFormat::VideoGame:
+            item.genre = i % 2 ? "Drama" : "Strategy";
+            item.rating = item.format == ItemFormat::Movie ? "PG" : "E";
+            break;
+    }
+    return item;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const int items = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const long long liveBefore = g_allocations - g_frees;
+    long long storeAllocations = 0;
+    auto counted = [&storeAllocations](auto &&call) {
+        const long long before = g_allocations;
+        call();
+        storeAllocations += g_allocations - before;
+    };
+
+    const auto start = Clock::now();
+    auto ds = std::make_unique<DataStore>(false);
+    for (int i = 1; i <= items; ++i)
+    {
+        Item item = makeItem(i);   // the caller's strings are not the store's
+        counted([&] { ds->addItem(std::move(item)); });
+    }
+    const long long itemAllocations = storeAllocations;
+    const double itemSecs = secondsSince(start);
+
+    std::mt19937 rng(5);
+    for (int p = 0; p < Patrons; ++p)
+    {
+        User user{0, QString("patron%1").arg(p), UserType::Patron, {}, {}};
+        int id = 0;
+        counted([&] { id = ds->upsertUser(std::move(user)); });
+        const std::vector<int> loans = {1 + int(rng() % items), 1 + int(rng() % items), 1 + int(rng() % items)};
+        counted([&] { ds->borrowItems(id, loans); });
+    }
+    for (int h = 0; h < HeldItems; ++h)
+    {
+        const int itemId = 1 + int(rng() % items);
+        for (int q = int(rng() % 4); q >= 0; --q)
+        {
+            const int patron = 1 + int(rng() % Patrons);
+            counted([&] { ds->placeHold(patron, itemId); });
+        }
+    }
+    const double seedSecs = secondsSince(start);
+    const long long live = g_allocations - g_frees - liveBefore;
+
+    const auto teardown = Clock::now();
+    ds.reset();
+    const double teardownSecs = secondsSince(teardown);
+
+    std::printf("%d items, %d patrons, %d held items\n", items, Patrons, HeldItems);
+#ifdef __GLIBC__
+    std::printf("store allocations, items           %12lld  (%.2f per item)\n", itemAllocations,
+                double(itemAllocations) / items);
+    std::printf("store allocations, all seeding     %12lld\n", storeAllocations);
+    std::printf("heap blocks live after seeding     %12lld\n", live);
+#else
+    std::printf("allocation counts need glibc\n");
+#endif
+    std::printf("peak RSS                           %12.1f MB\n", double(peakRssKb()) / 1024.0);
+    std::printf("seed items                         %12.2f s\n", itemSecs);
+    std::printf("seed everything                    %12.2f s\n", seedSecs);
+    std::printf("tear down                          %12.3f s\n", teardownSecs);
+    return 0;
+}
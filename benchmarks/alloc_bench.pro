@@ -0,0 +1,4 @@
+TARGET = alloc_bench
+include(store.pri)
+
+SOURCES += alloc_bench.cpp
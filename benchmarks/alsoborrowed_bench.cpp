@@ -0,0 +1,167 @@
+// "Also borrowed" index: 10M borrows of 1M items by 100k patrons. Items
+// come in clusters of 100 (a series, a subject) and each patron mostly
+// borrows from a few favourite clusters. Measures the cost an update adds
+// to a borrow, the lookup the PatronWindow makes on every selection, the
+// index's memory, and how many suggestions come from the item's own
+// cluster. Working the same answer out of the circulation history at
+// query time (the item's borrowers, then their other loans) is the
+// baseline. First it checks that a pair borrowed together again and again
+// pushes out pairs seen once.
+// Build: qmake benchmarks.pro && make && ./alsoborrowed_bench
+#include "alsoborrowedindex.hpp"
+#include "circulationhistory.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Kind = CirculationHistory::Kind;
+
+constexpr int Items = 1000000;
+constexpr int Patrons = 100000;
+constexpr int ClusterSize = 100;
+constexpr int Clusters = Items / ClusterSize;
+constexpr int Favourites = 3;         // clusters per patron
+constexpr int FromFavourites = 80;    // percent of borrows
+constexpr long long Borrows = 10000000;
+constexpr int Shown = 5;              // suggestions PatronWindow shows
+
+double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int clusterOf(int item)
+{
+    return (item - 1) / ClusterSize;
+}
+
+// The baseline: the item's last 200 borrowers, each one's last 20 loans
+std::vector<int> fromHistory(const CirculationHistory &history, int item, int limit)
+{
+    std::unordered_map<int, int> counts;
+    for (const CirculationHistory::Loan &loan : history.itemLoans(item, 200))
+        for (const CirculationHistory::Loan &other : history.patronLoans(loan.patronId, 20))
+            if (other.itemId != item)
+                ++counts[other.itemId];
+    std::vector<std::pair<int, int>> ranked(counts.begin(), counts.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    std::vector<int> out;
+    for (std::size_t i = 0; i < ranked.size() && int(i) < limit; ++i)
+        out.push_back(ranked[i].first);
+    return out;
+}
+
+// Item 1 is borrowed after 300 one-off items by 300 patrons, then after
+// item 2 by 100 more, with a further one-off between each; item 2 must
+// come out on top
+bool repeatedPairWins()
+{
+    AlsoBorrowedIndex index;
+    int patron = 0, oneOff = 1000;
+    auto oneOffPair = [&] {
+        ++patron;
+        index.recordBorrow(patron, ++oneOff);
+        index.recordBorrow(patron, 1);
+    };
+    for (int i = 0; i < 300; ++i)
+        oneOffPair();
+    for (int i = 0; i < 100; ++i)
+    {
+        ++patron;
+        index.recordBorrow(patron, 2);
+        index.recordBorrow(patron, 1);
+        oneOffPair();
+    }
+    return index.alsoBorrowed(1, 1) == std::vector<int>{2} && index.alsoBorrowed(2, 1) == std::vector<int>{1};
+}
+
+} // namespace
+
+int main()
+{
+    if (!repeatedPairWins())
+    {
+        std::printf("FAILED: a pair borrowed 100 times did not displace pairs seen once\n");
+        return 1;
+    }
+    std::printf("a pair borrowed 100 times displaces 400 pairs seen once\n");
+
+    std::mt19937 rng(42);
+    std::vector<std::array<int, Favourites>> favourites(Patrons + 1);
+    for (auto &f : favourites)
+        for (int &c : f)
+            c = int(rng() % Clusters);
+    // Within a cluster a few titles are far more popular than the rest
+    std::vector<double> weights(ClusterSize);
+    for (int r = 0; r < ClusterSize; ++r)
+        weights[std::size_t(r)] = 1.0 / (r + 1);
+    std::discrete_distribution<int> rank(weights.begin(), weights.end());
+    auto pick = [&](int patron) {
+        if (int(rng() % 100) < FromFavourites)
+            return favourites[std::size_t(patron)][rng() % Favourites] * ClusterSize + 1 + rank(rng);
+        return 1 + int(rng() % Items);
+    };
+
+    std::vector<std::pair<int, int>> borrows;   // patron, item
+    borrows.reserve(std::size_t(Borrows));
+    for (long long n = 0; n < Borrows; ++n)
+    {
+        const int patron = 1 + int(rng() % Patrons);
+        borrows.emplace_back(patron, pick(patron));
+    }
+
+    AlsoBorrowedIndex index;
+    auto t = Clock::now();
+    for (const auto &[patron, item] : borrows)
+        index.recordBorrow(patron, item);
+    const double updateMs = msSince(t);
+    std::printf("%lld borrows indexed in %.0f ms (%.0f ns each)\n", Borrows, updateMs, updateMs * 1e6 / double(Borrows));
+
+    // A node per item table and per patron list: the entry, its key and
+    // the node's next pointer and cached hash
+    const std::size_t items = index.itemCount();
+    const double mb = double(items * (AlsoBorrowedIndex::Neighbours * 8 + 4 + 24)
+                             + std::size_t(Patrons) * (AlsoBorrowedIndex::RecentLoans * 4 + 4 + 24)) / 1e6;
+    std::printf("%zu item tables, about %.0f MB with the patron lists (fixed per item and per patron)\n", items, mb);
+
+    CirculationHistory history;
+    qint64 at = 1672531200000LL;
+    for (const auto &[patron, item] : borrows)
+        history.record(Kind::Borrow, item, patron, at += 1000);
+
+    // Items are picked as a patron would select them (popular titles more
+    // often, as often as they are borrowed) and uniformly
+    auto run = [&](const char *name, int queries, bool popular, auto suggest) {
+        std::size_t shown = 0, sameCluster = 0;
+        double worst = 0;
+        const auto start = Clock::now();
+        for (int q = 0; q < queries; ++q)
+        {
+            const int item = popular ? borrows[rng() % borrows.size()].second : 1 + int(rng() % Items);
+            const auto one = Clock::now();
+            const std::vector<int> ids = suggest(item);
+            worst = std::max(worst, msSince(one));
+            shown += ids.size();
+            for (int id : ids)
+                sameCluster += clusterOf(id) == clusterOf(item);
+        }
+        std::printf("%-13s %-8s %8.2f us avg, %6.3f ms worst, %.1f shown, %2.0f%% from the item's cluster\n", name,
+                    popular ? "popular" : "uniform", msSince(start) * 1000 / queries, worst, double(shown) / queries,
+                    shown ? 100.0 * double(sameCluster) / double(shown) : 0.0);
+    };
+    for (const bool popular : {true, false})
+    {
+        run("alsoBorrowed", 100000, popular, [&](int item) { return index.alsoBorrowed(item, Shown); });
+        run("from history", 1000, popular, [&](int item) { return fromHistory(history, item, Shown); });
+    }
+    return 0;
+}
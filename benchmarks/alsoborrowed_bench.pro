@@ -0,0 +1,4 @@
+TARGET = alsoborrowed_bench
+include(store.pri)
+
+SOURCES += alsoborrowed_bench.cpp
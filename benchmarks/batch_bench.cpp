@@ -0,0 +1,95 @@
+// Batch vs single-item circulation: kiosk checkouts (one patron, several
+// items) and return-bin check-in (mixed patrons) on a 1M-item store.
+// Build: qmake benchmarks.pro && make && ./batch_bench
+#include "datastore.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int Items = 1000000;
+constexpr int Patrons = 100000;
+constexpr int BinSize = 48;
+
+void populate(DataStore &ds)
+{
+    for (int i = 1; i <= Patrons; ++i)
+        ds.upsertUser(User{0, QString("patron%1").arg(i), UserType::Patron, {}, {}});
+    for (int i = 1; i <= Items; ++i)
+        ds.addItem(Item{i, QString("Title %1").arg(i), "Author", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+}
+
+// Every patron checks out MaxActiveLoans items; returns items/s
+double checkout(DataStore &ds, const std::vector<int> &order, bool batched)
+{
+    const auto start = Clock::now();
+    std::vector<int> ids(Rules::MaxActiveLoans);
+    int next = 0;
+    for (int p = 1; p <= Patrons; ++p)
+    {
+        for (int &id : ids)
+            id = order[next++];
+        if (batched)
+        {
+            ds.borrowItems(p, ids);
+        }
+        else
+        {
+            for (int id : ids)
+                ds.borrowItem(p, id);
+        }
+    }
+    return next / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Check everything back in, BinSize items per bin in borrow order (so each
+// bin mixes ~16 patrons); returns items/s
+double checkin(DataStore &ds, const std::vector<int> &order, int count, bool batched)
+{
+    const auto start = Clock::now();
+    for (int first = 0; first < count; first += BinSize)
+    {
+        const std::vector<int> bin(order.begin() + first, order.begin() + std::min(count, first + BinSize));
+        if (batched)
+        {
+            ds.returnBin(bin);
+            continue;
+        }
+        // The single-item path: look up who has it, then return it for them
+        for (int id : bin)
+        {
+            const int borrower = ds.statusAt(ds.itemSlot(id)).borrower;
+            ds.returnItem(borrower, id);
+        }
+    }
+    return count / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main()
+{
+    DataStore ds(false);
+    populate(ds);
+
+    std::vector<int> order(Items);
+    std::iota(order.begin(), order.end(), 1);
+    std::shuffle(order.begin(), order.end(), std::mt19937(7));
+    const int loans = Patrons * Rules::MaxActiveLoans;
+
+    for (bool batched : {false, true})
+    {
+        const double out = checkout(ds, order, batched);
+        const double in = checkin(ds, order, loans, batched);
+        const int stillOut = Items - ds.availableCount();
+        std::printf("%-7s checkout %10.0f items/s   return bin %10.0f items/s   (%d left on loan)\n",
+                    batched ? "batch" : "single", out, in, stillOut);
+    }
+    return 0;
+}
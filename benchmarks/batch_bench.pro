@@ -0,0 +1,4 @@
+TARGET = batch_bench
+include(store.pri)
+
+SOURCES += batch_bench.cpp
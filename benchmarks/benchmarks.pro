@@ -0,0 +1,17 @@
+# Stand-alone DataStore benchmarks, one program each
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    alloc_bench.pro \
+    alsoborrowed_bench.pro \
+    batch_bench.pro \
+    concurrency_bench.pro \
+    due_bench.pro \
+    history_bench.pro \
+    import_bench.pro \
+    layout_bench.pro \
+    lookup_bench.pro \
+    micro_bench.pro \
+    report_bench.pro \
+    server_bench.pro \
+    snapshot_bench.pro
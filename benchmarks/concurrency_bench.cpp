@@ -0,0 +1,167 @@
+// Concurrent circulation: borrow/return/hold throughput at 1..16 threads
+// against one store, then consistency checks on the final state.
+// Build: qmake benchmarks.pro && make && ./concurrency_bench
+#include "datastore.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int Items = 1000000;
+constexpr int PatronsPerThread = 256;
+constexpr int OpsPerThread = 200000;
+
+// Each thread drives its own patrons (a kiosk's queue of users) against
+// the whole catalogue, so borrows from different threads only meet when
+// they pick the same item
+long long runSessions(DataStore &ds, int threadIndex, int firstPatron)
+{
+    std::mt19937 rng(1234 + threadIndex);
+    long long ok = 0;
+    for (int op = 0; op < OpsPerThread; ++op)
+    {
+        const int patron = firstPatron + int(rng() % PatronsPerThread);
+        const int itemId = 1 + int(rng() % Items);
+        int loans = 0, firstLoan = 0, firstHold = 0;
+        ds.withUser(patron, [&](const User &u) {
+            loans = (int)u.activeLoans.size();
+            firstLoan = loans ? u.activeLoans.front() : 0;
+            firstHold = u.holds.empty() ? 0 : u.holds.front();
+        });
+        if (loans >= Rules::MaxActiveLoans)
+        {
+            ok += !ds.returnItem(patron, firstLoan);
+        }
+        else if (op % 16 == 0)
+        {
+            // Holds on a small hot set so queues see real contention
+            const int hot = 1 + int(rng() % 64);
+            ok += !(firstHold == 0 ? ds.placeHold(patron, hot) : ds.cancelHold(patron, firstHold));
+        }
+        else
+        {
+            ok += !ds.borrowItem(patron, itemId);
+        }
+    }
+    return ok;
+}
+
+// Every loan the items record is on exactly that patron's list, nobody is
+// over the cap, and every hold a patron lists has them in the queue or
+// waiting on the hold shelf
+bool consistent(const DataStore &ds, int patronCount)
+{
+    std::vector<int> loansSeen(patronCount + 1, 0);
+    for (int slot = 0; slot < ds.itemCount(); ++slot)
+    {
+        const ItemStatus status = ds.statusAt(slot);
+        if (status.available || status.readyFor)
+            continue;
+        const int id = ds.itemIdAt(slot);
+        bool listed = false;
+        ds.withUser(status.borrower, [&](const User &u) {
+            listed = std::find(u.activeLoans.begin(), u.activeLoans.end(), id) != u.activeLoans.end();
+        });
+        if (!listed)
+        {
+            std::printf("item %d: borrower %d has no matching loan\n", id, status.borrower);
+            return false;
+        }
+        ++loansSeen[status.borrower];
+    }
+    for (int id = 1; id <= patronCount; ++id)
+    {
+        int loans = 0;
+        std::vector<int> holds;
+        ds.withUser(id, [&](const User &u) {
+            loans = (int)u.activeLoans.size();
+            holds.assign(u.holds.begin(), u.holds.end());
+        });
+        if (loans != loansSeen[id] || loansSeen[id] > Rules::MaxActiveLoans)
+        {
+            std::printf("patron %d: %d loans listed, %d recorded\n", id, loans, loansSeen[id]);
+            return false;
+        }
+        for (int itemId : holds)
+        {
+            if (ds.holdPosition(id, itemId) < 1 && ds.statusAt(ds.itemSlot(itemId)).readyFor != id)
+            {
+                std::printf("patron %d: hold on %d missing from queue\n", id, itemId);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Many sessions of one patron racing for the last loan slot
+bool capHolds(int threads)
+{
+    DataStore ds(false);
+    const int shared = ds.upsertUser(User{0, "shared", UserType::Patron, {}, {}});
+    for (int i = 1; i <= threads * 8; ++i)
+        ds.addItem(Item{i, QString("Item %1").arg(i), "Author", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+
+    std::atomic<int> granted{0};
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+    {
+        pool.emplace_back([&, t] {
+            for (int i = 0; i < 8; ++i)
+                granted += !ds.borrowItem(shared, 1 + t * 8 + i);
+        });
+    }
+    for (auto &th : pool)
+        th.join();
+    int loans = 0;
+    ds.withUser(shared, [&](const User &u) { loans = (int)u.activeLoans.size(); });
+    return granted == Rules::MaxActiveLoans && loans == Rules::MaxActiveLoans;
+}
+
+} // namespace
+
+int main()
+{
+    const int maxThreads = 16;
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+
+    double baseline = 0;
+    bool allConsistent = true;
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        DataStore ds(false);
+        const int patronCount = threads * PatronsPerThread;
+        for (int i = 1; i <= patronCount; ++i)
+            ds.upsertUser(User{0, QString("patron%1").arg(i), UserType::Patron, {}, {}});
+        for (int i = 1; i <= Items; ++i)
+            ds.addItem(Item{i, QString("Title %1").arg(i), "Author", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+
+        std::atomic<long long> ok{0};
+        std::vector<std::thread> pool;
+        const auto start = Clock::now();
+        for (int t = 0; t < threads; ++t)
+            pool.emplace_back([&, t] { ok += runSessions(ds, t, 1 + t * PatronsPerThread); });
+        for (auto &th : pool)
+            th.join();
+        const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        const double opsPerSec = double(threads) * OpsPerThread / secs;
+        if (threads == 1)
+            baseline = opsPerSec;
+        const bool good = consistent(ds, patronCount);
+        allConsistent = allConsistent && good;
+        std::printf("%2d threads   %10.0f ops/s   speedup %5.2fx   (%lld succeeded)   %s\n", threads, opsPerSec,
+                    opsPerSec / baseline, ok.load(), good ? "consistent" : "INCONSISTENT");
+    }
+
+    const bool cap = capHolds(maxThreads);
+    std::printf("loan cap under %d racing sessions: %s\n", maxThreads, cap ? "held" : "VIOLATED");
+    return allConsistent && cap ? 0 : 1;
+}
@@ -0,0 +1,4 @@
+TARGET = concurrency_bench
+include(store.pri)
+
+SOURCES += concurrency_bench.cpp
@@ -0,0 +1,71 @@
+// Due-date schedule: cost of the daily clock tick and of the overdue /
+// due-soon queries as a month passes over 300k loans in a 1M-item
+// catalogue. Costs should follow the loans involved, not the catalogue.
+// Build: qmake benchmarks.pro && make && ./due_bench
+#include "datastore.hpp"
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int Items = 1000000;
+constexpr int Patrons = 100000;
+
+double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main()
+{
+    DataStore ds(false);
+    for (int i = 1; i <= Patrons; ++i)
+        ds.upsertUser(User{0, QString("patron%1").arg(i), UserType::Patron, {}, {}});
+    for (int i = 1; i <= Items; ++i)
+        ds.addItem(Item{i, QString("Title %1").arg(i), "Author", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+
+    // Loans taken out over the last two weeks: spread the due days by
+    // walking the clock forward while patrons borrow
+    const QDate start = ds.clockDate();
+    int next = 1;
+    for (int day = 0; day < Rules::LoanDays; ++day)
+    {
+        ds.advanceClock(start.addDays(day));
+        for (int p = 1 + day; p <= Patrons; p += Rules::LoanDays)
+            for (int k = 0; k < Rules::MaxActiveLoans; ++k)
+                ds.borrowItem(p, next++);
+    }
+
+    long long dueSoon = 0, overdue = 0;
+    ds.subscribe([&](const ChangeSet &c) {
+        dueSoon += (long long)c.dueSoon.size();
+        overdue += (long long)c.overdue.size();
+    });
+
+    std::printf("%d items, %d on loan\n", Items, Items - ds.availableCount());
+    for (int day = Rules::LoanDays; day < Rules::LoanDays + 30; day += 3)
+    {
+        const QDate today = start.addDays(day);
+        const long long soonBefore = dueSoon, overBefore = overdue;
+        auto t = Clock::now();
+        ds.advanceClock(today);
+        const double tickMs = msSince(t);
+
+        t = Clock::now();
+        const std::size_t late = ds.overdueItems(today).size();
+        const double overdueMs = msSince(t);
+
+        t = Clock::now();
+        const std::size_t soon = ds.dueItems(today, today.addDays(Rules::DueSoonDays + 1)).size();
+        const double soonMs = msSince(t);
+
+        std::printf("day %2d   tick %7.3f ms (%6lld due-soon, %6lld overdue events)   overdue %6zu in %7.3f ms"
+                    "   due soon %6zu in %7.3f ms\n",
+                    day, tickMs, dueSoon - soonBefore, overdue - overBefore, late, overdueMs, soon, soonMs);
+    }
+    return 0;
+}
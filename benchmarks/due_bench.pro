@@ -0,0 +1,4 @@
+TARGET = due_bench
+include(store.pri)
+
+SOURCES += due_bench.cpp
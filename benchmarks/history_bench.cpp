@@ -0,0 +1,135 @@
+// Circulation history: 30M loan, return and hold events over three years
+// from 100k patrons and 1M items. Per-patron and per-item queries should
+// cost the events they return, not the history's size; date windows the
+// blocks they touch. A flat array of the same events, scanned, is the
+// baseline for both.
+// Build: qmake benchmarks.pro && make && ./history_bench
+#include "circulationhistory.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Kind = CirculationHistory::Kind;
+
+constexpr int Items = 1000000;
+constexpr int Patrons = 100000;
+constexpr long long Events = 30000000;
+constexpr std::size_t OnLoan = 250000;   // loans out at any time
+constexpr qint64 DayMs = 24LL * 3600 * 1000;
+constexpr qint64 StartMs = 1672531200000LL;   // 2023-01-01
+constexpr qint64 SpanMs = 3 * 365 * DayMs;
+
+double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(42);
+    CirculationHistory history;
+    std::vector<CirculationHistory::Event> flat;
+    flat.reserve(std::size_t(Events));
+
+    // Borrows go out in a FIFO and come back when it is full; every tenth
+    // event is a hold placed or cancelled
+    std::deque<std::pair<int, int>> out;
+    auto record = [&](Kind kind, int item, int patron, qint64 at) {
+        history.record(kind, item, patron, at);
+        flat.push_back(CirculationHistory::Event{at, kind, item, patron});
+    };
+    auto t = Clock::now();
+    for (long long n = 0; n < Events;)
+    {
+        const qint64 at = StartMs + SpanMs * n / Events;
+        const int patron = 1 + int(rng() % Patrons);
+        const int item = 1 + int(rng() % Items);
+        if (rng() % 10 == 0)
+        {
+            record(rng() % 2 ? Kind::PlaceHold : Kind::CancelHold, item, patron, at);
+            ++n;
+            continue;
+        }
+        record(Kind::Borrow, item, patron, at);
+        out.emplace_back(item, patron);
+        ++n;
+        if (out.size() > OnLoan)
+        {
+            record(Kind::Return, out.front().first, out.front().second, at);
+            out.pop_front();
+            ++n;
+        }
+    }
+    const double recordMs = msSince(t);
+    std::printf("%llu events recorded in %.0f ms (%.0f ns each, flat array included)\n",
+                (unsigned long long)history.size(), recordMs, recordMs * 1e6 / double(history.size()));
+    std::printf("history %.1f MB (%.1f bytes/event), flat array %.1f MB\n", double(history.bytesUsed()) / 1e6,
+                double(history.bytesUsed()) / double(history.size()),
+                double(flat.size() * sizeof(CirculationHistory::Event)) / 1e6);
+
+    // Chain queries
+    constexpr int Queries = 10000;
+    std::size_t found = 0;
+    double worst = 0;
+    t = Clock::now();
+    for (int q = 0; q < Queries; ++q)
+    {
+        const auto one = Clock::now();
+        found += history.patronLoans(1 + int(rng() % Patrons), 100).size();
+        worst = std::max(worst, msSince(one));
+    }
+    std::printf("patronLoans(p, 100): %.1f us avg, %.3f ms worst, %.1f loans each\n",
+                msSince(t) * 1000 / Queries, worst, double(found) / Queries);
+
+    found = 0;
+    worst = 0;
+    t = Clock::now();
+    for (int q = 0; q < Queries; ++q)
+    {
+        const auto one = Clock::now();
+        found += history.itemLoans(1 + int(rng() % Items)).size();
+        worst = std::max(worst, msSince(one));
+    }
+    std::printf("itemLoans(i):        %.1f us avg, %.3f ms worst, %.1f loans each\n",
+                msSince(t) * 1000 / Queries, worst, double(found) / Queries);
+
+    const int patron = 1 + int(rng() % Patrons);
+    t = Clock::now();
+    std::size_t patronBorrows = 0;
+    for (auto it = flat.rbegin(); it != flat.rend() && patronBorrows < 100; ++it)
+        patronBorrows += it->patronId == patron && it->kind == Kind::Borrow;
+    std::printf("flat scan, newest first, for one patron's last %zu borrows: %.1f ms\n", patronBorrows, msSince(t));
+
+    // Date windows: the last day, week, month and year, then counts
+    const qint64 endMs = StartMs + SpanMs;
+    for (const auto &[name, days] : {std::pair<const char *, int>{"day", 1}, {"week", 7}, {"month", 30}, {"year", 365}})
+    {
+        const qint64 from = endMs - days * DayMs - DayMs / 2;
+        const qint64 to = endMs - DayMs / 2;
+        t = Clock::now();
+        const std::size_t borrows = history.between(from, to, CirculationHistory::bit(Kind::Borrow)).size();
+        const double betweenMs = msSince(t);
+        t = Clock::now();
+        const auto counts = history.countBetween(from, to);
+        const double countMs = msSince(t);
+        t = Clock::now();
+        std::vector<CirculationHistory::Event> flatOut;
+        for (const CirculationHistory::Event &e : flat)
+            if (e.atMs >= from && e.atMs < to && e.kind == Kind::Borrow)
+                flatOut.push_back(e);
+        const double flatMs = msSince(t);
+        const std::size_t flatBorrows = flatOut.size();
+        std::printf("%-5s  between %8zu borrows %8.2f ms   countBetween %8.2f ms   flat scan %8zu in %7.2f ms%s\n", name,
+                    borrows, betweenMs, countMs, flatBorrows, flatMs,
+                    borrows == flatBorrows && counts[int(Kind::Borrow)] == flatBorrows ? "" : "   MISMATCH");
+    }
+    return 0;
+}
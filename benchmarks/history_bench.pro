@@ -0,0 +1,4 @@
+TARGET = history_bench
+include(store.pri)
+
+SOURCES += history_bench.cpp
@@ -0,0 +1,96 @@
+// CSV import: a generated acquisitions file (every format, one row in a
+// hundred invalid, a tenth without an id) imported into an empty store
+// with 1, 2, 4 and 8 parser threads, then the one index build at the end.
+// Build: qmake benchmarks.pro && make && ./import_bench
+#include "catalogueimport.hpp"
+#include "datastore.hpp"
+#include <QTemporaryDir>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int Rows = 1000000;
+
+bool writeCsv(const QString &path)
+{
+    std::FILE *f = std::fopen(qPrintable(path), "w");
+    if (!f)
+        return false;
+    std::fprintf(f, "id,title,creator,format,dewey,issue,pubDate,genre,rating\n");
+    for (int i = 1; i <= Rows; ++i)
+    {
+        // Every tenth row leaves the id to the store (after the highest one)
+        char id[16] = "";
+        if (i % 10)
+            std::snprintf(id, sizeof id, "%d", i);
+        switch (i % 5)
+        {
+            case 0:
+                std::fprintf(f, "%s,\"Novel %d, a story\",Author %d,Fiction Book,,,,,\n", id, i, i % 5000);
+                break;
+            case 1:
+                std::fprintf(f, "%s,Facts %d,Writer %d,Non-Fiction Book,%03d.%d,,,,\n", id, i, i % 5000, i % 1000,
+                             i % 97);
+                break;
+            case 2:
+                std::fprintf(f, "%s,Monthly %d,Editorial Board,Magazine,,Issue %d,20%02d-%02d,,\n", id, i, i % 300,
+                             i % 25, 1 + i % 12);
+                break;
+            case 3:
+                // one row in a hundred has a rating no movie carries
+                std::fprintf(f, "%s,Film %d,Director %d,Movie,,,,Drama,%s\n", id, i, i % 5000,
+                             i % 100 == 3 ? "E10+" : "PG-13");
+                break;
+            case 4:
+                std::fprintf(f, "%s,Game %d,Studio %d,Video Game,,,,Strategy,E10+\n", id, i, i % 500);
+                break;
+        }
+    }
+    return std::fclose(f) == 0;
+}
+
+} // namespace
+
+int main()
+{
+    QTemporaryDir dir;
+    const QString path = dir.path() + "/acquisitions.csv";
+    if (!writeCsv(path))
+    {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(path));
+        return 1;
+    }
+    std::printf("%d rows\n", Rows);
+
+    bool ok = true;
+    for (int threads : {1, 2, 4, 8})
+    {
+        DataStore ds(false);
+        CatalogueImporter importer(ds, threads);
+        const auto start = Clock::now();
+        if (auto err = importer.start(path))
+        {
+            std::fprintf(stderr, "%s\n", qPrintable(*err));
+            return 1;
+        }
+        auto indexStart = start;
+        while (importer.insertReady(true))
+            if (importer.progress().indexing && indexStart == start)
+                indexStart = Clock::now();
+        const auto end = Clock::now();
+
+        const CatalogueImporter::Progress p = importer.progress();
+        const double insertSecs = std::chrono::duration<double>(indexStart - start).count();
+        const double indexSecs = std::chrono::duration<double>(end - indexStart).count();
+        std::printf("%d threads  %8.0f rows/s   parse+insert %6.2f s   index %5.2f s   (%d items, %d rejected)\n",
+                    threads, Rows / insertSecs, insertSecs, indexSecs, p.imported, p.rejected);
+        ok = ok && p.finished && p.imported == ds.itemCount() && p.imported + p.rejected == Rows &&
+             p.rejected == Rows / 100 && !ds.searchCatalogue("Novel", 1).empty();
+    }
+    if (!ok)
+        std::printf("import results are WRONG\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,4 @@
+TARGET = import_bench
+include(store.pri)
+
+SOURCES += import_bench.cpp
@@ -0,0 +1,156 @@
+// Catalogue layout: heap bytes per item and full-catalogue availability /
+// overdue scans, for the original one-record-per-item layout ("before")
+// against DataStore's split circulation arrays ("after").
+// Build: qmake benchmarks.pro && make && ./layout_bench
+#include "datastore.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <queue>
+#include <vector>
+
+// Live heap bytes, tracked by a size header in front of every block
+static std::size_t g_liveBytes = 0;
+
+void *operator new(std::size_t size)
+{
+    auto *block = static_cast<std::size_t *>(std::malloc(size + sizeof(std::max_align_t)));
+    if (!block)
+        throw std::bad_alloc();
+    *block = size;
+    g_liveBytes += size;
+    return reinterpret_cast<char *>(block) + sizeof(std::max_align_t);
+}
+
+void operator delete(void *p) noexcept
+{
+    if (!p)
+        return;
+    auto *block = reinterpret_cast<std::size_t *>(static_cast<char *>(p) - sizeof(std::max_align_t));
+    g_liveBytes -= *block;
+    std::free(block);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The item record as it was before the split: every field of every
+// format inline, circulation state in the middle of it
+struct LegacyStatus {
+    bool available = true;
+    std::optional<QString> borrower;
+    std::optional<QDate> dueDate;
+};
+
+struct LegacyItem {
+    int id;
+    QString title;
+    QString creator;
+    ItemFormat format;
+    LegacyStatus status;
+    std::queue<QString> holdQueue;
+    QString dewey, issue, pubDate, genre, rating;
+};
+
+// Same synthetic catalogue for both layouts: formats round-robin, every
+// 10th item on loan, a third of those overdue
+Item makeItem(int id, const QDate &today)
+{
+    const auto format = ItemFormat(id % 5);
+    Item it{id, QString("Title %1").arg(id), QString("Author %1").arg(id % 5000), format, {}, "", "", "", "", ""};
+    switch (format)
+    {
+        case ItemFormat::FictionBook:    break;
+        case ItemFormat::NonFictionBook: it.dewey = "530.12"; break;
+        case ItemFormat::Magazine:       it.issue = QString("Issue %1").arg(id % 200); it.pubDate = "2025-10"; break;
+        case ItemFormat::Movie:
+        case ItemFormat::VideoGame:      it.genre = "Drama"; it.rating = "PG-13"; break;
+    }
+    if (id % 10 == 0)
+    {
+        it.status.available = false;
+        it.status.borrower = 1 + id % 1000;
+        it.status.dueDate = today.addDays(id % 30 == 0 ? -3 : 7);
+    }
+    return it;
+}
+
+double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void run(int items)
+{
+    const QDate today = QDate::currentDate();
+    const int reps = 20;
+
+    // Before
+    std::size_t base = g_liveBytes;
+    std::vector<LegacyItem> legacy;
+    legacy.reserve(items);
+    for (int id = 1; id <= items; ++id)
+    {
+        Item it = makeItem(id, today);
+        LegacyStatus status{it.status.available, std::nullopt, it.status.dueDate};
+        if (!it.status.available)
+            status.borrower = QString("patron%1").arg(it.status.borrower);
+        legacy.push_back(LegacyItem{it.id, it.title, it.creator, it.format, status, {},
+                                    it.dewey, it.issue, it.pubDate, it.genre, it.rating});
+    }
+    const double legacyBytes = double(g_liveBytes - base) / items;
+
+    long long sink = 0;
+    auto start = Clock::now();
+    for (int r = 0; r < reps; ++r)
+        for (const LegacyItem &it : legacy)
+            sink += it.status.available;
+    const double legacyAvail = msSince(start) / reps;
+
+    start = Clock::now();
+    for (int r = 0; r < reps; ++r)
+        for (const LegacyItem &it : legacy)
+            if (it.status.dueDate && *it.status.dueDate < today)
+                sink += it.id;
+    const double legacyOverdue = msSince(start) / reps;
+
+    legacy.clear();
+    legacy.shrink_to_fit();
+
+    // After
+    base = g_liveBytes;
+    DataStore ds(false);
+    for (int id = 1; id <= items; ++id)
+        ds.addItem(makeItem(id, today));
+    const double storeBytes = double(g_liveBytes - base) / items;
+
+    start = Clock::now();
+    for (int r = 0; r < reps; ++r)
+        sink += ds.availableCount();
+    const double storeAvail = msSince(start) / reps;
+
+    start = Clock::now();
+    for (int r = 0; r < reps; ++r)
+        sink += (long long)ds.overdueItems(today).size();
+    const double storeOverdue = msSince(start) / reps;
+
+    std::printf("%8d items   bytes/item %6.1f -> %6.1f   availability scan %7.3f -> %7.3f ms"
+                "   overdue sweep %7.3f -> %7.3f ms   (%lld)\n",
+                items, legacyBytes, storeBytes, legacyAvail, storeAvail, legacyOverdue, storeOverdue, sink);
+}
+
+} // namespace
+
+int main()
+{
+    for (int items : {10000, 100000, 1000000})
+        run(items);
+    return 0;
+}
@@ -0,0 +1,4 @@
+TARGET = layout_bench
+include(store.pri)
+
+SOURCES += layout_bench.cpp
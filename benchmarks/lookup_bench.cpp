@@ -0,0 +1,83 @@
+// Lookup latency for DataStore::itemSlot / findItemById / findUserId / searchCatalogue at several catalogue sizes.
+// Build: qmake benchmarks.pro && make && ./lookup_bench
+#include "datastore.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Fill a standalone store with `items` synthetic items and items/10 patrons
+void populate(DataStore &ds, int items)
+{
+    const int patrons = std::max(1, items / 10);
+    for (int i = 1; i <= patrons; ++i)
+        ds.upsertUser(User{0, QString("patron%1").arg(i), UserType::Patron, {}, {}});
+    for (int i = 1; i <= items; ++i)
+        ds.addItem(Item{i, QString("Title %1").arg(i), "Bench Author", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+}
+
+double nsPerOp(Clock::time_point start, int ops)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    return double(ns) / ops;
+}
+
+void run(int items)
+{
+    DataStore ds(false);
+    populate(ds, items);
+
+    const int patrons = std::max(1, items / 10);
+    const int ops = 1000000;
+    std::mt19937 rng(42);
+    std::vector<int> ids(ops);
+    std::vector<QString> names(4096);
+    for (auto &id : ids)
+        id = std::uniform_int_distribution<int>(1, items)(rng);
+    for (auto &n : names)
+        n = QString("patron%1").arg(std::uniform_int_distribution<int>(1, patrons)(rng));
+
+    long long sink = 0;
+    auto start = Clock::now();
+    for (int id : ids)
+        sink += ds.itemSlot(id);
+    double slotNs = nsPerOp(start, ops);
+
+    // findItemById also assembles an Item copy from the metadata
+    start = Clock::now();
+    for (int id : ids)
+        sink += ds.findItemById(id)->id;
+    double itemNs = nsPerOp(start, ops);
+
+    start = Clock::now();
+    for (int i = 0; i < ops; ++i)
+        sink += ds.findUserId(names[i & 4095]);
+    double userNs = nsPerOp(start, ops);
+
+    // Top-20 search; the first call builds the index
+    start = Clock::now();
+    sink += (long long)ds.searchCatalogue("title", 20).size();
+    double indexMs = nsPerOp(start, 1) / 1e6;
+    const int queries = 10000;
+    start = Clock::now();
+    for (int i = 0; i < queries; ++i)
+        sink += (long long)ds.searchCatalogue(QString("title %1").arg(ids[i] / 10), 20).size();
+    double searchNs = nsPerOp(start, queries);
+
+    std::printf("%9d items %8d patrons   itemSlot %7.1f ns/op   findItemById %7.1f ns/op   findUserId %7.1f ns/op"
+                "   search %9.1f ns/op (index %.0f ms)   (%lld)\n",
+                items, patrons, slotNs, itemNs, userNs, searchNs, indexMs, sink);
+}
+
+} // namespace
+
+int main()
+{
+    for (int items : {1000, 100000, 1000000})
+        run(items);
+    return 0;
+}
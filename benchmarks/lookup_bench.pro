@@ -0,0 +1,4 @@
+TARGET = lookup_bench
+include(store.pri)
+
+SOURCES += lookup_bench.cpp
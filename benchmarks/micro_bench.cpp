@@ -0,0 +1,430 @@
+// Micro-benchmarks for the DataStore hot paths, plus the catalogue model
+// the patron window draws from. Reports the median ns and heap allocations
+// per operation over several rounds (after one warm-up round) and writes
+// them to a tab-separated file, one line per benchmark, so two builds can
+// be compared with diff or with --baseline.
+// Build: qmake benchmarks.pro && make && ./micro_bench [options]
+//   --items N       catalogue size (default 100000)
+//   --patrons N     patron count (default 10000)
+//   --rounds N      measured rounds (default 5)
+//   --storage DIR   journal into DIR as well (it should start empty)
+//   --out FILE      results file (default micro_bench.tsv)
+//   --baseline FILE print the change against an earlier results file
+#include "cataloguemodel.hpp"
+#include "datastore.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Every heap allocation made by the process
+static long long g_allocations = 0;
+
+void *operator new(std::size_t size)
+{
+    ++g_allocations;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int items = 100000;
+    int patrons = 10000;
+    int rounds = 5;
+    QString storage;
+    const char *out = "micro_bench.tsv";
+    const char *baseline = nullptr;
+};
+
+// ---------------------------------------------
+// Synthetic library
+// ---------------------------------------------
+// Deterministic for a given scale: titles and creators are drawn from small
+// word lists so searches find realistic numbers of hits, and every format
+// carries its own metadata fields.
+const char *const TitleWords[] = {"Silent", "River", "Shadow", "Garden", "Winter", "Empire", "Last", "Light",
+                                  "Broken", "Crown", "Ocean", "Night", "Iron", "Song", "Hidden", "City",
+                                  "Golden", "Road", "Storm", "House", "Lost", "Star", "Wild", "Heart"};
+const char *const Surnames[] = {"Atwood", "Baldwin", "Carver", "Dickens", "Eliot", "Faulkner", "Gaiman", "Hurston",
+                                "Ishiguro", "Joyce", "Kafka", "Le Guin", "Morrison", "Nabokov", "Orwell", "Pratchett"};
+const char *const Genres[] = {"Action", "Drama", "Comedy", "Sci-Fi", "Puzzle", "Sports"};
+const char *const Ratings[] = {"G", "PG", "PG-13", "R", "E", "E10+", "T", "M"};
+
+template <typename T, std::size_t N>
+const T &pick(const T (&words)[N], std::mt19937 &rng)
+{
+    return words[rng() % N];
+}
+
+struct Library {
+    std::vector<int> patronIds;
+    std::vector<QString> patronNames;
+    std::vector<int> itemIds;   // in slot order
+};
+
+Library generate(DataStore &ds, const Options &opt)
+{
+    Library lib;
+    std::mt19937 rng(2024);
+
+    // Start past whatever the store already holds (the demo items)
+    int nextId = 1;
+    for (int slot = 0; slot < ds.itemCount(); ++slot)
+        nextId = std::max(nextId, ds.itemIdAt(slot) + 1);
+
+    for (int i = 1; i <= opt.patrons; ++i)
+    {
+        QString name = QString("patron%1").arg(i);
+        lib.patronIds.push_back(ds.upsertUser(User{0, name, UserType::Patron, {}, {}}));
+        lib.patronNames.push_back(name);
+    }
+    for (int i = 0; i < opt.items; ++i)
+    {
+        Item item;
+        item.id = nextId++;
+        item.title = QString("%1 %2 %3").arg(pick(TitleWords, rng)).arg(pick(TitleWords, rng)).arg(i);
+        const char initial[] = {char('A' + rng() % 26), '\0'};
+        item.creator = QString("%1. %2").arg(initial).arg(pick(Surnames, rng));
+        item.format = ItemFormat(i % 5);
+        switch (item.format)
+        {
+            case ItemFormat::FictionBook:
+                break;
+            case ItemFormat::NonFictionBook:
+                item.dewey = QString("%1.%2").arg(int(rng() % 1000)).arg(int(rng() % 100));
+                break;
+            case ItemFormat::Magazine:
+                item.issue = QString::number(int(1 + rng() % 52));
+                item.pubDate = QString("20%1-%2").arg(int(10 + rng() % 15)).arg(int(1 + rng() % 12));
+                break;
+            case ItemFormat::Movie:
+            case ItemFormat::VideoGame:
+                item.genre = pick(Genres, rng);
+                item.rating = pick(Ratings, rng);
+                break;
+        }
+        lib.itemIds.push_back(item.id);
+        ds.addItem(std::move(item));
+    }
+    return lib;
+}
+
+// ---------------------------------------------
+// Measurement
+// ---------------------------------------------
+struct Result {
+    std::string name;
+    std::vector<double> ns;   // per round
+    double allocs = 0;        // per op, last round
+};
+
+class Suite
+{
+public:
+    explicit Suite(int rounds) : m_rounds(rounds) {}
+
+    // Run body(round) for the warm-up round 0 and then each measured round;
+    // body returns how many operations it did. Benchmarks whose state must
+    // alternate (borrow then return) use step() inside their own round loop.
+    template <typename Body>
+    void run(const char *name, Body &&body)
+    {
+        for (int round = 0; round <= m_rounds; ++round)
+            step(name, round, [&] { return body(round); });
+    }
+
+    template <typename Body>
+    void step(const char *name, int round, Body &&body)
+    {
+        const long long allocsBefore = g_allocations;
+        const auto start = Clock::now();
+        const long long ops = body();
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        if (round == 0 || ops == 0)
+            return;
+        Result &r = result(name);
+        r.ns.push_back(ns / ops);
+        r.allocs = double(g_allocations - allocsBefore) / ops;
+    }
+
+    int rounds() const { return m_rounds; }
+    std::vector<Result> &results() { return m_results; }
+
+private:
+    Result &result(const char *name)
+    {
+        for (Result &r : m_results)
+            if (r.name == name)
+                return r;
+        m_results.push_back(Result{name, {}, 0});
+        return m_results.back();
+    }
+
+    int m_rounds;
+    std::vector<Result> m_results;   // in first-run order
+};
+
+double median(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+// Earlier results file: name -> ns/op
+std::map<std::string, double> readResults(const char *path)
+{
+    std::map<std::string, double> out;
+    FILE *f = std::fopen(path, "r");
+    if (!f)
+        return out;
+    char line[512];
+    while (std::fgets(line, sizeof line, f))
+    {
+        if (line[0] == '#')
+            continue;
+        char name[256];
+        double ns = 0, allocs = 0;
+        if (std::sscanf(line, "%255[^\t]\t%lf\t%lf", name, &ns, &allocs) == 3)
+            out[name] = ns;
+    }
+    std::fclose(f);
+    return out;
+}
+
+bool parseOptions(int argc, char **argv, Options &opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+            return false;
+        if (!std::strcmp(arg, "--items"))
+            opt.items = std::max(1, std::atoi(value));
+        else if (!std::strcmp(arg, "--patrons"))
+            opt.patrons = std::max(1, std::atoi(value));
+        else if (!std::strcmp(arg, "--rounds"))
+            opt.rounds = std::max(1, std::atoi(value));
+        else if (!std::strcmp(arg, "--storage"))
+            opt.storage = QString::fromLocal8Bit(value);
+        else if (!std::strcmp(arg, "--out"))
+            opt.out = value;
+        else if (!std::strcmp(arg, "--baseline"))
+            opt.baseline = value;
+        else
+            return false;
+        ++i;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    if (!parseOptions(argc, argv, opt))
+    {
+        std::printf("usage: %s [--items N] [--patrons N] [--rounds N] [--storage DIR] [--out FILE] [--baseline FILE]\n",
+                    argv[0]);
+        return 2;
+    }
+
+    // The shared store, as the windows see it (it starts with the demo data)
+    DataStore &ds = DataStore::instance();
+    const Library lib = generate(ds, opt);
+    if (!opt.storage.isEmpty())
+    {
+        if (auto err = ds.openStorage(opt.storage))
+        {
+            std::printf("%s\n", qPrintable(*err));
+            return 1;
+        }
+    }
+
+    // A listener, as the patron window has, so change sets are published
+    long long published = 0;
+    const int subscription = ds.subscribe([&](const ChangeSet &) { ++published; });
+
+    Suite suite(opt.rounds);
+    std::mt19937 rng(7);
+    const int items = opt.items;
+    const int patrons = opt.patrons;
+
+    // Random probes, drawn up front so the loops time only the store
+    constexpr int Probes = 1 << 16;
+    std::vector<int> probeItems(Probes), probePatrons(Probes);
+    for (int i = 0; i < Probes; ++i)
+    {
+        probeItems[i] = lib.itemIds[rng() % items];
+        probePatrons[i] = int(rng() % patrons);
+    }
+
+    long long sink = 0;
+    suite.run("DataStore::findItemById", [&](int) {
+        for (int id : probeItems)
+            sink += ds.findItemById(id)->id;
+        return Probes;
+    });
+    suite.run("DataStore::findUserId", [&](int) {
+        for (int p : probePatrons)
+            sink += ds.findUserId(lib.patronNames[p]);
+        return Probes;
+    });
+
+    // Circulation: every active patron borrows MaxActiveLoans items, puts
+    // a hold on one more, returns the loans and cancels the hold, each as
+    // its own timed pass. Loans move around the lending range from round to
+    // round; holds sit in the range past it, HoldSharing patrons per item,
+    // so queues are short but not trivial.
+    constexpr int HoldSharing = 8;
+    const int active = std::max(1, std::min(patrons, items * HoldSharing / (Rules::MaxActiveLoans * HoldSharing + 1)));
+    const int holdItems = (active + HoldSharing - 1) / HoldSharing;
+    const int lendable = items - holdItems;
+    auto loanItem = [&](int p, int k, int round) {
+        return lib.itemIds[(p * Rules::MaxActiveLoans + k + round * 7919) % lendable];
+    };
+    auto holdItem = [&](int p) { return lib.itemIds[lendable + p / HoldSharing]; };
+    for (int round = 0; round <= suite.rounds(); ++round)
+    {
+        suite.step("DataStore::borrowItem", round, [&] {
+            for (int p = 0; p < active; ++p)
+                for (int k = 0; k < Rules::MaxActiveLoans; ++k)
+                    sink += !ds.borrowItem(lib.patronIds[p], loanItem(p, k, round));
+            return active * Rules::MaxActiveLoans;
+        });
+        suite.step("DataStore::placeHold", round, [&] {
+            for (int p = 0; p < active; ++p)
+                sink += !ds.placeHold(lib.patronIds[p], holdItem(p));
+            return active;
+        });
+        suite.step("DataStore::holdPosition", round, [&] {
+            for (int p : probePatrons)
+                sink += ds.holdPosition(lib.patronIds[p % active], holdItem(p % active));
+            return Probes;
+        });
+        suite.step("DataStore::returnItem", round, [&] {
+            for (int p = 0; p < active; ++p)
+                for (int k = 0; k < Rules::MaxActiveLoans; ++k)
+                    sink += !ds.returnItem(lib.patronIds[p], loanItem(p, k, round));
+            return active * Rules::MaxActiveLoans;
+        });
+        suite.step("DataStore::cancelHold", round, [&] {
+            for (int p = 0; p < active; ++p)
+                sink += !ds.cancelHold(lib.patronIds[p], holdItem(p));
+            return active;
+        });
+    }
+
+    // One long queue: the position query on a popular title
+    const int popular = lib.itemIds[0];
+    for (int id : lib.patronIds)
+        ds.placeHold(id, popular);
+    suite.run("DataStore::holdPosition (long queue)", [&](int) {
+        for (int p : probePatrons)
+            sink += ds.holdPosition(lib.patronIds[p], popular);
+        return Probes;
+    });
+    for (int id : lib.patronIds)
+        ds.cancelHold(id, popular);
+
+    suite.run("DataStore::searchCatalogue", [&](int) {
+        int ops = 0;
+        for (const char *word : TitleWords)
+        {
+            sink += (long long)ds.searchCatalogue(QString("%1 %2").arg(word).arg(Surnames[ops % 16]), 50).size();
+            ++ops;
+        }
+        return ops;
+    });
+
+    // Facet filters as the patron window issues them: one format on the
+    // shelf, and two genres in two ratings; then their sidebar counts
+    std::vector<FacetFilter> filters(2);
+    filters[0].formats = {ItemFormat::Movie};
+    filters[0].availableOnly = true;
+    filters[1].genres = {Genres[1], Genres[2]};
+    filters[1].ratings = {Ratings[1], Ratings[2]};
+    suite.run("DataStore::filterCatalogue", [&](int) {
+        for (int i = 0; i < 100; ++i)
+            sink += ds.filterCatalogue(filters[i % 2], 200).total;
+        return 100;
+    });
+    suite.run("DataStore::facetCounts", [&](int) {
+        for (int i = 0; i < 100; ++i)
+            sink += ds.facetCounts(filters[i % 2]).matches;
+        return 100;
+    });
+
+    // What populating the patron window's catalogue costs now that it is a
+    // model: opening it, then formatting one screenful of rows per op
+    constexpr int ScreenRows = 40;
+    suite.run("CatalogueModel (open)", [&](int) {
+        for (int i = 0; i < 1000; ++i)
+        {
+            CatalogueModel model;
+            sink += model.rowCount();
+        }
+        return 1000;
+    });
+    CatalogueModel model;
+    suite.run("CatalogueModel::data (screen)", [&](int) {
+        const int screens = 2000;
+        for (int s = 0; s < screens; ++s)
+        {
+            const int top = probeItems[s] % std::max(1, model.rowCount() - ScreenRows);
+            for (int row = top; row < top + ScreenRows && row < model.rowCount(); ++row)
+                for (int col = 0; col < CatalogueModel::ColumnCount; ++col)
+                    sink += model.data(model.index(row, col)).isValid();
+        }
+        return screens;
+    });
+    ds.unsubscribe(subscription);
+
+    // Report
+    const std::map<std::string, double> baseline = opt.baseline ? readResults(opt.baseline) : std::map<std::string, double>();
+    FILE *out = std::fopen(opt.out, "w");
+    if (!out)
+    {
+        std::printf("cannot write %s\n", opt.out);
+        return 1;
+    }
+    std::fprintf(out, "# micro_bench items=%d patrons=%d rounds=%d storage=%s\n", items, patrons, opt.rounds,
+                 opt.storage.isEmpty() ? "off" : "on");
+    std::fprintf(out, "# benchmark\tns_per_op\tallocs_per_op\n");
+    std::printf("%d items, %d patrons, median of %d rounds\n", items, patrons, opt.rounds);
+    for (const Result &r : suite.results())
+    {
+        const double ns = median(r.ns);
+        std::fprintf(out, "%s\t%.1f\t%.2f\n", r.name.c_str(), ns, r.allocs);
+        std::printf("%-38s %12.1f ns/op %8.2f allocs/op", r.name.c_str(), ns, r.allocs);
+        auto before = baseline.find(r.name);
+        if (before != baseline.end() && before->second > 0)
+            std::printf("   %+6.1f%% vs baseline", 100.0 * (ns - before->second) / before->second);
+        std::printf("\n");
+    }
+    std::fclose(out);
+    std::printf("%lld change sets published; results in %s (checksum %lld)\n", published, opt.out, sink);
+    return 0;
+}
@@ -0,0 +1,13 @@
+TARGET = micro_bench
+include(store.pri)
+
+# CatalogueModel reads availability through StoreClient
+QT += network
+
+SOURCES += micro_bench.cpp \
+    $$PWD/../cataloguemodel.cpp \
+    $$PWD/../storeclient.cpp
+
+HEADERS += \
+    $$PWD/../cataloguemodel.hpp \
+    $$PWD/../storeclient.hpp
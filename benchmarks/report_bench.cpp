@@ -0,0 +1,135 @@
+// Circulation reports over a large catalogue: the first full report at 1,
+// 2, 4 and 8 threads, then refreshes after a given number of borrows and
+// returns, which recount only the snapshot pages those touched. Checks
+// that every thread count gives the same report, that a refreshed report
+// matches one counted from scratch, and the snapshot's own totals.
+// Build: qmake benchmarks.pro && make && ./report_bench [items]
+#include "circulationreport.hpp"
+#include "datastore.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int Patrons = 100000;
+constexpr int HeldItems = 20000;
+const char *const Genres[] = {"Drama", "Comedy", "Action", "Documentary", "Horror", "Animation",
+                              "Strategy", "Puzzle", "Sports", "Racing", "Adventure", "Simulation"};
+
+void fillStore(DataStore &ds, int items)
+{
+    std::vector<Item> batch;
+    for (int i = 1; i <= items; ++i)
+    {
+        const ItemFormat format = ItemFormat(i % 5);
+        Item item{i, QString("Title %1").arg(i), QString("Creator %1").arg(i % 200000), format, {}, "", "", "", "", ""};
+        if (format == ItemFormat::NonFictionBook)
+            item.dewey = "500.1";
+        else if (format == ItemFormat::Magazine)
+            item.issue = "1", item.pubDate = "2024-01";
+        else if (format == ItemFormat::Movie || format == ItemFormat::VideoGame)
+            item.genre = Genres[i % 12], item.rating = format == ItemFormat::Movie ? "PG" : "E";
+        batch.push_back(std::move(item));
+        if ((int)batch.size() == 100000 || i == items)
+        {
+            ds.addItems(std::move(batch));
+            batch.clear();
+        }
+    }
+
+    // Three loans each, then queues of 1-12 patrons on some borrowed items
+    std::mt19937 rng(7);
+    for (int p = 0; p < Patrons; ++p)
+    {
+        const int id = ds.upsertUser(User{0, QString("patron%1").arg(p), UserType::Patron, {}, {}});
+        ds.borrowItems(id, {1 + int(rng() % items), 1 + int(rng() % items), 1 + int(rng() % items)});
+    }
+    for (int h = 0; h < HeldItems; ++h)
+    {
+        const int itemId = 1 + int(rng() % items);
+        for (int q = int(rng() % 12); q >= 0; --q)
+            ds.placeHold(1 + int(rng() % Patrons), itemId);
+    }
+}
+
+bool same(const CirculationReport::Counts &a, const CirculationReport::Counts &b)
+{
+    return a.items == b.items && a.onLoan == b.onLoan && a.onHoldShelf == b.onHoldShelf &&
+           a.queuedHolds == b.queuedHolds;
+}
+
+bool same(const CirculationReport &a, const CirculationReport &b)
+{
+    bool ok = same(a.total, b.total) && a.queueLengths == b.queueLengths && a.genres.size() == b.genres.size() &&
+              a.creators.size() == b.creators.size() && a.mostHeld.size() == b.mostHeld.size();
+    for (int f = 0; f < FacetCounts::FormatCount && ok; ++f)
+        ok = same(a.formats[f], b.formats[f]);
+    for (std::size_t g = 0; g < a.genres.size() && ok; ++g)
+        ok = a.genres[g].first == b.genres[g].first && same(a.genres[g].second, b.genres[g].second);
+    for (std::size_t c = 0; c < a.creators.size() && ok; ++c)
+        ok = a.creators[c].first == b.creators[c].first && same(a.creators[c].second, b.creators[c].second);
+    for (std::size_t h = 0; h < a.mostHeld.size() && ok; ++h)
+        ok = a.mostHeld[h].itemId == b.mostHeld[h].itemId && a.mostHeld[h].queued == b.mostHeld[h].queued;
+    return ok;
+}
+
+double msSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const int items = argc > 1 ? std::atoi(argv[1]) : 5000000;
+    DataStore ds(false);
+    fillStore(ds, items);
+    ds.snapshot();
+    std::printf("%d items, %d patrons\n", items, Patrons);
+
+    CirculationReporter reporter(ds, 1);
+    const CirculationReport &report = reporter.refresh();
+    const CirculationSnapshot::Totals &t = ds.snapshot()->totals();
+    bool ok = report.total.items == ds.itemCount() && report.total.onLoan == t.activeLoans &&
+              report.total.onHoldShelf == t.onHoldShelf && report.total.queuedHolds == t.queuedHolds;
+
+    for (int threads : {1, 2, 4, 8})
+    {
+        CirculationReporter parallel(ds, threads);
+        const auto t0 = Clock::now();
+        parallel.refresh();
+        std::printf("full report, %d threads %10.1f ms\n", threads, msSince(t0));
+        ok = ok && same(report, parallel.report());
+    }
+
+    std::mt19937 rng(11);
+    for (int changes : {1, 100, 10000})
+    {
+        // A patron returns a loan and borrows something else
+        for (int i = 0; i < changes; ++i)
+        {
+            int itemId = 0, borrower = 0;
+            while (!borrower)
+            {
+                itemId = 1 + int(rng() % items);
+                borrower = ds.statusAt(itemId - 1).borrower;
+            }
+            ds.returnItem(borrower, itemId);
+            ds.borrowItem(borrower, 1 + int(rng() % items));
+        }
+        const auto t0 = Clock::now();
+        reporter.refresh();
+        std::printf("refresh after %5d changes  %8.2f ms   (%d of %d pages)\n", changes, msSince(t0),
+                    report.pagesRecounted, report.pageCount);
+
+        CirculationReporter fresh(ds, 4);
+        ok = ok && same(report, fresh.refresh());
+    }
+    std::printf("refreshed reports match a full count: %s\n", ok ? "yes" : "NO");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,4 @@
+TARGET = report_bench
+include(store.pri)
+
+SOURCES += report_bench.cpp
@@ -0,0 +1,156 @@
+// Store server throughput: requests per second through StoreService alone,
+// then over a local socket from StoreClients at pipeline depths 1..64 and
+// from several clients at once. The server runs on its own thread, as
+// tools/hinlibsd would in its own process.
+// Build: qmake benchmarks.pro && make && ./server_bench
+#include "datastore.hpp"
+#include "storeclient.hpp"
+#include "storeprotocol.hpp"
+#include "storeserver.hpp"
+#include "storeservice.hpp"
+#include <QCoreApplication>
+#include <QThread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int Items = 10000;
+constexpr int Requests = 200000;
+constexpr int Clients = 4;
+
+void fillStore(DataStore &ds)
+{
+    for (int i = 1; i <= Items; ++i)
+        ds.addItem(Item{i, QString("Title %1").arg(i), "Author", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+    ds.upsertUser(User{0, "patron", UserType::Patron, {}, {}});
+}
+
+void report(const char *label, int requests, Clock::time_point start)
+{
+    const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    std::printf("%-32s %10.0f req/s   %7.2f us/req\n", label, requests / secs, secs / requests * 1e6);
+}
+
+// Lookups pipelined `depth` at a time; false if any reply was missing
+bool lookups(StoreClient &client, int requests, int depth, int seed)
+{
+    std::vector<int> ids(depth);
+    for (int done = 0; done < requests; done += depth)
+    {
+        for (int i = 0; i < depth; ++i)
+            ids[i] = 1 + (seed + done + i * 7919) % Items;
+        for (const std::optional<Item> &item : client.findItems(ids))
+            if (!item)
+                return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    bool ok = true;
+
+    // StoreService alone: decode, run and encode, no socket
+    {
+        DataStore ds(false);
+        fillStore(ds);
+        StoreService service(ds);
+        ByteWriter in, out;
+        for (int i = 0; i < Requests; ++i)
+        {
+            const std::size_t start = StoreProtocol::beginFrame(in, quint32(i + 1), quint8(StoreProtocol::Request::FindItem));
+            in.putSVarint(1 + (i * 7919) % Items);
+            StoreProtocol::endFrame(in, start);
+        }
+        StoreService::Session session;
+        const auto start = Clock::now();
+        ok = service.handle(in.data(), in.size(), out, session) == in.size() && ok;
+        report("service only (findItem)", Requests, start);
+    }
+
+    DataStore serverStore(false), localStore(false);
+    fillStore(serverStore);
+    fillStore(localStore);
+    const QString name = QString("hinlibs-bench-%1").arg(QCoreApplication::applicationPid());
+
+    QThread serverThread;
+    auto *server = new StoreServer(serverStore);
+    server->moveToThread(&serverThread);
+    QObject::connect(&serverThread, &QThread::finished, server, &QObject::deleteLater);
+    serverThread.start();
+    std::optional<QString> err;
+    QMetaObject::invokeMethod(server, [&] { err = server->listen(name); }, Qt::BlockingQueuedConnection);
+    if (err)
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(*err));
+        serverThread.quit();
+        serverThread.wait();
+        return 1;
+    }
+
+    {
+        StoreClient client(localStore);
+        if ((err = client.connectToServer(name)))
+        {
+            std::fprintf(stderr, "%s\n", qPrintable(*err));
+            ok = false;
+        }
+        else
+        {
+            for (int depth : {1, 16, 64})
+            {
+                const auto start = Clock::now();
+                ok = lookups(client, Requests, depth, 0) && ok;
+                report(qPrintable(QString("1 client, depth %1 (findItem)").arg(depth)), Requests, start);
+            }
+
+            // Circulation: each borrow/return publishes a change pushed back
+            // to this (subscribed) client
+            const int patron = client.findUserId("patron");
+            const int pairs = Requests / 10;
+            const auto start = Clock::now();
+            for (int i = 0; i < pairs; ++i)
+            {
+                const int itemId = 1 + (i * 7919) % Items;
+                ok = !client.borrowItem(patron, itemId) && !client.returnItem(patron, itemId) && ok;
+                if (i % 256 == 0)
+                    QCoreApplication::processEvents();   // deliver the pushed changes
+            }
+            report("1 client, depth 1 (borrow+return)", 2 * pairs, start);
+        }
+    }
+
+    // Several terminals at once; the server is still one thread
+    {
+        std::atomic<bool> allOk{true};
+        std::vector<std::thread> pool;
+        const auto start = Clock::now();
+        for (int c = 0; c < Clients; ++c)
+        {
+            pool.emplace_back([&, c] {
+                StoreClient client(localStore);
+                if (client.connectToServer(name) || !lookups(client, Requests / Clients, 16, c * 1000))
+                    allOk = false;
+            });
+        }
+        for (std::thread &t : pool)
+            t.join();
+        ok = ok && allOk;
+        report(qPrintable(QString("%1 clients, depth 16 (findItem)").arg(Clients)), Requests, start);
+    }
+
+    serverThread.quit();
+    serverThread.wait();
+    if (!ok)
+        std::printf("some requests FAILED\n");
+    return ok ? 0 : 1;
+}
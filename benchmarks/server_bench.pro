@@ -0,0 +1,12 @@
+TARGET = server_bench
+include(store.pri)
+
+QT += network
+
+SOURCES += server_bench.cpp \
+    $$PWD/../storeclient.cpp \
+    $$PWD/../storeserver.cpp
+
+HEADERS += \
+    $$PWD/../storeclient.hpp \
+    $$PWD/../storeserver.hpp
@@ -0,0 +1,141 @@
+// Snapshot reads against live circulation: borrow/return throughput from
+// several threads alone, then while one reader scans the whole catalogue
+// over and over, either through statusAt() (an item lock per row) or from
+// snapshot() (no locks). Then what publishing a snapshot costs after a
+// given number of changes, and a check that a snapshot matches the store.
+// Build: qmake benchmarks.pro && make && ./snapshot_bench
+#include "datastore.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int Items = 1000000;
+constexpr int Writers = 4;
+constexpr int PatronsPerWriter = 64;
+constexpr int RunMs = 1500;
+
+enum class Reader { None, StatusAt, Snapshot };
+
+void fillStore(DataStore &ds)
+{
+    for (int i = 1; i <= Items; ++i)
+        ds.addItem(Item{i, QString("Title %1").arg(i), "Author", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+    for (int p = 0; p < Writers * PatronsPerWriter; ++p)
+        ds.upsertUser(User{0, QString("patron%1").arg(p), UserType::Patron, {}, {}});
+}
+
+// Writers borrow and return for RunMs; returns circulation calls per second
+// and the number of full catalogue passes the reader finished meanwhile
+std::pair<double, int> run(DataStore &ds, Reader reader)
+{
+    std::atomic<bool> stop{false};
+    std::atomic<long long> calls{0};
+    std::vector<std::thread> writers;
+    for (int w = 0; w < Writers; ++w)
+    {
+        writers.emplace_back([&, w] {
+            std::mt19937 rng(99 + w);
+            long long done = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                const int patron = 1 + w * PatronsPerWriter + int(rng() % PatronsPerWriter);
+                const int itemId = 1 + int(rng() % Items);
+                if (!ds.borrowItem(patron, itemId))
+                    ds.returnItem(patron, itemId);
+                done += 2;
+            }
+            calls += done;
+        });
+    }
+
+    int passes = 0;
+    long long sink = 0;
+    const auto start = Clock::now();
+    while (Clock::now() - start < std::chrono::milliseconds(RunMs))
+    {
+        if (reader == Reader::StatusAt)
+        {
+            for (int slot = 0; slot < Items; ++slot)
+                sink += ds.statusAt(slot).available;
+            ++passes;
+        }
+        else if (reader == Reader::Snapshot)
+        {
+            const std::shared_ptr<const CirculationSnapshot> snap = ds.snapshot();
+            for (int slot = 0; slot < snap->itemCount(); ++slot)
+                sink += snap->borrowerAt(slot) == 0;
+            ++passes;
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    stop = true;
+    for (std::thread &t : writers)
+        t.join();
+    const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    if (sink < 0)
+        std::printf("unreachable\n");
+    return {double(calls.load()) / secs, passes};
+}
+
+} // namespace
+
+int main()
+{
+    DataStore ds(false);
+    fillStore(ds);
+    std::printf("%d items, %d writer threads\n", Items, Writers);
+
+    auto t0 = Clock::now();
+    ds.snapshot();
+    std::printf("first snapshot (every item)      %10.2f ms\n",
+                std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+
+    const char *names[] = {"no reader", "reader via statusAt", "reader via snapshot"};
+    for (Reader reader : {Reader::None, Reader::StatusAt, Reader::Snapshot})
+    {
+        const auto result = run(ds, reader);
+        std::printf("%-32s %10.0f calls/s   %4d catalogue passes\n", names[int(reader)], result.first,
+                    result.second);
+    }
+
+    // Publishing cost follows the changes since the previous snapshot
+    const int patron = 1;
+    for (int changes : {0, 1, 100, 10000})
+    {
+        ds.snapshot();
+        for (int i = 0; i < changes; ++i)
+        {
+            const int itemId = 1 + (i * 7919) % Items;
+            if (ds.borrowItem(patron, itemId))
+                continue;
+            ds.returnItem(patron, itemId);
+        }
+        t0 = Clock::now();
+        ds.snapshot();
+        std::printf("snapshot after %6d borrow+returns %8.1f us\n", changes,
+                    std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    }
+
+    // Nothing moves now, so a snapshot must agree with the store item by item
+    const std::shared_ptr<const CirculationSnapshot> snap = ds.snapshot();
+    bool ok = snap->itemCount() == ds.itemCount() && snap->availableCount() == ds.availableCount();
+    for (int slot = 0; slot < snap->itemCount() && ok; ++slot)
+    {
+        const ItemStatus live = ds.statusAt(slot);
+        const ItemStatus seen = snap->statusAt(slot);
+        ok = snap->idAt(slot) == ds.itemIdAt(slot) && live.available == seen.available &&
+             live.borrower == seen.borrower && live.readyFor == seen.readyFor && live.dueDate == seen.dueDate;
+    }
+    std::printf("snapshot matches the store: %s\n", ok ? "yes" : "NO");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,4 @@
+TARGET = snapshot_bench
+include(store.pri)
+
+SOURCES += snapshot_bench.cpp
@@ -0,0 +1,9 @@
+# Settings shared by the benchmark programs: console programs on the store
+# core (../core.pri); no GUI code is linked in.
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+include(../core.pri)
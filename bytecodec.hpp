@@ -0,0 +1,160 @@
+#pragma once
+#include <QString>
+#include <QByteArray>
+#include <vector>
+#include <cstddef>
+
+// ---------------------------------------------
+// Binary encoding helpers for the on-disk formats and the wire protocol
+// ---------------------------------------------
+// Fixed-width integers are little-endian; varints are LEB128 and signed
+// values are zig-zag encoded. Strings are a varint length plus UTF-8.
+class ByteWriter
+{
+public:
+    void putU8(quint8 v) { m_buf.push_back(char(v)); }
+    void putU32(quint32 v)
+    {
+        for (int i = 0; i < 4; ++i)
+            m_buf.push_back(char(v >> (8 * i)));
+    }
+    void putU64(quint64 v)
+    {
+        for (int i = 0; i < 8; ++i)
+            m_buf.push_back(char(v >> (8 * i)));
+    }
+    void putVarint(quint64 v)
+    {
+        while (v >= 0x80)
+        {
+            m_buf.push_back(char(v | 0x80));
+            v >>= 7;
+        }
+        m_buf.push_back(char(v));
+    }
+    void putSVarint(qint64 v) { putVarint((quint64(v) << 1) ^ quint64(v >> 63)); }
+    void putString(const QString &s)
+    {
+        const QByteArray utf8 = s.toUtf8();
+        putVarint(quint64(utf8.size()));
+        putBytes(utf8.constData(), std::size_t(utf8.size()));
+    }
+    void putBytes(const char *data, std::size_t size) { m_buf.insert(m_buf.end(), data, data + size); }
+    //Overwrite four bytes already written (e.g. a length known only later)
+    void patchU32(std::size_t at, quint32 v)
+    {
+        for (int i = 0; i < 4; ++i)
+            m_buf[at + i] = char(v >> (8 * i));
+    }
+
+    const char *data() const { return m_buf.data(); }
+    std::size_t size() const { return m_buf.size(); }
+    void clear() { m_buf.clear(); }
+
+private:
+    std::vector<char> m_buf;
+};
+
+// Reads what ByteWriter wrote. Running past the end (or a malformed varint)
+// clears ok() and yields zeros instead of throwing.
+class ByteReader
+{
+public:
+    ByteReader(const char *data, std::size_t size) : m_p(data), m_end(data + size) {}
+
+    quint8 u8() { return need(1) ? quint8(*m_p++) : 0; }
+    quint32 u32()
+    {
+        quint32 v = 0;
+        if (need(4))
+            for (int i = 0; i < 4; ++i)
+                v |= quint32(quint8(*m_p++)) << (8 * i);
+        return v;
+    }
+    quint64 u64()
+    {
+        quint64 v = 0;
+        if (need(8))
+            for (int i = 0; i < 8; ++i)
+                v |= quint64(quint8(*m_p++)) << (8 * i);
+        return v;
+    }
+    quint64 varint()
+    {
+        quint64 v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (!need(1))
+                return 0;
+            const quint8 b = quint8(*m_p++);
+            v |= quint64(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        m_ok = false;
+        return 0;
+    }
+    qint64 svarint()
+    {
+        const quint64 v = varint();
+        return qint64(v >> 1) ^ -qint64(v & 1);
+    }
+    QString string()
+    {
+        const std::size_t n = std::size_t(varint());
+        if (!need(n))
+            return QString();
+        QString s = QString::fromUtf8(m_p, int(n));
+        m_p += n;
+        return s;
+    }
+    const char *bytes(std::size_t n)
+    {
+        if (!need(n))
+            return nullptr;
+        const char *p = m_p;
+        m_p += n;
+        return p;
+    }
+
+    //Reject the input (e.g. a count the remaining bytes cannot hold)
+    void fail() { m_ok = false; }
+    bool ok() const { return m_ok; }
+    bool atEnd() const { return m_p == m_end; }
+    std::size_t remaining() const { return std::size_t(m_end - m_p); }
+
+private:
+    bool need(std::size_t n)
+    {
+        if (!m_ok || std::size_t(m_end - m_p) < n)
+        {
+            m_ok = false;
+            return false;
+        }
+        return true;
+    }
+
+    const char *m_p;
+    const char *m_end;
+    bool m_ok = true;
+};
+
+// CRC-32 (IEEE) used to detect torn or corrupted blocks
+inline quint32 crc32(const char *data, std::size_t size)
+{
+    static const auto table = [] {
+        std::vector<quint32> t(256);
+        for (quint32 i = 0; i < 256; ++i)
+        {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    quint32 crc = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ quint8(data[i])) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
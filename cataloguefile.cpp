@@ -0,0 +1,213 @@
+#include "cataloguefile.hpp"
+#include "bytecodec.hpp"
+#include <QSaveFile>
+#include <cstring>
+#include <limits>
+
+namespace {
+const char CatalogueMagic[4] = {'H', 'C', 'A', 'T'};
+constexpr quint64 HeaderBytes = 64;
+constexpr quint32 RecordBytes = 36;
+
+// Fields that only some formats carry; others must leave them empty
+bool fieldAllowed(ItemFormat format, CatalogueFile::Field f)
+{
+    switch (f)
+    {
+        case CatalogueFile::Dewey:   return format == ItemFormat::NonFictionBook;
+        case CatalogueFile::Issue:
+        case CatalogueFile::PubDate: return format == ItemFormat::Magazine;
+        case CatalogueFile::Genre:
+        case CatalogueFile::Rating:  return format == ItemFormat::Movie || format == ItemFormat::VideoGame;
+        default:                     return true;
+    }
+}
+
+quint32 readU32(const uchar *p)
+{
+    quint32 v;
+    std::memcpy(&v, p, sizeof v);   // files are little-endian, as are all our targets
+    return v;
+}
+} // namespace
+
+struct CatalogueFile::Record {
+    qint32 id;
+    quint8 format;
+    quint8 reserved[3];
+    quint32 strings[FieldCount];
+};
+
+std::optional<QString> CatalogueFile::open(const QString &path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return QString("Cannot open catalogue %1: %2").arg(path, m_file.errorString());
+
+    const qint64 size = m_file.size();
+    if (size < qint64(HeaderBytes))
+        return QString("%1 is not a HinLIBS catalogue.").arg(path);
+    m_base = m_file.map(0, size);
+    if (!m_base)
+        return QString("Cannot map catalogue %1: %2").arg(path, m_file.errorString());
+
+    ByteReader header(reinterpret_cast<const char *>(m_base), HeaderBytes);
+    const char *magic = header.bytes(sizeof CatalogueMagic);
+    const quint32 version = header.u32();
+    const quint32 recordSize = header.u32();
+    const quint32 count = header.u32();
+    const quint64 recordsOffset = header.u64();
+    const quint64 stringsOffset = header.u64();
+    const quint64 stringsSize = header.u64();
+
+    if (!std::equal(magic, magic + sizeof CatalogueMagic, CatalogueMagic))
+        return QString("%1 is not a HinLIBS catalogue.").arg(path);
+    if (version != FormatVersion || recordSize != RecordBytes)
+        return QString("Catalogue %1 has unsupported version %2.").arg(path).arg(version);
+    // Compared as room left after each offset, so no sum can wrap around
+    if (recordsOffset % 4 || stringsOffset % 4 || recordsOffset > quint64(size) || stringsOffset > quint64(size)
+        || quint64(count) > (quint64(size) - recordsOffset) / RecordBytes
+        || stringsSize > quint64(size) - stringsOffset || count > quint32(std::numeric_limits<int>::max()))
+        return QString("Catalogue %1 is truncated or corrupt.").arg(path);
+
+    m_records = m_base + recordsOffset;
+    m_strings = m_base + stringsOffset;
+    m_stringsSize = stringsSize;
+    m_count = int(count);
+
+    // The format indexes per-format tables (facets, reports), so a bad
+    // byte must stop the file here rather than reach them
+    for (int slot = 0; slot < m_count; ++slot)
+    {
+        if (record(slot)->format > quint8(ItemFormat::VideoGame))
+        {
+            const int id = idAt(slot);
+            m_count = 0;
+            return QString("Catalogue %1: item %2 has unknown format %3.").arg(path).arg(id).arg(int(record(slot)->format));
+        }
+    }
+    return std::nullopt;
+}
+
+const CatalogueFile::Record *CatalogueFile::record(int slot) const
+{
+    static_assert(sizeof(Record) == RecordBytes, "record layout must match the file format");
+    return reinterpret_cast<const Record *>(m_records + quint64(slot) * RecordBytes);
+}
+
+int CatalogueFile::idAt(int slot) const
+{
+    return record(slot)->id;
+}
+
+ItemFormat CatalogueFile::formatAt(int slot) const
+{
+    return ItemFormat(record(slot)->format);
+}
+
+QString CatalogueFile::field(int slot, Field f) const
+{
+    const quint32 offset = record(slot)->strings[f];
+    if (offset == 0 || quint64(offset) + 4 > m_stringsSize)
+        return QString();
+    const quint32 length = readU32(m_strings + offset);
+    if (quint64(offset) + 4 + quint64(length) * 2 > m_stringsSize)
+        return QString();
+    return QString::fromRawData(reinterpret_cast<const QChar *>(m_strings + offset + 4), int(length));
+}
+
+Item CatalogueFile::itemAt(int slot) const
+{
+    Item it;
+    it.id = idAt(slot);
+    it.format = formatAt(slot);
+    it.title = field(slot, Title);
+    it.creator = field(slot, Creator);
+    it.dewey = field(slot, Dewey);
+    it.issue = field(slot, Issue);
+    it.pubDate = field(slot, PubDate);
+    it.genre = field(slot, Genre);
+    it.rating = field(slot, Rating);
+    return it;
+}
+
+CatalogueWriter::CatalogueWriter()
+{
+    // offset 0: the shared empty string
+    m_strings.assign(4, 0);
+}
+
+std::optional<QString> CatalogueWriter::add(const Item &item)
+{
+    if (item.id <= 0)
+        return QString("Item id %1 is not a positive number.").arg(item.id);
+    if (!m_ids.insert(item.id).second)
+        return QString("Item id %1 appears more than once.").arg(item.id);
+    if (item.title.isEmpty())
+        return QString("Item %1 has no title.").arg(item.id);
+
+    const QString fields[CatalogueFile::FieldCount] = {item.title, item.creator, item.dewey, item.issue,
+                                                        item.pubDate, item.genre, item.rating};
+    ByteWriter rec;
+    rec.putU32(quint32(item.id));
+    rec.putU8(quint8(item.format));
+    rec.putU8(0);
+    rec.putU8(0);
+    rec.putU8(0);
+    for (int f = 0; f < CatalogueFile::FieldCount; ++f)
+    {
+        // drop fields the format does not use instead of storing them
+        const bool keep = fieldAllowed(item.format, CatalogueFile::Field(f));
+        rec.putU32(keep ? intern(fields[f]) : 0);
+    }
+    m_records.insert(m_records.end(), rec.data(), rec.data() + rec.size());
+    return std::nullopt;
+}
+
+quint32 CatalogueWriter::intern(const QString &s)
+{
+    if (s.isEmpty())
+        return 0;
+    auto found = m_offsets.find(s);
+    if (found != m_offsets.end())
+        return found->second;
+
+    const quint32 offset = quint32(m_strings.size());
+    ByteWriter entry;
+    entry.putU32(quint32(s.size()));
+    entry.putBytes(reinterpret_cast<const char *>(s.utf16()), std::size_t(s.size()) * 2);
+    while (entry.size() % 4)
+        entry.putU8(0);
+    m_strings.insert(m_strings.end(), entry.data(), entry.data() + entry.size());
+    m_offsets.emplace(s, offset);
+    return offset;
+}
+
+std::optional<QString> CatalogueWriter::write(const QString &path) const
+{
+    if (m_strings.size() > 0xFFFFFFFFu)
+        return QString("Catalogue strings exceed the 4 GiB format limit.");
+
+    const quint64 recordsOffset = HeaderBytes;
+    const quint64 stringsOffset = recordsOffset + m_records.size();
+    ByteWriter header;
+    header.putBytes(CatalogueMagic, sizeof CatalogueMagic);
+    header.putU32(CatalogueFile::FormatVersion);
+    header.putU32(RecordBytes);
+    header.putU32(quint32(count()));
+    header.putU64(recordsOffset);
+    header.putU64(stringsOffset);
+    header.putU64(m_strings.size());
+    while (header.size() < HeaderBytes)
+        header.putU8(0);
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return QString("Cannot write catalogue %1: %2").arg(path, file.errorString());
+    file.write(header.data(), qint64(header.size()));
+    file.write(m_records.data(), qint64(m_records.size()));
+    file.write(m_strings.data(), qint64(m_strings.size()));
+    if (!file.commit())
+        return QString("Cannot write catalogue %1: %2").arg(path, file.errorString());
+    return std::nullopt;
+}
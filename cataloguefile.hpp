@@ -0,0 +1,75 @@
+#pragma once
+#include "models.hpp"
+#include <QFile>
+#include <QString>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// ---------------------------------------------
+// CatalogueFile: read-only, memory-mapped item metadata
+// ---------------------------------------------
+// Layout (little-endian, version 1):
+//   Header   64 bytes   magic "HCAT", version, record size, count,
+//                       records offset, strings offset/size
+//   Records  36 bytes   id, format, then 7 string offsets
+//   Strings             [u32 UTF-16 length][UTF-16 data], 4-byte aligned;
+//                       offset 0 is the empty string, equal strings shared
+// Strings are handed out with QString::fromRawData, so reading a field
+// neither parses nor copies; the file stays mapped for the object's life.
+class CatalogueFile
+{
+public:
+    static constexpr quint32 FormatVersion = 1;
+
+    enum Field { Title, Creator, Dewey, Issue, PubDate, Genre, Rating, FieldCount };
+
+    CatalogueFile() = default;
+    CatalogueFile(const CatalogueFile &) = delete;
+    CatalogueFile &operator=(const CatalogueFile &) = delete;
+
+    //Map and validate a catalogue file
+    std::optional<QString> open(const QString &path);
+
+    int count() const { return m_count; }
+    int idAt(int slot) const;
+    ItemFormat formatAt(int slot) const;
+    QString field(int slot, Field f) const;
+
+    //All metadata of one record (status left at its default)
+    Item itemAt(int slot) const;
+
+private:
+    struct Record;
+    const Record *record(int slot) const;
+
+    QFile m_file;
+    const uchar *m_base = nullptr;
+    const uchar *m_records = nullptr;
+    const uchar *m_strings = nullptr;
+    quint64 m_stringsSize = 0;
+    int m_count = 0;
+};
+
+// Builds a catalogue file; records are kept in the order they are added
+class CatalogueWriter
+{
+public:
+    CatalogueWriter();
+
+    //Validate and append one item; returns an error for bad rows
+    std::optional<QString> add(const Item &item);
+
+    int count() const { return int(m_records.size() / RecordBytes); }
+    std::optional<QString> write(const QString &path) const;
+
+private:
+    static constexpr std::size_t RecordBytes = 36;
+    quint32 intern(const QString &s);
+
+    std::vector<char> m_records;
+    std::vector<char> m_strings;
+    std::unordered_map<QString, quint32, QStringHash> m_offsets;
+    std::unordered_set<int> m_ids;
+};
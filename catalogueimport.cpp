@@ -0,0 +1,327 @@
+#include "catalogueimport.hpp"
+#include "csvreader.hpp"
+#include "datastore.hpp"
+#include <QDate>
+#include <algorithm>
+
+namespace {
+
+constexpr qint64 ChunkBytes = 1 << 20;
+constexpr int ChunksAheadPerThread = 4;
+
+const char *const ColumnNames[] = {"id", "title", "creator", "format", "dewey",
+                                   "issue", "pubdate", "genre", "rating"};
+const char *const MovieRatings[] = {"G", "PG", "PG-13", "R", "NC-17", "NR"};
+const char *const GameRatings[] = {"EC", "E", "E10+", "T", "M", "AO", "RP"};
+
+// Dewey class: three digits, optionally a point and more digits ("530.12")
+bool isDewey(const QString &s)
+{
+    const int n = s.size();
+    if (n < 3 || n == 4)
+        return false;
+    for (int i = 0; i < n; ++i)
+    {
+        const ushort c = s.at(i).unicode();
+        if (i == 3 ? c != '.' : c < '0' || c > '9')
+            return false;
+    }
+    return true;
+}
+
+// "yyyy-MM" or "yyyy-MM-dd"
+bool isPubDate(const QString &s)
+{
+    if (s.size() == 7)
+        return QDate::fromString(s + "-01", "yyyy-MM-dd").isValid();
+    return s.size() == 10 && QDate::fromString(s, "yyyy-MM-dd").isValid();
+}
+
+template <std::size_t N>
+bool isOneOf(const QString &s, const char *const (&values)[N])
+{
+    return std::any_of(values, values + N, [&s](const char *v) { return s == v; });
+}
+
+} // namespace
+
+CatalogueImporter::CatalogueImporter(DataStore &store, int threads)
+    : m_store(store)
+    , m_threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency())))
+{
+    std::fill(m_columns, m_columns + ColumnCount, -1);
+}
+
+CatalogueImporter::~CatalogueImporter()
+{
+    cancel();
+    for (std::thread &t : m_threads)
+        t.join();
+    if (m_indexer.joinable())
+        m_indexer.join();
+}
+
+std::optional<QString> CatalogueImporter::start(const QString &path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return QString("Cannot open %1: %2").arg(path, m_file.errorString());
+    m_size = m_file.size();
+    m_data = m_size > 0 ? reinterpret_cast<const char *>(m_file.map(0, m_size)) : nullptr;
+    if (!m_data)
+        return QString("%1 is empty or cannot be mapped.").arg(path);
+
+    // Header row -> column positions
+    CsvReader csv(m_data, std::size_t(m_size));
+    std::vector<QString> header;
+    if (!csv.next(header))
+        return QString("%1 has no header row.").arg(path);
+    for (int i = 0; i < (int)header.size(); ++i)
+        for (int c = 0; c < ColumnCount; ++c)
+            if (header[i].trimmed().toLower() == ColumnNames[c])
+                m_columns[c] = i;
+    for (Column required : {Title, Format})
+        if (m_columns[required] < 0)
+            return QString("%1: missing required column '%2'.").arg(path, ColumnNames[required]);
+
+    m_splitAt = qint64(csv.offset());
+    m_nextLine = 2;
+    m_bytesDone = m_splitAt;
+    m_parsersRunning = m_threadCount;
+    for (int t = 0; t < m_threadCount; ++t)
+        m_threads.emplace_back([this] { parseLoop(); });
+    return std::nullopt;
+}
+
+void CatalogueImporter::parseLoop()
+{
+    for (;;)
+    {
+        int index = 0, firstLine = 0;
+        qint64 begin = 0, end = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_chunkTaken.wait(lock, [this] {
+                return m_cancelled || m_splitAt >= m_size ||
+                       m_claimed - m_inserted < m_threadCount * ChunksAheadPerThread;
+            });
+            if (m_cancelled || m_splitAt >= m_size)
+                break;
+
+            // Claim ~ChunkBytes ending after a line break outside quotes.
+            // Both counts are vectorized scans; parsing is the slow part
+            // and happens unlocked.
+            begin = m_splitAt;
+            end = std::min(m_size, begin + ChunkBytes);
+            bool quoted = std::count(m_data + begin, m_data + end, '"') % 2;
+            while (end < m_size)
+            {
+                const char c = m_data[end++];
+                if (c == '"')
+                    quoted = !quoted;
+                else if (c == '\n' && !quoted)
+                    break;
+            }
+            index = m_claimed++;
+            firstLine = m_nextLine;
+            m_nextLine += int(std::count(m_data + begin, m_data + end, '\n'));
+            m_splitAt = end;
+        }
+
+        Chunk chunk = parse(m_data + begin, std::size_t(end - begin), firstLine);
+        chunk.endOffset = end;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_parsed.emplace(index, std::move(chunk));
+        }
+        m_chunkParsed.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_parsersRunning;
+    }
+    m_chunkParsed.notify_all();
+}
+
+CatalogueImporter::Chunk CatalogueImporter::parse(const char *data, std::size_t size, int firstLine) const
+{
+    Chunk chunk;
+    CsvReader csv(data, size);
+    std::vector<QString> row;
+    auto cell = [&](Column c) {
+        return m_columns[c] >= 0 && m_columns[c] < (int)row.size() ? row[m_columns[c]].trimmed() : QString();
+    };
+    while (csv.next(row))
+    {
+        if (row.size() == 1 && row[0].isEmpty())
+            continue; // blank line
+        const int line = firstLine + csv.line() - 1;
+
+        Item item;
+        const QString id = cell(Id);
+        bool idOk = true;
+        item.id = id.isEmpty() ? 0 : id.toInt(&idOk);
+        const auto format = formatFromString(cell(Format));
+        if (!idOk || (!id.isEmpty() && item.id <= 0))
+        {
+            chunk.problems.push_back(Problem{line, QString("id '%1' is not a positive number").arg(id)});
+            continue;
+        }
+        if (!format)
+        {
+            chunk.problems.push_back(Problem{line, QString("unknown format '%1'").arg(cell(Format))});
+            continue;
+        }
+        item.format = *format;
+        item.title = cell(Title);
+        item.creator = cell(Creator);
+        item.dewey = cell(Dewey);
+        item.issue = cell(Issue);
+        item.pubDate = cell(PubDate);
+        item.genre = cell(Genre);
+        item.rating = cell(Rating);
+        if (auto err = validate(item))
+        {
+            chunk.problems.push_back(Problem{line, *err});
+            continue;
+        }
+        chunk.items.push_back(std::move(item));
+        chunk.lines.push_back(line);
+    }
+    return chunk;
+}
+
+std::optional<QString> CatalogueImporter::validate(const Item &item)
+{
+    if (item.title.isEmpty())
+        return QString("no title");
+    switch (item.format)
+    {
+        case ItemFormat::FictionBook:
+            break;
+        case ItemFormat::NonFictionBook:
+            if (!isDewey(item.dewey))
+                return QString("non-fiction needs a Dewey number such as 530.12, not '%1'").arg(item.dewey);
+            break;
+        case ItemFormat::Magazine:
+            if (item.issue.isEmpty())
+                return QString("magazine has no issue");
+            if (!isPubDate(item.pubDate))
+                return QString("magazine publication date '%1' is not yyyy-MM or yyyy-MM-dd").arg(item.pubDate);
+            break;
+        case ItemFormat::Movie:
+        case ItemFormat::VideoGame:
+            if (item.genre.isEmpty())
+                return QString("%1 has no genre").arg(formatToString(item.format).toLower());
+            if (item.format == ItemFormat::Movie ? !isOneOf(item.rating, MovieRatings)
+                                                 : !isOneOf(item.rating, GameRatings))
+                return QString("unknown %1 rating '%2'").arg(formatToString(item.format).toLower(), item.rating);
+            break;
+    }
+    return std::nullopt;
+}
+
+bool CatalogueImporter::insertReady(bool wait)
+{
+    if (m_indexing)
+    {
+        if (!m_indexed && !wait)
+            return true;
+        m_indexer.join();
+        m_indexing = false;
+        m_finished = true;
+    }
+    if (m_finished || !m_data || m_cancelled)
+        return false;
+
+    std::vector<Chunk> ready;
+    bool parsing = true;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto take = [this, &ready] {
+            for (auto next = m_parsed.find(m_inserted + int(ready.size())); next != m_parsed.end();
+                 next = m_parsed.find(m_inserted + int(ready.size())))
+            {
+                ready.push_back(std::move(next->second));
+                m_parsed.erase(next);
+            }
+        };
+        take();
+        if (wait && ready.empty())
+        {
+            m_chunkParsed.wait(lock, [this] {
+                return m_cancelled || m_parsersRunning == 0 || m_parsed.count(m_inserted);
+            });
+            take();
+        }
+        parsing = m_parsersRunning > 0 || !m_parsed.empty();
+    }
+
+    for (Chunk &chunk : ready)
+    {
+        if (m_cancelled)
+            return false;
+        for (Problem &p : chunk.problems)
+            addProblem(p.line, std::move(p.message));
+        const std::vector<int> lines = std::move(chunk.lines);
+        const DataStore::BatchResult results = m_store.addItems(std::move(chunk.items));
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            if (results[i])
+                addProblem(lines[i], *results[i]);
+            else
+                ++m_imported;
+        }
+        m_bytesDone = chunk.endOffset;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_inserted;
+        }
+        m_chunkTaken.notify_all();
+    }
+    if (parsing || m_cancelled)
+        return !m_cancelled;
+
+    // Every row is in: one pass over the new items for search and facets
+    for (std::thread &t : m_threads)
+        t.join();
+    m_threads.clear();
+    m_data = nullptr;
+    m_file.close();
+    m_indexing = true;
+    m_indexer = std::thread([this] {
+        m_store.buildIndexes();
+        m_indexed = true;
+    });
+    return true;
+}
+
+void CatalogueImporter::addProblem(int line, QString message)
+{
+    ++m_rejected;
+    if ((int)m_problems.size() < MaxProblems)
+        m_problems.push_back(Problem{line, std::move(message)});
+}
+
+void CatalogueImporter::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancelled = true;
+    }
+    m_chunkTaken.notify_all();
+    m_chunkParsed.notify_all();
+}
+
+CatalogueImporter::Progress CatalogueImporter::progress() const
+{
+    Progress p;
+    p.bytesDone = m_bytesDone;
+    p.totalBytes = m_size;
+    p.imported = m_imported;
+    p.rejected = m_rejected;
+    p.indexing = m_indexing;
+    p.finished = m_finished;
+    return p;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "models.hpp"
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+class DataStore;
+
+// ---------------------------------------------
+// CatalogueImporter: CSV acquisitions into a running DataStore
+// ---------------------------------------------
+// Takes the same CSV layout as tools/catalogueconvert: a header row
+// naming the columns (id, title, creator, format, dewey, issue, pubDate,
+// genre, rating; any order, case-insensitive), then one item per row.
+// An empty id asks the store for the next free one.
+//
+// The file is mapped, not read. Parser threads claim it in ~1 MB chunks
+// that end on a line break outside quotes, turn rows into Items and
+// check each format's fields. The thread calling insertReady() adds the
+// parsed chunks in file order with DataStore::addItems, so change
+// notifications go out on that thread (the GUI's, in the app) and other
+// windows see the catalogue grow a chunk at a time. At most a few chunks
+// per thread are parsed ahead of insertion, so memory stays bounded
+// whatever the file size. After the last chunk the search and facet
+// indexes are built once, on a worker thread.
+//
+// Bad rows are skipped and reported with their line number; quotes are
+// expected to balance, as RFC 4180 requires.
+class CatalogueImporter
+{
+public:
+    static constexpr int MaxProblems = 1000;   // kept for reporting; all are counted
+
+    struct Problem {
+        int line;
+        QString message;
+    };
+
+    struct Progress {
+        qint64 bytesDone = 0;    // of the file, inserted or rejected
+        qint64 totalBytes = 0;
+        int imported = 0;
+        int rejected = 0;
+        bool indexing = false;   // every row is in; building the indexes
+        bool finished = false;
+    };
+
+    //threads = 0: one parser per core
+    explicit CatalogueImporter(DataStore &store, int threads = 0);
+    ~CatalogueImporter();   // cancels and waits for the threads
+    CatalogueImporter(const CatalogueImporter &) = delete;
+    CatalogueImporter &operator=(const CatalogueImporter &) = delete;
+
+    //Open the file, read the header and start parsing
+    std::optional<QString> start(const QString &path);
+
+    //Insert the chunks parsed so far, in order; with wait, block until
+    //at least one is ready. False once the import has finished.
+    bool insertReady(bool wait = false);
+
+    //Stop after the chunks already inserted; they stay in the store
+    void cancel();
+    bool isCancelled() const { return m_cancelled.load(); }
+
+    Progress progress() const;
+    const std::vector<Problem> &problems() const { return m_problems; }
+
+    //Format-specific checks on a parsed row: Dewey number for non-fiction,
+    //issue and publication date for magazines, genre and a known rating
+    //for movies and video games
+    static std::optional<QString> validate(const Item &item);
+
+private:
+    enum Column { Id, Title, Creator, Format, Dewey, Issue, PubDate, Genre, Rating, ColumnCount };
+
+    struct Chunk {
+        std::vector<Item> items;
+        std::vector<int> lines;          // of each item
+        std::vector<Problem> problems;   // rows that did not parse or validate
+        qint64 endOffset = 0;
+    };
+
+    void parseLoop();
+    Chunk parse(const char *data, std::size_t size, int firstLine) const;
+    void addProblem(int line, QString message);
+
+    DataStore &m_store;
+    int m_threadCount;
+    QFile m_file;
+    const char *m_data = nullptr;
+    qint64 m_size = 0;
+    int m_columns[ColumnCount];
+
+    // Shared with the parsers
+    mutable std::mutex m_mutex;
+    std::condition_variable m_chunkParsed;   // a chunk is ready (insertReady waits)
+    std::condition_variable m_chunkTaken;    // a chunk was inserted (parsers wait)
+    qint64 m_splitAt = 0;                    // start of the next unclaimed chunk
+    int m_nextLine = 0;                      // its first line
+    int m_claimed = 0;                       // chunks handed to parsers
+    int m_inserted = 0;                      // chunks inserted, in order
+    int m_parsersRunning = 0;
+    std::map<int, Chunk> m_parsed;           // chunk index -> parsed, waiting to be inserted
+    std::atomic<bool> m_cancelled{false};
+    std::vector<std::thread> m_threads;
+
+    // Caller's thread only
+    std::thread m_indexer;
+    std::atomic<bool> m_indexed{false};
+    bool m_indexing = false;
+    bool m_finished = false;
+    qint64 m_bytesDone = 0;
+    int m_imported = 0;
+    int m_rejected = 0;
+    std::vector<Problem> m_problems;
+};
@@ -0,0 +1,139 @@
+#include "cataloguemodel.hpp"
+#include "datastore.hpp"
+#include "storeclient.hpp"
+#include <algorithm>
+
+CatalogueModel::CatalogueModel(QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_rows(DataStore::instance().itemCount())
+{
+}
+
+int CatalogueModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows;
+}
+
+int CatalogueModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant CatalogueModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows)
+        return QVariant();
+
+    const DataStore &ds = DataStore::instance();
+    const int slot = slotAt(index.row());
+    if (role == ItemIdRole)
+        return ds.itemIdAt(slot);
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    const Item it = ds.itemAt(slot);
+    switch (index.column())
+    {
+        case IdColumn:      return QString::number(it.id);
+        case TitleColumn:   return it.title;
+        case CreatorColumn: return it.creator;
+        case FormatColumn:  return formatToString(it.format);
+        case StatusColumn:
+        {
+            const ItemStatus status = statusOf(index.row(), it);
+            if (status.readyFor)
+                return QString("On hold shelf");
+            return status.available ? QString("Available")
+                                    : QString("Out (due %1)").arg(status.dueDate ? status.dueDate->toString("yyyy-MM-dd") : "—");
+        }
+    }
+    return QVariant();
+}
+
+QVariant CatalogueModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    switch (section)
+    {
+        case IdColumn:      return QString("ID");
+        case TitleColumn:   return QString("Title");
+        case CreatorColumn: return QString("Author/Creator");
+        case FormatColumn:  return QString("Format");
+        case StatusColumn:  return QString("Availability");
+    }
+    return QVariant();
+}
+
+ItemStatus CatalogueModel::statusOf(int row, const Item &item) const
+{
+    StoreClient &client = StoreClient::instance();
+    if (!client.isRemote())
+        return item.status;
+    // Circulation lives on the server: fetch this row and the ones below it
+    // in one round trip, so painting a screen costs one request batch
+    if (!client.hasStatus(item.id))
+    {
+        std::vector<int> ids;
+        const int end = std::min(m_rows, row + StatusPrefetchRows);
+        for (int r = row; r < end; ++r)
+            ids.push_back(DataStore::instance().itemIdAt(slotAt(r)));
+        client.itemStatuses(ids);
+    }
+    return client.itemStatus(item.id);
+}
+
+int CatalogueModel::itemIdAt(int row) const
+{
+    if (row < 0 || row >= m_rows)
+        return -1;
+    return DataStore::instance().itemIdAt(slotAt(row));
+}
+
+void CatalogueModel::itemChanged(int itemId)
+{
+    int row = DataStore::instance().itemSlot(itemId);
+    if (m_searching)
+    {
+        // Search hits are a short ranked list; filter results can be long
+        // but come in slot order
+        auto found = m_resultsSorted ? std::lower_bound(m_results.begin(), m_results.end(), row)
+                                     : std::find(m_results.begin(), m_results.end(), row);
+        row = found == m_results.end() || *found != row ? -1 : int(found - m_results.begin());
+    }
+    if (row < 0 || row >= m_rows)
+        return;
+    emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+}
+
+void CatalogueModel::syncRowCount()
+{
+    const int total = DataStore::instance().itemCount();
+    if (m_searching || total <= m_rows)
+        return;
+    beginInsertRows(QModelIndex(), m_rows, total - 1);
+    m_rows = total;
+    endInsertRows();
+}
+
+void CatalogueModel::showSearchResults(std::vector<int> matches)
+{
+    beginResetModel();
+    m_searching = true;
+    m_results = std::move(matches);
+    m_resultsSorted = std::is_sorted(m_results.begin(), m_results.end());
+    m_rows = (int)m_results.size();
+    endResetModel();
+}
+
+void CatalogueModel::clearSearch()
+{
+    if (!m_searching)
+        return;
+    beginResetModel();
+    m_searching = false;
+    m_results.clear();
+    m_rows = DataStore::instance().itemCount();
+    endResetModel();
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <QAbstractTableModel>
+#include "models.hpp"
+#include <vector>
+
+// ---------------------------------------------
+// CatalogueModel: table model over the DataStore catalogue
+// ---------------------------------------------
+// Rows map 1:1 to catalogue slots and cells are formatted on demand,
+// so the view only ever materialises the rows it is painting. After a
+// circulation change call itemChanged() to repaint just that row.
+// showSearchResults() narrows the rows to a list of slots (ranked search
+// hits, or facet filter matches in catalogue order). Item details come
+// from the local catalogue; availability comes from StoreClient, so a
+// terminal connected to a server shows the shared state.
+class CatalogueModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column { IdColumn, TitleColumn, CreatorColumn, FormatColumn, StatusColumn, ColumnCount };
+    static constexpr int ItemIdRole = Qt::UserRole;
+
+    explicit CatalogueModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    //Item id shown in a row (-1 if out of range)
+    int itemIdAt(int row) const;
+
+    //Repaint the row of one item
+    void itemChanged(int itemId);
+
+    //Pick up items appended to the store since the last call
+    void syncRowCount();
+
+    //Show only these slots, in this order / go back to the whole catalogue
+    void showSearchResults(std::vector<int> matches);
+    void clearSearch();
+    bool isSearching() const { return m_searching; }
+
+private:
+    static constexpr int StatusPrefetchRows = 64;
+
+    int slotAt(int row) const { return m_searching ? m_results[row] : row; }
+    ItemStatus statusOf(int row, const Item &item) const;
+
+    int m_rows = 0;
+    bool m_searching = false;
+    std::vector<int> m_results;   // slots shown while searching
+    bool m_resultsSorted = false; // in slot order (filter results), so binary-searchable
+};
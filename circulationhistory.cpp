@@ -0,0 +1,585 @@
+#include "circulationhistory.hpp"
+#include "bytecodec.hpp"
+#include <algorithm>
+#include <cstring>
+
+// A sealed block: every column is base + offset, the offsets packed at one
+// width per column into a single buffer (each column 8-byte aligned, with
+// 8 bytes of slack so any offset can be read with one unaligned load).
+// Times and kinds take whole bytes (0, 1, 2, 4 or 8) for the scan loops;
+// ids and links take as many bits as they need. Offsets are in host byte
+// order, as written to history.bin; every platform HinLIBS ships on is
+// little-endian.
+struct CirculationHistory::Block {
+    struct Packed {
+        qint64 base = 0;
+        int bits = 0;             // per offset: 0-56 or 64
+        std::size_t offset = 0;   // into data
+    };
+    std::array<Packed, ColumnCount> columns;
+    qint64 minMs = 0;
+    qint64 maxMs = 0;
+    std::size_t bytes = 0;
+    std::unique_ptr<quint8[]> data;
+
+    qint64 value(int column, int i) const;
+    //Append the events whose mask byte is 1, one column at a time
+    void decode(const quint8 *mask, std::vector<Event> &out) const;
+    //mask[i] = 1 for the events in [fromMs, toMs) of the given kinds
+    void select(qint64 fromMs, qint64 toMs, Kinds kinds, quint8 *mask) const;
+};
+
+namespace {
+constexpr int N = CirculationHistory::BlockEvents;
+
+// Bits an offset of up to span needs; beyond 56 a shifted offset may not
+// fit one 8-byte load, so those take all 64
+int bitsFor(quint64 span)
+{
+    int bits = 0;
+    while (span >> bits)
+        ++bits;
+    return bits > 56 ? 64 : bits;
+}
+
+// Columns the scans read take whole bytes: 0, 8, 16, 32 or 64 bits
+int byteBitsFor(quint64 span)
+{
+    const int bits = bitsFor(span);
+    return bits == 0 ? 0 : bits <= 8 ? 8 : bits <= 16 ? 16 : bits <= 32 ? 32 : 64;
+}
+
+bool validBits(int bits, bool wholeBytes)
+{
+    if (wholeBytes)
+        return bits == 0 || bits == 8 || bits == 16 || bits == 32 || bits == 64;
+    return (bits >= 0 && bits <= 56) || bits == 64;
+}
+
+std::size_t columnBytes(int bits)
+{
+    return bits == 0 ? 0 : ((std::size_t(bits) * N / 8 + 8 + 7) & ~std::size_t(7));
+}
+
+quint64 maskOf(int bits)
+{
+    return bits == 64 ? ~quint64(0) : (quint64(1) << bits) - 1;
+}
+
+quint64 load64(const quint8 *p)
+{
+    quint64 word;
+    std::memcpy(&word, p, sizeof word);
+    return word;
+}
+
+// Offset i of a column: one load, a shift and a mask whatever the width
+quint64 unpack(const quint8 *column, int bits, int i)
+{
+    const quint64 bit = quint64(i) * quint64(bits);
+    return (load64(column + bit / 8) >> (bit % 8)) & maskOf(bits);
+}
+
+// out is zeroed; each offset is OR-ed into place
+void pack(const qint64 *values, qint64 base, int bits, quint8 *out)
+{
+    if (bits == 0)
+        return;
+    for (int i = 0; i < N; ++i)
+    {
+        const quint64 bit = quint64(i) * quint64(bits);
+        const quint64 word = load64(out + bit / 8) | ((quint64(values[i]) - quint64(base)) << (bit % 8));
+        std::memcpy(out + bit / 8, &word, sizeof word);
+    }
+}
+
+// mask[i] = lo <= v[i] < lo + span, as one unsigned compare: values below
+// lo wrap around to large ones. U is the narrowest type that holds the
+// window, so the loop runs over as many lanes as possible.
+template <typename T, typename U>
+void markWindow(const quint8 *column, quint64 lo, quint64 span, quint8 *mask)
+{
+    const T *v = reinterpret_cast<const T *>(column);
+    const U l = U(lo);
+    const U s = U(span);
+    for (int i = 0; i < N; ++i)
+        mask[i] = quint8(U(U(v[i]) - l) < s);
+}
+
+// Point id's chain at the event at (position + 1) and return the distance
+// back to the previous event of the same id (0 = none)
+quint64 link(std::vector<quint64> &heads, int id, quint64 at)
+{
+    if (id <= 0)
+        return 0;
+    if (std::size_t(id) >= heads.size())
+        heads.resize(std::max(std::size_t(id) + 1, heads.size() * 2));
+    const quint64 prev = heads[std::size_t(id)];
+    heads[std::size_t(id)] = at;
+    return prev ? at - prev : 0;
+}
+} // namespace
+
+qint64 CirculationHistory::Block::value(int column, int i) const
+{
+    const Packed &c = columns[column];
+    return qint64(quint64(c.base) + (c.bits ? unpack(data.get() + c.offset, c.bits, i) : 0));
+}
+
+void CirculationHistory::Block::decode(const quint8 *mask, std::vector<Event> &out) const
+{
+    // Branch-free compaction of the selected indices
+    std::array<int, N> picked;
+    int count = 0;
+    for (int i = 0; i < N; ++i)
+    {
+        picked[count] = i;
+        count += mask[i];
+    }
+    const std::size_t first = out.size();
+    out.resize(first + std::size_t(count));
+    Event *e = out.data() + first;
+
+    auto column = [&](int c, auto store) {
+        const Packed &p = columns[c];
+        const quint8 *bytes = data.get() + p.offset;
+        for (int j = 0; j < count; ++j)
+            store(e[j], qint64(quint64(p.base) + (p.bits ? unpack(bytes, p.bits, picked[j]) : 0)));
+    };
+    column(Time, [](Event &ev, qint64 v) { ev.atMs = v; });
+    column(KindColumn, [](Event &ev, qint64 v) { ev.kind = Kind(v); });
+    column(Item, [](Event &ev, qint64 v) { ev.itemId = int(v); });
+    column(Patron, [](Event &ev, qint64 v) { ev.patronId = int(v); });
+}
+
+void CirculationHistory::Block::select(qint64 fromMs, qint64 toMs, Kinds kinds, quint8 *mask) const
+{
+    const Packed &t = columns[Time];
+    if (fromMs <= minMs && toMs > maxMs)
+    {
+        std::fill(mask, mask + N, quint8(1));
+    }
+    else
+    {
+        // The window as offsets from minMs (the column's base): [lo, hi).
+        // It is not the whole block, so with 4-byte offsets hi - lo < 2^32.
+        const quint64 lo = fromMs <= minMs ? 0 : quint64(fromMs) - quint64(minMs);
+        const quint64 hi = toMs > maxMs ? quint64(maxMs) - quint64(minMs) + 1 : quint64(toMs) - quint64(minMs);
+        const quint64 span = hi > lo ? hi - lo : 0;
+        const quint8 *times = data.get() + t.offset;
+        switch (t.bits / 8)
+        {
+            case 1: markWindow<quint8, quint32>(times, lo, span, mask); break;
+            case 2: markWindow<quint16, quint32>(times, lo, span, mask); break;
+            case 4: markWindow<quint32, quint32>(times, lo, span, mask); break;
+            case 8: markWindow<quint64, quint64>(times, lo, span, mask); break;
+            default: std::fill(mask, mask + N, quint8(lo == 0 && span > 0)); break;
+        }
+    }
+
+    if ((kinds & AllKinds) == AllKinds)
+        return;
+    // Kinds are below KindCount, so their offsets are at most one byte wide
+    const Packed &k = columns[KindColumn];
+    if (k.bits == 0)
+    {
+        if (!((kinds >> k.base) & 1))
+            std::fill(mask, mask + N, quint8(0));
+        return;
+    }
+    const quint8 *kv = data.get() + k.offset;
+    const int base = int(k.base);
+    for (int i = 0; i < N; ++i)
+        mask[i] &= quint8((kinds >> (base + kv[i])) & 1);
+}
+
+const char *CirculationHistory::kindName(Kind kind)
+{
+    switch (kind)
+    {
+        case Kind::Borrow:         return "borrow";
+        case Kind::Return:         return "return";
+        case Kind::PlaceHold:      return "place hold";
+        case Kind::CancelHold:     return "cancel hold";
+        case Kind::ReadyForPickup: return "ready for pickup";
+        case Kind::PickupExpired:  return "pickup expired";
+    }
+    return "unknown";
+}
+
+CirculationHistory::CirculationHistory()
+{
+    for (auto &column : m_open)
+        column.reserve(N);
+}
+
+CirculationHistory::~CirculationHistory() = default;
+
+void CirculationHistory::record(Kind kind, int itemId, int patronId, qint64 atMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    append(kind, itemId, patronId, atMs);
+}
+
+void CirculationHistory::append(Kind kind, int itemId, int patronId, qint64 atMs)
+{
+    const quint64 at = m_count + 1;
+    m_open[Time].push_back(atMs);
+    m_open[KindColumn].push_back(qint64(kind));
+    m_open[Item].push_back(itemId);
+    m_open[Patron].push_back(patronId);
+    m_open[PrevItem].push_back(qint64(link(m_itemHead, itemId, at)));
+    m_open[PrevPatron].push_back(qint64(link(m_patronHead, patronId, at)));
+    ++m_count;
+    if (m_open[Time].size() == std::size_t(N))
+        seal();
+}
+
+void CirculationHistory::seal()
+{
+    auto block = std::make_unique<Block>();
+    std::size_t bytes = 0;
+    for (int c = 0; c < ColumnCount; ++c)
+    {
+        const auto range = std::minmax_element(m_open[c].begin(), m_open[c].end());
+        Block::Packed &p = block->columns[c];
+        const quint64 span = quint64(*range.second) - quint64(*range.first);
+        p.base = *range.first;
+        p.bits = c == Time || c == KindColumn ? byteBitsFor(span) : bitsFor(span);
+        p.offset = bytes;
+        bytes += columnBytes(p.bits);
+        if (c == Time)
+        {
+            block->minMs = *range.first;
+            block->maxMs = *range.second;
+        }
+    }
+    block->bytes = bytes;
+    block->data.reset(new quint8[bytes]());
+    for (int c = 0; c < ColumnCount; ++c)
+        pack(m_open[c].data(), block->columns[c].base, block->columns[c].bits, block->data.get() + block->columns[c].offset);
+
+    m_sealedBytes += sizeof(Block) + bytes;
+    m_blocks.push_back(std::move(block));
+    for (auto &column : m_open)
+        column.clear();
+}
+
+void CirculationHistory::linkBlock(const Block &block, quint64 first)
+{
+    for (int i = 0; i < N; ++i)
+    {
+        link(m_itemHead, int(block.value(Item, i)), first + quint64(i) + 1);
+        link(m_patronHead, int(block.value(Patron, i)), first + quint64(i) + 1);
+    }
+}
+
+CirculationHistory::Row CirculationHistory::rowAt(quint64 pos) const
+{
+    const quint64 block = pos / N;
+    const int i = int(pos % N);
+    Row row;
+    if (block < m_blocks.size())
+    {
+        for (int c = 0; c < ColumnCount; ++c)
+            row[c] = m_blocks[block]->value(c, i);
+    }
+    else
+    {
+        for (int c = 0; c < ColumnCount; ++c)
+            row[c] = m_open[c][i];
+    }
+    return row;
+}
+
+CirculationHistory::Event CirculationHistory::eventOf(const Row &row)
+{
+    return Event{row[Time], Kind(row[KindColumn]), int(row[Item]), int(row[Patron])};
+}
+
+template <typename Visit>
+void CirculationHistory::walk(const std::vector<quint64> &heads, int id, Column link, Visit visit) const
+{
+    if (id <= 0 || std::size_t(id) >= heads.size())
+        return;
+    for (quint64 at = heads[std::size_t(id)]; at != 0;)
+    {
+        const Row row = rowAt(at - 1);
+        if (!visit(row))
+            return;
+        const quint64 back = quint64(row[link]);
+        if (back == 0 || back >= at)
+            return;
+        at -= back;
+    }
+}
+
+std::vector<CirculationHistory::Event> CirculationHistory::events(const std::vector<quint64> &heads, int id, Column link,
+                                                                  int limit, Kinds kinds) const
+{
+    std::vector<Event> out;
+    if (limit == 0)
+        return out;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    walk(heads, id, link, [&](const Row &row) {
+        if ((kinds >> row[KindColumn]) & 1)
+            out.push_back(eventOf(row));
+        return limit < 0 || (int)out.size() < limit;
+    });
+    return out;
+}
+
+std::vector<CirculationHistory::Loan> CirculationHistory::loans(const std::vector<quint64> &heads, int id, Column link,
+                                                                int limit) const
+{
+    std::vector<Loan> out;
+    if (limit == 0)
+        return out;
+    // Newest first, so a return turns up before the borrow it ended; the
+    // nearest later return of the same item and patron is the one seen last
+    std::vector<Loan> returns;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    walk(heads, id, link, [&](const Row &row) {
+        const Kind kind = Kind(row[KindColumn]);
+        if (kind == Kind::Return)
+        {
+            returns.push_back(Loan{int(row[Item]), int(row[Patron]), 0, row[Time]});
+        }
+        else if (kind == Kind::Borrow)
+        {
+            Loan loan{int(row[Item]), int(row[Patron]), row[Time], 0};
+            for (auto it = returns.rbegin(); it != returns.rend(); ++it)
+            {
+                if (it->itemId == loan.itemId && it->patronId == loan.patronId)
+                {
+                    loan.returnedMs = it->returnedMs;
+                    returns.erase(std::next(it).base());
+                    break;
+                }
+            }
+            out.push_back(loan);
+        }
+        return limit < 0 || (int)out.size() < limit;
+    });
+    return out;
+}
+
+std::vector<CirculationHistory::Event> CirculationHistory::itemEvents(int itemId, int limit, Kinds kinds) const
+{
+    return events(m_itemHead, itemId, PrevItem, limit, kinds);
+}
+
+std::vector<CirculationHistory::Event> CirculationHistory::patronEvents(int patronId, int limit, Kinds kinds) const
+{
+    return events(m_patronHead, patronId, PrevPatron, limit, kinds);
+}
+
+std::vector<CirculationHistory::Loan> CirculationHistory::itemLoans(int itemId, int limit) const
+{
+    return loans(m_itemHead, itemId, PrevItem, limit);
+}
+
+std::vector<CirculationHistory::Loan> CirculationHistory::patronLoans(int patronId, int limit) const
+{
+    return loans(m_patronHead, patronId, PrevPatron, limit);
+}
+
+std::vector<const CirculationHistory::Block *> CirculationHistory::collect(qint64 fromMs, qint64 toMs, Kinds kinds,
+                                                                           std::vector<Event> &open) const
+{
+    std::vector<const Block *> blocks;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto &block : m_blocks)
+        if (block->maxMs >= fromMs && block->minMs < toMs)
+            blocks.push_back(block.get());
+    const std::vector<qint64> &times = m_open[Time];
+    for (std::size_t i = 0; i < times.size(); ++i)
+    {
+        if (times[i] < fromMs || times[i] >= toMs || !((kinds >> m_open[KindColumn][i]) & 1))
+            continue;
+        open.push_back(Event{times[i], Kind(m_open[KindColumn][i]), int(m_open[Item][i]), int(m_open[Patron][i])});
+    }
+    return blocks;
+}
+
+std::vector<CirculationHistory::Event> CirculationHistory::between(qint64 fromMs, qint64 toMs, Kinds kinds) const
+{
+    std::vector<Event> out;
+    if (toMs <= fromMs)
+        return out;
+    std::vector<Event> open;
+    const std::vector<const Block *> blocks = collect(fromMs, toMs, kinds, open);
+
+    std::vector<quint8> mask(N);
+    for (const Block *block : blocks)
+    {
+        block->select(fromMs, toMs, kinds, mask.data());
+        block->decode(mask.data(), out);
+    }
+    out.insert(out.end(), open.begin(), open.end());
+    return out;
+}
+
+std::array<quint64, CirculationHistory::KindCount> CirculationHistory::countBetween(qint64 fromMs, qint64 toMs) const
+{
+    std::array<quint64, KindCount> counts{};
+    if (toMs <= fromMs)
+        return counts;
+    std::vector<Event> open;
+    const std::vector<const Block *> blocks = collect(fromMs, toMs, AllKinds, open);
+
+    std::vector<quint8> mask(N);
+    for (const Block *block : blocks)
+    {
+        block->select(fromMs, toMs, AllKinds, mask.data());
+        const Block::Packed &k = block->columns[KindColumn];
+        if (k.bits == 0)
+        {
+            counts[std::size_t(k.base)] += quint64(std::count(mask.begin(), mask.end(), quint8(1)));
+            continue;
+        }
+        const quint8 *kv = block->data.get() + k.offset;
+        for (int i = 0; i < N; ++i)
+            counts[std::size_t(k.base) + kv[i]] += mask[i];
+    }
+    for (const Event &e : open)
+        ++counts[std::size_t(e.kind)];
+    return counts;
+}
+
+std::vector<CirculationHistory::Event> CirculationHistory::latest(quint64 count, Kinds kinds) const
+{
+    std::vector<Event> out;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (quint64 pos = count < m_count ? m_count - count : 0; pos < m_count; ++pos)
+    {
+        const Row row = rowAt(pos);
+        if ((kinds >> row[KindColumn]) & 1)
+            out.push_back(eventOf(row));
+    }
+    return out;
+}
+
+quint64 CirculationHistory::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
+
+std::size_t CirculationHistory::bytesUsed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sealedBytes + ColumnCount * sizeof(qint64) * m_open[Time].capacity();
+}
+
+quint64 CirculationHistory::sealedBlocks() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_blocks.size();
+}
+
+// Block: per column svarint base, u8 bits; then the packed buffer
+void CirculationHistory::writeBlock(quint64 block, ByteWriter &out) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Block &b = *m_blocks[block];
+    for (const Block::Packed &p : b.columns)
+    {
+        out.putSVarint(p.base);
+        out.putU8(quint8(p.bits));
+    }
+    out.putBytes(reinterpret_cast<const char *>(b.data.get()), b.bytes);
+}
+
+bool CirculationHistory::readBlock(ByteReader &in)
+{
+    auto block = std::make_unique<Block>();
+    std::size_t bytes = 0;
+    for (int c = 0; c < ColumnCount; ++c)
+    {
+        Block::Packed &p = block->columns[c];
+        p.base = in.svarint();
+        p.bits = in.u8();
+        if (!validBits(p.bits, c == Time || c == KindColumn))
+            return false;
+        p.offset = bytes;
+        bytes += columnBytes(p.bits);
+    }
+    const char *data = in.bytes(bytes);
+    if (!in.ok() || !data)
+        return false;
+    block->bytes = bytes;
+    block->data.reset(new quint8[bytes]);
+    std::memcpy(block->data.get(), data, bytes);
+
+    // Kinds index bit sets and counts, so they must be in range
+    block->minMs = block->maxMs = block->value(Time, 0);
+    for (int i = 0; i < N; ++i)
+    {
+        if (quint64(block->value(KindColumn, i)) >= quint64(KindCount))
+            return false;
+        block->minMs = std::min(block->minMs, block->value(Time, i));
+        block->maxMs = std::max(block->maxMs, block->value(Time, i));
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_open[Time].empty())
+        return false;
+    linkBlock(*block, m_count);
+    m_count += N;
+    m_sealedBytes += sizeof(Block) + bytes;
+    m_blocks.push_back(std::move(block));
+    return true;
+}
+
+// Event list: varint count, then per event svarint time delta, u8 kind,
+// varint item id, varint patron id
+void CirculationHistory::writeEvents(quint64 from, quint64 to, ByteWriter &out) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    to = std::min(to, m_count);
+    out.putVarint(from < to ? to - from : 0);
+    qint64 prev = 0;
+    for (quint64 pos = from; pos < to; ++pos)
+    {
+        const Row row = rowAt(pos);
+        out.putSVarint(row[Time] - prev);
+        prev = row[Time];
+        out.putU8(quint8(row[KindColumn]));
+        out.putVarint(quint64(row[Item]));
+        out.putVarint(quint64(row[Patron]));
+    }
+}
+
+bool CirculationHistory::readEvents(ByteReader &in)
+{
+    const quint64 count = in.varint();
+    // Every event takes at least four bytes
+    if (!in.ok() || count > in.remaining() / 4)
+        return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    qint64 atMs = 0;
+    for (quint64 i = 0; i < count; ++i)
+    {
+        atMs += in.svarint();
+        const quint8 kind = in.u8();
+        const int itemId = int(in.varint());
+        const int patronId = int(in.varint());
+        if (!in.ok() || kind >= KindCount)
+            return false;
+        append(Kind(kind), itemId, patronId, atMs);
+    }
+    return true;
+}
+
+void CirculationHistory::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_blocks.clear();
+    for (auto &column : m_open)
+        column.clear();
+    m_itemHead.clear();
+    m_patronHead.clear();
+    m_count = 0;
+    m_sealedBytes = 0;
+}
@@ -0,0 +1,396 @@
+#include "circulationreport.hpp"
+#include "datastore.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+
+constexpr int KeyBlockSlots = 16384;   // items per reportKeys() call
+constexpr int PagesPerBlock = 16;      // snapshot pages per claimed block
+
+const char *const BucketNames[CirculationReport::QueueBuckets] = {"1", "2", "3-4", "5-9", "10+"};
+
+// Run work(thread, block) for every block in [0, blocks) on up to threads
+// threads, the caller's included; threads claim the next block as they
+// finish one, so uneven blocks even out
+template <typename Work>
+void runBlocks(int blocks, int threads, Work &&work)
+{
+    threads = std::max(1, std::min(threads, blocks));
+    std::atomic<int> next{0};
+    auto loop = [&](int t) {
+        for (int b = next.fetch_add(1); b < blocks; b = next.fetch_add(1))
+            work(t, b);
+    };
+    std::vector<std::thread> helpers;
+    for (int t = 1; t < threads; ++t)
+        helpers.emplace_back(loop, t);
+    loop(0);
+    for (std::thread &h : helpers)
+        h.join();
+}
+
+void add(CirculationReport::Counts &to, const CirculationReport::Counts &d)
+{
+    to.items += d.items;
+    to.onLoan += d.onLoan;
+    to.onHoldShelf += d.onHoldShelf;
+    to.queuedHolds += d.queuedHolds;
+}
+
+// Longest queue first, then catalogue order
+bool longerQueue(const std::pair<int, int> &a, const std::pair<int, int> &b)
+{
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+}
+
+} // namespace
+
+// Dense ids for the names one thread met, listed by NameTable shard
+struct CirculationReporter::Names {
+    std::unordered_map<QString, int, QStringHash> ids;
+    std::vector<QString> names;
+    std::vector<int> items;                              // per id
+    std::array<std::vector<int>, NameShards> byShard;    // ids
+    int last = -1;   // neighbours often share a name (a shelf of one author)
+
+    int intern(const QString &name)
+    {
+        if (name.isEmpty())
+            return -1;
+        if (last >= 0 && names[last] == name)
+        {
+            ++items[last];
+            return last;
+        }
+        // Look up before inserting: most names are repeats, and emplace
+        // would build (and drop) a node for each
+        auto it = ids.find(name);
+        if (it == ids.end())
+        {
+            it = ids.emplace(name, (int)names.size()).first;
+            names.push_back(name);
+            items.push_back(0);
+            byShard[QStringHash()(name) % NameShards].push_back(it->second);
+        }
+        ++items[it->second];
+        return last = it->second;
+    }
+};
+
+// Keys read by one thread, with genre and creator ids local to it
+struct CirculationReporter::KeyPart {
+    Names genres;
+    Names creators;
+    std::array<int, FacetCounts::FormatCount> formatItems{};
+};
+
+// Circulation counted by one thread: changes to the running totals
+struct CirculationReporter::PagePart {
+    Counts total;
+    std::array<Counts, FacetCounts::FormatCount> formats{};
+    std::vector<Counts> genres;                      // by genre id
+    std::vector<std::pair<int, Counts>> creators;    // (creator id, change), circulating items only
+    std::array<int, CirculationReport::QueueBuckets> queueLengths{};
+};
+
+const char *CirculationReport::queueBucketName(int bucket)
+{
+    return BucketNames[bucket];
+}
+
+int CirculationReport::queueBucket(int queued)
+{
+    return queued <= 2 ? queued - 1 : queued <= 4 ? 2 : queued <= 9 ? 3 : 4;
+}
+
+QString CirculationReport::toText() const
+{
+    auto row = [](const QString &name, const Counts &c) {
+        return QString("%1\t%2\t%3\t%4\t%5\t%6\t%7\n")
+            .arg(name)
+            .arg(c.items)
+            .arg(c.onLoan)
+            .arg(c.onHoldShelf)
+            .arg(c.utilization() * 100.0, 0, 'f', 1)
+            .arg(c.queuedHolds)
+            .arg(c.holdPressure(), 0, 'f', 3);
+    };
+    const QString header = "\titems\ton_loan\thold_shelf\tutilization_pct\tqueued_holds\tholds_per_item\n";
+
+    QString text = QString("circulation as of %1 (version %2)\n\n").arg(asOf.toString("yyyy-MM-dd")).arg(version);
+    text += "format" + header;
+    text += row("all", total);
+    for (int f = 0; f < FacetCounts::FormatCount; ++f)
+        text += row(formatToString(ItemFormat(f)), formats[f]);
+    text += "\ngenre" + header;
+    for (const auto &g : genres)
+        text += row(g.first, g.second);
+    text += QString("\ncreator (top %1 of %2 by loans)").arg(creators.size()).arg(creatorCount) + header;
+    for (const auto &c : creators)
+        text += row(c.first, c.second);
+    text += "\nqueue_length\titems\n";
+    for (int b = 0; b < QueueBuckets; ++b)
+        text += QString("%1\t%2\n").arg(queueBucketName(b)).arg(queueLengths[b]);
+    text += "\nmost_held_item\ttitle\tqueued\n";
+    for (const Held &h : mostHeld)
+        text += QString("%1\t%2\t%3\n").arg(h.itemId).arg(h.title).arg(h.queued);
+    return text;
+}
+
+CirculationReporter::CirculationReporter(const DataStore &store, int threads, int topN)
+    : m_store(store)
+    , m_threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency())))
+    , m_topN(topN)
+{
+}
+
+CirculationReporter::~CirculationReporter() = default;
+
+const CirculationReport &CirculationReporter::refresh()
+{
+    std::shared_ptr<const CirculationSnapshot> next = m_store.snapshot();
+    if (next == m_snapshot)
+    {
+        m_report.itemsAdded = m_report.pagesRecounted = 0;
+        return m_report;
+    }
+    const int known = (int)m_keys.size();
+    readKeys(next->itemCount());
+    const int recounted = recountPages(*next);
+    buildReport(*next);
+    m_report.itemsAdded = next->itemCount() - known;
+    m_report.pagesRecounted = recounted;
+    m_report.pageCount = next->pageCount();
+    m_snapshot = std::move(next);
+    return m_report;
+}
+
+void CirculationReporter::readKeys(int count)
+{
+    const int from = (int)m_keys.size();
+    if (count <= from)
+        return;
+    m_keys.resize(std::size_t(count));
+    const int blocks = (count - from + KeyBlockSlots - 1) / KeyBlockSlots;
+    std::vector<KeyPart> parts(std::size_t(std::max(1, std::min(m_threadCount, blocks))));
+    std::vector<int> owner(blocks);
+
+    // Each thread numbers the genres and creators it meets itself...
+    runBlocks(blocks, (int)parts.size(), [&](int t, int b) {
+        KeyPart &part = parts[t];
+        const int begin = from + b * KeyBlockSlots;
+        const std::vector<DataStore::ReportKeys> keys = m_store.reportKeys(begin, std::min(count, begin + KeyBlockSlots));
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            const DataStore::ReportKeys &k = keys[i];
+            ++part.formatItems[int(k.format)];
+            m_keys[begin + i] = Key{k.format, part.genres.intern(k.genre), part.creators.intern(k.creator)};
+        }
+        owner[b] = t;
+    });
+
+    // ...then each name is looked up once per thread that met it, a shard
+    // at a time on every thread; only new names take a turn in order, to
+    // get the next id
+    auto merge = [this, &parts](Names KeyPart::*which, NameTable &table, std::vector<Counts> &counts) {
+        std::vector<std::vector<int *>> refs(parts.size());
+        for (std::size_t p = 0; p < parts.size(); ++p)
+            refs[p].resize((parts[p].*which).names.size());
+        std::array<std::vector<std::pair<int *, const QString *>>, NameShards> added;
+        runBlocks(NameShards, m_threadCount, [&](int, int s) {
+            for (std::size_t p = 0; p < parts.size(); ++p)
+            {
+                const Names &local = parts[p].*which;
+                for (int i : local.byShard[s])
+                {
+                    auto it = table.ids[s].find(local.names[i]);
+                    if (it == table.ids[s].end())
+                    {
+                        it = table.ids[s].emplace(local.names[i], -1).first;   // id to come
+                        added[s].emplace_back(&it->second, &it->first);
+                    }
+                    refs[p][i] = &it->second;
+                }
+            }
+        });
+        for (auto &shard : added)
+        {
+            for (auto &name : shard)
+            {
+                *name.first = (int)table.names.size();
+                table.names.push_back(*name.second);
+            }
+        }
+        counts.resize(table.names.size());
+
+        std::vector<std::vector<int>> global(parts.size());
+        for (std::size_t p = 0; p < parts.size(); ++p)
+            global[p].resize(refs[p].size());
+        runBlocks(NameShards, m_threadCount, [&](int, int s) {
+            for (std::size_t p = 0; p < parts.size(); ++p)
+            {
+                const Names &local = parts[p].*which;
+                for (int i : local.byShard[s])
+                {
+                    global[p][i] = *refs[p][i];
+                    counts[global[p][i]].items += local.items[i];
+                }
+            }
+        });
+        return global;
+    };
+    const std::vector<std::vector<int>> genreIds = merge(&KeyPart::genres, m_genreNames, m_genres);
+    const std::vector<std::vector<int>> creatorIds = merge(&KeyPart::creators, m_creatorNames, m_creators);
+    for (const KeyPart &part : parts)
+        for (int f = 0; f < FacetCounts::FormatCount; ++f)
+            m_formats[f].items += part.formatItems[f];
+    m_total.items += count - from;
+
+    runBlocks(blocks, (int)parts.size(), [&](int, int b) {
+        const std::vector<int> &genres = genreIds[owner[b]];
+        const std::vector<int> &creators = creatorIds[owner[b]];
+        const int begin = from + b * KeyBlockSlots;
+        for (int slot = begin; slot < std::min(count, begin + KeyBlockSlots); ++slot)
+        {
+            Key &key = m_keys[slot];
+            key.genre = key.genre >= 0 ? genres[key.genre] : -1;
+            key.creator = key.creator >= 0 ? creators[key.creator] : -1;
+        }
+    });
+}
+
+void CirculationReporter::tally(PagePart &part, const Key &key, int borrower, int queued, int sign)
+{
+    if (!borrower && !queued)
+        return;   // on the shelf with nobody waiting: counts for nothing
+    Counts d;
+    d.onLoan = borrower > 0 ? sign : 0;
+    d.onHoldShelf = borrower < 0 ? sign : 0;
+    d.queuedHolds = sign * queued;
+    add(part.total, d);
+    add(part.formats[int(key.format)], d);
+    if (key.genre >= 0)
+        add(part.genres[key.genre], d);
+    if (key.creator >= 0)
+        part.creators.emplace_back(key.creator, d);
+    if (queued)
+        part.queueLengths[CirculationReport::queueBucket(queued)] += sign;
+}
+
+int CirculationReporter::recountPages(const CirculationSnapshot &next)
+{
+    const CirculationSnapshot *old = m_snapshot.get();
+    std::vector<int> changed;
+    for (int p = 0; p < next.pageCount(); ++p)
+        if (!old || !next.sharesPage(*old, p))
+            changed.push_back(p);
+    m_pageTops.resize(std::size_t(next.pageCount()));
+
+    const int blocks = ((int)changed.size() + PagesPerBlock - 1) / PagesPerBlock;
+    std::vector<PagePart> parts(std::size_t(std::max(1, std::min(m_threadCount, blocks))));
+    for (PagePart &part : parts)
+        part.genres.resize(m_genres.size());
+
+    // A changed page takes back what it counted last time and counts again
+    runBlocks(blocks, (int)parts.size(), [&](int t, int b) {
+        PagePart &part = parts[t];
+        const int end = std::min((int)changed.size(), (b + 1) * PagesPerBlock);
+        for (int i = b * PagesPerBlock; i < end; ++i)
+        {
+            const int p = changed[i];
+            const int first = p * CirculationSnapshot::PageSlots;
+            if (old)
+                for (int slot = first; slot < std::min(old->itemCount(), first + CirculationSnapshot::PageSlots); ++slot)
+                    tally(part, m_keys[slot], old->borrowerAt(slot), old->queuedAt(slot), -1);
+
+            PageTop &top = m_pageTops[p];
+            top.clear();
+            for (int slot = first; slot < std::min(next.itemCount(), first + CirculationSnapshot::PageSlots); ++slot)
+            {
+                const int queued = next.queuedAt(slot);
+                tally(part, m_keys[slot], next.borrowerAt(slot), queued, +1);
+                if (queued)
+                    top.emplace_back(queued, slot);
+            }
+            if ((int)top.size() > m_topN)
+            {
+                std::partial_sort(top.begin(), top.begin() + m_topN, top.end(), longerQueue);
+                top.resize(std::size_t(m_topN));
+            }
+        }
+    });
+
+    for (const PagePart &part : parts)
+    {
+        add(m_total, part.total);
+        for (int f = 0; f < FacetCounts::FormatCount; ++f)
+            add(m_formats[f], part.formats[f]);
+        for (std::size_t g = 0; g < part.genres.size(); ++g)
+            add(m_genres[g], part.genres[g]);
+        for (const auto &c : part.creators)
+            add(m_creators[c.first], c.second);
+        for (int q = 0; q < CirculationReport::QueueBuckets; ++q)
+            m_queueLengths[q] += part.queueLengths[q];
+    }
+    return (int)changed.size();
+}
+
+void CirculationReporter::buildReport(const CirculationSnapshot &next)
+{
+    CirculationReport &r = m_report;
+    r.version = next.version();
+    r.asOf = next.clockDate();
+    r.total = m_total;
+    r.formats = m_formats;
+    r.queueLengths = m_queueLengths;
+
+    r.genres.clear();
+    for (std::size_t g = 0; g < m_genres.size(); ++g)
+        r.genres.emplace_back(m_genreNames.names[g], m_genres[g]);
+    std::sort(r.genres.begin(), r.genres.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    // Top creators by loans, then by patrons waiting: a bounded heap, so
+    // a refresh reads the creator totals once and sorts only topN
+    auto more = [this](int a, int b) {
+        const Counts &x = m_creators[a], &y = m_creators[b];
+        if (x.onLoan != y.onLoan)
+            return x.onLoan > y.onLoan;
+        if (x.queuedHolds != y.queuedHolds)
+            return x.queuedHolds > y.queuedHolds;
+        return m_creatorNames.names[a] < m_creatorNames.names[b];   // ids depend on thread count
+    };
+    std::vector<int> top;
+    for (int c = 0; c < (int)m_creators.size(); ++c)
+    {
+        if ((int)top.size() < m_topN)
+        {
+            top.push_back(c);
+            std::push_heap(top.begin(), top.end(), more);
+        }
+        else if (m_topN > 0 && more(c, top.front()))
+        {
+            std::pop_heap(top.begin(), top.end(), more);
+            top.back() = c;
+            std::push_heap(top.begin(), top.end(), more);
+        }
+    }
+    std::sort_heap(top.begin(), top.end(), more);
+    r.creators.clear();
+    for (int c : top)
+        r.creators.emplace_back(m_creatorNames.names[c], m_creators[c]);
+    r.creatorCount = (int)m_creators.size();
+
+    // Every page keeps its own longest queues, so these are among them
+    std::vector<std::pair<int, int>> held;
+    for (const PageTop &page : m_pageTops)
+        held.insert(held.end(), page.begin(), page.end());
+    const std::size_t n = std::min(held.size(), std::size_t(m_topN));
+    std::partial_sort(held.begin(), held.begin() + n, held.end(), longerQueue);
+    r.mostHeld.clear();
+    for (std::size_t i = 0; i < n; ++i)
+        r.mostHeld.push_back(CirculationReport::Held{next.idAt(held[i].second), m_store.itemAt(held[i].second).title,
+                                                     held[i].first});
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "circulationsnapshot.hpp"
+#include "facetindex.hpp"
+#include <QDate>
+#include <QString>
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class DataStore;
+
+// Circulation as management reads it, as of one snapshot
+struct CirculationReport {
+    struct Counts {
+        int items = 0;
+        int onLoan = 0;
+        int onHoldShelf = 0;
+        int queuedHolds = 0;   // patrons waiting
+
+        //Share of items out of patrons' reach: on loan or kept for someone
+        double utilization() const { return items ? double(onLoan + onHoldShelf) / items : 0.0; }
+        //Patrons waiting per item
+        double holdPressure() const { return items ? double(queuedHolds) / items : 0.0; }
+    };
+
+    struct Held {
+        int itemId;
+        QString title;
+        int queued;
+    };
+
+    // Items by hold queue length: 1, 2, 3-4, 5-9, 10 or more waiting
+    static constexpr int QueueBuckets = 5;
+    static const char *queueBucketName(int bucket);
+    static int queueBucket(int queued);
+
+    quint64 version = 0;   // snapshot the figures come from
+    QDate asOf;
+    Counts total;
+    std::array<Counts, FacetCounts::FormatCount> formats{};   // by ItemFormat
+    std::vector<std::pair<QString, Counts>> genres;            // every genre, by name
+    std::vector<std::pair<QString, Counts>> creators;          // most loans first, topN of creatorCount
+    int creatorCount = 0;
+    std::vector<Held> mostHeld;                                // longest queues first, topN
+    std::array<int, QueueBuckets> queueLengths{};
+
+    // What the refresh that produced it had to read
+    int itemsAdded = 0;       // new items whose keys were read
+    int pagesRecounted = 0;   // snapshot pages recounted, of pageCount
+    int pageCount = 0;
+
+    //Plain-text tables, for AdminWindow's export
+    QString toText() const;
+};
+
+// ---------------------------------------------
+// CirculationReporter: loans, utilization and hold pressure by format,
+// genre and creator, kept current from DataStore snapshots
+// ---------------------------------------------
+// Figures come in two parts. What the catalogue holds (items per format,
+// genre and creator) is counted once per item, when the item is first
+// seen: metadata never changes. What circulation is doing (loans, hold
+// shelf, queues) is counted per CirculationSnapshot page, and a refresh
+// recounts only the pages the new snapshot does not share with the
+// previous one, subtracting each page's old figures and adding its new
+// ones. After the first report a refresh costs the pages touched since the
+// last, not the catalogue.
+//
+// Both parts run on up to `threads` threads, the caller's included. Each
+// thread claims blocks of items or pages and counts into its own
+// accumulator (genres and creators by an id local to the thread while
+// reading keys, by global id while counting pages), and the accumulators
+// are merged when every block is done; new names are merged a hash shard
+// per thread. Snapshots are read without locks, so reporting never holds
+// up the desks.
+//
+// Not thread-safe: one thread refreshes (AdminWindow's timer). Slots must
+// keep their items, so open the catalogue before the first refresh.
+class CirculationReporter
+{
+public:
+    //threads = 0: one per core
+    explicit CirculationReporter(const DataStore &store, int threads = 0, int topN = 20);
+    ~CirculationReporter();
+    CirculationReporter(const CirculationReporter &) = delete;
+    CirculationReporter &operator=(const CirculationReporter &) = delete;
+
+    //Report as of a snapshot taken now
+    const CirculationReport &refresh();
+    const CirculationReport &report() const { return m_report; }
+
+private:
+    using Counts = CirculationReport::Counts;
+
+    // What an item is counted under; genre and creator are ids into the
+    // name tables (-1 = none)
+    struct Key {
+        ItemFormat format;
+        int genre;
+        int creator;
+    };
+
+    // One page's longest queues: (queued, slot), longest first
+    using PageTop = std::vector<std::pair<int, int>>;
+
+    // Genre or creator names by dense id. The lookup is split by hash, so
+    // the names the threads met are merged a shard per thread.
+    static constexpr int NameShards = 64;
+    struct NameTable {
+        std::array<std::unordered_map<QString, int, QStringHash>, NameShards> ids;
+        std::vector<QString> names;
+    };
+
+    struct Names;
+    struct KeyPart;
+    struct PagePart;
+
+    void readKeys(int count);
+    int recountPages(const CirculationSnapshot &next);   // pages recounted
+    void buildReport(const CirculationSnapshot &next);
+    static void tally(PagePart &part, const Key &key, int borrower, int queued, int sign);
+
+    const DataStore &m_store;
+    int m_threadCount;
+    int m_topN;
+
+    std::shared_ptr<const CirculationSnapshot> m_snapshot;   // last counted
+    std::vector<Key> m_keys;                                 // by slot
+    NameTable m_genreNames;
+    NameTable m_creatorNames;
+
+    // Running totals, by format / genre id / creator id
+    Counts m_total;
+    std::array<Counts, FacetCounts::FormatCount> m_formats{};
+    std::vector<Counts> m_genres;
+    std::vector<Counts> m_creators;
+    std::array<int, CirculationReport::QueueBuckets> m_queueLengths{};
+    std::vector<PageTop> m_pageTops;
+
+    CirculationReport m_report;
+};
@@ -0,0 +1,90 @@
+#include "circulationsnapshot.hpp"
+#include <algorithm>
+
+std::shared_ptr<const CirculationSnapshot> CirculationSnapshot::update(
+    const std::shared_ptr<const CirculationSnapshot> &previous, std::vector<Entry> &entries, int count,
+    quint64 version, qint32 clockDay)
+{
+    std::shared_ptr<CirculationSnapshot> next(new CirculationSnapshot);
+    next->m_count = count;
+    next->m_version = version;
+    next->m_clockDay = clockDay;
+    if (previous)
+        next->m_pages = previous->m_pages;   // shared until written
+    next->m_pages.resize(std::size_t(count + PageSlots - 1) / PageSlots);
+
+    // A first snapshot lists every slot in order; skip sorting a million entries
+    auto bySlot = [](const Entry &a, const Entry &b) { return a.slot < b.slot; };
+    if (!std::is_sorted(entries.begin(), entries.end(), bySlot))
+        std::stable_sort(entries.begin(), entries.end(), bySlot);
+    for (std::size_t i = 0; i < entries.size();)
+    {
+        // Copy the page once for all of its entries
+        const std::size_t p = std::size_t(entries[i].slot) / PageSlots;
+        auto page = next->m_pages[p] ? std::make_shared<Page>(*next->m_pages[p]) : std::make_shared<Page>();
+        for (; i < entries.size() && std::size_t(entries[i].slot) / PageSlots == p; ++i)
+        {
+            const Entry &e = entries[i];
+            const int at = e.slot % PageSlots;
+            page->ids[at] = e.id;
+            page->borrowers[at] = e.borrower;
+            page->days[at] = e.day;
+            page->queued[at] = e.queued;
+        }
+        page->summarize();
+        next->m_pages[p] = std::move(page);
+    }
+
+    // Page totals are kept with the pages, so this reads the table only
+    Totals &t = next->m_totals;
+    for (std::size_t p = 0; p < next->m_pages.size(); ++p)
+    {
+        const Totals &pt = next->m_pages[p]->totals;
+        t.activeLoans += pt.activeLoans;
+        t.onHoldShelf += pt.onHoldShelf;
+        t.queuedHolds += pt.queuedHolds;
+        t.itemsWithQueue += pt.itemsWithQueue;
+        if (pt.longestQueue > t.longestQueue)
+        {
+            t.longestQueue = pt.longestQueue;
+            t.longestQueueSlot = int(p) * PageSlots + pt.longestQueueSlot;
+        }
+    }
+    return next;
+}
+
+void CirculationSnapshot::Page::summarize()
+{
+    // Unused slots at the end of the last page are zero and count for nothing
+    totals = Totals();
+    for (int i = 0; i < PageSlots; ++i)
+    {
+        totals.activeLoans += borrowers[i] > 0;
+        totals.onHoldShelf += borrowers[i] < 0;
+        totals.queuedHolds += queued[i];
+        totals.itemsWithQueue += queued[i] > 0;
+        if (queued[i] > totals.longestQueue)
+        {
+            totals.longestQueue = queued[i];
+            totals.longestQueueSlot = i;
+        }
+    }
+}
+
+ItemStatus CirculationSnapshot::toStatus(int borrower, qint32 day)
+{
+    ItemStatus status;
+    status.available = borrower == 0;
+    if (borrower > 0)
+    {
+        status.borrower = borrower;
+        if (day)
+            status.dueDate = QDate::fromJulianDay(day);
+    }
+    else if (borrower < 0)
+    {
+        status.readyFor = -borrower;
+        status.pickupBy = QDate::fromJulianDay(day);
+    }
+    return status;
+}
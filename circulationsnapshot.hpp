@@ -0,0 +1,100 @@
+#pragma once
+#include "models.hpp"
+#include <QDate>
+#include <QtGlobal>
+#include <array>
+#include <memory>
+#include <vector>
+
+// ---------------------------------------------
+// CirculationSnapshot: every item's circulation state at one moment
+// ---------------------------------------------
+// Published by DataStore::snapshot() and never modified afterwards, so any
+// number of threads can read one for as long as they like, with no locks,
+// while borrows and returns carry on. Item metadata needs no snapshot:
+// records are append-only and never edited, so ids (kept here) and slots
+// stay valid.
+//
+// Slots are kept in pages of PageSlots. The next snapshot copies only the
+// pages holding items that changed and shares every other page with the
+// previous one, so publishing after a handful of borrows costs a handful
+// of page copies plus the page table. A page is freed with the last
+// snapshot that refers to it; readers never wait for that.
+class CirculationSnapshot
+{
+public:
+    static constexpr int PageSlots = 1024;
+
+    // One item's state as the store read it
+    struct Entry {
+        int slot;
+        int id;
+        int borrower;   // patron id, -patron id on the hold shelf, 0 = on the shelf
+        qint32 day;     // Julian due day, or last pickup day on the hold shelf
+        int queued;     // patrons in its hold queue
+    };
+
+    // Sums over all items
+    struct Totals {
+        int activeLoans = 0;
+        int onHoldShelf = 0;
+        int queuedHolds = 0;
+        int itemsWithQueue = 0;
+        int longestQueue = 0;
+        int longestQueueSlot = -1;   // -1 = no queues
+    };
+
+    //previous (may be null) with entries applied, covering slots [0, count).
+    //Every slot past previous's count must have an entry; entries are
+    //sorted here and the last one for a slot wins.
+    static std::shared_ptr<const CirculationSnapshot> update(const std::shared_ptr<const CirculationSnapshot> &previous,
+                                                             std::vector<Entry> &entries, int count,
+                                                             quint64 version, qint32 clockDay);
+
+    //How DataStore reports a borrower and day (see ItemStatus)
+    static ItemStatus toStatus(int borrower, qint32 day);
+
+    //Store version() when taken: every ChangeSet up to it is included
+    quint64 version() const { return m_version; }
+    QDate clockDate() const { return QDate::fromJulianDay(m_clockDay); }
+
+    int itemCount() const { return m_count; }
+    int availableCount() const { return m_count - m_totals.activeLoans - m_totals.onHoldShelf; }
+    const Totals &totals() const { return m_totals; }
+
+    //Per slot, 0 .. itemCount()-1
+    int idAt(int slot) const { return page(slot).ids[slot % PageSlots]; }
+    int borrowerAt(int slot) const { return page(slot).borrowers[slot % PageSlots]; }
+    qint32 dayAt(int slot) const { return page(slot).days[slot % PageSlots]; }
+    int queuedAt(int slot) const { return page(slot).queued[slot % PageSlots]; }
+    ItemStatus statusAt(int slot) const { return toStatus(borrowerAt(slot), dayAt(slot)); }
+
+    //Pages, PageSlots slots each. A page this snapshot shares with other
+    //is the same object, so none of its items differ between the two:
+    //readers that keep per-page results recount only the other pages.
+    int pageCount() const { return (int)m_pages.size(); }
+    bool sharesPage(const CirculationSnapshot &other, int page) const
+    {
+        return page < other.pageCount() && m_pages[page] == other.m_pages[page];
+    }
+
+private:
+    CirculationSnapshot() = default;
+
+    struct Page {
+        std::array<int, PageSlots> ids{};
+        std::array<int, PageSlots> borrowers{};
+        std::array<qint32, PageSlots> days{};
+        std::array<int, PageSlots> queued{};
+        Totals totals;   // of this page; slots are page-relative
+
+        void summarize();
+    };
+    const Page &page(int slot) const { return *m_pages[slot / PageSlots]; }
+
+    std::vector<std::shared_ptr<const Page>> m_pages;
+    int m_count = 0;
+    quint64 m_version = 0;
+    qint32 m_clockDay = 0;
+    Totals m_totals;
+};
@@ -0,0 +1,48 @@
+# Store core shared by the app, the tools and the benchmarks: the DataStore,
+# what it is built from and the store protocol. No GUI or socket code;
+# each project adds its own sources on top.
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/alsoborrowedindex.cpp \
+    $$PWD/cataloguefile.cpp \
+    $$PWD/catalogueimport.cpp \
+    $$PWD/circulationhistory.cpp \
+    $$PWD/circulationreport.cpp \
+    $$PWD/circulationsnapshot.cpp \
+    $$PWD/csvreader.cpp \
+    $$PWD/datastore.cpp \
+    $$PWD/datastorepersistence.cpp \
+    $$PWD/dueschedule.cpp \
+    $$PWD/facetindex.cpp \
+    $$PWD/holdqueue.cpp \
+    $$PWD/searchindex.cpp \
+    $$PWD/storemetrics.cpp \
+    $$PWD/storeprotocol.cpp \
+    $$PWD/storeservice.cpp \
+    $$PWD/stringarena.cpp \
+    $$PWD/transactionlog.cpp \
+    $$PWD/workloadtrace.cpp
+
+HEADERS += \
+    $$PWD/alsoborrowedindex.hpp \
+    $$PWD/bytecodec.hpp \
+    $$PWD/cataloguefile.hpp \
+    $$PWD/catalogueimport.hpp \
+    $$PWD/circulationhistory.hpp \
+    $$PWD/circulationreport.hpp \
+    $$PWD/circulationsnapshot.hpp \
+    $$PWD/csvreader.hpp \
+    $$PWD/datastore.hpp \
+    $$PWD/dueschedule.hpp \
+    $$PWD/facetindex.hpp \
+    $$PWD/holdqueue.hpp \
+    $$PWD/models.hpp \
+    $$PWD/searchindex.hpp \
+    $$PWD/storemetrics.hpp \
+    $$PWD/storeprotocol.hpp \
+    $$PWD/storeservice.hpp \
+    $$PWD/stringarena.hpp \
+    $$PWD/stripedlock.hpp \
+    $$PWD/transactionlog.hpp \
+    $$PWD/workloadtrace.hpp
@@ -0,0 +1,54 @@
+#include "csvreader.hpp"
+
+bool CsvReader::next(std::vector<QString> &fields)
+{
+    fields.clear();
+    if (m_p >= m_end)
+        return false;
+    m_recordLine = m_line;
+
+    for (;;)
+    {
+        m_field.clear();
+        if (m_p < m_end && *m_p == '"')
+        {
+            // quoted field: runs to the next lone quote
+            ++m_p;
+            while (m_p < m_end)
+            {
+                if (*m_p == '"')
+                {
+                    if (m_p + 1 < m_end && m_p[1] == '"')
+                    {
+                        m_field.push_back('"');
+                        m_p += 2;
+                        continue;
+                    }
+                    ++m_p;
+                    break;
+                }
+                if (*m_p == '\n')
+                    ++m_line;
+                m_field.push_back(*m_p++);
+            }
+        }
+        // unquoted field, or anything trailing a closing quote
+        while (m_p < m_end && *m_p != ',' && *m_p != '\n' && *m_p != '\r')
+            m_field.push_back(*m_p++);
+        fields.push_back(QString::fromUtf8(m_field.data(), int(m_field.size())));
+
+        if (m_p < m_end && *m_p == ',')
+        {
+            ++m_p;
+            continue;
+        }
+        if (m_p < m_end && *m_p == '\r')
+            ++m_p;
+        if (m_p < m_end && *m_p == '\n')
+        {
+            ++m_p;
+            ++m_line;
+        }
+        return true;
+    }
+}
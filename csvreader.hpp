@@ -0,0 +1,33 @@
+#pragma once
+#include <QString>
+#include <vector>
+#include <cstddef>
+#include <string>
+
+// ---------------------------------------------
+// CsvReader: RFC 4180 records from a block of memory
+// ---------------------------------------------
+// Fields may be "quoted" (with "" as an escaped quote and embedded line
+// breaks); records end at LF or CRLF. Text is decoded as UTF-8.
+class CsvReader
+{
+public:
+    CsvReader(const char *data, std::size_t size) : m_begin(data), m_p(data), m_end(data + size) {}
+
+    //Read the next record; false at end of input
+    bool next(std::vector<QString> &fields);
+
+    //Line the last record started on (1-based, counted from the start of data)
+    int line() const { return m_recordLine; }
+
+    //Bytes consumed so far
+    std::size_t offset() const { return std::size_t(m_p - m_begin); }
+
+private:
+    const char *m_begin;
+    const char *m_p;
+    const char *m_end;
+    int m_line = 1;
+    int m_recordLine = 0;
+    std::string m_field;
+};
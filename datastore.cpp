@@ -1,168 +1,1078 @@
 #include "datastore.hpp"
+#include "transactionlog.hpp"
+#include "cataloguefile.hpp"
 #include <algorithm>
+#include <limits>
+
+thread_local DataStore::ChangeBatch *DataStore::t_batch = nullptr;
+thread_local std::vector<std::unique_ptr<ChangeSet>> DataStore::t_spareChanges;
 
 DataStore &DataStore::instance()
 {
-    static DataStore ds;
+    static DataStore ds(true);
     return ds;
 }
 
-DataStore::DataStore()
+DataStore::~DataStore()
+{
+    waitForCompaction();
+}
+
+DataStore::DataStore(bool seedDemoData)
 {
-    seedUsers();
-    seedItems();
+    resetSchedules(qint32(QDate::currentDate().toJulianDay()));
+    if (seedDemoData)
+    {
+        seedUsers();
+        seedItems();
+        m_demoItems = true;
+    }
 }
 
 void DataStore::seedUsers()
 {
     // 5 patrons, 1 librarian, 1 admin — simple names so TAs can test quickly
-    m_users.push_back(User{"Alice", UserType::Patron, {}, {}});
-    m_users.push_back(User{"Bob", UserType::Patron, {}, {}});
-    m_users.push_back(User{"Carmen", UserType::Patron, {}, {}});
-    m_users.push_back(User{"Dev", UserType::Patron, {}, {}});
-    m_users.push_back(User{"Eve", UserType::Patron, {}, {}});
-    m_users.push_back(User{"Librarian", UserType::Librarian, {}, {}});
-    m_users.push_back(User{"Admin", UserType::Admin, {}, {}});
+    upsertUser(User{0, "Alice", UserType::Patron, {}, {}});
+    upsertUser(User{0, "Bob", UserType::Patron, {}, {}});
+    upsertUser(User{0, "Carmen", UserType::Patron, {}, {}});
+    upsertUser(User{0, "Dev", UserType::Patron, {}, {}});
+    upsertUser(User{0, "Eve", UserType::Patron, {}, {}});
+    upsertUser(User{0, "Librarian", UserType::Librarian, {}, {}});
+    upsertUser(User{0, "Admin", UserType::Admin, {}, {}});
 }
 
 void DataStore::seedItems()
 {
     int id = 1;
     // 5 fiction
-    m_items.push_back(Item{id++, "The Wind Road", "J. Harper", ItemFormat::FictionBook, {},{}, "", "", "", "", ""});
-    m_items.push_back(Item{id++, "Night Harbor", "A. Singh", ItemFormat::FictionBook, {},{}, "", "", "", "", ""});
-    m_items.push_back(Item{id++, "Echoes", "L. Chen", ItemFormat::FictionBook, {}, {},"", "", "", "", ""});
-    m_items.push_back(Item{id++, "Summer Glass", "M. Ortega", ItemFormat::FictionBook, {}, {}, "", "", "", "", ""});
-    m_items.push_back(Item{id++, "Hidden Leaves", "R. Patel", ItemFormat::FictionBook, {}, {},"", "", "", "", ""});
+    addItem(Item{id++, "The Wind Road", "J. Harper", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+    addItem(Item{id++, "Night Harbor", "A. Singh", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+    addItem(Item{id++, "Echoes", "L. Chen", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+    addItem(Item{id++, "Summer Glass", "M. Ortega", ItemFormat::FictionBook, {}, "", "", "", "", ""});
+    addItem(Item{id++, "Hidden Leaves", "R. Patel", ItemFormat::FictionBook, {}, "", "", "", "", ""});
 
     // 5 non-fiction (with Dewey)
-    m_items.push_back(Item{id++, "Quantum Basics", "S. Rao", ItemFormat::NonFictionBook, {}, {},"530.12", "", "", "", ""});
-    m_items.push_back(Item{id++, "The Brain Map", "N. Ahmed", ItemFormat::NonFictionBook, {}, {},"612.82", "", "", "", ""});
-    m_items.push_back(Item{id++, "Design Matters", "P. Nguyen", ItemFormat::NonFictionBook, {}, {},"745.4", "", "", "", ""});
-    m_items.push_back(Item{id++, "Civic Algorithms", "K. Okafor", ItemFormat::NonFictionBook, {}, {},"303.38", "", "", "", ""});
-    m_items.push_back(Item{id++, "Kitchen Chemistry", "D. Rossi", ItemFormat::NonFictionBook, {}, {},"540.1", "", "", "", ""});
+    addItem(Item{id++, "Quantum Basics", "S. Rao", ItemFormat::NonFictionBook, {}, "530.12", "", "", "", ""});
+    addItem(Item{id++, "The Brain Map", "N. Ahmed", ItemFormat::NonFictionBook, {}, "612.82", "", "", "", ""});
+    addItem(Item{id++, "Design Matters", "P. Nguyen", ItemFormat::NonFictionBook, {}, "745.4", "", "", "", ""});
+    addItem(Item{id++, "Civic Algorithms", "K. Okafor", ItemFormat::NonFictionBook, {}, "303.38", "", "", "", ""});
+    addItem(Item{id++, "Kitchen Chemistry", "D. Rossi", ItemFormat::NonFictionBook, {}, "540.1", "", "", "", ""});
 
     // 3 magazines (issue + pubDate)
-    m_items.push_back(Item{id++, "Tech Monthly", "Editorial Board", ItemFormat::Magazine, {}, {},"", "Issue 142", "2025-10", "", ""});
-    m_items.push_back(Item{id++, "Nature & You", "Editorial Board", ItemFormat::Magazine, {}, {},"", "Issue 88", "2025-09", "", ""});
-    m_items.push_back(Item{id++, "Cinema Now", "Editorial Board", ItemFormat::Magazine, {}, {},"", "Issue 23", "2025-11", "", ""});
+    addItem(Item{id++, "Tech Monthly", "Editorial Board", ItemFormat::Magazine, {}, "", "Issue 142", "2025-10", "", ""});
+    addItem(Item{id++, "Nature & You", "Editorial Board", ItemFormat::Magazine, {}, "", "Issue 88", "2025-09", "", ""});
+    addItem(Item{id++, "Cinema Now", "Editorial Board", ItemFormat::Magazine, {}, "", "Issue 23", "2025-11", "", ""});
 
     // 3 movies (genre + rating)
-    m_items.push_back(Item{id++, "Northern Lights", "K. Yamamoto", ItemFormat::Movie, {}, {},"", "", "", "Drama", "PG-13"});
-    m_items.push_back(Item{id++, "Edge Protocol", "R. Coleman", ItemFormat::Movie, {}, {},"", "", "", "Sci-Fi", "PG-13"});
-    m_items.push_back(Item{id++, "Riverfront", "M. Da Silva", ItemFormat::Movie, {}, {},"", "", "", "Documentary", "G"});
+    addItem(Item{id++, "Northern Lights", "K. Yamamoto", ItemFormat::Movie, {}, "", "", "", "Drama", "PG-13"});
+    addItem(Item{id++, "Edge Protocol", "R. Coleman", ItemFormat::Movie, {}, "", "", "", "Sci-Fi", "PG-13"});
+    addItem(Item{id++, "Riverfront", "M. Da Silva", ItemFormat::Movie, {}, "", "", "", "Documentary", "G"});
 
     // 4 video games (genre + rating)
-    m_items.push_back(Item{id++, "Skyforge", "BlueFox Studio", ItemFormat::VideoGame, {}, {},"", "", "", "Adventure", "E10+"});
-    m_items.push_back(Item{id++, "Circuit Clash", "ArcByte", ItemFormat::VideoGame, {}, {},"", "", "", "Action", "T"});
-    m_items.push_back(Item{id++, "Farmstead 2049", "Sunseed", ItemFormat::VideoGame, {}, {},"", "", "", "Simulation", "E"});
-    m_items.push_back(Item{id++, "Starlane", "Nova North", ItemFormat::VideoGame, {}, {},"", "", "", "Strategy", "E10+"});
+    addItem(Item{id++, "Skyforge", "BlueFox Studio", ItemFormat::VideoGame, {}, "", "", "", "Adventure", "E10+"});
+    addItem(Item{id++, "Circuit Clash", "ArcByte", ItemFormat::VideoGame, {}, "", "", "", "Action", "T"});
+    addItem(Item{id++, "Farmstead 2049", "Sunseed", ItemFormat::VideoGame, {}, "", "", "", "Simulation", "E"});
+    addItem(Item{id++, "Starlane", "Nova North", ItemFormat::VideoGame, {}, "", "", "", "Strategy", "E10+"});
+}
+
+int DataStore::findUserId(const QString &name) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::FindUser);
+    trace(WorkloadTrace::Op::FindUser, 0, 0, name);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    auto found = m_userIndex.find(name);
+    return found == m_userIndex.end() ? 0 : (int)found->second + 1;
+}
+
+int DataStore::upsertUser(User user)
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::UpsertUser);
+    ChangeBatch batch(*this);
+    std::unique_lock<StripedSharedMutex> structure(m_structure);
+    const int id = storeUser(std::move(user));
+    logUser(m_users[id - 1]);
+    return id;
+}
+
+int DataStore::storeUser(User &&user)
+{
+    auto found = m_userIndex.find(user.name);
+    if (found != m_userIndex.end())
+    {
+        // Same name: overwrite the fields in place, keeping the record's buffers
+        User &stored = m_users[found->second];
+        stored.type = user.type;
+        stored.activeLoans.assign(user.activeLoans.begin(), user.activeLoans.end());
+        stored.holds.assign(user.holds.begin(), user.holds.end());
+        markChanged(pending().usersChanged, stored.id);
+        return stored.id;
+    }
+    // ids are handed out densely so that id - 1 is the slot in m_users;
+    // the lists come from the patron's stripe pool, and the loan list is
+    // sized for the cap up front so borrowing never grows it
+    const int id = (int)m_users.size() + 1;
+    std::pmr::memory_resource *pool = &m_patronStripes[std::size_t(id) % LockStripes].pool;
+    m_userIndex.emplace(user.name, m_users.size());
+    m_users.push_back(User{id, std::move(user.name), user.type, std::pmr::vector<int>(pool), std::pmr::vector<int>(pool)});
+    User &stored = m_users.back();
+    stored.activeLoans.reserve(std::max<std::size_t>(user.activeLoans.size(), Rules::MaxActiveLoans));
+    stored.activeLoans.assign(user.activeLoans.begin(), user.activeLoans.end());
+    stored.holds.assign(user.holds.begin(), user.holds.end());
+    markChanged(pending().usersChanged, id);
+    return id;
+}
+
+User *DataStore::userRecord(int id)
+{
+    if (id <= 0 || id > (int)m_users.size())
+        return nullptr;
+    return &m_users[id - 1];
+}
+
+std::optional<QString> DataStore::addItem(Item item)
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::AddItem);
+    ChangeBatch batch(*this);
+    std::unique_lock<StripedSharedMutex> structure(m_structure);
+    const int slot = slotCount();
+    if (auto err = appendItem(item))
+        return err;
+    growSlots(slot);
+    if (!item.status.available)
+        setLoan(slot, item.status.borrower, item.status.dueDate ? item.status.dueDate->toJulianDay() : 0);
+    return std::nullopt;
+}
+
+DataStore::BatchResult DataStore::addItems(std::vector<Item> items, std::vector<int> *ids)
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::AddItems);
+    ChangeBatch batch(*this);
+    std::unique_lock<StripedSharedMutex> structure(m_structure);
+    const int first = slotCount();
+    BatchResult results(items.size());
+    if (ids)
+        ids->assign(items.size(), 0);
+    // Room for the batch, still growing geometrically over many batches
+    auto reserveFor = [](auto &v, std::size_t more) {
+        if (v.size() + more > v.capacity())
+            v.reserve(std::max(v.size() + more, v.capacity() * 2));
+    };
+    reserveFor(m_localItems, items.size());
+    reserveFor(m_borrower, items.size());
+
+    // Metadata first; circulation tables grow once for the whole batch
+    std::vector<std::size_t> onLoan;
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        Item &item = items[i];
+        if (item.id == 0)
+            item.id = m_highestItemId + 1;
+        results[i] = appendItem(item);
+        if (results[i])
+            continue;
+        if (ids)
+            (*ids)[i] = item.id;
+        if (!item.status.available)
+            onLoan.push_back(i);
+    }
+    growSlots(first);
+    for (std::size_t i : onLoan)
+    {
+        const ItemStatus &status = items[i].status;
+        setLoan(slotOf(items[i].id), status.borrower, status.dueDate ? status.dueDate->toJulianDay() : 0);
+    }
+    return results;
+}
+
+std::optional<QString> DataStore::appendItem(const Item &item)
+{
+    // Caller holds m_structure exclusively and calls growSlots afterwards;
+    // the text is copied into m_text, item is only read
+    const int slot = slotCount();
+    if (item.id <= 0 || item.id > MaxItemId)
+        return QString("Item id %1 is out of range.").arg(item.id);
+    if (!claimItemId(item.id, slot))
+        return QString("Item id %1 already exists.").arg(item.id);
+
+    markChanged(pending().itemsAdded, item.id);
+
+    // Keep only the fields this format uses (same rule as the catalogue file)
+    int details = -1;
+    switch (item.format)
+    {
+        case ItemFormat::FictionBook:
+            break;
+        case ItemFormat::NonFictionBook:
+            if (!item.dewey.isEmpty())
+            {
+                details = (int)m_deweys.size();
+                m_deweys.push_back(m_text.add(item.dewey));
+            }
+            break;
+        case ItemFormat::Magazine:
+            if (!item.issue.isEmpty() || !item.pubDate.isEmpty())
+            {
+                details = (int)m_issues.size();
+                m_issues.push_back(IssueDetails{m_text.add(item.issue), m_text.add(item.pubDate)});
+            }
+            break;
+        case ItemFormat::Movie:
+        case ItemFormat::VideoGame:
+            if (!item.genre.isEmpty() || !item.rating.isEmpty())
+            {
+                details = (int)m_media.size();
+                m_media.push_back(MediaDetails{m_text.add(item.genre), m_text.add(item.rating)});
+            }
+            break;
+    }
+    m_localItems.push_back(LocalItem{item.id, item.format, details, m_text.add(item.title), m_text.add(item.creator)});
+    m_borrower.push_back(0);
+    return std::nullopt;
+}
+
+void DataStore::growSlots(int from)
+{
+    // Slots [from, slotCount()) start on the shelf with no due date. Each
+    // stripe's schedule must reach its last new slot, and those are all
+    // among the last LockStripes slots
+    m_available.grow(slotCount());
+    for (int slot = std::max(from, slotCount() - LockStripes); slot < slotCount(); ++slot)
+        itemStripe(slot).due.resize(stripeIndex(slot) + 1);
 }
 
-std::optional<User> DataStore::findUser(QString name) const
+std::optional<QString> DataStore::openCatalogue(const QString &path)
 {
-    for (const auto &u : m_users)
+    std::unique_lock<StripedSharedMutex> structure(m_structure);
+    if (m_log)
+        return QString("Open the catalogue before storage.");
+    if (m_catalogue || (!m_localItems.empty() && !m_demoItems))
+        return QString("A catalogue is already loaded.");
+
+    auto file = std::make_unique<CatalogueFile>();
+    if (auto err = file->open(path))
+        return err;
+
+    // The file takes the first slots; demo items (if any) are dropped, but
+    // their text stays in m_text for Items already handed out
+    m_localItems.clear();
+    m_deweys.clear();
+    m_issues.clear();
+    m_media.clear();
+    m_borrower.clear();
+    m_available.clear();
+    m_slotById.clear();
+    m_highestItemId = 0;
+    for (ItemStripe &stripe : m_itemStripes)
+    {
+        stripe.holds.clear();
+        stripe.unpublished.clear();
+        stripe.allUnpublished = false;
+    }
+    {
+        // Snapshots already handed out keep their own pages
+        std::lock_guard<std::mutex> lock(m_snapshotLock);
+        m_snapshot.reset();
+    }
+    resetSchedules(m_clockDay);
+    {
+        std::lock_guard<std::mutex> lock(m_searchLock);
+        m_search = SearchIndex();
+        m_searchIndexed = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_facetLock);
+        m_facets = FacetIndex();
+    }
     {
-        if (u.name == name)
-            return u;
+        std::lock_guard<std::mutex> lock(m_fingerprintLock);
+        m_fingerprint = 0;
+        m_fingerprinted = 0;
     }
+    m_demoItems = false;
+    for (int slot = 0; slot < file->count(); ++slot)
+    {
+        const int id = file->idAt(slot);
+        if (id <= 0 || id > MaxItemId || !claimItemId(id, slot))
+        {
+            m_slotById.clear();
+            m_highestItemId = 0;
+            return QString("Catalogue %1 has a missing or duplicate item id %2.").arg(path).arg(id);
+        }
+    }
+    m_catalogueCount = file->count();
+    m_catalogue = std::move(file);
+    m_borrower.resize(m_catalogueCount, 0);
+    growSlots(0);
     return std::nullopt;
 }
 
-void DataStore::upsertUser(const User &user)
+bool DataStore::claimItemId(int id, int slot)
+{
+    if (id >= (int)m_slotById.size())
+        m_slotById.resize(std::max<std::size_t>(std::size_t(id) + 1, m_slotById.size() * 2), -1);
+    if (m_slotById[id] >= 0)
+        return false;
+    m_slotById[id] = slot;
+    m_highestItemId = std::max(m_highestItemId, id);
+    return true;
+}
+
+int DataStore::itemCount() const
+{
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return slotCount();
+}
+
+quint64 DataStore::catalogueFingerprint() const
 {
-    for (auto &u : m_users)
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    std::lock_guard<std::mutex> lock(m_fingerprintLock);
+    ByteWriter record;
+    for (; m_fingerprinted < slotCount(); ++m_fingerprinted)
     {
-        if (u.name == user.name)
+        const Item item = readItem(m_fingerprinted);
+        record.clear();
+        record.putSVarint(item.id);
+        record.putString(item.title);
+        record.putString(item.creator);
+        record.putU8(quint8(item.format));
+        record.putString(item.dewey);
+        record.putString(item.issue);
+        record.putString(item.pubDate);
+        record.putString(item.genre);
+        record.putString(item.rating);
+        // FNV-1a, then mixed (splitmix64) so that the per-item hashes can
+        // simply be added up
+        quint64 h = 0xcbf29ce484222325ull;
+        for (std::size_t i = 0; i < record.size(); ++i)
+            h = (h ^ quint8(record.data()[i])) * 0x100000001b3ull;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+        m_fingerprint += h ^ (h >> 31);
+    }
+    return m_fingerprint;
+}
+
+int DataStore::itemIdAt(int slot) const
+{
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return idAt(slot);
+}
+
+int DataStore::idAt(int slot) const
+{
+    return slot < m_catalogueCount ? m_catalogue->idAt(slot) : m_localItems[slot - m_catalogueCount].id;
+}
+
+Item DataStore::itemAt(int slot) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::ReadItem);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return readItem(slot);
+}
+
+Item DataStore::readItem(int slot) const
+{
+    Item it;
+    if (slot < m_catalogueCount)
+    {
+        it = m_catalogue->itemAt(slot);
+    }
+    else
+    {
+        const LocalItem &l = m_localItems[slot - m_catalogueCount];
+        it = Item{l.id, m_text.view(l.title), m_text.view(l.creator), l.format, {}, "", "", "", "", ""};
+        if (l.details >= 0)
         {
-            u = user;
+            switch (l.format)
+            {
+                case ItemFormat::FictionBook:
+                    break;
+                case ItemFormat::NonFictionBook:
+                    it.dewey = m_text.view(m_deweys[l.details]);
+                    break;
+                case ItemFormat::Magazine:
+                    it.issue = m_text.view(m_issues[l.details].issue);
+                    it.pubDate = m_text.view(m_issues[l.details].pubDate);
+                    break;
+                case ItemFormat::Movie:
+                case ItemFormat::VideoGame:
+                    it.genre = m_text.view(m_media[l.details].genre);
+                    it.rating = m_text.view(m_media[l.details].rating);
+                    break;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(itemStripe(slot).mutex);
+    it.status = readStatus(slot);
+    return it;
+}
+
+ItemStatus DataStore::statusAt(int slot) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::ReadItem);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    std::lock_guard<std::mutex> lock(itemStripe(slot).mutex);
+    return readStatus(slot);
+}
+
+ItemStatus DataStore::readStatus(int slot) const
+{
+    return CirculationSnapshot::toStatus(m_borrower[slot], dueDayAt(slot));
+}
+
+std::vector<std::unique_lock<std::mutex>> DataStore::lockAllItems() const
+{
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(LockStripes);
+    for (ItemStripe &stripe : m_itemStripes)
+        locks.emplace_back(stripe.mutex);
+    return locks;
+}
+
+std::shared_ptr<const CirculationSnapshot> DataStore::snapshot() const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::Snapshot);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    std::lock_guard<std::mutex> lock(m_snapshotLock);
+    if (m_snapshot && m_snapshotChanges == circulationChanges() && m_snapshot->itemCount() == slotCount() &&
+        m_snapshot->clockDate().toJulianDay() == m_clockDay.load())
+        return m_snapshot;
+
+    // Under the item locks only read what changed (and slots added since);
+    // copying pages happens after they are released
+    auto entryAt = [this](int slot) {
+        const HoldQueue *queue = holdsAt(slot);
+        return CirculationSnapshot::Entry{slot, 0, m_borrower[slot], dueDayAt(slot), queue ? queue->size() : 0};
+    };
+    const int published = m_snapshot ? m_snapshot->itemCount() : 0;
+    std::vector<CirculationSnapshot::Entry> &entries = m_snapshotEntries;
+    entries.clear();
+    quint64 version = 0;
+    qint32 clockDay = 0;
+    {
+        const auto locks = lockAllItems();
+        m_snapshotChanges = circulationChanges();
+        version = m_version.load();
+        clockDay = m_clockDay.load();
+        for (int s = 0; s < LockStripes; ++s)
+        {
+            ItemStripe &stripe = m_itemStripes[s];
+            if (stripe.allUnpublished)
+            {
+                for (int slot = s; slot < published; slot += LockStripes)
+                    entries.push_back(entryAt(slot));
+            }
+            else
+            {
+                for (int slot : stripe.unpublished)
+                    if (slot < published)
+                        entries.push_back(entryAt(slot));
+            }
+            stripe.unpublished.clear();
+            stripe.allUnpublished = false;
+        }
+        for (int slot = published; slot < slotCount(); ++slot)
+            entries.push_back(entryAt(slot));
+    }
+
+    // Ids never change, so the structure lock is enough for them
+    for (CirculationSnapshot::Entry &e : entries)
+        e.id = idAt(e.slot);
+    m_snapshot = CirculationSnapshot::update(m_snapshot, entries, slotCount(), version, clockDay);
+    return m_snapshot;
+}
+
+StoreMetrics::Snapshot DataStore::metrics() const
+{
+    StoreMetrics::Snapshot snap = m_metrics.snapshot();
+    StoreGauges &g = snap.gauges;
+    const std::shared_ptr<const CirculationSnapshot> circulation = snapshot();
+    const CirculationSnapshot::Totals &t = circulation->totals();
+    g.items = circulation->itemCount();
+    g.activeLoans = t.activeLoans;
+    g.onHoldShelf = t.onHoldShelf;
+    g.queuedHolds = t.queuedHolds;
+    g.itemsWithQueue = t.itemsWithQueue;
+    g.longestQueue = t.longestQueue;
+    g.longestQueueItem = t.longestQueue ? circulation->idAt(t.longestQueueSlot) : 0;
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    g.patrons = (int)m_users.size();
+    return snap;
+}
+
+int DataStore::availableCount() const
+{
+    return snapshot()->availableCount();
+}
+
+std::vector<int> DataStore::overdueItems(const QDate &asOf) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::DueQuery);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return collectDue(std::numeric_limits<qint32>::min(), qint32(asOf.toJulianDay()));
+}
+
+std::vector<int> DataStore::dueItems(const QDate &from, const QDate &to) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::DueQuery);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return collectDue(qint32(from.toJulianDay()), qint32(to.toJulianDay()));
+}
+
+std::vector<int> DataStore::collectDue(qint32 from, qint32 to) const
+{
+    // Every stripe's loans as (due day << 32 | slot) keys, sorted into due order
+    std::vector<quint64> due;
+    std::vector<int> local;
+    const auto locks = lockAllItems();
+    for (int s = 0; s < LockStripes; ++s)
+    {
+        local.clear();
+        m_itemStripes[s].due.collect(from, to, local);
+        for (int i : local)
+        {
+            // pickup deadlines share the schedule; only loans are reported
+            const int slot = i * LockStripes + s;
+            if (m_borrower[slot] > 0)
+                due.push_back(quint64(quint32(m_itemStripes[s].due.dueDay(i))) << 32 | quint32(slot));
+        }
+    }
+    std::sort(due.begin(), due.end());
+
+    std::vector<int> ids(due.size());
+    for (std::size_t i = 0; i < due.size(); ++i)
+        ids[i] = idAt(int(due[i] & 0xffffffffu));
+    return ids;
+}
+
+void DataStore::resetSchedules(qint32 today)
+{
+    m_clockDay = today;
+    for (ItemStripe &stripe : m_itemStripes)
+        stripe.due = DueSchedule(today);
+}
+
+QDate DataStore::clockDate() const
+{
+    return QDate::fromJulianDay(m_clockDay.load());
+}
+
+QDate DataStore::today() const
+{
+    // Due dates and pickup windows count from here. The clock may lag the
+    // calendar by up to one timer tick, or run ahead of it when a caller
+    // simulates time; whichever is later counts
+    return QDate::fromJulianDay(std::max<qint64>(m_clockDay.load(), QDate::currentDate().toJulianDay()));
+}
+
+void DataStore::advanceClock(const QDate &today)
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::AdvanceClock);
+    ChangeBatch batch(*this);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+
+    // Closed pickup windows: (slot, patron id). Expiring one edits the
+    // patron's hold list, which needs their lock, so it waits until the
+    // item locks are released
+    std::vector<std::pair<int, int>> expired;
+    {
+        const auto locks = lockAllItems();
+        if (today.toJulianDay() <= m_clockDay)
             return;
+        m_clockDay = qint32(today.toJulianDay());
+        std::vector<int> dueSoon, overdue;
+        for (int s = 0; s < LockStripes; ++s)
+        {
+            dueSoon.clear();
+            overdue.clear();
+            m_itemStripes[s].due.advance(m_clockDay, Rules::DueSoonDays, dueSoon, overdue);
+            for (int i : dueSoon)
+            {
+                const int slot = i * LockStripes + s;
+                if (m_borrower[slot] > 0)
+                    markChanged(pending().dueSoon, idAt(slot));
+            }
+            for (int i : overdue)
+            {
+                const int slot = i * LockStripes + s;
+                if (m_borrower[slot] > 0)
+                    markChanged(pending().overdue, idAt(slot));
+                else if (m_borrower[slot] < 0)
+                    expired.emplace_back(slot, -m_borrower[slot]);
+            }
+        }
+    }
+    for (const auto &e : expired)
+        expirePickup(e.first, e.second);
+}
+
+void DataStore::expirePickup(int slot, int patronId)
+{
+    User *patron = userRecord(patronId);
+    if (!patron)
+        return;
+    std::scoped_lock lock(patronLock(patronId), itemStripe(slot).mutex);
+
+    // It may have been collected or given up since the clock moved
+    if (!isReservedFor(slot, patronId) || dueDayAt(slot) >= m_clockDay)
+        return;
+    const int itemId = idAt(slot);
+    applyRelease(slot, *patron);
+    markChanged(pending().pickupExpired, itemId);
+    logCirculation(LogOp::PickupExpired, itemId, patronId);
+    handOff(slot);
+}
+
+void DataStore::handOff(int slot)
+{
+    // O(log n) in this item's queue; nothing else is looked at
+    const HoldQueue *queue = holdsAt(slot);
+    if (!queue)
+        return;
+    const int patronId = queue->front();
+    const qint64 pickupDay = today().addDays(Rules::PickupDays).toJulianDay();
+    applyReady(slot, patronId, pickupDay);
+    logCirculation(LogOp::ReadyForPickup, idAt(slot), patronId, pickupDay);
+}
+
+void DataStore::applyReady(int slot, int patronId, qint64 pickupDay)
+{
+    // Out of the queue and onto the hold shelf; the item stays on the
+    // patron's hold list until they collect it or it expires
+    itemStripe(slot).holds[slot].cancel(patronId);
+    setLoan(slot, -patronId, pickupDay);
+    const int itemId = idAt(slot);
+    markChanged(pending().holdsChanged, itemId);
+    markChanged(pending().usersChanged, patronId);
+    markChanged(pending().readyForPickup, itemId);
+}
+
+void DataStore::applyRelease(int slot, User &patron)
+{
+    const int itemId = idAt(slot);
+    setLoan(slot, 0, 0);
+    patron.holds.erase(std::remove(patron.holds.begin(), patron.holds.end(), itemId), patron.holds.end());
+    markChanged(pending().holdsChanged, itemId);
+    markChanged(pending().usersChanged, patron.id);
+}
+
+QString DataStore::titleAt(int slot) const
+{
+    return slot < m_catalogueCount ? m_catalogue->field(slot, CatalogueFile::Title)
+                                   : m_text.view(m_localItems[slot - m_catalogueCount].title);
+}
+
+QString DataStore::creatorAt(int slot) const
+{
+    return slot < m_catalogueCount ? m_catalogue->field(slot, CatalogueFile::Creator)
+                                   : m_text.view(m_localItems[slot - m_catalogueCount].creator);
+}
+
+std::vector<SearchIndex::Hit> DataStore::searchCatalogue(const QString &query, int limit) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::Search);
+    trace(WorkloadTrace::Op::Search, 0, limit, query);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    std::lock_guard<std::mutex> lock(m_searchLock);
+    indexSearch();
+    return m_search.search(query, limit);
+}
+
+void DataStore::indexSearch() const
+{
+    for (; m_searchIndexed < slotCount(); ++m_searchIndexed)
+        m_search.add(m_searchIndexed, titleAt(m_searchIndexed), creatorAt(m_searchIndexed));
+}
+
+void DataStore::buildIndexes() const
+{
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    {
+        std::lock_guard<std::mutex> lock(m_searchLock);
+        indexSearch();
+    }
+    std::lock_guard<std::mutex> lock(m_facetLock);
+    indexFacets();
+}
+
+std::vector<DataStore::ReportKeys> DataStore::reportKeys(int from, int to) const
+{
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    to = std::min(to, slotCount());
+    std::vector<ReportKeys> keys;
+    keys.reserve(std::size_t(std::max(0, to - from)));
+    for (int slot = from; slot < to; ++slot)
+    {
+        if (slot < m_catalogueCount)
+        {
+            keys.push_back(ReportKeys{m_catalogue->formatAt(slot), m_catalogue->field(slot, CatalogueFile::Genre),
+                                      m_catalogue->field(slot, CatalogueFile::Creator)});
+            continue;
+        }
+        const LocalItem &l = m_localItems[slot - m_catalogueCount];
+        const bool media = l.details >= 0 && (l.format == ItemFormat::Movie || l.format == ItemFormat::VideoGame);
+        keys.push_back(ReportKeys{l.format, media ? m_text.view(m_media[l.details].genre) : QString(),
+                                  m_text.view(l.creator)});
+    }
+    return keys;
+}
+
+void DataStore::indexFacets() const
+{
+    for (int slot = m_facets.size(); slot < slotCount(); ++slot)
+    {
+        if (slot < m_catalogueCount)
+        {
+            m_facets.add(slot, m_catalogue->formatAt(slot), m_catalogue->field(slot, CatalogueFile::Genre),
+                         m_catalogue->field(slot, CatalogueFile::Rating));
+            continue;
         }
+        const LocalItem &l = m_localItems[slot - m_catalogueCount];
+        const bool media = l.details >= 0 && (l.format == ItemFormat::Movie || l.format == ItemFormat::VideoGame);
+        m_facets.add(slot, l.format, media ? m_text.view(m_media[l.details].genre) : QString(),
+                     media ? m_text.view(m_media[l.details].rating) : QString());
     }
-    m_users.push_back(user);
 }
 
-Item *DataStore::findItemById(int id)
+FacetIndex::Matches DataStore::filterCatalogue(const FacetFilter &filter, int limit) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::Filter);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    std::lock_guard<std::mutex> lock(m_facetLock);
+    indexFacets();
+    return m_facets.filter(filter, m_available, limit);
+}
+
+std::vector<int> DataStore::filterSlots(const FacetFilter &filter, std::vector<int> candidates) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::Filter);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    std::lock_guard<std::mutex> lock(m_facetLock);
+    indexFacets();
+    return m_facets.narrow(filter, m_available, std::move(candidates));
+}
+
+FacetCounts DataStore::facetCounts(const FacetFilter &filter) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::Filter);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    std::lock_guard<std::mutex> lock(m_facetLock);
+    indexFacets();
+    return m_facets.counts(filter, m_available);
+}
+
+std::optional<Item> DataStore::findItemById(int id) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::FindItem);
+    trace(WorkloadTrace::Op::FindItem, 0, id);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    const int slot = slotOf(id);
+    if (slot < 0)
+        return std::nullopt;
+    return readItem(slot);
+}
+
+int DataStore::itemSlot(int id) const
 {
-    for (auto &it : m_items)
-        if (it.id == id)
-            return &it;
-    return nullptr;
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return slotOf(id);
 }
 
-const Item *DataStore::findItemById(int id) const
+std::optional<QString> DataStore::borrowItem(int patronId, int itemId)
 {
-    for (const auto &it : m_items)
-        if (it.id == id)
-            return &it;
-    return nullptr;
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::Borrow);
+    trace(WorkloadTrace::Op::Borrow, patronId, itemId);
+    ChangeBatch batch(*this);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    const int slot = slotOf(itemId);
+    if (slot < 0)
+        return QString("Internal error: item not found.");
+    User *patron = userRecord(patronId);
+    if (!patron)
+        return QString("Internal error: patron not found.");
+
+    // Cap check and checkout happen under both locks, so two sessions of
+    // the same patron cannot both take the last loan slot
+    std::optional<QString> err;
+    {
+        std::scoped_lock lock(patronLock(patronId), itemStripe(slot).mutex);
+        err = tryBorrow(slot, *patron, today().addDays(Rules::LoanDays));
+    }
+    // The "also borrowed" index has locks of its own: update it after ours
+    if (!err)
+        m_alsoBorrowed.recordBorrow(patronId, itemId);
+    return err;
 }
 
-std::optional<QString> DataStore::borrowItem(User &patron, int itemId)
+std::optional<QString> DataStore::tryBorrow(int slot, User &patron, const QDate &due)
 {
     // Check patron loan cap
     if ((int)patron.activeLoans.size() >= Rules::MaxActiveLoans)
     {
         return QString("Borrowing blocked: you already have %1 active loans.").arg(Rules::MaxActiveLoans);
     }
-    Item *it = findItemById(itemId);
-    if (!it)
-        return QString("Internal error: item not found.");
-    if (!it->status.available)
+    if (!isAvailable(slot) && !isReservedFor(slot, patron.id))
     {
-        return QString("Item '%1' is not available to borrow.").arg(it->title);
+        if (m_borrower[slot] < 0)
+            return QString("Item '%1' is being held for another patron.").arg(titleAt(slot));
+        return QString("Item '%1' is not available to borrow.").arg(titleAt(slot));
     }
 
     // All good: perform checkout
-    it->status.available = false;
-    it->status.borrower = patron.name;
-    it->status.dueDate = QDate::currentDate().addDays(Rules::LoanDays);
-    patron.activeLoans.push_back(itemId);
-
-    // Persist patron changes to store
-    upsertUser(patron);
+    applyBorrow(slot, patron, due);
+    logCirculation(LogOp::Borrow, idAt(slot), patron.id, due.toJulianDay());
     return std::nullopt; // success
 }
 
+void DataStore::applyBorrow(int slot, User &patron, const QDate &due)
+{
+    // Collecting an item from the hold shelf fulfils the hold
+    if (isReservedFor(slot, patron.id))
+    {
+        const int itemId = idAt(slot);
+        patron.holds.erase(std::remove(patron.holds.begin(), patron.holds.end(), itemId), patron.holds.end());
+        markChanged(pending().holdsChanged, itemId);
+    }
+    setLoan(slot, patron.id, due.toJulianDay());
+    patron.activeLoans.push_back(idAt(slot));
+    markChanged(pending().usersChanged, patron.id);
+}
+
+void DataStore::setLoan(int slot, int borrower, qint64 dueDay)
+{
+    m_borrower[slot] = borrower;
+    m_available.set(slot, borrower == 0);
+    itemStripe(slot).due.set(stripeIndex(slot), qint32(dueDay));
+    markUnpublished(slot);
+    markChanged(pending().statusChanged, idAt(slot));
+}
+
+void DataStore::markUnpublished(int slot)
+{
+    // Caller holds the item's stripe. A long list (nobody has taken a
+    // snapshot in a while, or storage is replaying) turns into one reread
+    // of the stripe; the list keeps its capacity either way.
+    ItemStripe &stripe = itemStripe(slot);
+    if (!stripe.allUnpublished)
+    {
+        if (stripe.unpublished.size() < MaxUnpublished)
+        {
+            stripe.unpublished.push_back(slot);
+        }
+        else
+        {
+            stripe.unpublished.clear();
+            stripe.allUnpublished = true;
+        }
+    }
+    stripe.changes.store(stripe.changes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+quint64 DataStore::circulationChanges() const
+{
+    // Each count only grows, so an unchanged sum means no stripe changed
+    quint64 sum = 0;
+    for (const ItemStripe &stripe : m_itemStripes)
+        sum += stripe.changes.load(std::memory_order_relaxed);
+    return sum;
+}
+
 //to return item
-std::optional<QString> DataStore::returnItem(User &patron, int itemId)
+std::optional<QString> DataStore::returnItem(int patronId, int itemId)
 {
-    Item *it = findItemById(itemId);
-    if (!it)
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::Return);
+    trace(WorkloadTrace::Op::Return, patronId, itemId);
+    ChangeBatch batch(*this);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    const int slot = slotOf(itemId);
+    if (slot < 0)
         return QString("Internal error: item not found.");
+    User *patron = userRecord(patronId);
+    if (!patron)
+        return QString("Internal error: patron not found.");
+    std::scoped_lock lock(patronLock(patronId), itemStripe(slot).mutex);
+    return tryReturn(slot, *patron);
+}
 
+std::optional<QString> DataStore::tryReturn(int slot, User &patron)
+{
     // Must currently be checked out
-    if (it->status.available)
+    if (isAvailable(slot))
     {
-        return QString("Item '%1' is already available.").arg(it->title);
+        return QString("Item '%1' is already available.").arg(titleAt(slot));
     }
 
     // Defensive: ensure the returning patron is the borrower
-    if (!it->status.borrower || *it->status.borrower != patron.name)
+    if (m_borrower[slot] != patron.id)
     {
-        return QString("Item '%1' is not checked out by you.").arg(it->title);
+        return QString("Item '%1' is not checked out by you.").arg(titleAt(slot));
     }
 
-    // Remove from patron's active loans
+    // Must be on the patron's active loans
+    const int itemId = idAt(slot);
     auto &loans = patron.activeLoans;
-    auto newEnd = std::remove(loans.begin(), loans.end(), itemId);
-    if (newEnd == loans.end())
+    if (std::find(loans.begin(), loans.end(), itemId) == loans.end())
     {
-        return QString("Internal error: loan record not found for '%1'.").arg(it->title);
+        return QString("Internal error: loan record not found for '%1'.").arg(titleAt(slot));
     }
-    loans.erase(newEnd, loans.end());
 
-    // Reset item status to Available
-    it->status.available = true;
-    it->status.borrower.reset();
-    it->status.dueDate.reset();
-
-    // Persist patron updates
-    upsertUser(patron);
+    applyReturn(slot, patron);
+    logCirculation(LogOp::Return, itemId, patron.id);
 
+    // Waiting patrons come before the shelf
+    handOff(slot);
     return std::nullopt; // success
 }
 
+DataStore::BatchResult DataStore::borrowItems(int patronId, const std::vector<int> &itemIds)
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::BorrowBatch);
+    for (int id : itemIds)
+        trace(WorkloadTrace::Op::Borrow, patronId, id);
+    ChangeBatch batch(*this);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    BatchResult results(itemIds.size());
+    User *patron = userRecord(patronId);
+    if (!patron)
+    {
+        std::fill(results.begin(), results.end(), QString("Internal error: patron not found."));
+        return results;
+    }
+
+    std::vector<int> slots;
+    slots.reserve(itemIds.size());
+    for (int id : itemIds)
+        slots.push_back(slotOf(id));
+    {
+        const auto locks = lockStripes({patronId}, slots);
+
+        // One due date for the whole checkout, as on a single receipt
+        const QDate due = today().addDays(Rules::LoanDays);
+        for (std::size_t i = 0; i < itemIds.size(); ++i)
+            results[i] = slots[i] < 0 ? QString("Internal error: item not found.") : tryBorrow(slots[i], *patron, due);
+    }
+    for (std::size_t i = 0; i < itemIds.size(); ++i)
+        if (!results[i])
+            m_alsoBorrowed.recordBorrow(patronId, itemIds[i]);
+    return results;
+}
+
+DataStore::BatchResult DataStore::returnItems(int patronId, const std::vector<int> &itemIds)
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::ReturnBatch);
+    for (int id : itemIds)
+        trace(WorkloadTrace::Op::Return, patronId, id);
+    ChangeBatch batch(*this);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    BatchResult results(itemIds.size());
+    User *patron = userRecord(patronId);
+    if (!patron)
+    {
+        std::fill(results.begin(), results.end(), QString("Internal error: patron not found."));
+        return results;
+    }
+
+    std::vector<int> slots;
+    slots.reserve(itemIds.size());
+    for (int id : itemIds)
+        slots.push_back(slotOf(id));
+    const auto locks = lockStripes({patronId}, slots);
+
+    for (std::size_t i = 0; i < itemIds.size(); ++i)
+        results[i] = slots[i] < 0 ? QString("Internal error: item not found.") : tryReturn(slots[i], *patron);
+    return results;
+}
+
+DataStore::BatchResult DataStore::returnBin(const std::vector<int> &itemIds)
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::ReturnBin);
+    for (int id : itemIds)
+        trace(WorkloadTrace::Op::CheckIn, 0, id);
+    ChangeBatch batch(*this);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    BatchResult results(itemIds.size());
+
+    std::vector<int> slots;
+    slots.reserve(itemIds.size());
+    for (int id : itemIds)
+        slots.push_back(slotOf(id));
+
+    // Patron locks come before item locks, but the borrowers are only known
+    // from the items: read them, lock, and start over if any changed hands
+    // in between (another desk returned or lent it meanwhile)
+    std::vector<int> borrowers(slots.size());
+    for (;;)
+    {
+        for (std::size_t i = 0; i < slots.size(); ++i)
+        {
+            if (slots[i] < 0)
+                continue;
+            std::lock_guard<std::mutex> lock(itemStripe(slots[i]).mutex);
+            borrowers[i] = m_borrower[slots[i]];
+        }
+        const auto locks = lockStripes(borrowers, slots);
+        bool stable = true;
+        for (std::size_t i = 0; i < slots.size() && stable; ++i)
+            stable = slots[i] < 0 || borrowers[i] == m_borrower[slots[i]];
+        if (!stable)
+            continue;
+
+        // Items are returned in bin order; each patron record is touched in place
+        for (std::size_t i = 0; i < slots.size(); ++i)
+        {
+            // Scanned ids are desk input, so an unknown one is not an internal error
+            if (slots[i] < 0)
+                results[i] = QString("No item with id %1.").arg(itemIds[i]);
+            else if (borrowers[i] < 0)
+                results[i] = QString("Item '%1' is on the hold shelf for patron %2.")
+                                 .arg(titleAt(slots[i]))
+                                 .arg(-borrowers[i]);
+            else if (User *borrower = userRecord(borrowers[i]))
+                results[i] = tryReturn(slots[i], *borrower);
+            else
+                results[i] = QString("Item '%1' is already available.").arg(titleAt(slots[i]));
+        }
+        return results;
+    }
+}
+
+std::vector<std::unique_lock<std::mutex>> DataStore::lockStripes(const std::vector<int> &patronIds,
+                                                                 const std::vector<int> &slots) const
+{
+    // Stripe indexes: patrons first, then items offset past them; negative
+    // or zero entries (unknown item, no borrower) need no lock
+    std::vector<std::size_t> stripes;
+    stripes.reserve(patronIds.size() + slots.size());
+    for (int id : patronIds)
+        if (id > 0)
+            stripes.push_back(std::size_t(id) % LockStripes);
+    for (int slot : slots)
+        if (slot >= 0)
+            stripes.push_back(LockStripes + std::size_t(slot) % LockStripes);
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(stripes.size());
+    for (std::size_t s : stripes)
+        locks.emplace_back(s < LockStripes ? m_patronStripes[s].mutex : m_itemStripes[s - LockStripes].mutex);
+    return locks;
+}
+
+void DataStore::applyReturn(int slot, User &patron)
+{
+    const int itemId = idAt(slot);
+
+    // Remove from patron's active loans
+    auto &loans = patron.activeLoans;
+    loans.erase(std::remove(loans.begin(), loans.end(), itemId), loans.end());
+
+    // Reset item status to Available
+    setLoan(slot, 0, 0);
+    markChanged(pending().usersChanged, patron.id);
+}
+
 
 void DataStore::clearCurrentUserState()
 {
@@ -170,69 +1080,260 @@ void DataStore::clearCurrentUserState()
     // Each window clears its own UI state and drops User references on close.
 }
 
+int DataStore::subscribe(ChangeListener listener)
+{
+    std::lock_guard<std::mutex> lock(m_listenerLock);
+    const int token = m_nextListenerToken++;
+    auto next = std::make_shared<ListenerList>(*m_listeners);
+    next->emplace_back(token, std::move(listener));
+    m_listeners = std::move(next);
+    return token;
+}
+
+void DataStore::unsubscribe(int token)
+{
+    std::lock_guard<std::mutex> lock(m_listenerLock);
+    auto next = std::make_shared<ListenerList>(*m_listeners);
+    next->erase(std::remove_if(next->begin(), next->end(), [token](const auto &l) { return l.first == token; }),
+                next->end());
+    m_listeners = std::move(next);
+}
+
+DataStore::ChangeBatch::ChangeBatch(DataStore &ds)
+    : m_ds(ds)
+    , m_outer(t_batch)
+    , m_root(this)
+{
+    for (ChangeBatch *b = m_outer; b; b = b->m_outer)
+        if (&b->m_ds == &ds)
+            m_root = b->m_root;
+    if (m_root == this)
+    {
+        // Listeners may start batches of their own, so there is one spare
+        // per nesting depth seen on this thread
+        if (t_spareChanges.empty())
+        {
+            m_changes = std::make_unique<ChangeSet>();
+        }
+        else
+        {
+            m_changes = std::move(t_spareChanges.back());
+            t_spareChanges.pop_back();
+        }
+    }
+    t_batch = this;
+}
+
+DataStore::ChangeBatch::~ChangeBatch()
+{
+    t_batch = m_outer;
+    if (m_root != this)
+        return;
+    m_ds.endBatch(*m_changes);
+    m_changes->version = 0;
+    for (auto *ids : m_changes->lists())
+        ids->clear();
+    t_spareChanges.push_back(std::move(m_changes));
+}
+
+ChangeSet &DataStore::pending()
+{
+    for (ChangeBatch *b = t_batch; b; b = b->m_outer)
+        if (&b->m_ds == this)
+            return *b->m_root->m_changes;
+    // Every mutating path opens a batch; this only catches a missing one
+    static thread_local ChangeSet unbatched;
+    unbatched = ChangeSet();
+    return unbatched;
+}
+
+void DataStore::markChanged(std::vector<int> &ids, int id)
+{
+    // duplicates are folded once per batch in endBatch()
+    ids.push_back(id);
+}
+
+void DataStore::endBatch(ChangeSet &changes)
+{
+    // Between operations is the only safe point to snapshot
+    compactIfDue();
+    if (changes.empty())
+        return;
+
+    // Runs with no locks held, so listeners may call back into the store
+    for (auto *ids : changes.lists())
+    {
+        std::sort(ids->begin(), ids->end());
+        ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+    }
+    changes.version = ++m_version;
+    std::shared_ptr<const ListenerList> listeners;
+    {
+        std::lock_guard<std::mutex> lock(m_listenerLock);
+        listeners = m_listeners;
+    }
+    for (const auto &l : *listeners)
+        l.second(changes);
+}
+
 //user places hold
-std::optional<QString> DataStore::placeHold(User &patron, int itemId) {
-    Item *it = findItemById(itemId);
-    if (!it) return "Internal error: item not found.";
+std::optional<QString> DataStore::placeHold(int patronId, int itemId) {
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::PlaceHold);
+    trace(WorkloadTrace::Op::PlaceHold, patronId, itemId);
+    ChangeBatch batch(*this);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    const int slot = slotOf(itemId);
+    if (slot < 0) return "Internal error: item not found.";
+    User *patron = userRecord(patronId);
+    if (!patron) return "Internal error: patron not found.";
+    std::scoped_lock lock(patronLock(patronId), itemStripe(slot).mutex);
 
     // Already on loan to patron?
-    if (std::find(patron.activeLoans.begin(), patron.activeLoans.end(), itemId) != patron.activeLoans.end())
-        return QString("You already have '%1' checked out.").arg(it->title);
+    if (std::find(patron->activeLoans.begin(), patron->activeLoans.end(), itemId) != patron->activeLoans.end())
+        return QString("You already have '%1' checked out.").arg(titleAt(slot));
+
+    // Already has a hold (queued, or waiting on the hold shelf)
+    if (isReservedFor(slot, patronId) || !applyHold(slot, *patron))
+        return QString("You already placed a hold on '%1'.").arg(titleAt(slot));
 
-    // Already has a hold
-    if (std::find(patron.holds.begin(), patron.holds.end(), itemId) != patron.holds.end())
-        return QString("You already placed a hold on '%1'.").arg(it->title);
+    logCirculation(LogOp::PlaceHold, itemId, patronId);
+    return std::nullopt; // success
+}
 
-    // Place the hold
-    it->holdQueue.push(patron.name);
+bool DataStore::applyHold(int slot, User &patron)
+{
+    // An item's queue stays allocated once created, so holds that come and
+    // go on the same item reuse its buffers
+    if (!itemStripe(slot).holds[slot].enqueue(patron.id))
+        return false;
+    markUnpublished(slot);
+    const int itemId = idAt(slot);
     patron.holds.push_back(itemId);
-    upsertUser(patron);
-    return QString("Hold placed successfully. You are #%1 in queue.")
-                .arg(it->holdQueue.size());
+    markChanged(pending().holdsChanged, itemId);
+    markChanged(pending().usersChanged, patron.id);
+    return true;
 }
 
 //user cancels hold
-std::optional<QString> DataStore::cancelHold(User &patron, int itemId) {
-    Item *it = findItemById(itemId);
-    if (!it) return "Internal error: item not found.";
-
-    std::queue<QString> newQueue;
-    bool removed = false;
-
-    while (!it->holdQueue.empty()) {
-        auto front = it->holdQueue.front();
-        it->holdQueue.pop();
-        if (front != patron.name)
-            newQueue.push(front);
-        else
-            removed = true;
-    }
+std::optional<QString> DataStore::cancelHold(int patronId, int itemId) {
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::CancelHold);
+    trace(WorkloadTrace::Op::CancelHold, patronId, itemId);
+    ChangeBatch batch(*this);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    const int slot = slotOf(itemId);
+    if (slot < 0) return "Internal error: item not found.";
+    User *patron = userRecord(patronId);
+    if (!patron) return "Internal error: patron not found.";
+    std::scoped_lock lock(patronLock(patronId), itemStripe(slot).mutex);
+
+    const bool wasReady = isReservedFor(slot, patronId);
+    if (!applyCancelHold(slot, *patron))
+        return QString("You have no hold on '%1'.").arg(titleAt(slot));
 
-    it->holdQueue = newQueue;
+    logCirculation(LogOp::CancelHold, itemId, patronId);
 
-    if (removed) {
-        patron.holds.erase(
-            std::remove(patron.holds.begin(), patron.holds.end(), itemId),
-            patron.holds.end());
-        upsertUser(patron);
-        return QString("Hold on '%1' cancelled.").arg(it->title);
-    } else {
-        return QString("You have no hold on '%1'.").arg(it->title);
+    // Giving up an item on the hold shelf passes it to the next in line
+    if (wasReady)
+        handOff(slot);
+    return std::nullopt; // success
+}
+
+bool DataStore::applyCancelHold(int slot, User &patron)
+{
+    auto &holds = itemStripe(slot).holds;
+    auto queue = holds.find(slot);
+    if (queue == holds.end() || !queue->second.cancel(patron.id))
+    {
+        if (!isReservedFor(slot, patron.id))
+            return false;
+        applyRelease(slot, patron);
+        return true;
     }
+
+    markUnpublished(slot);
+    const int itemId = idAt(slot);
+    patron.holds.erase(
+        std::remove(patron.holds.begin(), patron.holds.end(), itemId),
+        patron.holds.end());
+    markChanged(pending().holdsChanged, itemId);
+    markChanged(pending().usersChanged, patron.id);
+    return true;
+}
+
+const HoldQueue *DataStore::holdsAt(int slot) const
+{
+    const auto &holds = itemStripe(slot).holds;
+    auto queue = holds.find(slot);
+    return queue == holds.end() || queue->second.empty() ? nullptr : &queue->second;
 }
 
 //calcualting hold position of user on item
-int DataStore::holdPosition(const User &patron, int itemId) const {
-    const Item *it = findItemById(itemId);
-    if (!it) return -1;
-
-    std::queue<QString> q = it->holdQueue;
-    int pos = 1;
-    while (!q.empty()) {
-        if (q.front() == patron.name)
-            return pos;
-        q.pop();
-        ++pos;
-    }
-    return -1;
+int DataStore::holdPosition(int patronId, int itemId) const {
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::HoldPosition);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    const int slot = slotOf(itemId);
+    if (slot < 0) return -1;
+    std::lock_guard<std::mutex> lock(itemStripe(slot).mutex);
+    const HoldQueue *queue = holdsAt(slot);
+    return queue ? queue->position(patronId) : -1;
+}
+
+int DataStore::holdQueueLength(int itemId) const {
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    const int slot = slotOf(itemId);
+    if (slot < 0) return 0;
+    std::lock_guard<std::mutex> lock(itemStripe(slot).mutex);
+    const HoldQueue *queue = holdsAt(slot);
+    return queue ? queue->size() : 0;
+}
+
+// History calls only add the structure lock, which keeps loadSnapshot
+// from clearing the history under a query
+std::vector<CirculationHistory::Event> DataStore::itemHistory(int itemId, int limit, CirculationHistory::Kinds kinds) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::History);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return m_history.itemEvents(itemId, limit, kinds);
+}
+
+std::vector<CirculationHistory::Event> DataStore::patronHistory(int patronId, int limit, CirculationHistory::Kinds kinds) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::History);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return m_history.patronEvents(patronId, limit, kinds);
+}
+
+std::vector<CirculationHistory::Loan> DataStore::itemLoans(int itemId, int limit) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::History);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return m_history.itemLoans(itemId, limit);
+}
+
+std::vector<CirculationHistory::Loan> DataStore::patronLoans(int patronId, int limit) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::History);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return m_history.patronLoans(patronId, limit);
+}
+
+std::vector<CirculationHistory::Event> DataStore::historyBetween(qint64 fromMs, qint64 toMs,
+                                                                 CirculationHistory::Kinds kinds) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::History);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return m_history.between(fromMs, toMs, kinds);
+}
+
+std::array<quint64, CirculationHistory::KindCount> DataStore::historyCounts(qint64 fromMs, qint64 toMs) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::History);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    return m_history.countBetween(fromMs, toMs);
+}
+
+std::vector<int> DataStore::alsoBorrowed(int itemId, int limit) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::AlsoBorrowed);
+    return m_alsoBorrowed.alsoBorrowed(itemId, limit);
 }
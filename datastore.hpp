@@ -1,50 +1,509 @@
 #pragma once
 #include "models.hpp"
+#include "alsoborrowedindex.hpp"
+#include "bytecodec.hpp"
+#include "circulationhistory.hpp"
+#include "circulationsnapshot.hpp"
+#include "dueschedule.hpp"
+#include "facetindex.hpp"
+#include "holdqueue.hpp"
+#include "searchindex.hpp"
+#include "stringarena.hpp"
+#include "storemetrics.hpp"
+#include "stripedlock.hpp"
+#include "workloadtrace.hpp"
 #include <vector>
 #include <optional>
+#include <unordered_map>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <array>
+#include <atomic>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <QHash>
+
+class TransactionLog;
+class CatalogueFile;
+
+// What one store operation changed. Each public call publishes at most one
+// ChangeSet (nested calls are folded into the outer one), tagged with the
+// store version it produced. Listeners run on the thread that made the
+// change, so sets from different threads may arrive out of version order.
+struct ChangeSet {
+    quint64 version = 0;
+    std::vector<int> statusChanged;  // item ids whose loan status changed
+    std::vector<int> holdsChanged;   // item ids whose hold queue changed
+    std::vector<int> usersChanged;   // patron ids whose loans/holds changed
+    std::vector<int> itemsAdded;     // item ids appended to the catalogue
+    std::vector<int> dueSoon;        // item ids now Rules::DueSoonDays from due (advanceClock)
+    std::vector<int> overdue;        // item ids whose loan just became overdue (advanceClock)
+    std::vector<int> readyForPickup; // item ids handed to the next patron in their hold queue
+    std::vector<int> pickupExpired;  // item ids whose pickup window ran out (advanceClock)
+
+    // Every id list above, for code that treats them alike
+    std::array<std::vector<int> *, 8> lists()
+    {
+        return {&statusChanged, &holdsChanged, &usersChanged, &itemsAdded,
+                &dueSoon, &overdue, &readyForPickup, &pickupExpired};
+    }
+    std::array<const std::vector<int> *, 8> lists() const
+    {
+        return {&statusChanged, &holdsChanged, &usersChanged, &itemsAdded,
+                &dueSoon, &overdue, &readyForPickup, &pickupExpired};
+    }
+    bool empty() const
+    {
+        return statusChanged.empty() && holdsChanged.empty() && usersChanged.empty() && itemsAdded.empty() &&
+               dueSoon.empty() && overdue.empty() && readyForPickup.empty() && pickupExpired.empty();
+    }
+};
+
+using ChangeListener = std::function<void(const ChangeSet &)>;
 
 // ---------------------------------------------
 // DataStore: in-memory "database" for D1–D4
 // ---------------------------------------------
 // Seeds default items/users on startup and offers
 // basic operations for the Patron workflow.
+//
+// Every public call is safe from any thread. Circulation calls lock only
+// the patron and item they touch (striped mutexes), so unrelated borrows
+// and returns run in parallel; calls that add users or items, or
+// open/compact storage, briefly exclude everything else. Patrons are
+// named by id: their records never leave the store, circulation calls
+// edit only the loan/hold list they change, and withUser() reads a
+// record in place.
 class DataStore
 {
 public:
     static DataStore &instance();
 
-    const std::vector<User> &users() const { return m_users; }
-    const std::vector<Item> &items() const { return m_items; }
+    // Standalone store (benchmarks/tools); the app itself uses instance()
+    explicit DataStore(bool seedDemoData);
+    ~DataStore();
+    DataStore(const DataStore &) = delete;
+    DataStore &operator=(const DataStore &) = delete;
+
+    //Catalogue access by slot (0 .. itemCount()-1, stable order)
+    int itemCount() const;
+    //A hash of every item's id and metadata, whatever their slot order:
+    //stores that agree on it hold the same catalogue
+    quint64 catalogueFingerprint() const;
+    int itemIdAt(int slot) const;
+    Item itemAt(int slot) const;
+    ItemStatus statusAt(int slot) const;
+
+    //What reports group items by (see circulationreport.hpp), for slots
+    //[from, to) under one lock. Metadata never changes, so callers can
+    //keep what they read.
+    struct ReportKeys {
+        ItemFormat format;
+        QString genre;     // movies and games only
+        QString creator;
+    };
+    std::vector<ReportKeys> reportKeys(int from, int to) const;
+
+    //Items on the shelf, from snapshot()
+    int availableCount() const;
+
+    //Circulation state of every item as of now (see circulationsnapshot.hpp),
+    //to read without locks for as long as needed: reports and exports
+    //never hold up borrows and returns. Taking one locks the items for as
+    //long as it takes to read those changed since the previous snapshot;
+    //callers share it until the next change.
+    std::shared_ptr<const CirculationSnapshot> snapshot() const;
+
+    //Call counts and latency histograms of every public operation since
+    //the store was created, plus current sizes (see storemetrics.hpp).
+    //The gauges come from snapshot().
+    StoreMetrics::Snapshot metrics() const;
+
+    //Due dates (see dueschedule.hpp): item ids on loan, in due order,
+    //found without scanning the catalogue
+    std::vector<int> overdueItems(const QDate &asOf) const;   // due before asOf
+    std::vector<int> dueItems(const QDate &from, const QDate &to) const;   // due in [from, to)
+
+    //The store's idea of today. advanceClock() moves it forward and
+    //publishes the loans that turned overdue or due-soon on the way
+    //(ChangeSet::overdue / dueSoon) and expires pickup windows that have
+    //closed; the app calls it from a timer.
+    QDate clockDate() const;
+    void advanceClock(const QDate &today);
+
+    //Serve catalogue metadata from a mapped file (see cataloguefile.hpp).
+    //Must be called before openStorage(); replaces the built-in demo items.
+    std::optional<QString> openCatalogue(const QString &path);
+
+    //Patron id for an exact name (0 if there is no such user)
+    int findUserId(const QString &name) const;
 
-    //Look up a user by exact name
-    std::optional<User> findUser(QString name) const;
+    //Run read(const User &) on the stored record under its lock, without
+    //copying it; false if there is no such user. read must not call back
+    //into the store.
+    template <typename Read>
+    bool withUser(int id, Read &&read) const;
 
-    //Replace the stored user record
-    void upsertUser(const User &user);
+    //Add a user (moved in, assigned the next id) or replace the record
+    //with the same name; returns the id
+    int upsertUser(User user);
+
+    // Batch calls: one result per item, in order (nullopt = done)
+    using BatchResult = std::vector<std::optional<QString>>;
+
+    //Add a new catalogue item; fails if the id is already taken
+    std::optional<QString> addItem(Item item);
+
+    //Bulk load (importers): add items under one lock and publish them as
+    //one change. Items with id 0 get the next ids after the highest in
+    //use. One result per item, in order (nullopt = added); ids, if given,
+    //receives each item's id (0 where it was refused). Indexes are not
+    //touched: call buildIndexes() after the last batch.
+    BatchResult addItems(std::vector<Item> items, std::vector<int> *ids = nullptr);
 
     //Borrow an item for a patron
-    std::optional<QString> borrowItem(User &patron, int itemId);
+    std::optional<QString> borrowItem(int patronId, int itemId);
+
+    //Return an item. If patrons are waiting it goes straight to the head of
+    //the hold queue as ready for pickup, reserved for Rules::PickupDays;
+    //a pickup window that runs out (see advanceClock) passes the item to
+    //the next patron in line, and only an empty queue puts it back on the
+    //shelf. The patron collects it with borrowItem or gives it up with
+    //cancelHold; until then it stays on their hold list.
+    std::optional<QString> returnItem(int patronId, int itemId);
 
-    //Return an item
-    std::optional<QString> returnItem(User &patron, int itemId);
+    //Batch circulation for kiosks and return bins. The whole batch runs
+    //under one set of locks, item by item, so other sessions see all of it
+    //or none of it and later items see earlier ones (loan cap, repeated ids).
+    BatchResult borrowItems(int patronId, const std::vector<int> &itemIds);
+    BatchResult returnItems(int patronId, const std::vector<int> &itemIds);
 
-    // Utility: locate an item by id (mutable), or const
-    Item *findItemById(int id);
-    const Item *findItemById(int id) const;
+    //Check in a return bin: each item goes back from whoever has it
+    BatchResult returnBin(const std::vector<int> &itemIds);
+
+    // Utility: locate an item by id (a copy; strings are shared, not duplicated)
+    std::optional<Item> findItemById(int id) const;
+
+    // Slot of an item (-1 if unknown)
+    int itemSlot(int id) const;
 
     //Reset session state when leaving a user UI
     void clearCurrentUserState();
 
+    //Change notifications: listeners run after every mutating call.
+    //subscribe() returns a token for unsubscribe().
+    int subscribe(ChangeListener listener);
+    void unsubscribe(int token);
+    quint64 version() const { return m_version.load(); }
+
+    //Durable storage: load snapshot + journal from dir, then journal every
+    //change there (see datastorepersistence.cpp for the file layout)
+    std::optional<QString> openStorage(const QString &dir);
+
+    //Write a fresh snapshot and drop the journal it covers (after any
+    //compaction already under way)
+    std::optional<QString> compactStorage();
+
+    //Block until everything journalled so far is on disk
+    void syncStorage();
+
+    //Record every circulation call and lookup into trace (nullptr stops).
+    //The caller owns it and keeps it alive until calls in flight finish.
+    void setTrace(WorkloadTrace *trace) { m_trace.store(trace); }
+
+    //Ranked title/creator search, best first (see searchindex.hpp). The
+    //index is built on the first search and catches up with new items on
+    //later ones.
+    std::vector<SearchIndex::Hit> searchCatalogue(const QString &query, int limit) const;
+
+    //Bring the search and facet indexes up to date now instead of on the
+    //next query, in one pass over the items added since they were built
+    void buildIndexes() const;
+
+    //Facet filtering (see facetindex.hpp): the first `limit` matching slots
+    //in catalogue order plus the total, a short slot list (search hits)
+    //narrowed to the matches, and sidebar counts. Format, genre and rating
+    //are indexed like search, on first use; availability is kept current
+    //by every status change.
+    FacetIndex::Matches filterCatalogue(const FacetFilter &filter, int limit) const;
+    std::vector<int> filterSlots(const FacetFilter &filter, std::vector<int> candidates) const;
+    FacetCounts facetCounts(const FacetFilter &filter) const;
+
     //hold functions
-    std::optional<QString> placeHold(User &patron, int itemId);
-    std::optional<QString> cancelHold(User &patron, int itemId);
-    int holdPosition(const User &patron, int itemId) const;
+    std::optional<QString> placeHold(int patronId, int itemId);
+    std::optional<QString> cancelHold(int patronId, int itemId);
+    int holdPosition(int patronId, int itemId) const;
+    int holdQueueLength(int itemId) const;
+
+    //Circulation history (see circulationhistory.hpp): every borrow,
+    //return and hold event since the store began keeping one, kept with
+    //the storage. Per item and per patron newest first, limit -1 = all;
+    //loans pair each borrow with its return. Times are ms since the epoch.
+    std::vector<CirculationHistory::Event> itemHistory(int itemId, int limit = -1,
+                                                       CirculationHistory::Kinds kinds = CirculationHistory::AllKinds) const;
+    std::vector<CirculationHistory::Event> patronHistory(int patronId, int limit = -1,
+                                                         CirculationHistory::Kinds kinds = CirculationHistory::AllKinds) const;
+    std::vector<CirculationHistory::Loan> itemLoans(int itemId, int limit = -1) const;
+    std::vector<CirculationHistory::Loan> patronLoans(int patronId, int limit = -1) const;
+    //Events in [fromMs, toMs) in the order they happened, and their count per kind
+    std::vector<CirculationHistory::Event> historyBetween(qint64 fromMs, qint64 toMs,
+                                                          CirculationHistory::Kinds kinds = CirculationHistory::AllKinds) const;
+    std::array<quint64, CirculationHistory::KindCount> historyCounts(qint64 fromMs, qint64 toMs) const;
+
+    //"Patrons who borrowed this also borrowed": up to limit item ids, most
+    //often borrowed by the same patrons first (see alsoborrowedindex.hpp)
+    std::vector<int> alsoBorrowed(int itemId, int limit) const;
 
 private:
-    DataStore();
     void seedUsers();
     void seedItems();
 
+    // Collects changes for the duration of one public call and publishes
+    // them when the outermost batch for this store on this thread ends.
+    // Declare it before taking any lock: publishing runs unlocked. Change
+    // sets are recycled per thread, so their buffers keep their capacity
+    // and steady circulation allocates nothing here.
+    class ChangeBatch
+    {
+    public:
+        explicit ChangeBatch(DataStore &ds);
+        ~ChangeBatch();
+        ChangeBatch(const ChangeBatch &) = delete;
+        ChangeBatch &operator=(const ChangeBatch &) = delete;
+    private:
+        friend class DataStore;
+        DataStore &m_ds;
+        ChangeBatch *m_outer;       // enclosing batch on this thread (any store)
+        ChangeBatch *m_root;        // outermost batch for m_ds on this thread
+        std::unique_ptr<ChangeSet> m_changes;   // root only
+    };
+    static thread_local ChangeBatch *t_batch;   // innermost batch on this thread
+    static thread_local std::vector<std::unique_ptr<ChangeSet>> t_spareChanges;
+    ChangeSet &pending();
+    void endBatch(ChangeSet &changes);
+    static void markChanged(std::vector<int> &ids, int id);
+
+    // Locking. m_structure is held shared by every call and exclusively
+    // by calls that grow or replace the tables below; patron and item
+    // records are guarded by their stripe. Single-item calls take their
+    // two stripes with std::scoped_lock; batches and scans use
+    // lockStripes()/lockAllItems(), which lock in stripe order (patrons,
+    // then items) so they cannot deadlock with each other.
+    //
+    // Each stripe also owns a pool for what it guards: patrons' loan and
+    // hold lists, item hold queues and their map nodes. The pools are
+    // used under the stripe lock only (storeUser, which hands out the
+    // lists, holds m_structure exclusively), keep freed blocks for reuse
+    // and go back to the heap whole when the store does.
+    static constexpr int LockStripes = 256;
+    struct alignas(64) PatronStripe {
+        std::mutex mutex;
+        std::pmr::unsynchronized_pool_resource pool;
+    };
+    struct alignas(64) ItemStripe {
+        std::mutex mutex;
+        std::pmr::unsynchronized_pool_resource pool;
+        std::pmr::unordered_map<int, HoldQueue> holds{&pool};   // slot -> queue, only if ever held (kept when empty)
+        DueSchedule due;                            // indexed by slot / LockStripes
+        std::vector<int> unpublished;               // slots changed since the last snapshot()
+        bool allUnpublished = false;                // too many to list: reread the whole stripe
+        std::atomic<quint64> changes{0};            // ever, so snapshot() can tell nothing moved
+    };
+    std::mutex &patronLock(int patronId) const { return m_patronStripes[std::size_t(patronId) % LockStripes].mutex; }
+    ItemStripe &itemStripe(int slot) const { return m_itemStripes[std::size_t(slot) % LockStripes]; }
+    static int stripeIndex(int slot) { return slot / LockStripes; }
+    std::vector<std::unique_lock<std::mutex>> lockAllItems() const;
+    std::vector<std::unique_lock<std::mutex>> lockStripes(const std::vector<int> &patronIds,
+                                                          const std::vector<int> &slots) const;
+
+    // Unlocked building blocks shared by the public calls and journal
+    // replay; callers hold the locks described above
+    int slotCount() const { return (int)m_borrower.size(); }
+    int slotOf(int id) const { return (id > 0 && id < (int)m_slotById.size()) ? m_slotById[id] : -1; }
+    int idAt(int slot) const;
+    Item readItem(int slot) const;
+    ItemStatus readStatus(int slot) const;
+    bool isAvailable(int slot) const { return m_borrower[slot] == 0; }
+    qint32 dueDayAt(int slot) const { return itemStripe(slot).due.dueDay(stripeIndex(slot)); }
+    void resetSchedules(qint32 today);
+    QDate today() const;
+    std::vector<int> collectDue(qint32 from, qint32 to) const;
+    User *userRecord(int id);
+    const HoldQueue *holdsAt(int slot) const;
+    int storeUser(User &&user);
+    std::optional<QString> tryBorrow(int slot, User &patron, const QDate &due);
+    std::optional<QString> tryReturn(int slot, User &patron);
+    void applyBorrow(int slot, User &patron, const QDate &due);
+    void applyReturn(int slot, User &patron);
+    void setLoan(int slot, int borrower, qint64 dueDay);
+    void markUnpublished(int slot);
+    bool applyHold(int slot, User &patron);
+    bool applyCancelHold(int slot, User &patron);
+
+    // Hold shelf: a returned item with a queue is reserved for its head
+    // (m_borrower = -patron id, due day = last pickup day). Handing off
+    // touches only the item, so it needs no patron lock.
+    bool isReservedFor(int slot, int patronId) const { return m_borrower[slot] == -patronId; }
+    void handOff(int slot);
+    void applyReady(int slot, int patronId, qint64 pickupDay);
+    void applyRelease(int slot, User &patron);
+    void expirePickup(int slot, int patronId);
+
+    QString titleAt(int slot) const;
+    QString creatorAt(int slot) const;
+    bool claimItemId(int id, int slot);
+    std::optional<QString> appendItem(const Item &item);
+    void growSlots(int from);
+
+    // Journal records (no-ops while storage is closed or replaying);
+    // circulation records also go into m_history, storage or not
+    enum class LogOp : quint8 { User = 1, Borrow, Return, PlaceHold, CancelHold, ReadyForPickup, PickupExpired };
+    void logUser(const User &user);
+    void logCirculation(LogOp op, int itemId, int patronId, qint64 extra = 0);
+    bool replayRecord(ByteReader &in);
+
+    // Compaction: beginCompaction copies what the snapshot needs and starts
+    // the next journal (m_structure held exclusively); finishCompaction
+    // writes the history blocks and the snapshot and needs no store lock,
+    // so compactIfDue runs it on m_compactor while calls carry on
+    struct SnapshotState;
+    void compactIfDue();
+    std::optional<QString> compactLocked();
+    std::optional<QString> beginCompaction(SnapshotState &state);
+    std::optional<QString> finishCompaction(const SnapshotState &state);
+    void waitForCompaction();
+    std::optional<QString> writeSnapshot(const QString &path, const SnapshotState &state) const;
+    std::optional<QString> loadSnapshot(const QString &dir, quint64 &generation);
+    std::optional<QString> storeHistoryBlocks(quint64 sealed);
+    std::optional<QString> startJournal(quint64 generation);
+
+    // Catalogue metadata kept in RAM (demo seed, addItem). Fields only some
+    // formats use live in per-format side tables, indexed by `details`
+    // (-1 when the item has none); the text itself is in m_text.
+    using TextRef = StringArena::Ref;
+    struct LocalItem {
+        int id;
+        ItemFormat format;
+        int details;
+        TextRef title, creator;
+    };
+    struct IssueDetails {
+        TextRef issue, pubDate;
+    };
+    struct MediaDetails {
+        TextRef genre, rating;
+    };
+
+    // Item metadata is read-only: slots [0, catalogue count) come from the
+    // mapped catalogue file, later slots from m_localItems. Only the
+    // circulation state below is mutable.
+    std::unique_ptr<CatalogueFile> m_catalogue;
+    int m_catalogueCount = 0;
+    std::vector<LocalItem> m_localItems;
+    std::vector<TextRef> m_deweys;                    // non-fiction
+    std::vector<IssueDetails> m_issues;               // magazines
+    std::vector<MediaDetails> m_media;                // movies, video games
+    StringArena m_text;                               // kept whole: readers may hold views of any of it
+
+    // Circulation state: borrowers in a dense array so scans read 4 bytes
+    // per item instead of whole records; due days are kept ordered in each
+    // item stripe's DueSchedule
+    std::vector<int> m_borrower;                      // patron id, -patron id on the hold shelf, 0 = on the shelf
+    AvailabilityBits m_available;                     // m_borrower == 0, as bits for the facet index
+    std::atomic<qint32> m_clockDay{0};                // Julian day of every stripe's DueSchedule::today()
+
+    // Published circulation (see snapshot()). Every change to a borrower,
+    // due day or hold queue lists its slot in the item's stripe and counts
+    // it there; a snapshot is reused while the counts and the clock stand.
+    static constexpr std::size_t MaxUnpublished = 4096;   // per stripe
+    mutable std::mutex m_snapshotLock;
+    mutable std::shared_ptr<const CirculationSnapshot> m_snapshot;
+    mutable quint64 m_snapshotChanges = 0;                // sum of stripe counts it covers
+    mutable std::vector<CirculationSnapshot::Entry> m_snapshotEntries;   // reused between publications
+    quint64 circulationChanges() const;
+
+    // Lookup indexes: item id -> slot (direct table, ids are library-assigned
+    // and dense; no per-item allocation), user name -> slot in m_users.
+    // Slots are stable because records are only ever appended.
+    static constexpr int MaxItemId = 1 << 26;
+    std::vector<int> m_slotById;
+    int m_highestItemId = 0;
+    std::unordered_map<QString, std::size_t, QStringHash> m_userIndex;
+    bool m_demoItems = false;
+
+    mutable StripedSharedMutex m_structure;
+    mutable std::array<PatronStripe, LockStripes> m_patronStripes;
+    mutable std::array<ItemStripe, LockStripes> m_itemStripes;
+
+    // After the stripes: users' lists go back to the stripe pools first
     std::vector<User> m_users;
-    std::vector<Item> m_items;
+
+    // Search index covers slots [0, m_searchIndexed); slots are append-only
+    mutable std::mutex m_searchLock;
+    mutable SearchIndex m_search;
+    mutable int m_searchIndexed = 0;
+    void indexSearch() const;
+
+    // Facet index covers slots [0, m_facets.size()), the same way
+    mutable std::mutex m_facetLock;
+    mutable FacetIndex m_facets;
+    void indexFacets() const;
+
+    // Catalogue fingerprint covers slots [0, m_fingerprinted), likewise
+    mutable std::mutex m_fingerprintLock;
+    mutable quint64 m_fingerprint = 0;
+    mutable int m_fingerprinted = 0;
+
+    // Listeners are replaced, never edited in place, so publishing only
+    // needs to grab the current list
+    using ListenerList = std::vector<std::pair<int, ChangeListener>>;
+    mutable std::mutex m_listenerLock;
+    std::shared_ptr<const ListenerList> m_listeners = std::make_shared<ListenerList>();
+    int m_nextListenerToken = 1;
+    std::atomic<quint64> m_version{0};
+
+    std::unique_ptr<TransactionLog> m_log;
+    QString m_storageDir;
+    quint64 m_generation = 0;
+    std::atomic<quint64> m_recordsSinceSnapshot{0};
+
+    // Circulation history; sealed blocks [0, m_historyBlocksStored) are in
+    // <dir>/history.bin, whose first m_historyFileBytes bytes hold them
+    CirculationHistory m_history;
+    quint64 m_historyBlocksStored = 0;
+    quint64 m_historyFileBytes = 0;
+
+    // Background compaction; m_compacting is set from its start until its
+    // thread is done writing. The thread is joined (under m_structure held
+    // exclusively, or by the destructor) before the next one starts.
+    std::thread m_compactor;
+    std::atomic<bool> m_compacting{false};
+
+    // Co-borrowed items, updated after every borrow once its locks are
+    // released; rebuilt from the recent history when storage is opened
+    AlsoBorrowedIndex m_alsoBorrowed;
+
+    StoreMetrics m_metrics;
+
+    // Workload capture (see setTrace); a single load when nothing is attached
+    std::atomic<WorkloadTrace *> m_trace{nullptr};
+    void trace(WorkloadTrace::Op op, int patronId, int itemId, const QString &text = QString()) const
+    {
+        if (WorkloadTrace *t = m_trace.load(std::memory_order_relaxed))
+            t->record(op, patronId, itemId, text);
+    }
 };
+
+template <typename Read>
+bool DataStore::withUser(int id, Read &&read) const
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::ReadUser);
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    if (id <= 0 || id > (int)m_users.size())
+        return false;
+    std::lock_guard<std::mutex> lock(patronLock(id));
+    read(static_cast<const User &>(m_users[id - 1]));
+    return true;
+}
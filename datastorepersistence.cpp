@@ -0,0 +1,541 @@
+// DataStore durable storage: snapshot + journal files.
+//
+// <dir>/snapshot.bin              users and non-default circulation state
+// <dir>/journal-<generation>.log  changes made after that snapshot
+// <dir>/history.bin               sealed circulation history blocks
+//
+// The snapshot header names the first journal generation it does not
+// cover. Compaction starts a new generation, writes the snapshot
+// atomically (QSaveFile) and only then deletes older journals, so a crash
+// at any point leaves a snapshot plus every journal needed to catch up.
+// Only the switch to the new journal and a copy of the users and of the
+// items not on the shelf are made with the store locked; compactIfDue()
+// writes the rest on a thread of its own while calls carry on.
+//
+// history.bin only grows: each compaction appends the history blocks
+// sealed since the last one ([u32 length][u32 crc32][block] each) and
+// syncs it before writing the snapshot, which records how many blocks and
+// bytes of it are good and carries the events after them. Bytes past that
+// are from a compaction that did not finish and are cut off by the next.
+#include "datastore.hpp"
+#include "transactionlog.hpp"
+#include "bytecodec.hpp"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+// What a snapshot holds, copied when compaction starts
+struct DataStore::SnapshotState {
+    // An item not on the shelf or with a hold queue
+    struct Item {
+        int id = 0;
+        int borrower = 0;
+        qint32 dueDay = 0;
+        std::vector<int> queue;
+    };
+
+    quint64 generation = 0;      // first journal generation not covered
+    std::vector<User> users;
+    std::vector<Item> items;
+    quint64 historyBlocks = 0;   // sealed then
+    quint64 historyEvents = 0;   // recorded then
+};
+
+namespace {
+const char SnapshotMagic[4] = {'H', 'S', 'N', 'P'};
+constexpr quint32 SnapshotFormat = 2;   // 1: no history section
+constexpr quint64 SnapshotEveryRecords = 100000;
+// The "also borrowed" index is rebuilt from this many of the latest
+// history events, so start-up time does not grow with the history
+constexpr quint64 AlsoBorrowedRebuildEvents = 1000000;
+
+QString snapshotPath(const QString &dir)
+{
+    return QDir(dir).filePath("snapshot.bin");
+}
+
+QString historyPath(const QString &dir)
+{
+    return QDir(dir).filePath("history.bin");
+}
+
+QString journalPath(const QString &dir, quint64 generation)
+{
+    // zero-padded so that name order is generation order
+    return QDir(dir).filePath(QString("journal-%1.log").arg(generation, 20, 10, QChar('0')));
+}
+
+// Journal generations present in dir, oldest first
+std::vector<quint64> journalGenerations(const QString &dir)
+{
+    std::vector<quint64> gens;
+    const QStringList names = QDir(dir).entryList(QStringList() << "journal-*.log", QDir::Files, QDir::Name);
+    for (const QString &name : names)
+    {
+        bool ok = false;
+        const quint64 gen = name.mid(8, 20).toULongLong(&ok);
+        if (ok)
+            gens.push_back(gen);
+    }
+    return gens;
+}
+
+// The first `blocks` history blocks of history.bin, which must span at
+// least `bytes` bytes
+std::optional<QString> readHistoryBlocks(const QString &path, quint64 blocks, quint64 bytes, CirculationHistory &history)
+{
+    if (blocks == 0)
+        return std::nullopt;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString("Cannot open history %1: %2").arg(path, file.errorString());
+    const QByteArray data = file.readAll();
+    if (quint64(data.size()) < bytes)
+        return QString("History %1 is truncated.").arg(path);
+
+    ByteReader in(data.constData(), std::size_t(bytes));
+    for (quint64 b = 0; b < blocks; ++b)
+    {
+        const quint32 length = in.u32();
+        const quint32 crc = in.u32();
+        const char *block = in.bytes(length);
+        if (!block || crc32(block, length) != crc)
+            return QString("History %1 is corrupt.").arg(path);
+        ByteReader blockIn(block, length);
+        if (!history.readBlock(blockIn) || !blockIn.atEnd())
+            return QString("History %1 is corrupt.").arg(path);
+    }
+    return std::nullopt;
+}
+
+qint64 wallClockMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+} // namespace
+
+std::optional<QString> DataStore::openStorage(const QString &dir)
+{
+    ChangeBatch batch(*this);
+    std::unique_lock<StripedSharedMutex> structure(m_structure);
+    if (m_log)
+        return QString("Storage is already open.");
+    waitForCompaction();
+    if (!QDir().mkpath(dir))
+        return QString("Cannot create storage directory %1.").arg(dir);
+
+    quint64 generation = 0;
+    if (QFile::exists(snapshotPath(dir)))
+    {
+        if (auto err = loadSnapshot(dir, generation))
+            return err;
+    }
+
+    // Catch up on every journal the snapshot does not cover, oldest first
+    quint64 last = generation;
+    for (quint64 gen : journalGenerations(dir))
+    {
+        if (gen < generation)
+            continue;
+        auto err = TransactionLog::replay(journalPath(dir, gen),
+                                          [this](ByteReader &in) { return replayRecord(in); });
+        if (err)
+            return err;
+        last = std::max(last, gen);
+    }
+
+    m_alsoBorrowed.clear();
+    for (const CirculationHistory::Event &e :
+         m_history.latest(AlsoBorrowedRebuildEvents, CirculationHistory::bit(CirculationHistory::Kind::Borrow)))
+        m_alsoBorrowed.recordBorrow(e.patronId, e.itemId);
+
+    m_storageDir = dir;
+    m_generation = last;
+    // Fold the replayed tail into a fresh snapshot so the next start is cheap
+    return compactLocked();
+}
+
+std::optional<QString> DataStore::compactStorage()
+{
+    std::unique_lock<StripedSharedMutex> structure(m_structure);
+    return compactLocked();
+}
+
+std::optional<QString> DataStore::compactLocked()
+{
+    if (m_storageDir.isEmpty())
+        return QString("Storage is not open.");
+    waitForCompaction();
+    SnapshotState state;
+    const auto journalErr = beginCompaction(state);
+    const auto err = finishCompaction(state);
+    return journalErr ? journalErr : err;
+}
+
+std::optional<QString> DataStore::beginCompaction(SnapshotState &state)
+{
+    // Everything journalled so far must be in memory (it is) and on disk
+    // in the old generation before that generation can be superseded
+    if (m_log)
+        m_log->close();
+
+    state.generation = m_generation + 1;
+    state.users = m_users;
+    // Only items that are out, on the hold shelf or have a queue; the rest
+    // are on the shelf
+    for (int slot = 0; slot < slotCount(); ++slot)
+    {
+        const HoldQueue *held = holdsAt(slot);
+        if (isAvailable(slot) && !held)
+            continue;
+        SnapshotState::Item item;
+        item.id = idAt(slot);
+        item.borrower = m_borrower[slot];
+        item.dueDay = item.borrower != 0 ? dueDayAt(slot) : 0;
+        if (held)
+            item.queue = held->patrons();
+        state.items.push_back(std::move(item));
+    }
+    // Calls record history under m_structure, so these agree
+    state.historyBlocks = m_history.sealedBlocks();
+    state.historyEvents = m_history.size();
+
+    // Even if the snapshot fails, older journals are still there and the
+    // new generation simply replays after them
+    m_generation = state.generation;
+    m_recordsSinceSnapshot = 0;
+    return startJournal(state.generation);
+}
+
+std::optional<QString> DataStore::finishCompaction(const SnapshotState &state)
+{
+    const StoreMetrics::Timer timer(m_metrics, StoreMetrics::Op::Compact);
+    // If the history blocks cannot be stored the snapshot keeps their
+    // events instead, so it is written either way
+    const auto historyErr = storeHistoryBlocks(state.historyBlocks);
+    auto err = writeSnapshot(snapshotPath(m_storageDir), state);
+    if (!err)
+    {
+        for (quint64 gen : journalGenerations(m_storageDir))
+            if (gen < state.generation)
+                QFile::remove(journalPath(m_storageDir, gen));
+    }
+    return err ? err : historyErr;
+}
+
+void DataStore::waitForCompaction()
+{
+    if (m_compactor.joinable())
+        m_compactor.join();
+}
+
+std::optional<QString> DataStore::storeHistoryBlocks(quint64 sealed)
+{
+    if (m_historyBlocksStored == sealed)
+        return std::nullopt;
+
+    QFile file(historyPath(m_storageDir));
+    if (!file.open(QIODevice::ReadWrite) || !file.resize(qint64(m_historyFileBytes))
+        || !file.seek(qint64(m_historyFileBytes)))
+        return QString("Cannot write history %1: %2").arg(file.fileName(), file.errorString());
+    quint64 written = 0;
+    ByteWriter block;
+    for (quint64 b = m_historyBlocksStored; b < sealed; ++b)
+    {
+        block.clear();
+        block.putU32(0);
+        block.putU32(0);
+        m_history.writeBlock(b, block);
+        block.patchU32(0, quint32(block.size() - 8));
+        block.patchU32(4, crc32(block.data() + 8, block.size() - 8));
+        if (file.write(block.data(), qint64(block.size())) != qint64(block.size()))
+            return QString("Cannot write history %1: %2").arg(file.fileName(), file.errorString());
+        written += block.size();
+    }
+    if (!TransactionLog::syncToDisk(file))
+        return QString("Cannot write history %1: %2").arg(file.fileName(), file.errorString());
+
+    m_historyBlocksStored = sealed;
+    m_historyFileBytes += written;
+    return std::nullopt;
+}
+
+void DataStore::syncStorage()
+{
+    std::shared_lock<StripedSharedMutex> structure(m_structure);
+    if (m_log)
+        m_log->sync();
+}
+
+std::optional<QString> DataStore::startJournal(quint64 generation)
+{
+    if (!m_log)
+        m_log = std::make_unique<TransactionLog>();
+    auto err = m_log->open(journalPath(m_storageDir, generation), generation);
+    if (err)
+        m_log.reset();
+    return err;
+}
+
+void DataStore::compactIfDue()
+{
+    if (m_recordsSinceSnapshot.load(std::memory_order_relaxed) < SnapshotEveryRecords
+        || m_compacting.load(std::memory_order_relaxed))
+        return;
+    std::unique_lock<StripedSharedMutex> structure(m_structure);
+    // Another thread may have started one while we waited; one still
+    // writing is left to finish, and records pile up until it has
+    if (!m_log || m_recordsSinceSnapshot < SnapshotEveryRecords || m_compacting)
+        return;
+    waitForCompaction();   // already done; only its thread is left
+    auto state = std::make_unique<SnapshotState>();
+    beginCompaction(*state);
+    m_compacting = true;
+    m_compactor = std::thread([this, state = std::move(state)] {
+        finishCompaction(*state);
+        m_compacting = false;
+    });
+}
+
+// Encode buffer reused across records; one per thread since records are
+// built under per-item locks only
+static ByteWriter &recordBuffer()
+{
+    thread_local ByteWriter record;
+    record.clear();
+    return record;
+}
+
+void DataStore::logUser(const User &user)
+{
+    if (!m_log)
+        return;
+    ByteWriter &record = recordBuffer();
+    record.putU8(quint8(LogOp::User));
+    record.putVarint(quint64(user.id));
+    record.putU8(quint8(user.type));
+    record.putString(user.name);
+    record.putVarint(user.activeLoans.size());
+    for (int id : user.activeLoans)
+        record.putVarint(quint64(id));
+    record.putVarint(user.holds.size());
+    for (int id : user.holds)
+        record.putVarint(quint64(id));
+    m_log->append(record);
+    ++m_recordsSinceSnapshot;
+}
+
+void DataStore::logCirculation(LogOp op, int itemId, int patronId, qint64 extra)
+{
+    // Circulation ops and history kinds are in the same order
+    static_assert(int(LogOp::PickupExpired) - int(LogOp::Borrow) + 1 == CirculationHistory::KindCount,
+                  "every circulation record has a history kind");
+    const qint64 atMs = wallClockMs();
+    m_history.record(CirculationHistory::Kind(quint8(op) - quint8(LogOp::Borrow)), itemId, patronId, atMs);
+    if (!m_log)
+        return;
+    ByteWriter &record = recordBuffer();
+    record.putU8(quint8(op));
+    record.putVarint(quint64(itemId));
+    record.putVarint(quint64(patronId));
+    record.putSVarint(extra);
+    record.putSVarint(atMs);
+    m_log->append(record);
+    ++m_recordsSinceSnapshot;
+}
+
+bool DataStore::replayRecord(ByteReader &in)
+{
+    const auto op = LogOp(in.u8());
+    if (op == LogOp::User)
+    {
+        User u;
+        u.id = int(in.varint());
+        u.type = UserType(in.u8());
+        u.name = in.string();
+        u.activeLoans.resize(std::size_t(in.varint()));
+        for (int &id : u.activeLoans)
+            id = int(in.varint());
+        u.holds.resize(std::size_t(in.varint()));
+        for (int &id : u.holds)
+            id = int(in.varint());
+        if (!in.ok())
+            return false;
+        storeUser(std::move(u));
+        return true;
+    }
+
+    const int itemId = int(in.varint());
+    const int patronId = int(in.varint());
+    const qint64 extra = in.svarint();
+    // When it happened; records written before the history have no time
+    // and stay out of it
+    const bool timed = in.remaining() > 0;
+    const qint64 atMs = timed ? in.svarint() : 0;
+    if (!in.ok())
+        return false;
+
+    // Records for items no longer in the catalogue are skipped, not fatal
+    const int slot = slotOf(itemId);
+    User *patron = userRecord(patronId);
+    if (slot < 0 || !patron)
+        return true;
+
+    switch (op)
+    {
+        case LogOp::Borrow:         applyBorrow(slot, *patron, QDate::fromJulianDay(extra)); break;
+        case LogOp::Return:         applyReturn(slot, *patron); break;
+        case LogOp::PlaceHold:      applyHold(slot, *patron); break;
+        case LogOp::CancelHold:     applyCancelHold(slot, *patron); break;
+        case LogOp::ReadyForPickup: applyReady(slot, patronId, extra); break;
+        case LogOp::PickupExpired:  applyRelease(slot, *patron); break;
+        default:                    return false;
+    }
+    if (timed)
+        m_history.record(CirculationHistory::Kind(quint8(op) - quint8(LogOp::Borrow)), itemId, patronId, atMs);
+    return true;
+}
+
+std::optional<QString> DataStore::writeSnapshot(const QString &path, const SnapshotState &state) const
+{
+    ByteWriter body;
+    body.putVarint(state.users.size());
+    for (const User &u : state.users)
+    {
+        body.putVarint(quint64(u.id));
+        body.putU8(quint8(u.type));
+        body.putString(u.name);
+        body.putVarint(u.activeLoans.size());
+        for (int id : u.activeLoans)
+            body.putVarint(quint64(id));
+        body.putVarint(u.holds.size());
+        for (int id : u.holds)
+            body.putVarint(quint64(id));
+    }
+
+    // State: 0 shelf, 1 on loan, 2 on the hold shelf (borrower = the
+    // patron it waits for, day = last pickup day)
+    body.putVarint(state.items.size());
+    for (const SnapshotState::Item &item : state.items)
+    {
+        body.putVarint(quint64(item.id));
+        body.putU8(item.borrower == 0 ? 0 : item.borrower > 0 ? 1 : 2);
+        if (item.borrower != 0)
+        {
+            body.putVarint(quint64(std::abs(item.borrower)));
+            body.putSVarint(item.dueDay);
+        }
+        body.putVarint(item.queue.size());
+        for (int patronId : item.queue)
+            body.putVarint(quint64(patronId));
+    }
+
+    // History: how much of history.bin this snapshot vouches for, then
+    // every event after those blocks up to when it was taken
+    body.putVarint(m_historyBlocksStored);
+    body.putVarint(m_historyFileBytes);
+    m_history.writeEvents(m_historyBlocksStored * CirculationHistory::BlockEvents, state.historyEvents, body);
+
+    ByteWriter header;
+    header.putBytes(SnapshotMagic, sizeof SnapshotMagic);
+    header.putU32(SnapshotFormat);
+    header.putU64(state.generation);
+    header.putU32(crc32(body.data(), body.size()));
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return QString("Cannot write snapshot %1: %2").arg(path, file.errorString());
+    file.write(header.data(), qint64(header.size()));
+    file.write(body.data(), qint64(body.size()));
+    if (!file.commit())
+        return QString("Cannot write snapshot %1: %2").arg(path, file.errorString());
+    return std::nullopt;
+}
+
+std::optional<QString> DataStore::loadSnapshot(const QString &dir, quint64 &generation)
+{
+    const QString path = snapshotPath(dir);
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString("Cannot open snapshot %1: %2").arg(path, file.errorString());
+    const QByteArray bytes = file.readAll();
+
+    ByteReader in(bytes.constData(), std::size_t(bytes.size()));
+    const char *magic = in.bytes(sizeof SnapshotMagic);
+    const quint32 format = magic ? in.u32() : 0;
+    if (!magic || !std::equal(magic, magic + sizeof SnapshotMagic, SnapshotMagic) || format < 1 || format > SnapshotFormat)
+        return QString("%1 is not a HinLIBS snapshot.").arg(path);
+    generation = in.u64();
+    const quint32 crc = in.u32();
+    if (!in.ok() || crc32(bytes.constData() + (bytes.size() - in.remaining()), in.remaining()) != crc)
+        return QString("Snapshot %1 is corrupt.").arg(path);
+
+    const std::size_t userCount = std::size_t(in.varint());
+    for (std::size_t i = 0; i < userCount && in.ok(); ++i)
+    {
+        User u;
+        u.id = int(in.varint());
+        u.type = UserType(in.u8());
+        u.name = in.string();
+        u.activeLoans.resize(std::size_t(in.varint()));
+        for (int &id : u.activeLoans)
+            id = int(in.varint());
+        u.holds.resize(std::size_t(in.varint()));
+        for (int &id : u.holds)
+            id = int(in.varint());
+        // ids are slot numbers, so users must come back in the same order
+        const int id = u.id;
+        if (in.ok() && storeUser(std::move(u)) != id)
+            return QString("Snapshot %1 does not match the user table.").arg(path);
+    }
+
+    const std::size_t itemCount = std::size_t(in.varint());
+    for (std::size_t i = 0; i < itemCount && in.ok(); ++i)
+    {
+        const int itemId = int(in.varint());
+        const int state = in.u8();
+        int borrower = 0;
+        qint64 due = 0;
+        if (state != 0)
+        {
+            borrower = int(in.varint());
+            due = in.svarint();
+        }
+        const std::size_t queued = std::size_t(in.varint());
+        const int slot = slotOf(itemId);
+        if (slot >= 0 && state != 0)
+            setLoan(slot, state == 2 ? -borrower : borrower, due);
+        for (std::size_t q = 0; q < queued; ++q)
+        {
+            const int patronId = int(in.varint());
+            if (slot >= 0 && itemStripe(slot).holds[slot].enqueue(patronId))
+                markUnpublished(slot);
+        }
+        if (slot >= 0 && queued)
+            markChanged(pending().holdsChanged, itemId);
+    }
+
+    m_history.clear();
+    m_historyBlocksStored = m_historyFileBytes = 0;
+    if (format >= 2 && in.ok())
+    {
+        const quint64 blocks = in.varint();
+        const quint64 fileBytes = in.varint();
+        if (in.ok())
+        {
+            if (auto err = readHistoryBlocks(historyPath(dir), blocks, fileBytes, m_history))
+                return err;
+            m_historyBlocksStored = blocks;
+            m_historyFileBytes = fileBytes;
+            if (!m_history.readEvents(in))
+                in.fail();
+        }
+    }
+    if (!in.ok())
+        return QString("Snapshot %1 is truncated.").arg(path);
+    return std::nullopt;
+}
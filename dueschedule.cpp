@@ -0,0 +1,139 @@
+#include "dueschedule.hpp"
+#include <algorithm>
+#include <limits>
+
+DueSchedule::DueSchedule(qint32 today)
+    : m_today(today)
+    , m_overflowMin(std::numeric_limits<qint32>::max())
+{
+    m_heads.fill(-1);
+}
+
+void DueSchedule::resize(int count)
+{
+    if (count <= (int)m_day.size())
+        return;
+    m_day.resize(count, 0);
+    m_next.resize(count, -1);
+    m_prev.resize(count, -1);
+}
+
+int DueSchedule::listOf(qint32 day) const
+{
+    if (day < m_today)
+        return Overdue;
+    if (day - m_today < WheelDays)
+        return int(day % WheelDays);
+    return Overflow;
+}
+
+void DueSchedule::link(int slot, int list)
+{
+    const int head = m_heads[list];
+    m_prev[slot] = -1;
+    m_next[slot] = head;
+    if (head >= 0)
+        m_prev[head] = slot;
+    m_heads[list] = slot;
+}
+
+void DueSchedule::unlink(int slot, int list)
+{
+    const int prev = m_prev[slot];
+    const int next = m_next[slot];
+    if (prev >= 0)
+        m_next[prev] = next;
+    else
+        m_heads[list] = next;
+    if (next >= 0)
+        m_prev[next] = prev;
+    m_next[slot] = m_prev[slot] = -1;
+}
+
+void DueSchedule::set(int slot, qint32 day)
+{
+    if (m_day[slot] != 0)
+        unlink(slot, listOf(m_day[slot]));
+    m_day[slot] = day;
+    if (day == 0)
+        return;
+    const int list = listOf(day);
+    link(slot, list);
+    if (list == Overflow)
+        m_overflowMin = std::min(m_overflowMin, day);
+}
+
+void DueSchedule::advance(qint32 day, int soonDays, std::vector<int> &dueSoon, std::vector<int> &overdue)
+{
+    while (m_today < day)
+    {
+        // Loans due today are overdue from tomorrow: splice the bucket onto
+        // the front of the overdue list
+        const int bucket = int(m_today % WheelDays);
+        int tail = -1;
+        for (int s = m_heads[bucket]; s >= 0; s = m_next[s])
+        {
+            overdue.push_back(s);
+            tail = s;
+        }
+        if (tail >= 0)
+        {
+            m_next[tail] = m_heads[Overdue];
+            if (m_heads[Overdue] >= 0)
+                m_prev[m_heads[Overdue]] = tail;
+            m_heads[Overdue] = m_heads[bucket];
+            m_heads[bucket] = -1;
+        }
+        ++m_today;
+
+        if (soonDays > 0)
+            for (int s = m_heads[(m_today + soonDays) % WheelDays]; s >= 0; s = m_next[s])
+                dueSoon.push_back(s);
+
+        // The freed bucket now stands for the day just entering the wheel
+        if (m_overflowMin - m_today < WheelDays)
+            refillFromOverflow();
+    }
+}
+
+void DueSchedule::refillFromOverflow()
+{
+    m_overflowMin = std::numeric_limits<qint32>::max();
+    for (int s = m_heads[Overflow]; s >= 0;)
+    {
+        const int next = m_next[s];
+        const int list = listOf(m_day[s]);
+        if (list != Overflow)
+        {
+            unlink(s, Overflow);
+            link(s, list);
+        }
+        else
+        {
+            m_overflowMin = std::min(m_overflowMin, m_day[s]);
+        }
+        s = next;
+    }
+}
+
+void DueSchedule::collect(qint32 from, qint32 to, std::vector<int> &out) const
+{
+    if (from >= to)
+        return;
+    if (from < m_today)
+        for (int s = m_heads[Overdue]; s >= 0; s = m_next[s])
+            if (m_day[s] >= from && m_day[s] < to)
+                out.push_back(s);
+
+    // Every loan in a day bucket is due on exactly that day
+    const qint32 first = std::max(from, m_today);
+    const qint32 last = std::min<qint64>(to, qint64(m_today) + WheelDays);
+    for (qint32 d = first; d < last; ++d)
+        for (int s = m_heads[d % WheelDays]; s >= 0; s = m_next[s])
+            out.push_back(s);
+
+    if (qint64(to) > qint64(m_today) + WheelDays)
+        for (int s = m_heads[Overflow]; s >= 0; s = m_next[s])
+            if (m_day[s] >= from && m_day[s] < to)
+                out.push_back(s);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <QtGlobal>
+#include <array>
+#include <vector>
+
+// ---------------------------------------------
+// DueSchedule: loans ordered by due day
+// ---------------------------------------------
+// A timing wheel with one bucket per day for the next WheelDays days, an
+// overflow list for loans due later and an overdue list for loans already
+// past due. Each loan sits on exactly one intrusive doubly linked list
+// (next/prev per slot), so scheduling, moving and cancelling a due date
+// are O(1) and never allocate. Moving the clock forward a day hands that
+// day's bucket to the overdue list, so "what is overdue" and "what comes
+// due in the next few days" cost time in the number of loans reported,
+// not the number of items.
+//
+// Slots are the caller's dense indexes; days are Julian day numbers and
+// 0 means "not on loan".
+class DueSchedule
+{
+public:
+    static constexpr int WheelDays = 64;
+
+    explicit DueSchedule(qint32 today = 0);
+
+    qint32 today() const { return m_today; }
+
+    //Track slots [0, count); slots are only ever added
+    void resize(int count);
+
+    //Due day of a slot (0 = none)
+    qint32 dueDay(int slot) const { return m_day[slot]; }
+
+    //Schedule, move or (day 0) cancel a slot's due date
+    void set(int slot, qint32 day);
+
+    //Move the clock forward to `day` (earlier days are ignored). Appends
+    //the slots whose loans became overdue, and those that are now exactly
+    //`soonDays` (< WheelDays) before their due day, one day at a time.
+    void advance(qint32 day, int soonDays, std::vector<int> &dueSoon, std::vector<int> &overdue);
+
+    //Append the slots due in [from, to)
+    void collect(qint32 from, qint32 to, std::vector<int> &out) const;
+
+private:
+    static constexpr int Overdue = WheelDays;
+    static constexpr int Overflow = WheelDays + 1;
+
+    int listOf(qint32 day) const;
+    void link(int slot, int list);
+    void unlink(int slot, int list);
+    void refillFromOverflow();
+
+    std::vector<qint32> m_day;
+    std::vector<int> m_next;                      // -1 ends a list
+    std::vector<int> m_prev;                      // -1 = list head
+    std::array<int, WheelDays + 2> m_heads;       // day buckets, overdue, overflow
+    qint32 m_today;
+    qint32 m_overflowMin;                         // no overflow loan is due earlier
+};
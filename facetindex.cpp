@@ -0,0 +1,383 @@
+#include "facetindex.hpp"
+#include <QtAlgorithms>
+#include <algorithm>
+
+namespace {
+constexpr int ChunkBits = 16;
+constexpr int ChunkSlots = 1 << ChunkBits;
+constexpr int ChunkWords = ChunkSlots / 64;
+// Counting an offset array probes the mask once per slot while a bitset
+// is one vectorized pass, so arrays turn into bitsets at a quarter of the
+// bitset's size rather than at break-even
+constexpr std::size_t MaxOffsets = ChunkWords;
+
+// The word kernels. Fixed trip counts, no branches, no early exit inside
+// the loops and no aliasing, so they compile to SIMD without any -m flags.
+
+//dst &= src; whether any bit is left
+bool andInto(quint64 *__restrict dst, const quint64 *__restrict src)
+{
+    quint64 any = 0;
+    for (int i = 0; i < ChunkWords; ++i)
+    {
+        dst[i] &= src[i];
+        any |= dst[i];
+    }
+    return any != 0;
+}
+
+//dst |= src
+void orInto(quint64 *__restrict dst, const quint64 *__restrict src)
+{
+    for (int i = 0; i < ChunkWords; ++i)
+        dst[i] |= src[i];
+}
+
+// Bits set in each byte of x. Counting by bytes and adding up the bytes
+// once per block keeps popcounts vectorizable; without a popcount
+// instruction in the baseline ISA, qPopulationCount is a library call.
+inline quint64 byteCounts(quint64 x)
+{
+    x -= (x >> 1) & 0x5555555555555555ull;
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    return (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+}
+
+// Sum of the byte lanes of acc (each at most 255)
+inline int sumBytes(quint64 acc)
+{
+    acc = (acc & 0x00ff00ff00ff00ffull) + ((acc >> 8) & 0x00ff00ff00ff00ffull);
+    return int((acc * 0x0001000100010001ull) >> 48);
+}
+
+constexpr int CountBlock = 16;   // 16 words * 8 bits fit a byte lane
+
+//popcount(a & b) over a chunk
+int countAnd(const quint64 *__restrict a, const quint64 *__restrict b)
+{
+    int n = 0;
+    for (int i = 0; i < ChunkWords; i += CountBlock)
+    {
+        quint64 acc = 0;
+        for (int j = i; j < i + CountBlock; ++j)
+            acc += byteCounts(a[j] & b[j]);
+        n += sumBytes(acc);
+    }
+    return n;
+}
+
+//popcount(a) over a chunk
+int popcount(const quint64 *a)
+{
+    int n = 0;
+    for (int i = 0; i < ChunkWords; i += CountBlock)
+    {
+        quint64 acc = 0;
+        for (int j = i; j < i + CountBlock; ++j)
+            acc += byteCounts(a[j]);
+        n += sumBytes(acc);
+    }
+    return n;
+}
+}
+
+// ---------------------------------------------
+// AvailabilityBits
+// ---------------------------------------------
+
+void AvailabilityBits::grow(int count)
+{
+    if (count <= m_count)
+        return;
+    const int used = (m_count + WordBits - 1) / WordBits;
+    const int words = (count + WordBits - 1) / WordBits;
+    if (words > m_capacity)
+    {
+        const int capacity = std::max(words, m_capacity * 2);
+        auto bigger = std::make_unique<std::atomic<quint64>[]>(std::size_t(capacity));
+        for (int i = 0; i < used; ++i)
+            bigger[i].store(m_words[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_words = std::move(bigger);
+        m_capacity = capacity;
+    }
+    // Set [m_count, count); bits past the old count may be stale after clear()
+    for (int w = m_count / WordBits; w < words; ++w)
+    {
+        const int from = std::max(m_count, w * WordBits) - w * WordBits;
+        const int to = std::min(count, (w + 1) * WordBits) - w * WordBits;
+        const quint64 below = (quint64(1) << from) - 1;
+        const quint64 upTo = to == WordBits ? ~quint64(0) : (quint64(1) << to) - 1;
+        const quint64 keep = m_words[w].load(std::memory_order_relaxed) & below;
+        m_words[w].store(keep | (upTo & ~below), std::memory_order_relaxed);
+    }
+    m_count = count;
+}
+
+int AvailabilityBits::popcount() const
+{
+    // A chunk at a time through the vectorized kernel
+    std::vector<quint64> chunk(ChunkWords);
+    int n = 0;
+    for (int i = 0, words = (m_count + WordBits - 1) / WordBits; i < words; i += ChunkWords)
+    {
+        for (int j = 0; j < ChunkWords; ++j)
+            chunk[j] = word(i + j);
+        n += ::popcount(chunk.data());
+    }
+    return n;
+}
+
+// ---------------------------------------------
+// FacetIndex::Bitmap
+// ---------------------------------------------
+
+void FacetIndex::Bitmap::add(int slot)
+{
+    const std::size_t c = std::size_t(slot >> ChunkBits);
+    if (c >= m_chunks.size())
+        m_chunks.resize(c + 1);
+    Chunk &chunk = m_chunks[c];
+    const int offset = slot & (ChunkSlots - 1);
+    ++chunk.count;
+    if (!chunk.words.empty())
+    {
+        chunk.words[offset / 64] |= quint64(1) << (offset % 64);
+        return;
+    }
+    chunk.offsets.push_back(quint16(offset));
+    if (chunk.offsets.size() <= MaxOffsets)
+        return;
+    // Dense enough that the bitset is smaller
+    chunk.words.assign(ChunkWords, 0);
+    for (quint16 o : chunk.offsets)
+        chunk.words[o / 64] |= quint64(1) << (o % 64);
+    std::vector<quint16>().swap(chunk.offsets);
+}
+
+bool FacetIndex::Bitmap::contains(int slot) const
+{
+    const std::size_t c = std::size_t(slot >> ChunkBits);
+    if (c >= m_chunks.size())
+        return false;
+    const Chunk &chunk = m_chunks[c];
+    const int offset = slot & (ChunkSlots - 1);
+    if (!chunk.words.empty())
+        return chunk.words[offset / 64] >> (offset % 64) & 1;
+    return std::binary_search(chunk.offsets.begin(), chunk.offsets.end(), quint16(offset));
+}
+
+void FacetIndex::Bitmap::orInto(int c, quint64 *words) const
+{
+    if (c >= (int)m_chunks.size())
+        return;
+    const Chunk &chunk = m_chunks[c];
+    if (!chunk.words.empty())
+    {
+        ::orInto(words, chunk.words.data());
+        return;
+    }
+    for (quint16 o : chunk.offsets)
+        words[o / 64] |= quint64(1) << (o % 64);
+}
+
+int FacetIndex::Bitmap::countAnd(int c, const quint64 *mask) const
+{
+    if (c >= (int)m_chunks.size())
+        return 0;
+    const Chunk &chunk = m_chunks[c];
+    if (!chunk.words.empty())
+        return ::countAnd(chunk.words.data(), mask);
+    int n = 0;
+    for (quint16 o : chunk.offsets)
+        n += int(mask[o / 64] >> (o % 64) & 1);
+    return n;
+}
+
+// ---------------------------------------------
+// FacetIndex
+// ---------------------------------------------
+
+void FacetIndex::add(int slot, ItemFormat format, const QString &genre, const QString &rating)
+{
+    m_formats[std::size_t(format)].add(slot);
+    if (!genre.isEmpty())
+        m_genres[genre].add(slot);
+    if (!rating.isEmpty())
+        m_ratings[rating].add(slot);
+    m_size = slot + 1;
+}
+
+FacetIndex::Clauses FacetIndex::resolve(const FacetFilter &filter) const
+{
+    Clauses clauses;
+    clauses.active[FormatFacet] = !filter.formats.empty();
+    for (ItemFormat format : filter.formats)
+        if (int(format) >= 0 && int(format) < FacetCounts::FormatCount)
+            clauses.values[FormatFacet].push_back(&m_formats[std::size_t(format)]);
+
+    const auto lookup = [&](Facet f, const std::vector<QString> &wanted, const std::map<QString, Bitmap> &values) {
+        clauses.active[f] = !wanted.empty();
+        for (const QString &value : wanted)
+        {
+            auto found = values.find(value);
+            if (found != values.end())
+                clauses.values[f].push_back(&found->second);
+        }
+    };
+    lookup(GenreFacet, filter.genres, m_genres);
+    lookup(RatingFacet, filter.ratings, m_ratings);
+    clauses.active[AvailableFacet] = filter.availableOnly;
+    return clauses;
+}
+
+void FacetIndex::clauseMask(const Clauses &clauses, int f, int c, const AvailabilityBits &available,
+                            quint64 *mask) const
+{
+    if (f == AvailableFacet)
+    {
+        for (int i = 0; i < ChunkWords; ++i)
+            mask[i] = available.word(c * ChunkWords + i);
+        return;
+    }
+    std::fill(mask, mask + ChunkWords, 0);
+    for (const Bitmap *bitmap : clauses.values[f])
+        bitmap->orInto(c, mask);
+}
+
+void FacetIndex::fullMask(int c, quint64 *mask) const
+{
+    const int count = std::min(ChunkSlots, m_size - c * ChunkSlots);
+    std::fill(mask, mask + count / 64, ~quint64(0));
+    std::fill(mask + count / 64, mask + ChunkWords, 0);
+    if (count % 64)
+        mask[count / 64] = (quint64(1) << (count % 64)) - 1;
+}
+
+FacetIndex::Matches FacetIndex::filter(const FacetFilter &filter, const AvailabilityBits &available, int limit) const
+{
+    Matches out;
+    const Clauses clauses = resolve(filter);
+    std::vector<quint64> scratch(2 * ChunkWords);
+    quint64 *result = scratch.data();
+    quint64 *mask = result + ChunkWords;
+    const int chunks = (m_size + ChunkSlots - 1) / ChunkSlots;
+    for (int c = 0; c < chunks; ++c)
+    {
+        fullMask(c, result);
+        bool any = true;
+        for (int f = 0; f < FacetCount && any; ++f)
+        {
+            if (!clauses.active[f])
+                continue;
+            clauseMask(clauses, f, c, available, mask);
+            any = andInto(result, mask);
+        }
+        if (!any)
+            continue;
+        out.total += popcount(result);
+        for (int i = 0; i < ChunkWords && (int)out.found.size() < limit; ++i)
+        {
+            for (quint64 bits = result[i]; bits && (int)out.found.size() < limit; bits &= bits - 1)
+                out.found.push_back(c * ChunkSlots + i * 64 + qCountTrailingZeroBits(bits));
+        }
+    }
+    return out;
+}
+
+FacetCounts FacetIndex::counts(const FacetFilter &filter, const AvailabilityBits &available) const
+{
+    FacetCounts out;
+    for (const auto &[genre, bitmap] : m_genres)
+        out.genres.emplace_back(genre, 0);
+    for (const auto &[rating, bitmap] : m_ratings)
+        out.ratings.emplace_back(rating, 0);
+
+    const Clauses clauses = resolve(filter);
+    std::vector<quint64> scratch((FacetCount + 2) * ChunkWords);
+    quint64 *full = scratch.data();
+    quint64 *others = full + ChunkWords;
+    const auto clause = [&](int f) { return others + (f + 1) * ChunkWords; };
+    const int chunks = (m_size + ChunkSlots - 1) / ChunkSlots;
+    for (int c = 0; c < chunks; ++c)
+    {
+        fullMask(c, full);
+        for (int f = 0; f < FacetCount; ++f)
+            if (clauses.active[f])
+                clauseMask(clauses, f, c, available, clause(f));
+
+        // For each facet, the slots passing every other clause, then its
+        // values counted within them. With no other clause that is every
+        // slot, and the chunk counts kept by add() answer without a scan.
+        for (int f = 0; f < FacetCount; ++f)
+        {
+            std::copy(full, full + ChunkWords, others);
+            bool any = true, unconstrained = true;
+            for (int g = 0; g < FacetCount && any; ++g)
+            {
+                if (g != f && clauses.active[g])
+                {
+                    any = andInto(others, clause(g));
+                    unconstrained = false;
+                }
+            }
+            if (!any)
+                continue;
+            const auto count = [&](const Bitmap &bitmap) {
+                return unconstrained ? bitmap.count(c) : bitmap.countAnd(c, others);
+            };
+            switch (f)
+            {
+                case FormatFacet:
+                    for (int v = 0; v < FacetCounts::FormatCount; ++v)
+                        out.formats[v] += count(m_formats[v]);
+                    break;
+                case GenreFacet:
+                {
+                    std::size_t i = 0;
+                    for (const auto &[genre, bitmap] : m_genres)
+                        out.genres[i++].second += count(bitmap);
+                    break;
+                }
+                case RatingFacet:
+                {
+                    std::size_t i = 0;
+                    for (const auto &[rating, bitmap] : m_ratings)
+                        out.ratings[i++].second += count(bitmap);
+                    break;
+                }
+                case AvailableFacet:
+                {
+                    // others = the filter without "available only"
+                    const int all = popcount(others);
+                    clauseMask(clauses, AvailableFacet, c, available, clause(AvailableFacet));
+                    andInto(others, clause(AvailableFacet));
+                    const int onShelf = popcount(others);
+                    out.available += onShelf;
+                    out.matches += clauses.active[AvailableFacet] ? onShelf : all;
+                    break;
+                }
+            }
+        }
+    }
+    return out;
+}
+
+std::vector<int> FacetIndex::narrow(const FacetFilter &filter, const AvailabilityBits &available,
+                                    std::vector<int> candidates) const
+{
+    const Clauses clauses = resolve(filter);
+    const auto passes = [&](int slot) {
+        if (slot < 0 || slot >= m_size)
+            return false;
+        for (int f = 0; f < AvailableFacet; ++f)
+        {
+            if (clauses.active[f] && std::none_of(clauses.values[f].begin(), clauses.values[f].end(),
+                                                  [slot](const Bitmap *b) { return b->contains(slot); }))
+                return false;
+        }
+        return !clauses.active[AvailableFacet] || available.test(slot);
+    };
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](int slot) { return !passes(slot); }),
+                     candidates.end());
+    return candidates;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include "models.hpp"
+#include <QString>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// What a patron narrows the catalogue to: an item passes if it has one of
+// the listed values of every facet that lists any (empty = any value).
+// Items without a genre or rating never match a genre or rating list.
+struct FacetFilter {
+    std::vector<ItemFormat> formats;
+    std::vector<QString> genres;
+    std::vector<QString> ratings;
+    bool availableOnly = false;
+
+    bool empty() const { return formats.empty() && genres.empty() && ratings.empty() && !availableOnly; }
+};
+
+// Sidebar counts for a filter. Each facet is counted with the rest of the
+// filter applied but not its own list, so the numbers say what picking
+// that value (too) would show.
+struct FacetCounts {
+    static constexpr int FormatCount = int(ItemFormat::VideoGame) + 1;
+
+    int matches = 0;                                 // items passing the whole filter
+    int available = 0;                               // of those, on the shelf
+    std::array<int, FormatCount> formats{};          // by ItemFormat
+    std::vector<std::pair<QString, int>> genres;     // every genre in the catalogue, by name
+    std::vector<std::pair<QString, int>> ratings;
+};
+
+// ---------------------------------------------
+// AvailabilityBits: one live bit per slot, set while the item is on the shelf
+// ---------------------------------------------
+// The store flips a slot's bit with every status change, under that item's
+// stripe lock. A word holds 64 neighbouring slots from different stripes,
+// so bits are set and cleared atomically; readers see each word as of
+// some moment, not a snapshot of the whole set.
+class AvailabilityBits
+{
+public:
+    static constexpr int WordBits = 64;
+
+    //Track slots [0, count), new ones available; never concurrent with other calls
+    void grow(int count);
+    void clear() { m_count = 0; }
+
+    void set(int slot, bool available)
+    {
+        const quint64 bit = quint64(1) << (slot % WordBits);
+        if (available)
+            m_words[slot / WordBits].fetch_or(bit, std::memory_order_relaxed);
+        else
+            m_words[slot / WordBits].fetch_and(~bit, std::memory_order_relaxed);
+    }
+    bool test(int slot) const { return word(slot / WordBits) >> (slot % WordBits) & 1; }
+
+    int count() const { return m_count; }
+    //Word i (bits of slots [64 i, 64 i + 64)); 0 past the end
+    quint64 word(int i) const
+    {
+        return i < (m_count + WordBits - 1) / WordBits ? m_words[i].load(std::memory_order_relaxed) : 0;
+    }
+    int popcount() const;
+
+private:
+    std::unique_ptr<std::atomic<quint64>[]> m_words;
+    int m_capacity = 0;   // words allocated
+    int m_count = 0;      // slots tracked
+};
+
+// ---------------------------------------------
+// FacetIndex: bitmap indexes for filtering the catalogue by facet
+// ---------------------------------------------
+// Format, genre and rating map each value to a bitmap of the slots that
+// have it; availability comes from the store's AvailabilityBits. Bitmaps
+// are cut into chunks of 64K slots and each chunk is kept as whichever is
+// smaller: an ascending array of 16-bit offsets (up to 4096 slots) or a
+// 1024-word bitset. A rare genre costs two bytes per item and a common
+// format at most 8 KB per chunk, and adding slots in order only appends.
+//
+// Queries run chunk by chunk into a 1024-word scratch bitset: a facet's
+// values are ORed, facets are ANDed, and counts are popcounts. The
+// kernels are plain loops over 64-bit words that the compiler vectorizes,
+// and a chunk that runs empty skips its remaining facets, so a query over
+// a million items reads a few hundred KB at most.
+class FacetIndex
+{
+public:
+    struct Matches {
+        std::vector<int> found;   // the first `limit` passing slots, ascending
+        int total = 0;            // all passing slots
+    };
+
+    int size() const { return m_size; }
+
+    //Index one item; slots must be added in increasing order
+    void add(int slot, ItemFormat format, const QString &genre, const QString &rating);
+
+    Matches filter(const FacetFilter &filter, const AvailabilityBits &available, int limit) const;
+    FacetCounts counts(const FacetFilter &filter, const AvailabilityBits &available) const;
+
+    //Keep the slots that pass, in their order (for a short list such as search hits)
+    std::vector<int> narrow(const FacetFilter &filter, const AvailabilityBits &available,
+                            std::vector<int> candidates) const;
+
+private:
+    enum Facet { FormatFacet, GenreFacet, RatingFacet, AvailableFacet, FacetCount };
+
+    class Bitmap
+    {
+    public:
+        void add(int slot);
+        bool contains(int slot) const;
+        //words |= this bitmap's chunk c
+        void orInto(int c, quint64 *words) const;
+        //popcount(chunk c & mask), and of chunk c alone
+        int countAnd(int c, const quint64 *mask) const;
+        int count(int c) const { return c < (int)m_chunks.size() ? m_chunks[c].count : 0; }
+    private:
+        struct Chunk {
+            int count = 0;
+            std::vector<quint16> offsets;   // while sparse
+            std::vector<quint64> words;     // once dense (offsets emptied)
+        };
+        std::vector<Chunk> m_chunks;
+    };
+
+    // A filter resolved to bitmaps: per facet, whether it constrains and
+    // which value bitmaps it accepts (none known = matches nothing)
+    struct Clauses {
+        std::array<bool, FacetCount> active{};
+        std::array<std::vector<const Bitmap *>, FacetCount> values;
+    };
+    Clauses resolve(const FacetFilter &filter) const;
+    //mask = slots of chunk c passing clause f
+    void clauseMask(const Clauses &clauses, int f, int c, const AvailabilityBits &available, quint64 *mask) const;
+    //mask = slots of chunk c that exist
+    void fullMask(int c, quint64 *mask) const;
+
+    int m_size = 0;
+    std::array<Bitmap, FacetCounts::FormatCount> m_formats;
+    std::map<QString, Bitmap> m_genres, m_ratings;   // ordered for the sidebar
+};
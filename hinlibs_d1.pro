@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -8,21 +8,24 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(core.pri)
+
 SOURCES += \
-    datastore.cpp \
+    cataloguemodel.cpp \
     main.cpp \
     mainwindow.cpp \
     patronwindow.cpp \
     rolewindows.cpp \
-    startupdialog.cpp
+    startupdialog.cpp \
+    storeclient.cpp
 
 HEADERS += \
-    datastore.hpp \
+    cataloguemodel.hpp \
     mainwindow.h \
-    models.hpp \
     patronwindow.hpp \
     rolewindows.hpp \
-    startupdialog.hpp
+    startupdialog.hpp \
+    storeclient.hpp
 
 FORMS += \
     mainwindow.ui
@@ -32,6 +35,15 @@ TRANSLATIONS += \
 CONFIG += lrelease
 CONFIG += embed_translations
 
+# `make bench` builds the stand-alone benchmarks (benchmarks/) next to this
+# build and runs the micro-benchmark suite; results go to micro_bench.tsv
+bench.commands = mkdir -p $$OUT_PWD/benchmarks && \
+                 cd $$OUT_PWD/benchmarks && \
+                 $$QMAKE_QMAKE $$PWD/benchmarks/benchmarks.pro && \
+                 $(MAKE) && \
+                 ./micro_bench --out $$OUT_PWD/micro_bench.tsv
+QMAKE_EXTRA_TARGETS += bench
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
@@ -0,0 +1,178 @@
+#include "holdqueue.hpp"
+#include <algorithm>
+
+bool HoldQueue::enqueue(int patronId)
+{
+    if (patronId <= 0 || contains(patronId))
+        return false;
+
+    // Appending slot i (1-based): its tree node covers (i - lowbit(i), i],
+    // i.e. this ticket plus the live count of the slots just before it.
+    const int i = (int)m_slots.size() + 1;
+    m_slots.push_back(patronId);
+    m_tree.push_back(1 + prefix(i - 1) - prefix(i - (i & -i)));
+    insertTicket(patronId, i - 1);
+    ++m_size;
+    return true;
+}
+
+bool HoldQueue::cancel(int patronId)
+{
+    const int entry = findEntry(patronId);
+    if (entry < 0)
+        return false;
+
+    const int ticket = m_tickets[entry].ticket;
+    m_slots[ticket] = 0;
+    add(ticket, -1);
+    eraseEntry(entry);
+    --m_size;
+
+    skipCleared();
+    compactIfSparse();
+    return true;
+}
+
+int HoldQueue::position(int patronId) const
+{
+    const int ticket = ticketOf(patronId);
+    if (ticket < 0)
+        return -1;
+    // Every slot before the ticket is either live (ahead in line) or cleared (0)
+    return prefix(ticket + 1);
+}
+
+int HoldQueue::front() const
+{
+    return m_size == 0 ? 0 : m_slots[m_head];
+}
+
+int HoldQueue::popFront()
+{
+    if (m_size == 0)
+        return 0;
+    const int patronId = m_slots[m_head];
+    cancel(patronId);
+    return patronId;
+}
+
+std::vector<int> HoldQueue::patrons() const
+{
+    std::vector<int> out;
+    out.reserve(m_size);
+    for (int i = m_head; i < (int)m_slots.size(); ++i)
+        if (m_slots[i] != 0)
+            out.push_back(m_slots[i]);
+    return out;
+}
+
+void HoldQueue::add(int ticket, int delta)
+{
+    for (int i = ticket + 1; i <= (int)m_tree.size(); i += i & -i)
+        m_tree[i - 1] += delta;
+}
+
+int HoldQueue::prefix(int count) const
+{
+    int sum = 0;
+    for (int i = count; i > 0; i -= i & -i)
+        sum += m_tree[i - 1];
+    return sum;
+}
+
+void HoldQueue::skipCleared()
+{
+    while (m_head < (int)m_slots.size() && m_slots[m_head] == 0)
+        ++m_head;
+}
+
+void HoldQueue::compactIfSparse()
+{
+    const int cleared = (int)m_slots.size() - m_size;
+    if (m_size == 0)
+    {
+        // Cheap reset; keeps capacity for the next burst of holds
+        m_slots.clear();
+        m_tree.clear();
+        m_head = 0;
+        return;
+    }
+    if (cleared < 32 || cleared < m_size)
+        return;
+
+    // Rebuild with only live tickets: O(n), amortised over the cleared slots
+    std::pmr::vector<int> live(m_slots.get_allocator());
+    live.reserve(std::size_t(m_size));
+    for (int i = m_head; i < (int)m_slots.size(); ++i)
+        if (m_slots[i] != 0)
+            live.push_back(m_slots[i]);
+
+    m_slots.clear();
+    m_tree.clear();
+    std::fill(m_tickets.begin(), m_tickets.end(), TicketEntry());
+    m_head = 0;
+    m_size = 0;
+    for (int patronId : live)
+        enqueue(patronId);
+}
+
+std::size_t HoldQueue::homeOf(int patronId) const
+{
+    // Fibonacci hashing; the table size is a power of two
+    return std::size_t(unsigned(patronId) * 2654435769u) & (m_tickets.size() - 1);
+}
+
+int HoldQueue::findEntry(int patronId) const
+{
+    if (m_tickets.empty())
+        return -1;
+    const std::size_t mask = m_tickets.size() - 1;
+    for (std::size_t i = homeOf(patronId);; i = (i + 1) & mask)
+    {
+        if (m_tickets[i].patronId == patronId)
+            return (int)i;
+        if (m_tickets[i].patronId == 0)
+            return -1;
+    }
+}
+
+int HoldQueue::ticketOf(int patronId) const
+{
+    const int entry = findEntry(patronId);
+    return entry < 0 ? -1 : m_tickets[entry].ticket;
+}
+
+void HoldQueue::insertTicket(int patronId, int ticket)
+{
+    if (std::size_t(m_size + 1) * 2 > m_tickets.size())
+    {
+        std::pmr::vector<TicketEntry> old(std::max<std::size_t>(8, m_tickets.size() * 2), m_tickets.get_allocator());
+        old.swap(m_tickets);
+        for (const TicketEntry &e : old)
+            if (e.patronId != 0)
+                insertTicket(e.patronId, e.ticket);
+    }
+    const std::size_t mask = m_tickets.size() - 1;
+    std::size_t i = homeOf(patronId);
+    while (m_tickets[i].patronId != 0)
+        i = (i + 1) & mask;
+    m_tickets[i] = TicketEntry{patronId, ticket};
+}
+
+void HoldQueue::eraseEntry(int index)
+{
+    // Backward-shift delete: pull later entries of the probe run into the
+    // hole unless that would move them in front of their home slot
+    const std::size_t mask = m_tickets.size() - 1;
+    std::size_t hole = std::size_t(index);
+    for (std::size_t i = (hole + 1) & mask; m_tickets[i].patronId != 0; i = (i + 1) & mask)
+    {
+        const std::size_t home = homeOf(m_tickets[i].patronId);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            m_tickets[hole] = m_tickets[i];
+            hole = i;
+        }
+    }
+    m_tickets[hole] = TicketEntry();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// ---------------------------------------------
+// HoldQueue: FIFO of patron ids waiting for one item
+// ---------------------------------------------
+// Every enqueue takes the next "ticket" slot. A Fenwick tree over the
+// slots counts live tickets, so a patron's position is a prefix sum and
+// cancelling from the middle just clears a slot: enqueue, cancel and
+// position are O(log n), pop-head is amortised O(log n). Cleared slots
+// are compacted away once they outnumber the live ones. All state lives
+// in flat vectors that keep their capacity, so a queue that has seen its
+// peak size does not allocate again. The vectors come from the queue's
+// allocator: DataStore gives each item stripe's queues one pool.
+class HoldQueue
+{
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<int>;
+
+    explicit HoldQueue(const allocator_type &alloc = {}) : m_slots(alloc), m_tree(alloc), m_tickets(alloc) {}
+
+    //Append a patron; false if they are already queued
+    bool enqueue(int patronId);
+
+    //Remove a patron from anywhere in the queue; false if not queued
+    bool cancel(int patronId);
+
+    //1-based position of the patron, or -1 if not queued
+    int position(int patronId) const;
+
+    //Patron at the head (0 if empty) / remove and return it
+    int front() const;
+    int popFront();
+
+    //Queued patron ids, head first (O(n); snapshots and debugging)
+    std::vector<int> patrons() const;
+
+    bool contains(int patronId) const { return ticketOf(patronId) >= 0; }
+    int size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    void add(int ticket, int delta);
+    int prefix(int ticket) const;
+    void skipCleared();
+    void compactIfSparse();
+
+    // patron id -> ticket: open addressing with linear probing, at most
+    // half full; erase shifts followers back, so there are no tombstones
+    struct TicketEntry {
+        int patronId = 0;   // 0 = empty
+        int ticket = 0;
+    };
+    std::size_t homeOf(int patronId) const;
+    int findEntry(int patronId) const;       // index in m_tickets, -1 if absent
+    int ticketOf(int patronId) const;        // -1 if absent
+    void insertTicket(int patronId, int ticket);
+    void eraseEntry(int index);
+
+    std::pmr::vector<int> m_slots;           // patron id per ticket, 0 = cleared
+    std::pmr::vector<int> m_tree;            // Fenwick tree over live tickets (1-based)
+    std::pmr::vector<TicketEntry> m_tickets; // size 0 or a power of two
+    int m_head = 0;                          // no live ticket before this one
+    int m_size = 0;
+};
@@ -1,9 +1,73 @@
 #include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QMessageBox>
+#include <QStandardPaths>
+#include <QTimer>
+#include "datastore.hpp"
 #include "startupdialog.hpp"
+#include "storeclient.hpp"
+#include "workloadtrace.hpp"
 
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
+    app.setApplicationName("HinLIBS");
+
+    const QString storageDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+
+    // A catalogue built by tools/catalogueconvert replaces the demo items
+    const QString cataloguePath = QDir(storageDir).filePath("catalogue.hcat");
+    if (QFile::exists(cataloguePath))
+    {
+        if (auto err = DataStore::instance().openCatalogue(cataloguePath))
+            QMessageBox::warning(nullptr, "Catalogue unavailable",
+                                 QString("%1\nUsing the built-in demo catalogue.").arg(*err));
+    }
+
+    // HINLIBS_SERVER=<name> makes this a terminal of a shared library
+    // server (tools/hinlibsd): loans and holds live there, and this process
+    // keeps only the catalogue, so it neither opens storage nor runs the clock
+    const QString serverName = qEnvironmentVariable("HINLIBS_SERVER");
+    if (!serverName.isEmpty())
+    {
+        if (auto err = StoreClient::instance().connectToServer(serverName))
+        {
+            QMessageBox::critical(nullptr, "Library server unavailable", *err);
+            return 1;
+        }
+        StartupDialog dlg;
+        dlg.show();
+        const int result = app.exec();
+        StoreClient::instance().disconnectFromServer();
+        return result;
+    }
+
+    // Loans and holds survive restarts: replay the journal before any UI opens
+    if (auto err = DataStore::instance().openStorage(storageDir))
+        QMessageBox::warning(nullptr, "Storage unavailable",
+                             QString("%1\nChanges in this session will not be saved.").arg(*err));
+
+    // HINLIBS_TRACE=<file> records this session's circulation calls and
+    // lookups for tools/workloadreplay
+    WorkloadTrace trace;
+    const QString tracePath = qEnvironmentVariable("HINLIBS_TRACE");
+    if (!tracePath.isEmpty())
+    {
+        if (auto err = trace.open(tracePath))
+            QMessageBox::warning(nullptr, "Trace unavailable", *err);
+        else
+            DataStore::instance().setTrace(&trace);
+    }
+
+    // The due schedule follows the calendar: loans turning overdue or due
+    // soon are published to the open windows as the date rolls over
+    QTimer clock;
+    QObject::connect(&clock, &QTimer::timeout, [] { DataStore::instance().advanceClock(QDate::currentDate()); });
+    clock.start(60 * 1000);
+
     StartupDialog dlg;
     dlg.show();
-    return app.exec();
+    const int result = app.exec();
+    DataStore::instance().setTrace(nullptr);
+    return result;
 }
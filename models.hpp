@@ -1,19 +1,28 @@
 #pragma once
 #include <QString>
 #include <QDate>
+#include <QHash>
+#include <cstddef>
+#include <memory_resource>
 #include <vector>
 #include <optional>
-#include <queue>
+
+// Lets QString keys be used in std::unordered_map/set
+struct QStringHash {
+    std::size_t operator()(const QString &s) const { return qHash(s); }
+};
 
 enum class UserType { Patron, Librarian, Admin };
 
 struct User {
+    int id = 0;         // compact patron id assigned by DataStore (0 = not yet stored)
     QString name;
     UserType type;
-    // For patrons only: store active loans by item id
-    std::vector<int> activeLoans;
+    // For patrons only: store active loans by item id (DataStore's records
+    // allocate both lists from a pool; copies use the default heap)
+    std::pmr::vector<int> activeLoans;
     //to store holds for the user
-    std::vector<int> holds;
+    std::pmr::vector<int> holds;
 };
 
 enum class ItemFormat { FictionBook, NonFictionBook, Magazine, Movie, VideoGame };
@@ -29,22 +38,35 @@ inline QString formatToString(ItemFormat f) {
     return "Unknown";
 }
 
+// Parse a format name as written by formatToString (or without the space/
+// hyphen, e.g. "NonFictionBook"); case-insensitive
+inline std::optional<ItemFormat> formatFromString(QString s) {
+    s = s.toLower().remove(' ').remove('-');
+    if (s == "fictionbook")    return ItemFormat::FictionBook;
+    if (s == "nonfictionbook") return ItemFormat::NonFictionBook;
+    if (s == "magazine")       return ItemFormat::Magazine;
+    if (s == "movie")          return ItemFormat::Movie;
+    if (s == "videogame")      return ItemFormat::VideoGame;
+    return std::nullopt;
+}
+
 // Availability/state for items
 struct ItemStatus {
     bool available = true;
-    std::optional<QString> borrower; // name of patron
+    int borrower = 0;                // id of borrowing patron (0 = none)
     std::optional<QDate>  dueDate;   // 14 days from checkout
+    int readyFor = 0;                // patron it waits for on the hold shelf (0 = none)
+    std::optional<QDate>  pickupBy;  // last day they can collect it
 };
 
-// Single catalogue item (kept intentionally compact for D1)
+// Single catalogue item: metadata plus current status. DataStore keeps
+// the two apart internally (see datastore.hpp) and hands out copies.
 struct Item {
-    int id;
+    int id = 0;
     QString title;
     QString creator;    // author / director / studio, etc.
-    ItemFormat format;
+    ItemFormat format = ItemFormat::FictionBook;
     ItemStatus status;
-    //to track holds on an item
-    std::queue<QString> holdQueue;
 
     // Optional fields for formats that require them
     QString dewey;      // for non-fiction e.g. "123.45"
@@ -58,4 +80,6 @@ struct Item {
 namespace Rules {
     constexpr int MaxActiveLoans = 3;     // patrons may borrow at most 3 items at a time
     constexpr int LoanDays       = 14;    // due date is 14 days from checkout
+    constexpr int DueSoonDays    = 2;     // due-soon reminder this many days before the due date
+    constexpr int PickupDays     = 7;     // a returned item waits this long for the next patron in line
 }
@@ -1,13 +1,22 @@
 #include "patronwindow.hpp"
-#include "datastore.hpp"
+#include "cataloguemodel.hpp"
+#include "storeclient.hpp"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QHeaderView>
-#include <QTableWidget>
+#include <QTableView>
 #include <QPushButton>
 #include <QListWidget>
 #include <QLabel>
+#include <QLineEdit>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QTimer>
+#include <QLocale>
+#include <QDateTime>
+#include <QSignalBlocker>
 #include <QMessageBox>
+#include <algorithm>
 
 PatronWindow::PatronWindow(const QString &patronName, QWidget *parent)
     : QDialog(parent)
@@ -15,16 +24,52 @@ PatronWindow::PatronWindow(const QString &patronName, QWidget *parent)
     setWindowTitle(QString("HinLIBS — Patron: %1").arg(patronName));
     resize(900, 540);
 
-    // Load the user from DataStore (we assume existence)
-    m_patron = DataStore::instance().findUser(patronName).value();
+    // Look the user up in the store (we assume existence)
+    m_patronId = StoreClient::instance().findUserId(patronName);
 
     auto *root = new QVBoxLayout(this);
 
-    // Top: Catalogue table
-    m_table = new QTableWidget(this);
-    m_table->setColumnCount(5);
-    m_table->setHorizontalHeaderLabels({"ID", "Title", "Author/Creator", "Format", "Availability"});
+    // Search-as-you-type over title and author; empty shows everything
+    m_searchEdit = new QLineEdit(this);
+    m_searchEdit->setPlaceholderText("Search title or author…");
+    m_searchEdit->setClearButtonEnabled(true);
+    root->addWidget(m_searchEdit);
+
+    // Facet filters, each value with its count (see refreshFacetCounts);
+    // they narrow the whole catalogue or the search results
+    auto *filterRow = new QHBoxLayout();
+    m_formatBox = new QComboBox(this);
+    m_formatBox->addItem("All formats", -1);
+    for (int f = 0; f < FacetCounts::FormatCount; ++f)
+        m_formatBox->addItem(formatToString(ItemFormat(f)), f);
+    m_genreBox = new QComboBox(this);
+    m_genreBox->addItem("All genres", QString());
+    m_ratingBox = new QComboBox(this);
+    m_ratingBox->addItem("All ratings", QString());
+    m_availableBox = new QCheckBox("Available only", this);
+    m_matchesLabel = new QLabel(this);
+    filterRow->addWidget(m_formatBox);
+    filterRow->addWidget(m_genreBox);
+    filterRow->addWidget(m_ratingBox);
+    filterRow->addWidget(m_availableBox);
+    filterRow->addStretch();
+    filterRow->addWidget(m_matchesLabel);
+    root->addLayout(filterRow);
+
+    // Circulation moves the counts constantly; recount at most a few
+    // times a second
+    m_countsTimer = new QTimer(this);
+    m_countsTimer->setSingleShot(true);
+    m_countsTimer->setInterval(250);
+
+    // Top: Catalogue table (model formats rows on demand, fixed row height
+    // so the view never has to measure the whole catalogue)
+    m_model = new CatalogueModel(this);
+    m_table = new QTableView(this);
+    m_table->setModel(m_model);
     m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_table->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    m_table->verticalHeader()->hide();
     m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
     m_table->setSelectionMode(QAbstractItemView::SingleSelection);
     root->addWidget(m_table, 3);
@@ -44,6 +89,11 @@ PatronWindow::PatronWindow(const QString &patronName, QWidget *parent)
     mid->addWidget(m_holdBtn, 0); // add the hold button
     root->addLayout(mid);
 
+    // Suggestions for the selected item
+    m_alsoBorrowedLabel = new QLabel();
+    m_alsoBorrowedLabel->setWordWrap(true);
+    root->addWidget(m_alsoBorrowedLabel);
+
     // Bottom: Active loans panel
     auto *loansBox = new QHBoxLayout();
     auto *loansLabel = new QLabel("My Active Loans (max 3):");
@@ -79,7 +129,22 @@ PatronWindow::PatronWindow(const QString &patronName, QWidget *parent)
     retRow->addWidget(m_returnBtn);
     root->addLayout(retRow);
 
+    //borrowing history panel
+    auto *historyBox = new QHBoxLayout();
+    auto *historyLabel = new QLabel("My Borrowing History (last 100):");
+    m_historyList = new QListWidget();
+    historyBox->addWidget(historyLabel);
+    historyBox->addStretch();
+    root->addLayout(historyBox);
+    root->addWidget(m_historyList, 1);
+
     // Wire signals
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &PatronWindow::onSearchTextChanged);
+    connect(m_formatBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &PatronWindow::onFilterChanged);
+    connect(m_genreBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &PatronWindow::onFilterChanged);
+    connect(m_ratingBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &PatronWindow::onFilterChanged);
+    connect(m_availableBox, &QCheckBox::toggled, this, &PatronWindow::onFilterChanged);
+    connect(m_countsTimer, &QTimer::timeout, this, &PatronWindow::refreshFacetCounts);
     connect(m_table->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &PatronWindow::onCatalogueSelectionChanged);
     connect(m_borrowBtn, &QPushButton::clicked, this, &PatronWindow::onBorrowClicked);
@@ -96,93 +161,217 @@ PatronWindow::PatronWindow(const QString &patronName, QWidget *parent)
     connect(m_holdsList, &QListWidget::itemSelectionChanged,
             this, &PatronWindow::onHoldsSelectionChanged);
 
+    // Follow store changes from this and any other open window
+    m_subscription = StoreClient::instance().subscribe(
+        [this](const ChangeSet &changes) { applyChanges(changes); });
+
     // Initial population
-    populateCatalogue();
+    refreshFacetCounts();
     refreshLoansView();
 }
 
-void PatronWindow::populateCatalogue()
+PatronWindow::~PatronWindow()
+{
+    StoreClient::instance().unsubscribe(m_subscription);
+}
+
+void PatronWindow::applyChanges(const ChangeSet &changes)
 {
-    const auto &items = DataStore::instance().items();
-    m_table->setRowCount((int)items.size());
-    int r = 0;
-    for (const auto &it : items)
+    if (!changes.itemsAdded.empty())
+    {
+        if (m_model->isSearching())
+            onSearchTextChanged(); // new items may match the current query
+        else
+            m_model->syncRowCount();
+    }
+    for (int id : changes.statusChanged)
+        m_model->itemChanged(id);
+
+    // Rows already shown stay until the filter changes (a row under
+    // "Available only" shows its new status); the counts follow
+    if (!changes.statusChanged.empty() || !changes.itemsAdded.empty())
+        m_countsTimer->start();
+
+    // Our own record changed: reload both lists
+    bool patronChanged = std::find(changes.usersChanged.begin(), changes.usersChanged.end(),
+                                   m_patronId) != changes.usersChanged.end();
+    if (patronChanged)
     {
-        // ID
-        auto *idItem = new QTableWidgetItem(QString::number(it.id));
-        idItem->setFlags(idItem->flags() & ~Qt::ItemIsEditable);
-        m_table->setItem(r, 0, idItem);
-
-        // Title
-        auto *titleItem = new QTableWidgetItem(it.title);
-        titleItem->setFlags(titleItem->flags() & ~Qt::ItemIsEditable);
-        m_table->setItem(r, 1, titleItem);
-
-        // Creator
-        auto *creatorItem = new QTableWidgetItem(it.creator);
-        creatorItem->setFlags(creatorItem->flags() & ~Qt::ItemIsEditable);
-        m_table->setItem(r, 2, creatorItem);
-
-        // Format
-        auto *fmtItem = new QTableWidgetItem(formatToString(it.format));
-        fmtItem->setFlags(fmtItem->flags() & ~Qt::ItemIsEditable);
-        m_table->setItem(r, 3, fmtItem);
-
-        // Availability
-        QString status = it.status.available ? "Available" : QString("Out (due %1)").arg(it.status.dueDate ? it.status.dueDate->toString("yyyy-MM-dd") : "—");
-        auto *statusItem = new QTableWidgetItem(status);
-        statusItem->setFlags(statusItem->flags() & ~Qt::ItemIsEditable);
-        m_table->setItem(r, 4, statusItem);
-
-        r++;
+        refreshLoansView();
     }
-    m_table->resizeRowsToContents();
+    else
+    {
+        // Someone else joined/left a queue we are in: positions moved
+        bool queueMoved = std::any_of(changes.holdsChanged.begin(), changes.holdsChanged.end(), [this](int id) {
+            return std::find(m_holdIds.begin(), m_holdIds.end(), id) != m_holdIds.end();
+        });
+        if (queueMoved)
+            refreshHoldsView();
+    }
+
+    // Selected item may have changed state (borrow/hold buttons, details)
+    int selected = selectedItemId();
+    if (patronChanged || std::find(changes.statusChanged.begin(), changes.statusChanged.end(), selected) != changes.statusChanged.end())
+        onCatalogueSelectionChanged();
 }
 
-//updating users GUI when loans are selected
-void PatronWindow::onCatalogueSelectionChanged()
+int PatronWindow::selectedItemId() const
 {
     auto selected = m_table->selectionModel()->selectedRows();
     if (selected.isEmpty())
+        return -1;
+    return m_model->itemIdAt(selected.first().row());
+}
+
+//narrow the catalogue to the best matches as the patron types, and to
+//the filters
+void PatronWindow::onSearchTextChanged()
+{
+    static constexpr int MaxResults = 200;
+    static constexpr int MaxFilterRows = 50000;   // also what a server sends back
+
+    StoreClient &store = StoreClient::instance();
+    const QString query = m_searchEdit->text().trimmed();
+    const FacetFilter filter = currentFilter();
+    if (query.isEmpty() && filter.empty())
+    {
+        m_model->clearSearch();
+    }
+    else if (query.isEmpty())
+    {
+        m_model->showSearchResults(store.filterCatalogue(filter, MaxFilterRows).found);
+    }
+    else
+    {
+        std::vector<int> matches = store.searchCatalogue(query, MaxResults);
+        if (!filter.empty())
+            matches = store.filterSlots(filter, std::move(matches));
+        m_model->showSearchResults(std::move(matches));
+    }
+
+    // A model reset drops the selection without a selectionChanged signal
+    onCatalogueSelectionChanged();
+}
+
+void PatronWindow::onFilterChanged()
+{
+    onSearchTextChanged();
+    refreshFacetCounts();
+}
+
+FacetFilter PatronWindow::currentFilter() const
+{
+    FacetFilter filter;
+    if (const int format = m_formatBox->currentData().toInt(); format >= 0)
+        filter.formats.push_back(ItemFormat(format));
+    if (const QString genre = m_genreBox->currentData().toString(); !genre.isEmpty())
+        filter.genres.push_back(genre);
+    if (const QString rating = m_ratingBox->currentData().toString(); !rating.isEmpty())
+        filter.ratings.push_back(rating);
+    filter.availableOnly = m_availableBox->isChecked();
+    return filter;
+}
+
+//put the current counts into the filter controls, keeping what is picked
+void PatronWindow::refreshFacetCounts()
+{
+    const FacetCounts counts = StoreClient::instance().facetCounts(currentFilter());
+    const QLocale locale;
+    const auto label = [&](const QString &value, int n) { return QString("%1 (%2)").arg(value, locale.toString(n)); };
+
+    const QSignalBlocker blockFormats(m_formatBox), blockGenres(m_genreBox), blockRatings(m_ratingBox);
+    for (int f = 0; f < FacetCounts::FormatCount; ++f)
+        m_formatBox->setItemText(f + 1, label(formatToString(ItemFormat(f)), counts.formats[f]));
+
+    // Genres and ratings are whatever the catalogue has. Texts are updated
+    // in place (an open list stays open); only new values rebuild the box.
+    const auto fill = [&](QComboBox *box, const QString &all, const std::vector<std::pair<QString, int>> &values) {
+        bool same = box->count() == (int)values.size() + 1;
+        for (int i = 0; same && i < (int)values.size(); ++i)
+            same = box->itemData(i + 1).toString() == values[i].first;
+        if (same)
+        {
+            for (int i = 0; i < (int)values.size(); ++i)
+                box->setItemText(i + 1, label(values[i].first, values[i].second));
+            return;
+        }
+        const QString picked = box->currentData().toString();
+        box->clear();
+        box->addItem(all, QString());
+        for (const auto &[value, n] : values)
+            box->addItem(label(value, n), value);
+        box->setCurrentIndex(std::max(0, box->findData(picked)));
+    };
+    fill(m_genreBox, "All genres", counts.genres);
+    fill(m_ratingBox, "All ratings", counts.ratings);
+
+    m_matchesLabel->setText(QString("%1 match, %2 available")
+                                .arg(locale.toString(counts.matches), locale.toString(counts.available)));
+}
+
+//updating users GUI when loans are selected
+void PatronWindow::onCatalogueSelectionChanged()
+{
+    int itemId = selectedItemId();
+    if (itemId < 0)
     {
         m_selectedLabel->setText("No item selected.");
+        m_alsoBorrowedLabel->clear();
         m_borrowBtn->setEnabled(false);
+        m_holdBtn->setEnabled(false);
         return;
     }
-    int row = selected.first().row();
-    int itemId = m_table->item(row, 0)->text().toInt();
-    const Item *it = DataStore::instance().findItemById(itemId);
+    auto it = StoreClient::instance().findItemById(itemId);
     if (!it)
         return;
 
     // Show details: title, author/creator, format, availability
+    QString status;
+    if (it->status.available)
+        status = "Available";
+    else if (it->status.readyFor == m_patronId)
+        status = QString("Ready for you until %1").arg(it->status.pickupBy->toString("yyyy-MM-dd"));
+    else if (it->status.readyFor)
+        status = "On the hold shelf";
+    else
+        status = QString("Checked out (due %1)").arg(it->status.dueDate ? it->status.dueDate->toString("yyyy-MM-dd") : "—");
     QString detail = QString("Selected #%1 — \"%2\" by %3  |  %4  |  %5")
                          .arg(it->id)
                          .arg(it->title)
                          .arg(it->creator)
                          .arg(formatToString(it->format))
-                         .arg(it->status.available ? "Available" : QString("Checked out (due %1)").arg(it->status.dueDate ? it->status.dueDate->toString("yyyy-MM-dd") : "—"));
+                         .arg(status);
     m_selectedLabel->setText(detail);
 
-    // You can only borrow if it's available and you haven't hit the cap
-    bool canBorrow = it->status.available && ((int)m_patron.activeLoans.size() < Rules::MaxActiveLoans);
+    // "Also borrowed": one table lookup, then the titles in one round trip
+    QStringList titles;
+    for (const auto &also : StoreClient::instance().findItems(StoreClient::instance().alsoBorrowed(itemId, 5)))
+        if (also)
+            titles << QString("\"%1\"").arg(also->title);
+    m_alsoBorrowedLabel->setText(titles.isEmpty() ? QString()
+                                                  : "Patrons who borrowed this also borrowed: " + titles.join(", "));
+
+    // You can only borrow if it's available (or waiting for you on the hold
+    // shelf) and you haven't hit the cap
+    const bool readyForMe = it->status.readyFor == m_patronId;
+    int loans = 0;
+    StoreClient::instance().withUser(m_patronId, [&](const User &u) { loans = (int)u.activeLoans.size(); });
+    bool canBorrow = (it->status.available || readyForMe) && (loans < Rules::MaxActiveLoans);
     m_borrowBtn->setEnabled(canBorrow);
 
-    //can place hold if item is unavailable
-    bool canHold = !it->status.available;
+    //can place hold if item is unavailable and not already waiting for you
+    bool canHold = !it->status.available && !readyForMe;
     m_holdBtn->setEnabled(canHold);
 }
 
 //when user selescts items to borrow
 void PatronWindow::onBorrowClicked()
 {
-    auto selected = m_table->selectionModel()->selectedRows();
-    if (selected.isEmpty())
+    int itemId = selectedItemId();
+    if (itemId < 0)
         return;
-    int row = selected.first().row();
-    int itemId = m_table->item(row, 0)->text().toInt();
 
-    auto err = DataStore::instance().borrowItem(m_patron, itemId);
+    auto err = StoreClient::instance().borrowItem(m_patronId, itemId);
     if (err)
     {
         QMessageBox::warning(this, "Borrow failed", *err);
@@ -191,20 +380,17 @@ void PatronWindow::onBorrowClicked()
     {
         QMessageBox::information(this, "Success", "Item checked out! Due in 14 days.");
     }
-
-    // Refresh UI to reflect new state
-    populateCatalogue();
-    refreshLoansView();
-    onCatalogueSelectionChanged();
+    // views follow via applyChanges()
 }
 
 //updating users loans on GUI
 void PatronWindow::refreshLoansView()
 {
     m_loansList->clear();
-    for (int id : m_patron.activeLoans)
+    std::vector<int> loanIds;
+    StoreClient::instance().withUser(m_patronId, [&](const User &u) { loanIds.assign(u.activeLoans.begin(), u.activeLoans.end()); });
+    for (const std::optional<Item> &it : StoreClient::instance().findItems(loanIds))
     {
-        const Item *it = DataStore::instance().findItemById(id);
         if (!it)
             continue;
         QString due = it->status.dueDate ? it->status.dueDate->toString("yyyy-MM-dd") : "—";
@@ -218,6 +404,7 @@ void PatronWindow::refreshLoansView()
         m_loansList->addItem(li);
     }
     refreshHoldsView();
+    refreshHistoryView();
 
     // After repopulating, enable/disable Return based on selection presence
     m_returnBtn->setEnabled(m_loansList->currentItem() != nullptr);
@@ -237,7 +424,7 @@ void PatronWindow::onReturnClicked()
         return;
 
     int itemId = cur->data(Qt::UserRole).toInt();
-    auto err = DataStore::instance().returnItem(m_patron, itemId);
+    auto err = StoreClient::instance().returnItem(m_patronId, itemId);
     if (err)
     {
         QMessageBox::warning(this, "Return failed", *err);
@@ -246,37 +433,28 @@ void PatronWindow::onReturnClicked()
     {
         QMessageBox::information(this, "Returned", "Item returned successfully.");
     }
-
-    // Refresh to show updated availability and loan list
-    populateCatalogue();
-    refreshLoansView();
-    onCatalogueSelectionChanged();
+    // views follow via applyChanges()
 }
 
 //when user selects an item for hold
 void PatronWindow::onHoldClicked()
 {
-    auto selected = m_table->selectionModel()->selectedRows();
-    if (selected.isEmpty())
+    int itemId = selectedItemId();
+    if (itemId < 0)
         return;
 
-    int row = selected.first().row();
-    int itemId = m_table->item(row, 0)->text().toInt();
-
-    auto err = DataStore::instance().placeHold(m_patron, itemId); // assumes you added placeHold logic
+    auto err = StoreClient::instance().placeHold(m_patronId, itemId);
     if (err)
     {
         QMessageBox::warning(this, "Hold failed", *err);
     }
     else
     {
-        QMessageBox::information(this, "Hold placed", "You have successfully placed a hold on this item.");
+        int position = StoreClient::instance().holdPosition(m_patronId, itemId);
+        QMessageBox::information(this, "Hold placed",
+                                 QString("You have successfully placed a hold on this item. You are #%1 in the queue.").arg(position));
     }
-
-    // Refresh UI
-    populateCatalogue();
-    refreshLoansView();
-    onCatalogueSelectionChanged();
+    // views follow via applyChanges()
 }
 
 
@@ -285,21 +463,52 @@ void PatronWindow::onHoldClicked()
 void PatronWindow::refreshHoldsView()
 {
     m_holdsList->clear();
-    for (size_t i = 0; i < m_patron.holds.size(); ++i)
+    StoreClient::instance().withUser(m_patronId, [this](const User &u) { m_holdIds.assign(u.holds.begin(), u.holds.end()); });
+    for (const std::optional<Item> &it : StoreClient::instance().findItems(m_holdIds))
     {
-        int id = m_patron.holds[i];
-        const Item *it = DataStore::instance().findItemById(id);
         if (!it) continue;
 
-        int position = i + 1; // queue position is just the index + 1
-        auto *li = new QListWidgetItem(
-            QString("#%1  %2  (position %3)").arg(it->id).arg(it->title).arg(position)
-        );
+        QString text;
+        if (it->status.readyFor == m_patronId)
+        {
+            text = QString("#%1  %2  (ready for pickup until %3)")
+                       .arg(it->id).arg(it->title).arg(it->status.pickupBy->toString("yyyy-MM-dd"));
+        }
+        else
+        {
+            // real place in this item's queue, not the index in our own list
+            int position = StoreClient::instance().holdPosition(m_patronId, it->id);
+            int queued = StoreClient::instance().holdQueueLength(it->id);
+            text = QString("#%1  %2  (position %3 of %4)").arg(it->id).arg(it->title).arg(position).arg(queued);
+        }
+        auto *li = new QListWidgetItem(text);
         li->setData(Qt::UserRole, it->id);
         m_holdsList->addItem(li);
     }
 }
 
+//past and current loans from the circulation history, newest first
+void PatronWindow::refreshHistoryView()
+{
+    m_historyList->clear();
+    const std::vector<CirculationHistory::Loan> loans = StoreClient::instance().patronLoans(m_patronId, 100);
+    std::vector<int> itemIds;
+    for (const CirculationHistory::Loan &loan : loans)
+        itemIds.push_back(loan.itemId);
+    const std::vector<std::optional<Item>> items = StoreClient::instance().findItems(itemIds);
+    for (std::size_t i = 0; i < loans.size(); ++i)
+    {
+        const QString title = items[i] ? items[i]->title : QString("(no longer in the catalogue)");
+        const QString borrowed = QDateTime::fromMSecsSinceEpoch(loans[i].borrowedMs).date().toString("yyyy-MM-dd");
+        const QString returned = loans[i].returnedMs
+            ? "returned " + QDateTime::fromMSecsSinceEpoch(loans[i].returnedMs).date().toString("yyyy-MM-dd")
+            : QString("still out");
+        auto *li = new QListWidgetItem(QString("#%1  %2  (borrowed %3, %4)").arg(loans[i].itemId).arg(title).arg(borrowed).arg(returned));
+        li->setData(Qt::UserRole, loans[i].itemId);
+        m_historyList->addItem(li);
+    }
+}
+
 //ennabligng hhold selection only if item is selected from  hold list
 void PatronWindow::onHoldsSelectionChanged()
 {
@@ -315,7 +524,7 @@ void PatronWindow::onCancelHoldClicked()
 
     int itemId = cur->data(Qt::UserRole).toInt();
 
-    auto err = DataStore::instance().cancelHold(m_patron, itemId);
+    auto err = StoreClient::instance().cancelHold(m_patronId, itemId);
     if (err)
     {
         QMessageBox::warning(this, "Cancel Hold Failed", *err);
@@ -324,9 +533,5 @@ void PatronWindow::onCancelHoldClicked()
     {
         QMessageBox::information(this, "Hold Canceled", "You have successfully canceled your hold on this item.");
     }
-
-    // Refresh UI
-    populateCatalogue();
-    refreshLoansView();
-    onCatalogueSelectionChanged();
+    // views follow via applyChanges()
 }
@@ -1,20 +1,31 @@
 #pragma once
 #include <QDialog>
 #include "models.hpp"
+#include <vector>
 
-class QTableWidget;
+struct ChangeSet;
+struct FacetFilter;
+
+class QTableView;
 class QPushButton;
 class QListWidget;
 class QLabel;
+class QLineEdit;
+class QComboBox;
+class QCheckBox;
+class QTimer;
+class CatalogueModel;
 
 class PatronWindow : public QDialog
 {
     Q_OBJECT
 public:
     explicit PatronWindow(const QString &patronName, QWidget *parent = nullptr);
+    ~PatronWindow() override;
 
 private slots:
-    void populateCatalogue();
+    void onSearchTextChanged();
+    void onFilterChanged();
     void onCatalogueSelectionChanged();
     void onBorrowClicked();
     void onLoansSelectionChanged();
@@ -23,20 +34,47 @@ private slots:
     void onCancelHoldClicked();
     void onHoldsSelectionChanged();
 private:
-    // Working copy of the patron; we upsert after changes
-    User m_patron;
+    // The signed-in patron; their record stays in the DataStore
+    int m_patronId = 0;
+
+    // Item ids of our holds, as last shown (see applyChanges)
+    std::vector<int> m_holdIds;
+
+    // StoreClient change subscription (see applyChanges)
+    int m_subscription = 0;
 
     //UI Widgets
-    QTableWidget *m_table;
+    QLineEdit *m_searchEdit;
+    QComboBox *m_formatBox;
+    QComboBox *m_genreBox;
+    QComboBox *m_ratingBox;
+    QCheckBox *m_availableBox;
+    QLabel *m_matchesLabel;
+    QTimer *m_countsTimer;   // coalesces count refreshes after store changes
+    QTableView *m_table;
+    CatalogueModel *m_model;
     QPushButton *m_borrowBtn;
     QListWidget *m_loansList;
     QLabel *m_selectedLabel;
+    QLabel *m_alsoBorrowedLabel;
     QPushButton *m_returnBtn;
     QPushButton *m_holdBtn;
     QPushButton *m_cancelHoldBtn;
     QListWidget *m_holdsList;
+    QListWidget *m_historyList;
+
+    //item id of the selected catalogue row (-1 if none)
+    int selectedItemId() const;
+
+    //filter controls -> FacetFilter, and their counts from the store
+    FacetFilter currentFilter() const;
+    void refreshFacetCounts();
+
+    //apply a DataStore change set to just the affected rows/lists
+    void applyChanges(const ChangeSet &changes);
 
-    //to update loans and holds for user on  GUI
+    //to update loans, holds and borrowing history for user on  GUI
     void refreshLoansView();
     void refreshHoldsView();
+    void refreshHistoryView();
 };
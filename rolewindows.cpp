@@ -1,18 +1,187 @@
 #include "rolewindows.hpp"
+#include "catalogueimport.hpp"
+#include "circulationreport.hpp"
+#include "datastore.hpp"
+#include "storeclient.hpp"
 #include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFile>
+#include <QFileDialog>
+#include <QHeaderView>
 #include <QLabel>
+#include <QListWidget>
+#include <QMessageBox>
+#include <QProgressDialog>
 #include <QPushButton>
+#include <QTabWidget>
+#include <QTableWidget>
+#include <QTimer>
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+// A terminal connected to a library server keeps only the catalogue in
+// DataStore::instance(): no loans, no clock, no metrics. Staff views read
+// that store, so there they say so instead of showing it as if empty.
+bool showRemoteNotice(QLabel* label, const QString& what)
+{
+    if (!StoreClient::instance().isRemote())
+        return false;
+    label->setText(QString("This terminal is connected to a library server and holds only the catalogue.\n"
+                           "%1 are only available on a terminal running its own store.")
+                       .arg(what));
+    return true;
+}
+} // namespace
 
 LibrarianWindow::LibrarianWindow(const QString& name, QWidget* parent)
     : QDialog(parent)
 {
     setWindowTitle(QString("HinLIBS — Librarian: %1").arg(name));
     auto* lay = new QVBoxLayout(this);
-    lay->addWidget(new QLabel("Librarian interface placeholder for D1.\nClose this window to return to Startup."));
+
+    m_overdueLabel = new QLabel(this);
+    lay->addWidget(m_overdueLabel);
+    m_overdueList = new QListWidget(this);
+    lay->addWidget(m_overdueList, 1);
+    m_dueSoonLabel = new QLabel(this);
+    lay->addWidget(m_dueSoonLabel);
+
+    auto* buttons = new QHBoxLayout();
+    auto* exportBtn = new QPushButton("Export circulation…");
+    buttons->addWidget(exportBtn);
+    auto* importBtn = new QPushButton("Import items…");
+    buttons->addWidget(importBtn);
+    buttons->addStretch();
     auto* closeBtn = new QPushButton("Close");
-    lay->addWidget(closeBtn);
+    buttons->addWidget(closeBtn);
+    lay->addLayout(buttons);
+    connect(exportBtn, &QPushButton::clicked, this, &LibrarianWindow::exportCirculation);
+    connect(importBtn, &QPushButton::clicked, this, &LibrarianWindow::importItems);
     connect(closeBtn, &QPushButton::clicked, this, &QDialog::accept);
-    resize(480, 180);
+    resize(640, 420);
+
+    // Imported items would also land in this terminal's copy, not the served store
+    if (showRemoteNotice(m_overdueLabel, "Overdue and due-soon loans, circulation export and item import"))
+    {
+        exportBtn->setEnabled(false);
+        importBtn->setEnabled(false);
+        return;
+    }
+
+    // Oldest first; later arrivals are due later, so appending keeps the order
+    DataStore& ds = DataStore::instance();
+    for (int id : ds.overdueItems(ds.clockDate()))
+        addOverdueRow(id);
+    refreshCounts();
+
+    m_subscription = ds.subscribe([this](const ChangeSet& changes) { applyChanges(changes); });
+}
+
+LibrarianWindow::~LibrarianWindow()
+{
+    m_importer.reset();   // stops the parsers before the store listener goes
+    if (m_subscription)
+        DataStore::instance().unsubscribe(m_subscription);
+}
+
+void LibrarianWindow::addOverdueRow(int itemId)
+{
+    if (m_overdueRows.count(itemId))
+        return;
+    auto it = DataStore::instance().findItemById(itemId);
+    if (!it || it->status.available || !it->status.dueDate)
+        return;
+
+    QString borrower = QString("patron #%1").arg(it->status.borrower);
+    DataStore::instance().withUser(it->status.borrower, [&](const User& u) { borrower = u.name; });
+    auto* row = new QListWidgetItem(QString("#%1  %2  —  %3  (due %4)")
+                                        .arg(it->id)
+                                        .arg(it->title)
+                                        .arg(borrower)
+                                        .arg(it->status.dueDate->toString("yyyy-MM-dd")));
+    row->setData(Qt::UserRole, it->id);
+    m_overdueList->addItem(row);
+    m_overdueRows.emplace(itemId, row);
+}
+
+void LibrarianWindow::applyChanges(const ChangeSet& changes)
+{
+    bool changed = !changes.overdue.empty() || !changes.dueSoon.empty();
+    for (int id : changes.overdue)
+        addOverdueRow(id);
+
+    // A listed loan that was returned (or renewed) is no longer overdue
+    if (!m_overdueRows.empty())
+    {
+        const QDate today = DataStore::instance().clockDate();
+        for (int id : changes.statusChanged)
+        {
+            auto row = m_overdueRows.find(id);
+            if (row == m_overdueRows.end())
+                continue;
+            auto it = DataStore::instance().findItemById(id);
+            if (it && !it->status.available && it->status.dueDate && *it->status.dueDate < today)
+                continue;
+            delete row->second;
+            m_overdueRows.erase(row);
+        }
+    }
+    if (changed || !changes.statusChanged.empty())
+        refreshCounts();
+}
+
+void LibrarianWindow::refreshCounts()
+{
+    // Both come from the due schedule: cost follows the loans listed, not the catalogue
+    DataStore& ds = DataStore::instance();
+    const QDate today = ds.clockDate();
+    const int dueSoon = (int)ds.dueItems(today, today.addDays(Rules::DueSoonDays + 1)).size();
+    m_overdueLabel->setText(QString("Overdue loans: %1").arg(m_overdueRows.size()));
+    m_dueSoonLabel->setText(QString("Due in the next %1 days: %2").arg(Rules::DueSoonDays).arg(dueSoon));
+}
+
+void LibrarianWindow::exportCirculation()
+{
+    const QString path = QFileDialog::getSaveFileName(this, "Export circulation", "hinlibs-circulation.csv",
+                                                      "CSV files (*.csv);;All files (*)");
+    if (path.isEmpty())
+        return;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        QMessageBox::warning(this, "Export failed", QString("Cannot write %1: %2").arg(path, file.errorString()));
+        return;
+    }
+
+    // One consistent picture of the whole catalogue, read without locks:
+    // the desks keep lending while a large catalogue is written out
+    const std::shared_ptr<const CirculationSnapshot> snap = DataStore::instance().snapshot();
+    const qint32 today = qint32(snap->clockDate().toJulianDay());
+    QByteArray out = "item_id,status,patron_id,date,holds_queued\n";
+    bool ok = true;
+    for (int slot = 0; slot < snap->itemCount() && ok; ++slot)
+    {
+        const int borrower = snap->borrowerAt(slot);
+        const qint32 day = snap->dayAt(slot);
+        const char* status = borrower == 0 ? "available"
+                             : borrower < 0 ? "hold shelf"
+                             : day && day < today ? "overdue" : "on loan";
+        out += QByteArray::number(snap->idAt(slot)) + ',' + status + ',';
+        if (borrower)
+            out += QByteArray::number(std::abs(borrower));
+        out += ',';
+        if (borrower && day)
+            out += QDate::fromJulianDay(day).toString("yyyy-MM-dd").toLatin1();
+        out += ',' + QByteArray::number(snap->queuedAt(slot)) + '\n';
+        if (out.size() >= 1 << 20)
+        {
+            ok = file.write(out) == out.size();
+            out.clear();
+        }
+    }
+    if (!ok || file.write(out) != out.size() || !file.flush())
+        QMessageBox::warning(this, "Export failed", QString("Cannot write %1: %2").arg(path, file.errorString()));
 }
 
 AdminWindow::AdminWindow(const QString& name, QWidget* parent)
@@ -20,9 +189,243 @@ AdminWindow::AdminWindow(const QString& name, QWidget* parent)
 {
     setWindowTitle(QString("HinLIBS — Administrator: %1").arg(name));
     auto* lay = new QVBoxLayout(this);
-    lay->addWidget(new QLabel("Admin interface placeholder for D1.\nClose this window to return to Startup."));
+
+    m_gaugeLabel = new QLabel(this);
+    lay->addWidget(m_gaugeLabel);
+    m_reportLabel = new QLabel(this);
+    lay->addWidget(m_reportLabel);
+    auto* tabs = new QTabWidget(this);
+    lay->addWidget(tabs, 1);
+
+    // One fixed row per operation; rows stay hidden until the operation runs
+    m_opTable = new QTableWidget(StoreMetrics::OpCount, 8, this);
+    m_opTable->setHorizontalHeaderLabels(
+        {"Operation", "Calls", "Calls/s", "Mean µs", "p50 µs", "p95 µs", "p99 µs", "Max µs"});
+    m_opTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_opTable->setSelectionMode(QAbstractItemView::NoSelection);
+    m_opTable->verticalHeader()->setVisible(false);
+    m_opTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    for (int op = 0; op < StoreMetrics::OpCount; ++op)
+    {
+        m_opTable->setItem(op, 0, new QTableWidgetItem(StoreMetrics::opName(StoreMetrics::Op(op))));
+        for (int col = 1; col < 8; ++col)
+        {
+            auto* cell = new QTableWidgetItem();
+            cell->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_opTable->setItem(op, col, cell);
+        }
+        m_opTable->setRowHidden(op, true);
+    }
+    tabs->addTab(m_opTable, "Operations");
+
+    auto table = [this](const QStringList& headers) {
+        auto* t = new QTableWidget(0, headers.size(), this);
+        t->setHorizontalHeaderLabels(headers);
+        t->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        t->setSelectionMode(QAbstractItemView::NoSelection);
+        t->verticalHeader()->setVisible(false);
+        t->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+        return t;
+    };
+    const QStringList countColumns = {"Items", "On loan", "Hold shelf", "Utilization", "Queued holds", "Holds/item"};
+    m_formatTable = table(QStringList{"Format"} + countColumns);
+    m_genreTable = table(QStringList{"Genre"} + countColumns);
+    m_creatorTable = table(QStringList{"Creator"} + countColumns);
+    m_heldTable = table({"Item", "Title", "Patrons waiting"});
+    tabs->addTab(m_formatTable, "By format");
+    tabs->addTab(m_genreTable, "By genre");
+    tabs->addTab(m_creatorTable, "Top creators");
+    tabs->addTab(m_heldTable, "Most held");
+
+    auto* buttons = new QHBoxLayout();
+    auto* exportBtn = new QPushButton("Export…");
+    buttons->addWidget(exportBtn);
+    buttons->addStretch();
     auto* closeBtn = new QPushButton("Close");
-    lay->addWidget(closeBtn);
+    buttons->addWidget(closeBtn);
+    lay->addLayout(buttons);
+    connect(exportBtn, &QPushButton::clicked, this, &AdminWindow::exportSnapshot);
     connect(closeBtn, &QPushButton::clicked, this, &QDialog::accept);
-    resize(480, 180);
+    resize(820, 520);
+
+    if (showRemoteNotice(m_gaugeLabel, "Store metrics and circulation reports"))
+    {
+        tabs->setEnabled(false);
+        exportBtn->setEnabled(false);
+        return;
+    }
+
+    m_reporter = std::make_unique<CirculationReporter>(DataStore::instance());
+    refresh();
+    auto* timer = new QTimer(this);
+    connect(timer, &QTimer::timeout, this, &AdminWindow::refresh);
+    timer->start(1000);
+}
+
+AdminWindow::~AdminWindow() = default;
+
+void AdminWindow::refresh()
+{
+    const StoreMetrics::Snapshot snap = DataStore::instance().metrics();
+    const StoreGauges& g = snap.gauges;
+    QString longest = "none";
+    if (g.longestQueue)
+        longest = QString("%1 (item #%2)").arg(g.longestQueue).arg(g.longestQueueItem);
+    m_gaugeLabel->setText(QString("Items: %1    Patrons: %2    Active loans: %3    On hold shelf: %4\n"
+                                  "Queued holds: %5 on %6 items    Longest queue: %7")
+                              .arg(g.items)
+                              .arg(g.patrons)
+                              .arg(g.activeLoans)
+                              .arg(g.onHoldShelf)
+                              .arg(g.queuedHolds)
+                              .arg(g.itemsWithQueue)
+                              .arg(longest));
+
+    const qint64 elapsedMs = m_hasLast ? snap.takenMs - m_last.takenMs : 0;
+    for (int op = 0; op < StoreMetrics::OpCount; ++op)
+    {
+        const StoreMetrics::OpStats& s = snap.ops[op];
+        if (!s.calls)
+            continue;
+        QString rate = "—";
+        if (elapsedMs > 0)
+            rate = QString::number(double(s.calls - m_last.ops[op].calls) * 1000.0 / double(elapsedMs), 'f', 1);
+        m_opTable->setRowHidden(op, false);
+        m_opTable->item(op, 1)->setText(QString::number(s.calls));
+        m_opTable->item(op, 2)->setText(rate);
+        m_opTable->item(op, 3)->setText(QString::number(s.meanUs(), 'f', 2));
+        m_opTable->item(op, 4)->setText(QString::number(s.percentileUs(0.50), 'f', 2));
+        m_opTable->item(op, 5)->setText(QString::number(s.percentileUs(0.95), 'f', 2));
+        m_opTable->item(op, 6)->setText(QString::number(s.percentileUs(0.99), 'f', 2));
+        m_opTable->item(op, 7)->setText(QString::number(double(s.maxNs) / 1000.0, 'f', 2));
+    }
+    m_last = snap;
+    m_hasLast = true;
+    refreshReport();
+}
+
+void AdminWindow::refreshReport()
+{
+    const CirculationReport& r = m_reporter->refresh();
+    if (r.version == m_reportVersion && m_formatTable->rowCount())
+        return;
+    m_reportVersion = r.version;
+
+    QString queues;
+    for (int b = 0; b < CirculationReport::QueueBuckets; ++b)
+        queues += QString("   %1: %2").arg(CirculationReport::queueBucketName(b)).arg(r.queueLengths[b]);
+    m_reportLabel->setText(QString("Utilization: %1%    Holds per item: %2    Items by patrons waiting:%3")
+                               .arg(r.total.utilization() * 100.0, 0, 'f', 1)
+                               .arg(r.total.holdPressure(), 0, 'f', 3)
+                               .arg(queues));
+
+    auto cell = [](QTableWidget* t, int row, int col, const QString& text, bool number = true) {
+        auto* item = new QTableWidgetItem(text);
+        if (number)
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        t->setItem(row, col, item);
+    };
+    auto fill = [&cell](QTableWidget* t, const std::vector<std::pair<QString, CirculationReport::Counts>>& rows) {
+        t->setRowCount((int)rows.size());
+        for (int row = 0; row < (int)rows.size(); ++row)
+        {
+            const CirculationReport::Counts& c = rows[row].second;
+            cell(t, row, 0, rows[row].first, false);
+            cell(t, row, 1, QString::number(c.items));
+            cell(t, row, 2, QString::number(c.onLoan));
+            cell(t, row, 3, QString::number(c.onHoldShelf));
+            cell(t, row, 4, QString::number(c.utilization() * 100.0, 'f', 1) + "%");
+            cell(t, row, 5, QString::number(c.queuedHolds));
+            cell(t, row, 6, QString::number(c.holdPressure(), 'f', 3));
+        }
+    };
+    std::vector<std::pair<QString, CirculationReport::Counts>> formats{{"All items", r.total}};
+    for (int f = 0; f < FacetCounts::FormatCount; ++f)
+        formats.emplace_back(formatToString(ItemFormat(f)), r.formats[f]);
+    fill(m_formatTable, formats);
+    fill(m_genreTable, r.genres);
+    fill(m_creatorTable, r.creators);
+
+    m_heldTable->setRowCount((int)r.mostHeld.size());
+    for (int row = 0; row < (int)r.mostHeld.size(); ++row)
+    {
+        cell(m_heldTable, row, 0, QString("#%1").arg(r.mostHeld[row].itemId));
+        cell(m_heldTable, row, 1, r.mostHeld[row].title, false);
+        cell(m_heldTable, row, 2, QString::number(r.mostHeld[row].queued));
+    }
+}
+
+void AdminWindow::exportSnapshot()
+{
+    const QString path = QFileDialog::getSaveFileName(this, "Export metrics", "hinlibs-metrics.txt",
+                                                      "Text files (*.txt);;All files (*)");
+    if (path.isEmpty())
+        return;
+    QFile file(path);
+    const QByteArray text = (DataStore::instance().metrics().toText() + "\n" + m_reporter->refresh().toText()).toUtf8();
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text) || file.write(text) != text.size())
+        QMessageBox::warning(this, "Export failed", QString("Cannot write %1: %2").arg(path, file.errorString()));
+}
+
+void LibrarianWindow::importItems()
+{
+    if (m_importer)
+        return;
+    const QString path = QFileDialog::getOpenFileName(this, "Import items", QString(),
+                                                      "CSV files (*.csv);;All files (*)");
+    if (path.isEmpty())
+        return;
+    m_importer = std::make_unique<CatalogueImporter>(DataStore::instance());
+    if (auto err = m_importer->start(path))
+    {
+        m_importer.reset();
+        QMessageBox::warning(this, "Import failed", *err);
+        return;
+    }
+
+    // Parsing runs on the importer's threads; inserting runs here, a batch
+    // per tick, so the store's listeners (this window's included) stay on
+    // the GUI thread and the dialog keeps repainting
+    m_importProgress = new QProgressDialog("Importing items…", "Cancel", 0, 1000, this);
+    m_importProgress->setWindowModality(Qt::WindowModal);
+    m_importProgress->setMinimumDuration(0);
+    connect(m_importProgress, &QProgressDialog::canceled, this, [this] { m_importer->cancel(); });
+    m_importTimer = new QTimer(this);
+    connect(m_importTimer, &QTimer::timeout, this, &LibrarianWindow::importStep);
+    m_importTimer->start(50);
+}
+
+void LibrarianWindow::importStep()
+{
+    const bool more = m_importer->insertReady();
+    const CatalogueImporter::Progress p = m_importer->progress();
+    if (more)
+    {
+        m_importProgress->setLabelText(p.indexing ? QString("Indexing %1 new items…").arg(p.imported)
+                                                  : QString("%1 items imported, %2 rejected")
+                                                        .arg(p.imported)
+                                                        .arg(p.rejected));
+        if (p.totalBytes > 0)
+            m_importProgress->setValue(int(p.bytesDone * 1000 / p.totalBytes));
+        return;
+    }
+
+    m_importTimer->stop();
+    m_importTimer->deleteLater();
+    m_importTimer = nullptr;
+    m_importProgress->deleteLater();
+    m_importProgress = nullptr;
+
+    QString summary = QString("%1 items imported, %2 rows rejected%3.")
+                          .arg(p.imported)
+                          .arg(p.rejected)
+                          .arg(p.finished ? "" : " (cancelled; the items imported so far stay)");
+    const std::vector<CatalogueImporter::Problem>& problems = m_importer->problems();
+    const int shown = std::min<int>((int)problems.size(), 20);
+    for (int i = 0; i < shown; ++i)
+        summary += QString("\nLine %1: %2").arg(problems[i].line).arg(problems[i].message);
+    if (p.rejected > shown)
+        summary += QString("\n… and %1 more.").arg(p.rejected - shown);
+    m_importer.reset();
+    QMessageBox::information(this, "Import items", summary);
 }
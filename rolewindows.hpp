@@ -1,17 +1,79 @@
 #pragma once
+#include "storemetrics.hpp"
 #include <QDialog>
 #include <QString>
+#include <memory>
+#include <unordered_map>
 
-// Simple placeholder windows for Librarian/Admin so the startup form
-// "displays the appropriate interface"
+struct ChangeSet;
+struct CirculationReport;
+class CatalogueImporter;
+class CirculationReporter;
+
+class QLabel;
+class QListWidget;
+class QListWidgetItem;
+class QProgressDialog;
+class QTableWidget;
+class QTimer;
+
+// Librarian desk: the loans that are overdue right now. Filled once from
+// DataStore's due schedule, then kept current from change notifications
+// (newly overdue loans, returns) without rescanning the catalogue.
+// "Export circulation…" writes every item's state from one snapshot;
+// "Import items…" loads a CSV of acquisitions with CatalogueImporter.
+// On a terminal connected to a library server it shows a notice instead.
 class LibrarianWindow : public QDialog {
     Q_OBJECT
 public:
     explicit LibrarianWindow(const QString& name, QWidget* parent = nullptr);
+    ~LibrarianWindow() override;
+
+private:
+    void addOverdueRow(int itemId);
+    void applyChanges(const ChangeSet& changes);
+    void refreshCounts();
+    void exportCirculation();
+    void importItems();
+    void importStep();
+
+    int m_subscription = 0;
+    std::unique_ptr<CatalogueImporter> m_importer;
+    QProgressDialog* m_importProgress = nullptr;
+    QTimer* m_importTimer = nullptr;
+    QLabel* m_overdueLabel;
+    QLabel* m_dueSoonLabel;
+    QListWidget* m_overdueList;
+    std::unordered_map<int, QListWidgetItem*> m_overdueRows;   // item id -> row
 };
 
+// Administrator: live DataStore metrics. Polls DataStore::metrics() once a
+// second; rates are the change in call counts since the previous poll.
+// The circulation tabs (by format, genre, creator; most-held items) come
+// from a CirculationReporter refreshed on the same tick, which recounts
+// only what changed since the last one. On a terminal connected to a
+// library server it shows a notice instead.
 class AdminWindow : public QDialog {
     Q_OBJECT
 public:
     explicit AdminWindow(const QString& name, QWidget* parent = nullptr);
+    ~AdminWindow() override;
+
+private:
+    void refresh();
+    void refreshReport();
+    void exportSnapshot();
+
+    QLabel* m_gaugeLabel;
+    QTableWidget* m_opTable;
+    StoreMetrics::Snapshot m_last;
+    bool m_hasLast = false;
+
+    std::unique_ptr<CirculationReporter> m_reporter;
+    QLabel* m_reportLabel;
+    QTableWidget* m_formatTable;
+    QTableWidget* m_genreTable;
+    QTableWidget* m_creatorTable;
+    QTableWidget* m_heldTable;
+    quint64 m_reportVersion = 0;   // shown in the tables
 };
@@ -0,0 +1,310 @@
+#include "searchindex.hpp"
+#include <algorithm>
+#include <functional>
+
+namespace {
+constexpr float TitleWeight = 2.0f;
+constexpr float CreatorWeight = 1.0f;
+constexpr float ExactMatch = 1.0f;
+constexpr float PrefixMatch = 0.8f;
+constexpr float FuzzyMatch = 0.5f;
+constexpr std::size_t MaxPrefixTerms = 256;   // bounds work for short prefixes
+constexpr std::size_t MaxFuzzyTerms = 32;
+
+quint64 trigramKey(const QString &term, int i)
+{
+    return (quint64(term.at(i).unicode()) << 32) | (quint64(term.at(i + 1).unicode()) << 16)
+         | quint64(term.at(i + 2).unicode());
+}
+
+// Edit distance counting adjacent transpositions as one edit (optimal
+// string alignment), giving up once it must exceed maxDistance
+int boundedDistance(const QString &a, const QString &b, int maxDistance)
+{
+    const int n = a.size(), m = b.size();
+    if (std::abs(n - m) > maxDistance)
+        return maxDistance + 1;
+    std::vector<int> before(m + 1), prev(m + 1), cur(m + 1);
+    for (int j = 0; j <= m; ++j)
+        prev[j] = j;
+    for (int i = 1; i <= n; ++i)
+    {
+        cur[0] = i;
+        int rowMin = cur[0];
+        for (int j = 1; j <= m; ++j)
+        {
+            const int subst = prev[j - 1] + (a.at(i - 1) == b.at(j - 1) ? 0 : 1);
+            cur[j] = std::min({prev[j] + 1, cur[j - 1] + 1, subst});
+            if (i > 1 && j > 1 && a.at(i - 1) == b.at(j - 2) && a.at(i - 2) == b.at(j - 1))
+                cur[j] = std::min(cur[j], before[j - 2] + 1);
+            rowMin = std::min(rowMin, cur[j]);
+        }
+        if (rowMin > maxDistance)
+            return maxDistance + 1;
+        std::swap(before, prev);
+        std::swap(prev, cur);
+    }
+    return prev[m];
+}
+
+// Advance pos to the first entry >= slot, galloping from the current
+// position; returns whether slot is present
+bool seek(const std::vector<int> &list, std::size_t &pos, int slot)
+{
+    std::size_t step = 1, hi = pos;
+    while (hi < list.size() && list[hi] < slot)
+    {
+        pos = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    pos = std::lower_bound(list.begin() + pos, list.begin() + std::min(hi, list.size()), slot) - list.begin();
+    return pos < list.size() && list[pos] == slot;
+}
+} // namespace
+
+std::vector<QString> SearchIndex::tokenize(const QString &text)
+{
+    const QString decomposed = text.normalized(QString::NormalizationForm_KD);
+    std::vector<QString> tokens;
+    QString current;
+    for (const QChar c : decomposed)
+    {
+        if (c.isMark())
+            continue; // accents left over from decomposition
+        if (c.isLetterOrNumber())
+        {
+            current.append(c.toCaseFolded());
+        }
+        else if (!current.isEmpty())
+        {
+            tokens.push_back(current);
+            current.clear();
+        }
+    }
+    if (!current.isEmpty())
+        tokens.push_back(current);
+    return tokens;
+}
+
+int SearchIndex::termId(const QString &term)
+{
+    auto found = m_dictionary.find(term);
+    if (found != m_dictionary.end())
+        return found->second;
+
+    const int id = (int)m_termText.size();
+    m_dictionary.emplace(term, id);
+    m_termText.push_back(term);
+    m_postings.emplace_back();
+    for (int i = 0; i + 3 <= term.size(); ++i)
+        m_trigrams[trigramKey(term, i)].push_back(id);
+    return id;
+}
+
+void SearchIndex::add(int slot, const QString &title, const QString &creator)
+{
+    // A word in both fields is indexed once, as a title hit
+    std::vector<int> titleTerms, creatorTerms;
+    for (const QString &t : tokenize(title))
+        titleTerms.push_back(termId(t));
+    for (const QString &t : tokenize(creator))
+        creatorTerms.push_back(termId(t));
+    std::sort(titleTerms.begin(), titleTerms.end());
+    titleTerms.erase(std::unique(titleTerms.begin(), titleTerms.end()), titleTerms.end());
+    std::sort(creatorTerms.begin(), creatorTerms.end());
+    creatorTerms.erase(std::unique(creatorTerms.begin(), creatorTerms.end()), creatorTerms.end());
+
+    for (int t : titleTerms)
+        m_postings[t].title.push_back(slot);
+    for (int t : creatorTerms)
+        if (!std::binary_search(titleTerms.begin(), titleTerms.end(), t))
+            m_postings[t].creator.push_back(slot);
+}
+
+std::vector<SearchIndex::Expansion> SearchIndex::expand(const QString &word, bool prefix) const
+{
+    std::vector<Expansion> out;
+    auto exact = m_dictionary.find(word);
+    if (exact != m_dictionary.end())
+        out.push_back({exact->second, ExactMatch});
+
+    if (prefix)
+    {
+        for (auto it = m_dictionary.upper_bound(word);
+             it != m_dictionary.end() && it->first.startsWith(word) && out.size() < MaxPrefixTerms; ++it)
+            out.push_back({it->second, PrefixMatch});
+    }
+
+    // Typo tolerance: only when the word is not a known term
+    if (exact == m_dictionary.end() && word.size() >= 4)
+    {
+        const int maxDistance = word.size() >= 8 ? 2 : 1;
+        std::unordered_map<int, int> shared;
+        for (int i = 0; i + 3 <= word.size(); ++i)
+        {
+            auto found = m_trigrams.find(trigramKey(word, i));
+            if (found != m_trigrams.end())
+                for (int t : found->second)
+                    ++shared[t];
+        }
+        // Each edit destroys at most 4 trigrams (a transposition)
+        const int needed = std::max(1, (word.size() - 2) - 4 * maxDistance);
+        std::size_t fuzzy = 0;
+        for (const auto &[t, count] : shared)
+        {
+            if (count < needed || fuzzy >= MaxFuzzyTerms)
+                continue;
+            if (boundedDistance(word, m_termText[t], maxDistance) <= maxDistance)
+            {
+                out.push_back({t, FuzzyMatch});
+                ++fuzzy;
+            }
+        }
+    }
+    return out;
+}
+
+std::vector<SearchIndex::Hit> SearchIndex::search(const QString &query, int limit) const
+{
+    const std::vector<QString> words = tokenize(query);
+    if (words.empty() || limit <= 0)
+        return {};
+
+    std::vector<std::vector<Expansion>> perWord;
+    std::size_t driver = 0, driverCost = SIZE_MAX;
+    for (std::size_t w = 0; w < words.size(); ++w)
+    {
+        perWord.push_back(expand(words[w], w + 1 == words.size()));
+        if (perWord.back().empty())
+            return {}; // a word nothing matches: AND can't succeed
+
+        std::size_t cost = 0;
+        for (const Expansion &e : perWord.back())
+            cost += m_postings[e.term].title.size() + m_postings[e.term].creator.size();
+        if (cost < driverCost)
+        {
+            driverCost = cost;
+            driver = w;
+        }
+    }
+
+    // Candidates come from the rarest word's lists, merged into slot order
+    // one weight level at a time, best level first. The other words are
+    // probed with forward-only cursors, reset per level.
+    struct List {
+        const std::vector<int> *slots;
+        float weight;
+        std::size_t pos;
+    };
+    std::vector<std::vector<List>> probes(perWord.size());
+    std::vector<List> lists;
+    for (std::size_t w = 0; w < perWord.size(); ++w)
+    {
+        for (const Expansion &e : perWord[w])
+        {
+            auto &into = w == driver ? lists : probes[w];
+            into.push_back({&m_postings[e.term].title, e.weight * TitleWeight, 0});
+            into.push_back({&m_postings[e.term].creator, e.weight * CreatorWeight, 0});
+        }
+    }
+    std::stable_sort(lists.begin(), lists.end(), [](const List &a, const List &b) { return a.weight > b.weight; });
+
+    // Best score the other words can still add to a candidate
+    float restMax = 0.0f;
+    for (const auto &word : probes)
+    {
+        float best = 0.0f;
+        for (const List &p : word)
+            if (!p.slots->empty())
+                best = std::max(best, p.weight);
+        restMax += best;
+    }
+
+    auto better = [](const Hit &a, const Hit &b) { return a.score != b.score ? a.score > b.score : a.slot < b.slot; };
+    std::vector<Hit> top;                 // heap, worst hit at front
+    std::vector<std::vector<int>> done;   // slots scored by earlier levels, ascending
+    using Head = std::pair<int, std::size_t>; // (slot, list index), min-heap on slot
+    std::vector<Head> heads;
+    for (std::size_t first = 0; first < lists.size();)
+    {
+        std::size_t last = first;
+        while (last < lists.size() && lists[last].weight == lists[first].weight)
+            ++last;
+        const float bound = lists[first].weight + restMax;
+
+        heads.clear();
+        for (std::size_t i = first; i < last; ++i)
+            if (!lists[i].slots->empty())
+                heads.push_back({lists[i].slots->front(), i});
+        std::make_heap(heads.begin(), heads.end(), std::greater<Head>());
+        for (auto &word : probes)
+            for (List &p : word)
+                p.pos = 0;
+
+        std::vector<int> scored;
+        int previous = -1;
+        while (!heads.empty())
+        {
+            std::pop_heap(heads.begin(), heads.end(), std::greater<Head>());
+            const auto [slot, i] = heads.back();
+            heads.pop_back();
+            List &list = lists[i];
+            if (++list.pos < list.slots->size())
+            {
+                heads.push_back({(*list.slots)[list.pos], i});
+                std::push_heap(heads.begin(), heads.end(), std::greater<Head>());
+            }
+
+            if ((int)top.size() == limit)
+            {
+                // Slots only grow within a level, so nothing later here can win
+                const Hit &worst = top.front();
+                if (bound < worst.score || (bound == worst.score && slot > worst.slot))
+                    break;
+            }
+            // Same slot from two terms of this level, or already scored
+            // at a better weight by an earlier level
+            if (slot == previous)
+                continue;
+            previous = slot;
+            bool earlier = false;
+            for (const auto &d : done)
+                earlier = earlier || std::binary_search(d.begin(), d.end(), slot);
+            if (earlier)
+                continue;
+            scored.push_back(slot);
+
+            Hit h{slot, lists[first].weight};
+            bool all = true;
+            for (std::size_t w = 0; w < probes.size() && all; ++w)
+            {
+                if (w == driver)
+                    continue;
+                float best = 0.0f;
+                for (List &p : probes[w])
+                    if (seek(*p.slots, p.pos, slot))
+                        best = std::max(best, p.weight);
+                all = best > 0.0f;
+                h.score += best;
+            }
+            if (!all)
+                continue;
+            if ((int)top.size() < limit)
+            {
+                top.push_back(h);
+                std::push_heap(top.begin(), top.end(), better);
+            }
+            else if (better(h, top.front()))
+            {
+                std::pop_heap(top.begin(), top.end(), better);
+                top.back() = h;
+                std::push_heap(top.begin(), top.end(), better);
+            }
+        }
+        done.push_back(std::move(scored));
+        first = last;
+    }
+    std::sort(top.begin(), top.end(), better);
+    return top;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "models.hpp"
+#include <QString>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// ---------------------------------------------
+// SearchIndex: inverted index over item titles and creators
+// ---------------------------------------------
+// Text is folded (NFKD, combining marks dropped, case-folded) and split
+// on anything that is not a letter or digit. Each term keeps title and
+// creator posting lists of catalogue slots in ascending order, so
+// appending new items keeps lists sorted and indexing is incremental. The
+// term dictionary is ordered for prefix scans, and a trigram -> term
+// table finds near-miss spellings. Queries AND their words together; the
+// last word also matches as a prefix.
+//
+// search() walks the rarest word's lists best-weight first and stops as
+// soon as no remaining posting can beat the current top `limit`, so a
+// common word does not cost a full scan of its list.
+class SearchIndex
+{
+public:
+    struct Hit {
+        int slot;
+        float score;
+    };
+
+    //Index one item; slots must be added in increasing order
+    void add(int slot, const QString &title, const QString &creator);
+
+    //Best `limit` matches, highest score first (ties: lower slot first)
+    std::vector<Hit> search(const QString &query, int limit) const;
+
+    //Fold and split text the way the index does
+    static std::vector<QString> tokenize(const QString &text);
+
+private:
+    // One matching term for a query word, with the weight of that match
+    struct Expansion {
+        int term;
+        float weight;
+    };
+
+    int termId(const QString &term);
+    std::vector<Expansion> expand(const QString &word, bool prefix) const;
+
+    struct Postings {
+        std::vector<int> title, creator;   // ascending slots
+    };
+
+    std::vector<Postings> m_postings;                 // term id -> postings
+    std::vector<QString> m_termText;                  // term id -> term
+    std::map<QString, int> m_dictionary;              // term -> term id, ordered
+    std::unordered_map<quint64, std::vector<int>> m_trigrams;
+};
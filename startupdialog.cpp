@@ -2,6 +2,7 @@
 #include "datastore.hpp"
 #include "patronwindow.hpp"
 #include "rolewindows.hpp"
+#include "storeclient.hpp"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -36,16 +37,25 @@ void StartupDialog::handleEnter() {
         QMessageBox::warning(this, "Missing name", "Please enter a name.");
         return;
     }
-    auto u = DataStore::instance().findUser(name);
-    if (!u) {
+    UserType type = UserType::Patron;
+    StoreClient &store = StoreClient::instance();
+    const int id = store.findUserId(name);
+    if (!store.withUser(id, [&](const User &u) { type = u.type; })) {
         QMessageBox::warning(this, "Not found", "No user with that name exists in this demo.");
         return;
     }
+    // Staff windows read the store directly, so they need the store in this process
+    if (type != UserType::Patron && store.isRemote()) {
+        QMessageBox::warning(this, "Not available here",
+                             "This terminal is connected to a library server; staff windows are only available "
+                             "on a terminal running its own store.");
+        return;
+    }
 
-    switch (u->type) {
-        case UserType::Patron:    openPatronUI(u->name); break;
-        case UserType::Librarian: openLibrarianUI(u->name); break;
-        case UserType::Admin:     openAdminUI(u->name); break;
+    switch (type) {
+        case UserType::Patron:    openPatronUI(name); break;
+        case UserType::Librarian: openLibrarianUI(name); break;
+        case UserType::Admin:     openAdminUI(name); break;
     }
 }
 
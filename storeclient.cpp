@@ -0,0 +1,556 @@
+#include "storeclient.hpp"
+#include <QElapsedTimer>
+#include <QLocalSocket>
+#include <algorithm>
+#include <limits>
+
+using namespace StoreProtocol;
+
+StoreClient &StoreClient::instance()
+{
+    static StoreClient client(DataStore::instance());
+    return client;
+}
+
+StoreClient::StoreClient(DataStore &local, QObject *parent)
+    : QObject(parent)
+    , m_local(local)
+{
+    m_localSubscription = m_local.subscribe([this](const ChangeSet &changes) { publish(changes); });
+}
+
+StoreClient::~StoreClient()
+{
+    disconnectFromServer();
+    if (m_localSubscription)
+        m_local.unsubscribe(m_localSubscription);
+}
+
+std::optional<QString> StoreClient::connectToServer(const QString &name, int timeoutMs)
+{
+    if (m_remote)
+        return QString("Already connected to a library server.");
+    m_socket = new QLocalSocket(this);
+    m_socket->connectToServer(name);
+    if (!m_socket->waitForConnected(timeoutMs))
+    {
+        const QString why = QString("Cannot reach the library server \"%1\": %2").arg(name, m_socket->errorString());
+        lose(why);
+        return why;
+    }
+    connect(m_socket, &QLocalSocket::readyRead, this, &StoreClient::receive);
+    connect(m_socket, &QLocalSocket::disconnected, this,
+            [this] { lose("The library server closed the connection."); });
+
+    ByteWriter hello;
+    hello.putSVarint(Version);
+    const quint32 helloTag = send(Request::Hello, hello);
+    const quint32 subscribeTag = send(Request::Subscribe, ByteWriter());
+    Reply reply = await(helloTag);
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    if (reply.code != StoreProtocol::Reply::Ok)
+    {
+        const QString why = in.string();
+        lose(why);
+        return why;
+    }
+    in.varint();   // the version, already checked by the server
+    const int serverItems = int(in.varint());
+    const quint64 serverFingerprint = in.u64();
+    if (serverItems != m_local.itemCount())
+    {
+        const QString why = QString("The library server has %1 catalogue items but this terminal has %2; "
+                                    "both must open the same catalogue.")
+                                .arg(serverItems)
+                                .arg(m_local.itemCount());
+        lose(why);
+        return why;
+    }
+    if (!in.ok() || serverFingerprint != m_local.catalogueFingerprint())
+    {
+        const QString why("The library server's catalogue items differ from this terminal's; "
+                          "both must open the same catalogue.");
+        lose(why);
+        return why;
+    }
+    if (await(subscribeTag).code != StoreProtocol::Reply::Ok)
+    {
+        lose(m_lostReason.isEmpty() ? QString("The library server refused change notifications.") : m_lostReason);
+        return m_lostReason;
+    }
+
+    // From here on the local store only supplies catalogue metadata
+    m_remote = true;
+    m_local.unsubscribe(m_localSubscription);
+    m_localSubscription = 0;
+    return std::nullopt;
+}
+
+void StoreClient::disconnectFromServer()
+{
+    if (m_socket)
+        lose("Disconnected from the library server.");
+}
+
+void StoreClient::lose(const QString &why)
+{
+    if (!m_socket)
+        return;
+    QLocalSocket *socket = m_socket;
+    m_socket = nullptr;
+    m_lostReason = why;
+    disconnect(socket, nullptr, this, nullptr);
+    socket->abort();
+    socket->deleteLater();
+    m_out.clear();
+    m_in.clear();
+    m_statuses.clear();
+}
+
+quint32 StoreClient::send(Request request, const ByteWriter &args)
+{
+    const quint32 tag = m_nextTag++;
+    if (!m_nextTag)
+        m_nextTag = 1;   // 0 marks pushed frames
+    const std::size_t start = beginFrame(m_out, tag, quint8(request));
+    m_out.putBytes(args.data(), args.size());
+    endFrame(m_out, start);
+    return tag;
+}
+
+StoreClient::Reply StoreClient::await(quint32 tag)
+{
+    if (m_socket && m_out.size())
+    {
+        m_socket->write(m_out.data(), qint64(m_out.size()));
+        m_out.clear();
+    }
+
+    QElapsedTimer waited;
+    waited.start();
+    for (;;)
+    {
+        receive();
+        auto found = m_replies.find(tag);
+        if (found != m_replies.end())
+        {
+            Reply reply = std::move(found->second);
+            m_replies.erase(found);
+            return reply;
+        }
+        if (!m_socket)
+        {
+            Reply lost;
+            ByteWriter message;
+            message.putString(m_lostReason);
+            lost.payload.assign(message.data(), message.data() + message.size());
+            return lost;
+        }
+        const qint64 left = ReplyTimeoutMs - waited.elapsed();
+        if (left <= 0)
+            lose("The library server did not answer in time.");
+        else if (!m_socket->waitForReadyRead(int(left)) && m_socket && m_socket->state() != QLocalSocket::ConnectedState)
+            lose("Lost the connection to the library server.");
+    }
+}
+
+void StoreClient::receive()
+{
+    if (!m_socket)
+        return;
+    const qint64 available = m_socket->bytesAvailable();
+    if (available > 0)
+    {
+        const std::size_t old = m_in.size();
+        m_in.resize(old + std::size_t(available));
+        const qint64 got = m_socket->read(m_in.data() + old, available);
+        m_in.resize(old + std::size_t(std::max<qint64>(got, 0)));
+    }
+
+    std::size_t used = 0;
+    Frame frame;
+    Parse parsed;
+    while ((parsed = parseFrame(m_in.data() + used, m_in.size() - used, frame)) == Parse::Complete)
+    {
+        used += frame.frameSize;
+        if (frame.tag != 0)
+        {
+            Reply &reply = m_replies[frame.tag];
+            reply.code = StoreProtocol::Reply(frame.code);
+            reply.payload.assign(frame.payload, frame.payload + frame.payloadSize);
+            continue;
+        }
+        ByteReader in(frame.payload, frame.payloadSize);
+        ChangeSet changes = readChanges(in);
+        if (frame.code != quint8(StoreProtocol::Reply::Changes) || !in.ok())
+            continue;
+        // Forget stale statuses now, so calls made before the listeners
+        // run already see the change
+        for (const std::vector<int> *ids : {&changes.statusChanged, &changes.readyForPickup, &changes.pickupExpired})
+            for (int id : *ids)
+                m_statuses.erase(id);
+        if (m_pendingChanges.empty())
+            QMetaObject::invokeMethod(this, &StoreClient::deliverChanges, Qt::QueuedConnection);
+        m_pendingChanges.push_back(std::move(changes));
+    }
+    m_in.erase(m_in.begin(), m_in.begin() + std::ptrdiff_t(used));
+    if (parsed == Parse::TooLarge)
+        lose("The library server sent a malformed reply.");
+}
+
+void StoreClient::deliverChanges()
+{
+    // Listeners may call back into the client, which can queue more changes
+    const std::vector<ChangeSet> changes = std::move(m_pendingChanges);
+    m_pendingChanges.clear();
+    for (const ChangeSet &c : changes)
+    {
+        if (!c.itemsAdded.empty())
+            adoptItems(c.itemsAdded);
+        publish(c);
+    }
+}
+
+void StoreClient::adoptItems(const std::vector<int> &ids)
+{
+    std::vector<int> missing;
+    for (int id : ids)
+        if (m_local.itemSlot(id) < 0)
+            missing.push_back(id);
+    if (missing.empty())
+        return;
+
+    // A bulk import can add hundreds of thousands: fetch them a batch at a
+    // time rather than queue every request at once
+    std::vector<Item> items;
+    items.reserve(missing.size());
+    for (std::size_t from = 0; from < missing.size(); from += AdoptBatch)
+    {
+        const std::size_t to = std::min(missing.size(), from + AdoptBatch);
+        for (std::optional<Item> &item : findItems(std::vector<int>(missing.begin() + std::ptrdiff_t(from),
+                                                                    missing.begin() + std::ptrdiff_t(to))))
+        {
+            if (!item)
+            {
+                lose("Cannot read the items the library server added.");
+                return;
+            }
+            item->status = ItemStatus();   // circulation state stays on the server
+            items.push_back(std::move(*item));
+        }
+    }
+    for (const std::optional<QString> &err : m_local.addItems(std::move(items)))
+    {
+        if (err)
+        {
+            lose(QString("Cannot add an item the library server added: %1").arg(*err));
+            return;
+        }
+    }
+}
+
+void StoreClient::publish(const ChangeSet &changes)
+{
+    const auto listeners = m_listeners;
+    for (const auto &l : listeners)
+        l.second(changes);
+}
+
+int StoreClient::subscribe(ChangeListener listener)
+{
+    const int token = m_nextToken++;
+    m_listeners.emplace_back(token, std::move(listener));
+    return token;
+}
+
+void StoreClient::unsubscribe(int token)
+{
+    m_listeners.erase(std::remove_if(m_listeners.begin(), m_listeners.end(),
+                                     [token](const auto &l) { return l.first == token; }),
+                      m_listeners.end());
+}
+
+std::optional<QString> StoreClient::circulate(Request request, int patronId, int itemId)
+{
+    ByteWriter args;
+    args.putSVarint(patronId);
+    args.putSVarint(itemId);
+    const Reply reply = call(request, args);
+    if (reply.code == StoreProtocol::Reply::Ok)
+        return std::nullopt;
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    return in.string();
+}
+
+bool StoreClient::fetchUser(int id, User &user)
+{
+    ByteWriter args;
+    args.putSVarint(id);
+    const Reply reply = call(Request::ReadUser, args);
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    if (reply.code != StoreProtocol::Reply::Ok || !in.u8())
+        return false;
+    user = readUser(in);
+    return in.ok();
+}
+
+int StoreClient::findUserId(const QString &name)
+{
+    if (!m_remote)
+        return m_local.findUserId(name);
+    ByteWriter args;
+    args.putString(name);
+    const Reply reply = call(Request::FindUser, args);
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    return reply.code == StoreProtocol::Reply::Ok ? int(in.svarint()) : 0;
+}
+
+std::optional<Item> StoreClient::findItemById(int id)
+{
+    if (!m_remote)
+        return m_local.findItemById(id);
+    return findItems({id}).front();
+}
+
+std::vector<std::optional<Item>> StoreClient::findItems(const std::vector<int> &ids)
+{
+    std::vector<std::optional<Item>> items;
+    items.reserve(ids.size());
+    if (!m_remote)
+    {
+        for (int id : ids)
+            items.push_back(m_local.findItemById(id));
+        return items;
+    }
+
+    std::vector<quint32> tags;
+    tags.reserve(ids.size());
+    for (int id : ids)
+    {
+        ByteWriter args;
+        args.putSVarint(id);
+        tags.push_back(send(Request::FindItem, args));
+    }
+    for (quint32 tag : tags)
+    {
+        const Reply reply = await(tag);
+        ByteReader in(reply.payload.data(), reply.payload.size());
+        std::optional<Item> item;
+        if (reply.code == StoreProtocol::Reply::Ok && in.u8())
+        {
+            item = readItem(in);
+            if (!in.ok())
+                item.reset();
+        }
+        items.push_back(std::move(item));
+    }
+    return items;
+}
+
+std::optional<QString> StoreClient::borrowItem(int patronId, int itemId)
+{
+    return m_remote ? circulate(Request::Borrow, patronId, itemId) : m_local.borrowItem(patronId, itemId);
+}
+
+std::optional<QString> StoreClient::returnItem(int patronId, int itemId)
+{
+    return m_remote ? circulate(Request::Return, patronId, itemId) : m_local.returnItem(patronId, itemId);
+}
+
+std::optional<QString> StoreClient::placeHold(int patronId, int itemId)
+{
+    return m_remote ? circulate(Request::PlaceHold, patronId, itemId) : m_local.placeHold(patronId, itemId);
+}
+
+std::optional<QString> StoreClient::cancelHold(int patronId, int itemId)
+{
+    return m_remote ? circulate(Request::CancelHold, patronId, itemId) : m_local.cancelHold(patronId, itemId);
+}
+
+int StoreClient::holdPosition(int patronId, int itemId)
+{
+    if (!m_remote)
+        return m_local.holdPosition(patronId, itemId);
+    ByteWriter args;
+    args.putSVarint(patronId);
+    args.putSVarint(itemId);
+    const Reply reply = call(Request::HoldPosition, args);
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    return reply.code == StoreProtocol::Reply::Ok ? int(in.svarint()) : 0;
+}
+
+int StoreClient::holdQueueLength(int itemId)
+{
+    if (!m_remote)
+        return m_local.holdQueueLength(itemId);
+    ByteWriter args;
+    args.putSVarint(itemId);
+    const Reply reply = call(Request::HoldQueueLength, args);
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    return reply.code == StoreProtocol::Reply::Ok ? int(in.svarint()) : 0;
+}
+
+std::vector<int> StoreClient::searchCatalogue(const QString &query, int limit)
+{
+    std::vector<int> matches;
+    if (!m_remote)
+    {
+        for (const SearchIndex::Hit &hit : m_local.searchCatalogue(query, limit))
+            matches.push_back(hit.slot);
+        return matches;
+    }
+
+    ByteWriter args;
+    args.putString(query);
+    args.putVarint(quint64(std::max(limit, 0)));
+    const Reply reply = call(Request::Search, args);
+    if (reply.code != StoreProtocol::Reply::Ok)
+        return matches;
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    for (int id : readIds(in))
+    {
+        const int slot = m_local.itemSlot(id);
+        if (slot >= 0)
+            matches.push_back(slot);
+    }
+    return matches;
+}
+
+FacetIndex::Matches StoreClient::filterCatalogue(const FacetFilter &filter, int limit)
+{
+    if (!m_remote)
+        return m_local.filterCatalogue(filter, limit);
+
+    FacetIndex::Matches matches;
+    ByteWriter args;
+    putFilter(args, filter);
+    args.putVarint(quint64(std::max(limit, 0)));
+    const Reply reply = call(Request::Filter, args);
+    if (reply.code != StoreProtocol::Reply::Ok)
+        return matches;
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    matches.total = int(in.varint());
+    for (int id : readIds(in))
+    {
+        const int slot = m_local.itemSlot(id);
+        if (slot >= 0)
+            matches.found.push_back(slot);
+    }
+    return matches;
+}
+
+std::vector<int> StoreClient::filterSlots(const FacetFilter &filter, std::vector<int> candidates)
+{
+    if (!m_remote)
+        return m_local.filterSlots(filter, std::move(candidates));
+
+    std::vector<int> ids;
+    ids.reserve(candidates.size());
+    for (int slot : candidates)
+        ids.push_back(m_local.itemIdAt(slot));
+    ByteWriter args;
+    putFilter(args, filter);
+    putIds(args, ids);
+    const Reply reply = call(Request::FilterIds, args);
+    candidates.clear();
+    if (reply.code != StoreProtocol::Reply::Ok)
+        return candidates;
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    for (int id : readIds(in))
+    {
+        const int slot = m_local.itemSlot(id);
+        if (slot >= 0)
+            candidates.push_back(slot);
+    }
+    return candidates;
+}
+
+FacetCounts StoreClient::facetCounts(const FacetFilter &filter)
+{
+    if (!m_remote)
+        return m_local.facetCounts(filter);
+
+    ByteWriter args;
+    putFilter(args, filter);
+    const Reply reply = call(Request::FacetCounts, args);
+    if (reply.code != StoreProtocol::Reply::Ok)
+        return FacetCounts();
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    const FacetCounts counts = readFacetCounts(in);
+    return in.ok() ? counts : FacetCounts();
+}
+
+std::vector<CirculationHistory::Loan> StoreClient::patronLoans(int patronId, int limit)
+{
+    if (!m_remote)
+        return m_local.patronLoans(patronId, limit);
+
+    ByteWriter args;
+    args.putSVarint(patronId);
+    // All of them (-1) is as many as the server sends
+    args.putVarint(quint64(limit < 0 ? std::numeric_limits<int>::max() : limit));
+    const Reply reply = call(Request::PatronLoans, args);
+    if (reply.code != StoreProtocol::Reply::Ok)
+        return {};
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    std::vector<CirculationHistory::Loan> loans = readLoans(in);
+    return in.ok() ? loans : std::vector<CirculationHistory::Loan>();
+}
+
+std::vector<int> StoreClient::alsoBorrowed(int itemId, int limit)
+{
+    if (!m_remote)
+        return m_local.alsoBorrowed(itemId, limit);
+
+    ByteWriter args;
+    args.putSVarint(itemId);
+    args.putVarint(quint64(std::max(limit, 0)));
+    const Reply reply = call(Request::AlsoBorrowed, args);
+    if (reply.code != StoreProtocol::Reply::Ok)
+        return {};
+    ByteReader in(reply.payload.data(), reply.payload.size());
+    std::vector<int> ids = readIds(in);
+    return in.ok() ? ids : std::vector<int>();
+}
+
+ItemStatus StoreClient::itemStatus(int itemId)
+{
+    if (!m_remote)
+    {
+        const int slot = m_local.itemSlot(itemId);
+        return slot >= 0 ? m_local.statusAt(slot) : ItemStatus();
+    }
+    if (!m_statuses.count(itemId))
+        itemStatuses({itemId});
+    auto found = m_statuses.find(itemId);
+    return found == m_statuses.end() ? ItemStatus() : found->second;
+}
+
+void StoreClient::itemStatuses(const std::vector<int> &ids)
+{
+    if (!m_remote)
+        return;
+    std::vector<std::pair<int, quint32>> asked;
+    for (int id : ids)
+    {
+        if (m_statuses.count(id))
+            continue;
+        ByteWriter args;
+        args.putSVarint(id);
+        asked.emplace_back(id, send(Request::ItemStatus, args));
+    }
+    if (asked.empty())
+        return;
+    if (m_statuses.size() + asked.size() > MaxCachedStatuses)
+        m_statuses.clear();
+    for (const auto &[id, tag] : asked)
+    {
+        const Reply reply = await(tag);
+        ByteReader in(reply.payload.data(), reply.payload.size());
+        if (reply.code != StoreProtocol::Reply::Ok || !in.u8())
+            continue;
+        const ItemStatus status = readStatus(in);
+        if (in.ok())
+            m_statuses[id] = status;
+    }
+}
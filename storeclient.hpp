@@ -0,0 +1,132 @@
+#pragma once
+#include "datastore.hpp"
+#include "storeprotocol.hpp"
+#include <QObject>
+#include <QString>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class QLocalSocket;
+
+// ---------------------------------------------
+// StoreClient: the store as the patron terminal sees it
+// ---------------------------------------------
+// By default every call goes straight to DataStore::instance(). After
+// connectToServer() the same calls become StoreProtocol requests to a
+// StoreServer, so terminals share one store. Catalogue metadata is still
+// read from the local store, which must hold the same catalogue as the
+// server (their catalogue fingerprints are compared on connect); only
+// circulation state travels. Items the server adds later are fetched and
+// added to the local store before their change is published.
+//
+// Remote calls block until their reply arrives. The batch calls
+// (findItems, itemStatuses) pipeline: all requests are written at once and
+// the replies collected together, one round trip in all. Use from the GUI
+// thread only; change listeners run from its event loop.
+class StoreClient : public QObject
+{
+    Q_OBJECT
+public:
+    static StoreClient &instance();
+
+    explicit StoreClient(DataStore &local, QObject *parent = nullptr);
+    ~StoreClient() override;
+
+    //Send every later call to the server at name; fails (and stays local)
+    //if it cannot be reached or serves a different catalogue
+    std::optional<QString> connectToServer(const QString &name, int timeoutMs = 3000);
+    void disconnectFromServer();
+    bool isRemote() const { return m_remote; }
+
+    // The DataStore calls a patron terminal needs (see datastore.hpp)
+    int findUserId(const QString &name);
+    template <typename Read>
+    bool withUser(int id, Read &&read);
+    std::optional<Item> findItemById(int id);
+    std::optional<QString> borrowItem(int patronId, int itemId);
+    std::optional<QString> returnItem(int patronId, int itemId);
+    std::optional<QString> placeHold(int patronId, int itemId);
+    std::optional<QString> cancelHold(int patronId, int itemId);
+    int holdPosition(int patronId, int itemId);
+    int holdQueueLength(int itemId);
+
+    //Ranked search; returns slots of the local catalogue, best first
+    std::vector<int> searchCatalogue(const QString &query, int limit);
+
+    //Facet filtering (see DataStore::filterCatalogue), in slots of the
+    //local catalogue; remotely the server runs it, as it owns availability
+    FacetIndex::Matches filterCatalogue(const FacetFilter &filter, int limit);
+    std::vector<int> filterSlots(const FacetFilter &filter, std::vector<int> candidates);
+    FacetCounts facetCounts(const FacetFilter &filter);
+
+    //A patron's most recent loans, newest first (see DataStore::patronLoans)
+    std::vector<CirculationHistory::Loan> patronLoans(int patronId, int limit);
+
+    //Items most often borrowed by patrons who borrowed this one (see
+    //DataStore::alsoBorrowed)
+    std::vector<int> alsoBorrowed(int itemId, int limit);
+
+    //Several items at once, in the order asked (nullopt = no such item)
+    std::vector<std::optional<Item>> findItems(const std::vector<int> &ids);
+
+    //Current status of an item. Remote statuses are cached until a change
+    //for that item arrives; itemStatuses() fetches any not cached, in one
+    //round trip, so a view can prefetch the rows it is about to paint.
+    ItemStatus itemStatus(int itemId);
+    void itemStatuses(const std::vector<int> &ids);
+    bool hasStatus(int itemId) const { return !isRemote() || m_statuses.count(itemId); }
+
+    //Change notifications, from whichever store is in use
+    int subscribe(ChangeListener listener);
+    void unsubscribe(int token);
+
+private:
+    struct Reply {
+        StoreProtocol::Reply code = StoreProtocol::Reply::Failed;
+        std::vector<char> payload;
+    };
+
+    quint32 send(StoreProtocol::Request request, const ByteWriter &args);
+    Reply await(quint32 tag);
+    Reply call(StoreProtocol::Request request, const ByteWriter &args) { return await(send(request, args)); }
+    std::optional<QString> circulate(StoreProtocol::Request request, int patronId, int itemId);
+    bool fetchUser(int id, User &user);
+    void receive();
+    void lose(const QString &why);
+    void deliverChanges();
+    void adoptItems(const std::vector<int> &ids);
+    void publish(const ChangeSet &changes);
+
+    static constexpr int ReplyTimeoutMs = 5000;
+    static constexpr std::size_t MaxCachedStatuses = 64 * 1024;
+    static constexpr std::size_t AdoptBatch = 1024;   // items fetched per round trip
+
+    DataStore &m_local;
+    bool m_remote = false;
+    QLocalSocket *m_socket = nullptr;   // null once the connection is lost
+    QString m_lostReason;
+    ByteWriter m_out;                 // requests not yet written
+    std::vector<char> m_in;           // received, not yet parsed
+    quint32 m_nextTag = 1;
+    std::unordered_map<quint32, Reply> m_replies;
+    std::unordered_map<int, ItemStatus> m_statuses;
+
+    std::vector<ChangeSet> m_pendingChanges;
+    std::vector<std::pair<int, ChangeListener>> m_listeners;
+    int m_nextToken = 1;
+    int m_localSubscription = 0;
+};
+
+template <typename Read>
+bool StoreClient::withUser(int id, Read &&read)
+{
+    if (!isRemote())
+        return m_local.withUser(id, std::forward<Read>(read));
+    User user;
+    if (!fetchUser(id, user))
+        return false;
+    read(static_cast<const User &>(user));
+    return true;
+}
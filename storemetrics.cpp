@@ -0,0 +1,175 @@
+#include "storemetrics.hpp"
+#include <algorithm>
+
+namespace {
+const char *const OpNames[StoreMetrics::OpCount] = {
+    "borrowItem", "returnItem", "borrowItems", "returnItems", "returnBin", "placeHold",
+    "cancelHold", "holdPosition", "findItemById", "findUserId", "withUser", "itemAt/statusAt",
+    "searchCatalogue", "filterCatalogue/facetCounts", "snapshot", "addItem", "addItems", "upsertUser", "overdue/dueItems", "advanceClock",
+    "itemHistory/patronHistory", "alsoBorrowed", "compactStorage"};
+
+std::atomic<quint64> g_nextMetricsId{1};
+
+// Highest set bit (n > 0)
+int log2Floor(quint64 n)
+{
+    int bit = 0;
+    while (n >>= 1)
+        ++bit;
+    return bit;
+}
+}
+
+const char *StoreMetrics::opName(Op op)
+{
+    return OpNames[int(op)];
+}
+
+int StoreMetrics::bucketOf(quint64 ns)
+{
+    // 0-3 ns get a bucket each; above that, four buckets per power of two
+    if (ns < 4)
+        return int(ns);
+    const int bit = log2Floor(ns);
+    const int bucket = (bit - 1) * 4 + int((ns >> (bit - 2)) & 3);
+    return std::min(bucket, Buckets - 1);
+}
+
+quint64 StoreMetrics::bucketFloor(int bucket)
+{
+    if (bucket < 4)
+        return quint64(bucket);
+    const int bit = bucket / 4 + 1;
+    return quint64(4 + bucket % 4) << (bit - 2);
+}
+
+double StoreMetrics::OpStats::percentileUs(double p) const
+{
+    if (!timed)
+        return 0.0;
+    const quint64 rank = std::max<quint64>(1, quint64(p * double(timed) + 0.5));
+    quint64 seen = 0;
+    for (int b = 0; b < Buckets; ++b)
+    {
+        seen += histogram[b];
+        if (seen >= rank)
+        {
+            const quint64 low = bucketFloor(b);
+            const quint64 high = b + 1 < Buckets ? bucketFloor(b + 1) : low;
+            return std::min(double(low + high) / 2.0, double(maxNs)) / 1000.0;
+        }
+    }
+    return double(maxNs) / 1000.0;
+}
+
+QString StoreMetrics::Snapshot::toText() const
+{
+    QString text;
+    text += QString("items %1\npatrons %2\nactive loans %3\non hold shelf %4\n")
+                .arg(gauges.items)
+                .arg(gauges.patrons)
+                .arg(gauges.activeLoans)
+                .arg(gauges.onHoldShelf);
+    text += QString("queued holds %1 on %2 items\nlongest queue %3 (item %4)\n\n")
+                .arg(gauges.queuedHolds)
+                .arg(gauges.itemsWithQueue)
+                .arg(gauges.longestQueue)
+                .arg(gauges.longestQueueItem);
+    text += "operation\tcalls\tmean_us\tp50_us\tp95_us\tp99_us\tmax_us\n";
+    for (int op = 0; op < OpCount; ++op)
+    {
+        const OpStats &s = ops[op];
+        if (!s.calls)
+            continue;
+        text += QString("%1\t%2\t%3\t%4\t%5\t%6\t%7\n")
+                    .arg(OpNames[op])
+                    .arg(s.calls)
+                    .arg(s.meanUs(), 0, 'f', 2)
+                    .arg(s.percentileUs(0.50), 0, 'f', 2)
+                    .arg(s.percentileUs(0.95), 0, 'f', 2)
+                    .arg(s.percentileUs(0.99), 0, 'f', 2)
+                    .arg(double(s.maxNs) / 1000.0, 0, 'f', 2);
+    }
+    return text;
+}
+
+StoreMetrics::StoreMetrics()
+    : m_id(g_nextMetricsId.fetch_add(1))
+{
+}
+
+StoreMetrics::~StoreMetrics() = default;
+
+StoreMetrics::Slab &StoreMetrics::localSlab() const
+{
+    // The last store this thread used is almost always the one asked for
+    thread_local quint64 t_lastId = 0;
+    thread_local Slab *t_lastSlab = nullptr;
+    if (t_lastId == m_id)
+        return *t_lastSlab;
+
+    // Ids are never reused, so entries left by destroyed stores never match
+    thread_local std::vector<std::pair<quint64, Slab *>> t_slabs;
+    Slab *slab = nullptr;
+    for (const auto &entry : t_slabs)
+        if (entry.first == m_id)
+            slab = entry.second;
+    if (!slab)
+    {
+        std::lock_guard<std::mutex> lock(m_slabLock);
+        m_slabs.push_back(std::make_unique<Slab>());
+        slab = m_slabs.back().get();
+        t_slabs.emplace_back(m_id, slab);
+    }
+    t_lastId = m_id;
+    t_lastSlab = slab;
+    return *slab;
+}
+
+namespace {
+// Only the owning thread writes a slab: load + store, no read-modify-write
+void bump(std::atomic<quint64> &v, quint64 by)
+{
+    v.store(v.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+}
+
+StoreMetrics::Counters *StoreMetrics::count(Op op) const
+{
+    Counters &c = localSlab().ops[int(op)];
+    const quint64 calls = c.calls.load(std::memory_order_relaxed) + 1;
+    c.calls.store(calls, std::memory_order_relaxed);
+    return !isSampled(op) || calls % SampleEvery == 1 ? &c : nullptr;
+}
+
+void StoreMetrics::record(Counters &c, Clock::duration elapsed)
+{
+    const quint64 ns = quint64(std::max<qint64>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    bump(c.timed, 1);
+    bump(c.totalNs, ns);
+    bump(c.histogram[bucketOf(ns)], 1);
+    if (ns > c.maxNs.load(std::memory_order_relaxed))
+        c.maxNs.store(ns, std::memory_order_relaxed);
+}
+
+StoreMetrics::Snapshot StoreMetrics::snapshot() const
+{
+    Snapshot snap;
+    snap.takenMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    std::lock_guard<std::mutex> lock(m_slabLock);
+    for (const auto &slab : m_slabs)
+    {
+        for (int op = 0; op < OpCount; ++op)
+        {
+            const Counters &c = slab->ops[op];
+            OpStats &s = snap.ops[op];
+            s.calls += c.calls.load(std::memory_order_relaxed);
+            s.timed += c.timed.load(std::memory_order_relaxed);
+            s.totalNs += c.totalNs.load(std::memory_order_relaxed);
+            s.maxNs = std::max(s.maxNs, c.maxNs.load(std::memory_order_relaxed));
+            for (int b = 0; b < Buckets; ++b)
+                s.histogram[b] += c.histogram[b].load(std::memory_order_relaxed);
+        }
+    }
+    return snap;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <QString>
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// ---------------------------------------------
+// StoreMetrics: call counts and latency histograms per DataStore operation
+// ---------------------------------------------
+// Each thread records into its own slab of counters, so recording is a
+// handful of plain (relaxed, single-writer) atomic stores: no locks and no
+// shared cache lines. snapshot() adds the slabs up. A thread gets its slab
+// on its first call into a store and keeps it; slabs live as long as the
+// store, so counts from threads that have exited are kept.
+//
+// Every call is counted. Reading the clock costs about as much as a whole
+// borrow, so the cheap per-item operations time one call in SampleEvery;
+// the rest are timed on every call. Latencies go into log-linear buckets,
+// four per power of two, so a percentile read from the histogram is within
+// about 12% of the true value.
+
+// Point-in-time store sizes, computed when a snapshot is taken
+struct StoreGauges {
+    int items = 0;
+    int patrons = 0;
+    int activeLoans = 0;
+    int onHoldShelf = 0;      // returned items waiting for a patron
+    int queuedHolds = 0;      // patrons waiting, over all hold queues
+    int itemsWithQueue = 0;
+    int longestQueue = 0;
+    int longestQueueItem = 0; // item id (0 = no queues)
+};
+
+class StoreMetrics
+{
+public:
+    enum class Op {
+        Borrow, Return, BorrowBatch, ReturnBatch, ReturnBin, PlaceHold, CancelHold, HoldPosition,
+        FindItem, FindUser, ReadUser, ReadItem, Search, Filter, Snapshot, AddItem, AddItems, UpsertUser, DueQuery, AdvanceClock,
+        History, AlsoBorrowed, Compact, Count
+    };
+    static constexpr int OpCount = int(Op::Count);
+    static constexpr int Buckets = 144;   // up to ~2^36 ns (about a minute)
+    static constexpr quint64 SampleEvery = 8;
+
+    //Operations cheap enough that only a sample of calls is timed
+    static constexpr bool isSampled(Op op) { return op <= Op::ReadItem; }
+
+    static const char *opName(Op op);
+
+    //Lower bound (ns) of a histogram bucket, and the bucket of a latency
+    static quint64 bucketFloor(int bucket);
+    static int bucketOf(quint64 ns);
+
+    // Merged figures for one operation
+    struct OpStats {
+        quint64 calls = 0;
+        quint64 timed = 0;     // calls in the histogram
+        quint64 totalNs = 0;   // over the timed calls
+        quint64 maxNs = 0;
+        std::array<quint64, Buckets> histogram{};
+
+        double meanUs() const { return timed ? double(totalNs) / double(timed) / 1000.0 : 0.0; }
+        //p in [0, 1]; the midpoint of the bucket holding that rank
+        double percentileUs(double p) const;
+    };
+
+    struct Snapshot {
+        qint64 takenMs = 0;   // steady clock, for rates between snapshots
+        std::array<OpStats, OpCount> ops;
+        StoreGauges gauges;
+
+        //Plain-text report: gauges, then one line per operation that ran
+        QString toText() const;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Counters;
+
+public:
+    // Counts one call and, if it is to be timed, times it from
+    // construction to destruction
+    class Timer
+    {
+    public:
+        Timer(const StoreMetrics &metrics, Op op) : m_counters(metrics.count(op))
+        {
+            if (m_counters)
+                m_start = Clock::now();
+        }
+        ~Timer()
+        {
+            if (m_counters)
+                record(*m_counters, Clock::now() - m_start);
+        }
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+    private:
+        Counters *m_counters;
+        Clock::time_point m_start;
+    };
+
+    StoreMetrics();
+    ~StoreMetrics();
+    StoreMetrics(const StoreMetrics &) = delete;
+    StoreMetrics &operator=(const StoreMetrics &) = delete;
+
+    //Sum of every thread's counters (gauges are left for the caller)
+    Snapshot snapshot() const;
+
+private:
+    struct Counters {
+        std::atomic<quint64> calls{0};
+        std::atomic<quint64> timed{0};
+        std::atomic<quint64> totalNs{0};
+        std::atomic<quint64> maxNs{0};
+        std::array<std::atomic<quint64>, Buckets> histogram{};
+    };
+    struct alignas(64) Slab {
+        std::array<Counters, OpCount> ops;
+    };
+
+    //Count a call; returns its counters if it should be timed
+    Counters *count(Op op) const;
+    static void record(Counters &c, Clock::duration elapsed);
+    Slab &localSlab() const;
+
+    const quint64 m_id;                               // tells stores apart in the thread-local cache
+    mutable std::mutex m_slabLock;                    // guards the list, not the counters
+    mutable std::vector<std::unique_ptr<Slab>> m_slabs;
+};
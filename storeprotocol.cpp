@@ -0,0 +1,347 @@
+#include "storeprotocol.hpp"
+#include "datastore.hpp"
+#include <algorithm>
+#include <array>
+#include <tuple>
+
+namespace StoreProtocol {
+
+namespace {
+void putDate(ByteWriter &out, const std::optional<QDate> &date)
+{
+    out.putU8(date ? 1 : 0);
+    if (date)
+        out.putSVarint(date->toJulianDay());
+}
+
+std::optional<QDate> readDate(ByteReader &in)
+{
+    if (!in.u8())
+        return std::nullopt;
+    return QDate::fromJulianDay(in.svarint());
+}
+
+// A count that cannot fit in what is left (each entry takes a byte) fails
+// the reader instead of reserving gigabytes
+bool readCount(ByteReader &in, quint64 &n)
+{
+    n = in.varint();
+    if (n <= in.remaining())
+        return true;
+    in.fail();
+    return false;
+}
+
+template <typename Ids>
+void writeIds(ByteWriter &out, const Ids &ids)
+{
+    out.putVarint(ids.size());
+    for (int id : ids)
+        out.putSVarint(id);
+}
+
+template <typename Ids>
+void readIdsInto(ByteReader &in, Ids &ids)
+{
+    ids.clear();
+    quint64 n = 0;
+    if (!readCount(in, n))
+        return;
+    ids.reserve(std::size_t(n));
+    for (quint64 i = 0; i < n; ++i)
+        ids.push_back(int(in.svarint()));
+}
+
+void putStrings(ByteWriter &out, const std::vector<QString> &values)
+{
+    out.putVarint(values.size());
+    for (const QString &value : values)
+        out.putString(value);
+}
+
+std::vector<QString> readStrings(ByteReader &in)
+{
+    std::vector<QString> values;
+    quint64 n = 0;
+    if (!readCount(in, n))
+        return values;
+    values.reserve(std::size_t(n));
+    for (quint64 i = 0; i < n; ++i)
+        values.push_back(in.string());
+    return values;
+}
+
+void putValueCounts(ByteWriter &out, const std::vector<std::pair<QString, int>> &values)
+{
+    out.putVarint(values.size());
+    for (const auto &[value, count] : values)
+    {
+        out.putString(value);
+        out.putVarint(quint64(count));
+    }
+}
+
+std::vector<std::pair<QString, int>> readValueCounts(ByteReader &in)
+{
+    std::vector<std::pair<QString, int>> values;
+    quint64 n = 0;
+    if (!readCount(in, n))
+        return values;
+    values.reserve(std::size_t(n));
+    for (quint64 i = 0; i < n; ++i)
+    {
+        QString value = in.string();
+        values.emplace_back(std::move(value), int(in.varint()));
+    }
+    return values;
+}
+}
+
+Parse parseFrame(const char *data, std::size_t size, Frame &frame)
+{
+    if (size < 4)
+        return Parse::Incomplete;
+    ByteReader in(data, size);
+    const quint32 length = in.u32();
+    if (length > MaxFrame || length < HeaderSize - 4)
+        return Parse::TooLarge;
+    if (size < 4 + std::size_t(length))
+        return Parse::Incomplete;
+    frame.tag = in.u32();
+    frame.code = in.u8();
+    frame.payload = data + HeaderSize;
+    frame.payloadSize = length - (HeaderSize - 4);
+    frame.frameSize = 4 + std::size_t(length);
+    return Parse::Complete;
+}
+
+std::size_t beginFrame(ByteWriter &out, quint32 tag, quint8 code)
+{
+    const std::size_t start = out.size();
+    out.putU32(0);
+    out.putU32(tag);
+    out.putU8(code);
+    return start;
+}
+
+void endFrame(ByteWriter &out, std::size_t start)
+{
+    out.patchU32(start, quint32(out.size() - start - 4));
+}
+
+void putIds(ByteWriter &out, const std::vector<int> &ids)
+{
+    writeIds(out, ids);
+}
+
+void putIds(ByteWriter &out, const std::pmr::vector<int> &ids)
+{
+    writeIds(out, ids);
+}
+
+std::vector<int> readIds(ByteReader &in)
+{
+    std::vector<int> ids;
+    readIdsInto(in, ids);
+    return ids;
+}
+
+void putStatus(ByteWriter &out, const ItemStatus &status)
+{
+    out.putU8(status.available ? 1 : 0);
+    out.putSVarint(status.borrower);
+    putDate(out, status.dueDate);
+    out.putSVarint(status.readyFor);
+    putDate(out, status.pickupBy);
+}
+
+ItemStatus readStatus(ByteReader &in)
+{
+    ItemStatus status;
+    status.available = in.u8() != 0;
+    status.borrower = int(in.svarint());
+    status.dueDate = readDate(in);
+    status.readyFor = int(in.svarint());
+    status.pickupBy = readDate(in);
+    return status;
+}
+
+void putItem(ByteWriter &out, const Item &item)
+{
+    out.putSVarint(item.id);
+    out.putString(item.title);
+    out.putString(item.creator);
+    out.putU8(quint8(item.format));
+    putStatus(out, item.status);
+    out.putString(item.dewey);
+    out.putString(item.issue);
+    out.putString(item.pubDate);
+    out.putString(item.genre);
+    out.putString(item.rating);
+}
+
+Item readItem(ByteReader &in)
+{
+    Item item;
+    item.id = int(in.svarint());
+    item.title = in.string();
+    item.creator = in.string();
+    item.format = ItemFormat(in.u8());
+    item.status = readStatus(in);
+    item.dewey = in.string();
+    item.issue = in.string();
+    item.pubDate = in.string();
+    item.genre = in.string();
+    item.rating = in.string();
+    return item;
+}
+
+void putUser(ByteWriter &out, const User &user)
+{
+    out.putSVarint(user.id);
+    out.putString(user.name);
+    out.putU8(quint8(user.type));
+    putIds(out, user.activeLoans);
+    putIds(out, user.holds);
+}
+
+User readUser(ByteReader &in)
+{
+    User user;
+    user.id = int(in.svarint());
+    user.name = in.string();
+    user.type = UserType(in.u8());
+    readIdsInto(in, user.activeLoans);
+    readIdsInto(in, user.holds);
+    return user;
+}
+
+void putChanges(ByteWriter &out, const ChangeSet &changes)
+{
+    out.putU64(changes.version);
+    for (const std::vector<int> *ids : changes.lists())
+        putIds(out, *ids);
+}
+
+ChangeSet readChanges(ByteReader &in)
+{
+    ChangeSet changes;
+    changes.version = in.u64();
+    for (std::vector<int> *ids : changes.lists())
+        *ids = readIds(in);
+    return changes;
+}
+
+void putChangeFrames(ByteWriter &out, const ChangeSet &changes)
+{
+    // An id takes at most 5 bytes; the version and list lengths fit the rest
+    static_assert(MaxChangeIds * 5 + 64 <= MaxFrame, "a full Changes frame must stay under MaxFrame");
+    const auto lists = changes.lists();
+    std::array<std::size_t, std::tuple_size<decltype(lists)>::value> sent{};   // per list
+    bool more = true;
+    while (more)
+    {
+        // Fill the part list by list, taking up to MaxChangeIds in all
+        ChangeSet part;
+        part.version = changes.version;
+        const auto partLists = part.lists();
+        std::size_t room = MaxChangeIds;
+        more = false;
+        for (std::size_t l = 0; l < lists.size(); ++l)
+        {
+            const std::vector<int> &ids = *lists[l];
+            const std::size_t n = std::min(room, ids.size() - sent[l]);
+            partLists[l]->assign(ids.begin() + std::ptrdiff_t(sent[l]), ids.begin() + std::ptrdiff_t(sent[l] + n));
+            sent[l] += n;
+            room -= n;
+            more |= sent[l] < ids.size();
+        }
+        const std::size_t start = beginFrame(out, 0, quint8(Reply::Changes));
+        putChanges(out, part);
+        endFrame(out, start);
+    }
+}
+
+void putFilter(ByteWriter &out, const FacetFilter &filter)
+{
+    out.putVarint(filter.formats.size());
+    for (ItemFormat format : filter.formats)
+        out.putU8(quint8(format));
+    putStrings(out, filter.genres);
+    putStrings(out, filter.ratings);
+    out.putU8(filter.availableOnly ? 1 : 0);
+}
+
+FacetFilter readFilter(ByteReader &in)
+{
+    FacetFilter filter;
+    quint64 n = 0;
+    if (!readCount(in, n))
+        return filter;
+    for (quint64 i = 0; i < n; ++i)
+    {
+        const quint8 format = in.u8();
+        if (format >= FacetCounts::FormatCount)
+            in.fail();
+        filter.formats.push_back(ItemFormat(format));
+    }
+    filter.genres = readStrings(in);
+    filter.ratings = readStrings(in);
+    filter.availableOnly = in.u8() != 0;
+    return filter;
+}
+
+void putFacetCounts(ByteWriter &out, const FacetCounts &counts)
+{
+    out.putVarint(quint64(counts.matches));
+    out.putVarint(quint64(counts.available));
+    for (int n : counts.formats)
+        out.putVarint(quint64(n));
+    putValueCounts(out, counts.genres);
+    putValueCounts(out, counts.ratings);
+}
+
+FacetCounts readFacetCounts(ByteReader &in)
+{
+    FacetCounts counts;
+    counts.matches = int(in.varint());
+    counts.available = int(in.varint());
+    for (int &n : counts.formats)
+        n = int(in.varint());
+    counts.genres = readValueCounts(in);
+    counts.ratings = readValueCounts(in);
+    return counts;
+}
+
+void putLoans(ByteWriter &out, const std::vector<CirculationHistory::Loan> &loans)
+{
+    out.putVarint(loans.size());
+    for (const CirculationHistory::Loan &loan : loans)
+    {
+        out.putSVarint(loan.itemId);
+        out.putSVarint(loan.patronId);
+        out.putSVarint(loan.borrowedMs);
+        out.putSVarint(loan.returnedMs);
+    }
+}
+
+std::vector<CirculationHistory::Loan> readLoans(ByteReader &in)
+{
+    std::vector<CirculationHistory::Loan> loans;
+    quint64 n = 0;
+    if (!readCount(in, n))
+        return loans;
+    loans.reserve(std::size_t(n));
+    for (quint64 i = 0; i < n; ++i)
+    {
+        CirculationHistory::Loan loan;
+        loan.itemId = int(in.svarint());
+        loan.patronId = int(in.svarint());
+        loan.borrowedMs = in.svarint();
+        loan.returnedMs = in.svarint();
+        loans.push_back(loan);
+    }
+    return loans;
+}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "bytecodec.hpp"
+#include "circulationhistory.hpp"
+#include "models.hpp"
+#include <cstddef>
+
+struct ChangeSet;
+struct FacetCounts;
+struct FacetFilter;
+
+// ---------------------------------------------
+// StoreProtocol: binary requests between StoreClient and StoreServer
+// ---------------------------------------------
+// Every message is one frame:
+//
+//   u32 length      bytes after this field
+//   u32 tag         chosen by the client, echoed in the reply (0 = push)
+//   u8  code        Request in requests, Reply in replies
+//   payload         ByteWriter encoding, per code (see storeservice.cpp)
+//
+// A connection may send any number of requests without waiting; replies
+// come back in request order, and the tag pairs them up. A client that
+// subscribed also receives Changes frames (tag 0) for every store change,
+// sent before the replies to the requests that caused them. A change with
+// more ids than fit a frame (a bulk import, a clock sweep after downtime)
+// comes as several Changes frames with the same version, each a ChangeSet
+// holding part of the ids.
+namespace StoreProtocol {
+
+constexpr quint32 Version = 5;
+constexpr std::size_t HeaderSize = 9;
+constexpr quint32 MaxFrame = 1 << 20;   // larger frames drop the connection
+constexpr std::size_t MaxChangeIds = 128 * 1024;   // per Changes frame, at most 5 bytes each
+
+enum class Request : quint8 {
+    Hello,           // version -> version, item count, catalogue fingerprint
+    FindUser,        // name -> patron id (0 = none)
+    ReadUser,        // patron id -> found, User
+    FindItem,        // item id -> found, Item
+    ItemStatus,      // item id -> found, ItemStatus
+    Search,          // query, limit -> item ids, best first
+    Borrow,          // patron id, item id -> Ok / Failed(message)
+    Return,
+    PlaceHold,
+    CancelHold,
+    HoldPosition,    // patron id, item id -> position (0 = not queued)
+    HoldQueueLength, // item id -> patrons waiting
+    Subscribe,       // -> Ok, then Changes frames
+    Filter,          // FacetFilter, limit -> total, item ids in catalogue order
+    FilterIds,       // FacetFilter, item ids -> the ids that pass, in order
+    FacetCounts,     // FacetFilter -> FacetCounts
+    PatronLoans,     // patron id, limit -> loans, newest first
+    AlsoBorrowed,    // item id, limit -> item ids, most co-borrowed first
+    Count
+};
+
+enum class Reply : quint8 {
+    Ok,
+    Failed,       // the operation was refused: payload is the message
+    BadRequest,   // unknown code or malformed payload: payload is the message
+    Changes       // push (tag 0): a ChangeSet
+};
+
+// A frame inside a received buffer; payload points into that buffer
+struct Frame {
+    quint32 tag = 0;
+    quint8 code = 0;
+    const char *payload = nullptr;
+    std::size_t payloadSize = 0;
+    std::size_t frameSize = 0;   // header included
+};
+
+enum class Parse { Complete, Incomplete, TooLarge };
+
+//Parse the frame at the start of data
+Parse parseFrame(const char *data, std::size_t size, Frame &frame);
+
+//Write a frame header; endFrame() fills in the length once the payload is written
+std::size_t beginFrame(ByteWriter &out, quint32 tag, quint8 code);
+void endFrame(ByteWriter &out, std::size_t start);
+
+// Payload encodings. The read functions leave in.ok() false on a short or
+// malformed payload.
+void putIds(ByteWriter &out, const std::vector<int> &ids);
+void putIds(ByteWriter &out, const std::pmr::vector<int> &ids);   // User's lists
+std::vector<int> readIds(ByteReader &in);
+void putStatus(ByteWriter &out, const ItemStatus &status);
+ItemStatus readStatus(ByteReader &in);
+void putItem(ByteWriter &out, const Item &item);
+Item readItem(ByteReader &in);
+void putUser(ByteWriter &out, const User &user);
+User readUser(ByteReader &in);
+void putChanges(ByteWriter &out, const ChangeSet &changes);
+ChangeSet readChanges(ByteReader &in);
+//changes as pushed Changes frames (tag 0), split to MaxChangeIds ids each
+void putChangeFrames(ByteWriter &out, const ChangeSet &changes);
+void putFilter(ByteWriter &out, const FacetFilter &filter);
+FacetFilter readFilter(ByteReader &in);
+void putFacetCounts(ByteWriter &out, const FacetCounts &counts);
+FacetCounts readFacetCounts(ByteReader &in);
+void putLoans(ByteWriter &out, const std::vector<CirculationHistory::Loan> &loans);
+std::vector<CirculationHistory::Loan> readLoans(ByteReader &in);
+
+}
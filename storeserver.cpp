@@ -0,0 +1,128 @@
+#include "storeserver.hpp"
+#include "datastore.hpp"
+#include "storeprotocol.hpp"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <algorithm>
+
+namespace {
+// A consumed prefix this large is dropped even while a frame is still partial
+constexpr std::size_t CompactInputAt = 64 * 1024;
+}
+
+StoreServer::StoreServer(DataStore &store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+    , m_service(store)
+    , m_server(new QLocalServer(this))
+{
+    connect(m_server, &QLocalServer::newConnection, this, &StoreServer::acceptConnections);
+    m_subscription = m_store.subscribe([this](const ChangeSet &changes) { queueChanges(changes); });
+}
+
+StoreServer::~StoreServer()
+{
+    m_store.unsubscribe(m_subscription);
+    // The sockets outlive m_connections (children of m_server): cut them
+    // loose so closing them cannot call back into a half-destroyed server
+    for (const auto &c : m_connections)
+        disconnect(c->socket, nullptr, this, nullptr);
+}
+
+std::optional<QString> StoreServer::listen(const QString &name)
+{
+    // Only take over the name if nothing answers on it
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(200))
+        return QString("A server is already running as \"%1\".").arg(name);
+    QLocalServer::removeServer(name);
+    if (!m_server->listen(name))
+        return QString("Cannot listen as \"%1\": %2").arg(name, m_server->errorString());
+    return std::nullopt;
+}
+
+void StoreServer::acceptConnections()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection())
+    {
+        m_connections.push_back(std::make_unique<Connection>());
+        Connection *c = m_connections.back().get();
+        c->socket = socket;
+        connect(socket, &QLocalSocket::readyRead, this, [this, c] { serve(c); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, c] { drop(c); });
+    }
+}
+
+void StoreServer::serve(Connection *c)
+{
+    const qint64 available = c->socket->bytesAvailable();
+    if (available > 0)
+    {
+        const std::size_t old = c->in.size();
+        c->in.resize(old + std::size_t(available));
+        const qint64 got = c->socket->read(c->in.data() + old, available);
+        c->in.resize(old + std::size_t(std::max<qint64>(got, 0)));
+    }
+
+    c->inUsed += m_service.handle(c->in.data() + c->inUsed, c->in.size() - c->inUsed, c->out, c->session);
+    if (c->inUsed == c->in.size())
+    {
+        c->in.clear();
+        c->inUsed = 0;
+    }
+    else if (c->inUsed >= CompactInputAt)
+    {
+        c->in.erase(c->in.begin(), c->in.begin() + std::ptrdiff_t(c->inUsed));
+        c->inUsed = 0;
+    }
+
+    // Changes made by these requests go out first, so a client never gets
+    // a reply before the change it caused
+    sendChanges();
+    if (c->out.size())
+    {
+        c->socket->write(c->out.data(), qint64(c->out.size()));
+        c->out.clear();
+    }
+    if (c->session.broken)
+        c->socket->disconnectFromServer();
+}
+
+void StoreServer::drop(Connection *c)
+{
+    auto found = std::find_if(m_connections.begin(), m_connections.end(),
+                              [c](const std::unique_ptr<Connection> &entry) { return entry.get() == c; });
+    if (found == m_connections.end())
+        return;
+    c->socket->deleteLater();
+    m_connections.erase(found);
+}
+
+void StoreServer::queueChanges(const ChangeSet &changes)
+{
+    std::lock_guard<std::mutex> lock(m_changeLock);
+    StoreProtocol::putChangeFrames(m_changeFrames, changes);
+    // Changes made outside a request (the clock, another thread) are sent
+    // from the event loop
+    if (!m_sendQueued)
+    {
+        m_sendQueued = true;
+        QMetaObject::invokeMethod(this, [this] { sendChanges(); }, Qt::QueuedConnection);
+    }
+}
+
+void StoreServer::sendChanges()
+{
+    ByteWriter frames;
+    {
+        std::lock_guard<std::mutex> lock(m_changeLock);
+        std::swap(frames, m_changeFrames);
+        m_sendQueued = false;
+    }
+    if (!frames.size())
+        return;
+    for (const auto &c : m_connections)
+        if (c->session.subscribed)
+            c->socket->write(frames.data(), qint64(frames.size()));
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "bytecodec.hpp"
+#include "storeservice.hpp"
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+struct ChangeSet;
+class DataStore;
+class QLocalServer;
+class QLocalSocket;
+
+// ---------------------------------------------
+// StoreServer: serves a DataStore to StoreClients over local sockets
+// ---------------------------------------------
+// Event driven on the thread that owns it: each readyRead runs every
+// complete request received on that connection (StoreService) and answers
+// them with a single write, so a client that pipelines requests gets its
+// replies in one batch. Store changes are pushed to subscribed clients
+// ahead of those replies. The daemon is tools/hinlibsd.
+class StoreServer : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr const char *DefaultName = "hinlibs";
+
+    explicit StoreServer(DataStore &store, QObject *parent = nullptr);
+    ~StoreServer() override;
+
+    //Start accepting connections on a local socket name (a stale socket
+    //left by a crashed server is removed first)
+    std::optional<QString> listen(const QString &name);
+
+    int connectionCount() const { return int(m_connections.size()); }
+
+private:
+    struct Connection {
+        QLocalSocket *socket = nullptr;
+        std::vector<char> in;
+        std::size_t inUsed = 0;   // consumed prefix of in
+        ByteWriter out;
+        StoreService::Session session;
+    };
+
+    void acceptConnections();
+    void serve(Connection *c);
+    void drop(Connection *c);
+    void queueChanges(const ChangeSet &changes);
+    void sendChanges();
+
+    DataStore &m_store;
+    StoreService m_service;
+    QLocalServer *m_server;
+    std::vector<std::unique_ptr<Connection>> m_connections;
+    int m_subscription = 0;
+
+    // Changes frames not yet sent; listeners may run on any thread
+    std::mutex m_changeLock;
+    ByteWriter m_changeFrames;
+    bool m_sendQueued = false;
+};
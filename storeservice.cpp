@@ -0,0 +1,267 @@
+#include "storeservice.hpp"
+#include "datastore.hpp"
+#include "storeprotocol.hpp"
+#include <algorithm>
+
+using namespace StoreProtocol;
+
+namespace {
+constexpr quint64 MaxSearchResults = 1000;
+constexpr quint64 MaxFilterResults = 50000;   // about 200 KB of ids, well inside a frame
+constexpr quint64 MaxLoanResults = 10000;     // under 40 bytes each
+
+void replyMessage(ByteWriter &out, quint32 tag, Reply code, const QString &message)
+{
+    const std::size_t start = beginFrame(out, tag, quint8(code));
+    out.putString(message);
+    endFrame(out, start);
+}
+
+// Ok with no payload, or Failed with the store's message
+void replyResult(ByteWriter &out, quint32 tag, const std::optional<QString> &err)
+{
+    if (err)
+    {
+        replyMessage(out, tag, Reply::Failed, *err);
+        return;
+    }
+    endFrame(out, beginFrame(out, tag, quint8(Reply::Ok)));
+}
+}
+
+std::size_t StoreService::handle(const char *data, std::size_t size, ByteWriter &out, Session &session)
+{
+    std::size_t used = 0;
+    while (!session.broken)
+    {
+        Frame frame;
+        const Parse parsed = parseFrame(data + used, size - used, frame);
+        if (parsed == Parse::Incomplete)
+            break;
+        if (parsed == Parse::TooLarge)
+        {
+            session.broken = true;
+            break;
+        }
+        ByteReader in(frame.payload, frame.payloadSize);
+        execute(frame.tag, frame.code, in, out, session);
+        used += frame.frameSize;
+    }
+    return used;
+}
+
+void StoreService::execute(quint32 tag, quint8 code, ByteReader &in, ByteWriter &out, Session &session)
+{
+    // Arguments are decoded first and checked once: a short or overlong
+    // payload gets BadRequest and never reaches the store
+    const auto request = Request(code);
+    QString text;
+    qint64 first = 0, second = 0;
+    FacetFilter filter;
+    std::vector<int> ids;
+    switch (request)
+    {
+        case Request::Hello:
+        case Request::ReadUser:
+        case Request::FindItem:
+        case Request::ItemStatus:
+        case Request::HoldQueueLength:
+            first = in.svarint();
+            break;
+        case Request::FindUser:
+            text = in.string();
+            break;
+        case Request::Search:
+            text = in.string();
+            first = qint64(std::min<quint64>(in.varint(), MaxSearchResults));
+            break;
+        case Request::Borrow:
+        case Request::Return:
+        case Request::PlaceHold:
+        case Request::CancelHold:
+        case Request::HoldPosition:
+            first = in.svarint();
+            second = in.svarint();
+            break;
+        case Request::Subscribe:
+            break;
+        case Request::Filter:
+            filter = readFilter(in);
+            first = qint64(std::min<quint64>(in.varint(), MaxFilterResults));
+            break;
+        case Request::FilterIds:
+            filter = readFilter(in);
+            ids = readIds(in);
+            break;
+        case Request::FacetCounts:
+            filter = readFilter(in);
+            break;
+        case Request::PatronLoans:
+            first = in.svarint();
+            second = qint64(std::min<quint64>(in.varint(), MaxLoanResults));
+            break;
+        case Request::AlsoBorrowed:
+            first = in.svarint();
+            second = qint64(std::min<quint64>(in.varint(), AlsoBorrowedIndex::Neighbours));
+            break;
+        default:
+            replyMessage(out, tag, Reply::BadRequest, QString("Unknown request code %1.").arg(code));
+            return;
+    }
+    if (!in.ok() || !in.atEnd())
+    {
+        replyMessage(out, tag, Reply::BadRequest, QString("Malformed payload for request code %1.").arg(code));
+        return;
+    }
+
+    const int a = int(first), b = int(second);
+    switch (request)
+    {
+        case Request::Hello:
+        {
+            if (first != qint64(Version))
+            {
+                replyMessage(out, tag, Reply::Failed,
+                             QString("The server speaks protocol version %1, not %2.").arg(Version).arg(first));
+                return;
+            }
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            out.putVarint(Version);
+            out.putVarint(quint64(m_store.itemCount()));
+            out.putU64(m_store.catalogueFingerprint());
+            endFrame(out, start);
+            return;
+        }
+        case Request::FindUser:
+        {
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            out.putSVarint(m_store.findUserId(text));
+            endFrame(out, start);
+            return;
+        }
+        case Request::ReadUser:
+        {
+            // Encoded in place under the patron's lock, as withUser reads it
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            const bool found = m_store.withUser(a, [&](const User &u) {
+                out.putU8(1);
+                putUser(out, u);
+            });
+            if (!found)
+                out.putU8(0);
+            endFrame(out, start);
+            return;
+        }
+        case Request::FindItem:
+        {
+            const std::optional<Item> item = m_store.findItemById(a);
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            out.putU8(item ? 1 : 0);
+            if (item)
+                putItem(out, *item);
+            endFrame(out, start);
+            return;
+        }
+        case Request::ItemStatus:
+        {
+            const int slot = m_store.itemSlot(a);
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            out.putU8(slot >= 0 ? 1 : 0);
+            if (slot >= 0)
+                putStatus(out, m_store.statusAt(slot));
+            endFrame(out, start);
+            return;
+        }
+        case Request::Search:
+        {
+            const std::vector<SearchIndex::Hit> hits = m_store.searchCatalogue(text, a);
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            out.putVarint(hits.size());
+            for (const SearchIndex::Hit &hit : hits)
+                out.putSVarint(m_store.itemIdAt(hit.slot));
+            endFrame(out, start);
+            return;
+        }
+        case Request::Borrow:
+            replyResult(out, tag, m_store.borrowItem(a, b));
+            return;
+        case Request::Return:
+            replyResult(out, tag, m_store.returnItem(a, b));
+            return;
+        case Request::PlaceHold:
+            replyResult(out, tag, m_store.placeHold(a, b));
+            return;
+        case Request::CancelHold:
+            replyResult(out, tag, m_store.cancelHold(a, b));
+            return;
+        case Request::HoldPosition:
+        {
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            out.putSVarint(m_store.holdPosition(a, b));
+            endFrame(out, start);
+            return;
+        }
+        case Request::HoldQueueLength:
+        {
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            out.putSVarint(m_store.holdQueueLength(a));
+            endFrame(out, start);
+            return;
+        }
+        case Request::Subscribe:
+            session.subscribed = true;
+            replyResult(out, tag, std::nullopt);
+            return;
+        case Request::Filter:
+        {
+            const FacetIndex::Matches matches = m_store.filterCatalogue(filter, a);
+            for (int slot : matches.found)
+                ids.push_back(m_store.itemIdAt(slot));
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            out.putVarint(quint64(matches.total));
+            putIds(out, ids);
+            endFrame(out, start);
+            return;
+        }
+        case Request::FilterIds:
+        {
+            // Unknown ids are dropped, as a filter would drop them
+            std::vector<int> candidates;
+            for (int id : ids)
+                if (const int slot = m_store.itemSlot(id); slot >= 0)
+                    candidates.push_back(slot);
+            ids.clear();
+            for (int slot : m_store.filterSlots(filter, std::move(candidates)))
+                ids.push_back(m_store.itemIdAt(slot));
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            putIds(out, ids);
+            endFrame(out, start);
+            return;
+        }
+        case Request::FacetCounts:
+        {
+            const FacetCounts counts = m_store.facetCounts(filter);
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            putFacetCounts(out, counts);
+            endFrame(out, start);
+            return;
+        }
+        case Request::PatronLoans:
+        {
+            const std::vector<CirculationHistory::Loan> loans = m_store.patronLoans(a, b);
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            putLoans(out, loans);
+            endFrame(out, start);
+            return;
+        }
+        case Request::AlsoBorrowed:
+        {
+            const std::size_t start = beginFrame(out, tag, quint8(Reply::Ok));
+            putIds(out, m_store.alsoBorrowed(a, b));
+            endFrame(out, start);
+            return;
+        }
+        case Request::Count:
+            break;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "bytecodec.hpp"
+#include <cstddef>
+
+class DataStore;
+
+// ---------------------------------------------
+// StoreService: runs StoreProtocol requests against a DataStore
+// ---------------------------------------------
+// The transport-free half of the server: hand it the bytes received on a
+// connection and it executes every complete request in them, in order,
+// appending one reply frame per request. StoreServer moves the bytes over
+// local sockets; benchmarks drive it directly.
+class StoreService
+{
+public:
+    // Per-connection state
+    struct Session {
+        bool subscribed = false;   // asked for Changes frames
+        bool broken = false;       // sent an oversized frame; close the connection
+    };
+
+    explicit StoreService(DataStore &store) : m_store(store) {}
+
+    //Execute the complete requests at the start of data, replies appended
+    //to out; returns the bytes consumed (a partial frame is left for later)
+    std::size_t handle(const char *data, std::size_t size, ByteWriter &out, Session &session);
+
+private:
+    void execute(quint32 tag, quint8 code, ByteReader &in, ByteWriter &out, Session &session);
+
+    DataStore &m_store;
+};
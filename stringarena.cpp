@@ -0,0 +1,45 @@
+#include "stringarena.hpp"
+#include <algorithm>
+
+StringArena::Ref StringArena::add(const QString &s)
+{
+    if (s.isEmpty())
+        return Ref();
+
+    const std::size_t length = std::size_t(s.size());
+    const std::size_t units = 2 + length;   // u32 length, then the text
+    std::size_t block = m_current;
+    if (units > BlockChars)
+    {
+        // Its own block, sized to fit; the current one keeps filling
+        m_blocks.push_back(std::make_unique<quint16[]>(units));
+        m_bytes += units * 2;
+        block = m_blocks.size();
+    }
+    else if (m_current == 0 || m_used + units > BlockChars)
+    {
+        m_blocks.push_back(std::make_unique<quint16[]>(BlockChars));
+        m_bytes += BlockChars * 2;
+        m_current = block = m_blocks.size();
+        m_used = 0;
+    }
+
+    const std::size_t offset = block == m_current ? m_used : 0;
+    quint16 *out = m_blocks[block - 1].get() + offset;
+    out[0] = quint16(length & 0xFFFF);
+    out[1] = quint16(length >> 16);
+    const quint16 *text = reinterpret_cast<const quint16 *>(s.utf16());
+    std::copy(text, text + length, out + 2);
+    if (block == m_current)
+        m_used += units;
+    return Ref{quint32(block), quint32(offset)};
+}
+
+QString StringArena::view(Ref ref) const
+{
+    if (ref.block == 0)
+        return QString();
+    const quint16 *at = m_blocks[ref.block - 1].get() + ref.offset;
+    const int length = int(at[0] | quint32(at[1]) << 16);
+    return QString::fromRawData(reinterpret_cast<const QChar *>(at + 2), length);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <QString>
+#include <QtGlobal>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// ---------------------------------------------
+// StringArena: write-once text packed into large blocks
+// ---------------------------------------------
+// Each string is copied in as [u32 length][UTF-16 data], like the strings
+// of a CatalogueFile, and named by a Ref. Blocks are never moved or freed
+// before the arena is destroyed, so a million titles cost a few hundred
+// allocations instead of one each, and all of them go in one sweep.
+// Strings are handed out with QString::fromRawData: reading copies nothing,
+// and what is handed out stays valid for the arena's life.
+//
+// Not thread-safe; DataStore adds under its exclusive structure lock and
+// reads under the shared one.
+class StringArena
+{
+public:
+    static constexpr std::size_t BlockChars = 1 << 16;   // UTF-16 units; longer strings get their own block
+
+    struct Ref {
+        quint32 block = 0;    // 1-based, 0 = the empty string
+        quint32 offset = 0;   // of the length, in UTF-16 units
+    };
+
+    StringArena() = default;
+    StringArena(const StringArena &) = delete;
+    StringArena &operator=(const StringArena &) = delete;
+
+    //Copy a string in; the empty string takes no space
+    Ref add(const QString &s);
+    QString view(Ref ref) const;
+
+    int blockCount() const { return (int)m_blocks.size(); }
+    std::size_t bytesUsed() const { return m_bytes; }
+
+private:
+    std::vector<std::unique_ptr<quint16[]>> m_blocks;
+    std::size_t m_current = 0;   // block being filled, 1-based (0 = none yet)
+    std::size_t m_used = 0;      // units used in it
+    std::size_t m_bytes = 0;     // allocated, all blocks
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <shared_mutex>
+
+// ---------------------------------------------
+// StripedSharedMutex: reader/writer lock for read-mostly state
+// ---------------------------------------------
+// A plain shared_mutex makes every reader write the same lock word, which
+// bounces one cache line between all cores. Here each thread reads
+// through its own stripe; a writer takes every stripe in order. Meets
+// the SharedMutex requirements, so std::shared_lock / std::unique_lock
+// work as usual (a thread always maps to the same stripe).
+class StripedSharedMutex
+{
+public:
+    static constexpr int Stripes = 16;
+
+    void lock()
+    {
+        for (Stripe &s : m_stripes)
+            s.mutex.lock();
+    }
+    void unlock()
+    {
+        for (auto it = m_stripes.rbegin(); it != m_stripes.rend(); ++it)
+            it->mutex.unlock();
+    }
+    bool try_lock()
+    {
+        for (int i = 0; i < Stripes; ++i)
+        {
+            if (!m_stripes[i].mutex.try_lock())
+            {
+                while (i-- > 0)
+                    m_stripes[i].mutex.unlock();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void lock_shared() { mine().lock_shared(); }
+    void unlock_shared() { mine().unlock_shared(); }
+    bool try_lock_shared() { return mine().try_lock_shared(); }
+
+private:
+    struct alignas(64) Stripe {
+        std::shared_mutex mutex;
+    };
+
+    std::shared_mutex &mine()
+    {
+        static std::atomic<unsigned> nextThread{0};
+        thread_local const unsigned stripe = nextThread++ % Stripes;
+        return m_stripes[stripe].mutex;
+    }
+
+    std::array<Stripe, Stripes> m_stripes;
+};
@@ -0,0 +1,116 @@
+// catalogueconvert: CSV export -> binary catalogue for DataStore::openCatalogue
+//
+//   catalogueconvert <input.csv> <output.hcat>
+//
+// The first CSV row names the columns (any order, case-insensitive):
+//   id, title, creator, format, dewey, issue, pubDate, genre, rating
+// id, title and format are required. Format is a name such as "Movie" or
+// "Non-Fiction Book". Fields a format does not use are dropped. Bad rows
+// are reported with their line number and skipped.
+#include "cataloguefile.hpp"
+#include "csvreader.hpp"
+#include <QFile>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+enum Column { Id, Title, Creator, Format, Dewey, Issue, PubDate, Genre, Rating, ColumnCount };
+const char *const ColumnNames[ColumnCount] = {"id", "title", "creator", "format", "dewey",
+                                              "issue", "pubdate", "genre", "rating"};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        std::fprintf(stderr, "usage: %s <input.csv> <output.hcat>\n", argv[0]);
+        return 2;
+    }
+    const QString inputPath = QString::fromLocal8Bit(argv[1]);
+    const QString outputPath = QString::fromLocal8Bit(argv[2]);
+
+    QFile input(inputPath);
+    if (!input.open(QIODevice::ReadOnly))
+    {
+        std::fprintf(stderr, "cannot open %s: %s\n", argv[1], qPrintable(input.errorString()));
+        return 1;
+    }
+    const qint64 size = input.size();
+    const uchar *data = size > 0 ? input.map(0, size) : nullptr;
+    if (!data)
+    {
+        std::fprintf(stderr, "%s is empty or cannot be mapped\n", argv[1]);
+        return 1;
+    }
+
+    CsvReader csv(reinterpret_cast<const char *>(data), std::size_t(size));
+    std::vector<QString> row;
+    if (!csv.next(row))
+    {
+        std::fprintf(stderr, "%s has no header row\n", argv[1]);
+        return 1;
+    }
+
+    // Header row -> column positions
+    int at[ColumnCount];
+    std::fill(at, at + ColumnCount, -1);
+    for (int i = 0; i < (int)row.size(); ++i)
+        for (int c = 0; c < ColumnCount; ++c)
+            if (row[i].trimmed().toLower() == ColumnNames[c])
+                at[c] = i;
+    for (Column required : {Id, Title, Format})
+    {
+        if (at[required] < 0)
+        {
+            std::fprintf(stderr, "%s: missing required column '%s'\n", argv[1], ColumnNames[required]);
+            return 1;
+        }
+    }
+
+    auto cell = [&](Column c) { return at[c] >= 0 && at[c] < (int)row.size() ? row[at[c]].trimmed() : QString(); };
+
+    CatalogueWriter writer;
+    int skipped = 0;
+    while (csv.next(row))
+    {
+        if (row.size() == 1 && row[0].isEmpty())
+            continue; // blank line
+
+        bool idOk = false;
+        Item item;
+        item.id = cell(Id).toInt(&idOk);
+        auto format = formatFromString(cell(Format));
+        std::optional<QString> err;
+        if (!idOk)
+            err = QString("id '%1' is not a number").arg(cell(Id));
+        else if (!format)
+            err = QString("unknown format '%1'").arg(cell(Format));
+        else
+        {
+            item.format = *format;
+            item.title = cell(Title);
+            item.creator = cell(Creator);
+            item.dewey = cell(Dewey);
+            item.issue = cell(Issue);
+            item.pubDate = cell(PubDate);
+            item.genre = cell(Genre);
+            item.rating = cell(Rating);
+            err = writer.add(item);
+        }
+        if (err)
+        {
+            std::fprintf(stderr, "%s:%d: %s\n", argv[1], csv.line(), qPrintable(*err));
+            ++skipped;
+        }
+    }
+
+    if (auto err = writer.write(outputPath))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(*err));
+        return 1;
+    }
+    std::printf("Wrote %d items to %s (%d rows skipped)\n", writer.count(), argv[2], skipped);
+    return 0;
+}
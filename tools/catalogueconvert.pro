@@ -0,0 +1,21 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = catalogueconvert
+
+# Builds a memory-mappable catalogue (.hcat) from a CSV export.
+INCLUDEPATH += ..
+
+SOURCES += \
+    catalogueconvert.cpp \
+    ../cataloguefile.cpp \
+    ../csvreader.cpp
+
+HEADERS += \
+    ../bytecodec.hpp \
+    ../cataloguefile.hpp \
+    ../csvreader.hpp \
+    ../models.hpp
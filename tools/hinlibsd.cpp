@@ -0,0 +1,141 @@
+// hinlibsd: serve one DataStore to every terminal of a branch
+//
+//   hinlibsd [--name NAME] [--storage DIR] [--catalogue FILE] [--trace FILE]
+//
+// Opens the store the way the app does (demo data, then the catalogue,
+// then the loans and holds journalled in --storage, by default the app's
+// own data folder) and serves it on the local socket NAME (default
+// "hinlibs") until interrupted. Terminals connect by starting the app with
+// HINLIBS_SERVER=NAME; they must open the same catalogue. The server owns
+// the store's clock: loans turning overdue and expired pickup windows are
+// published from here. --trace records the served traffic for
+// tools/workloadreplay, as HINLIBS_TRACE does for the app.
+#include "datastore.hpp"
+#include "storeserver.hpp"
+#include "workloadtrace.hpp"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTimer>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+struct Options {
+    QString name = StoreServer::DefaultName;
+    QString storage;
+    QString catalogue;
+    QString trace;
+};
+
+bool parseOptions(int argc, char **argv, Options &opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (i + 1 >= argc)
+            return false;
+        const char *value = argv[++i];
+        if (!std::strcmp(arg, "--name"))
+            opt.name = QString::fromLocal8Bit(value);
+        else if (!std::strcmp(arg, "--storage"))
+            opt.storage = QString::fromLocal8Bit(value);
+        else if (!std::strcmp(arg, "--catalogue"))
+            opt.catalogue = QString::fromLocal8Bit(value);
+        else if (!std::strcmp(arg, "--trace"))
+            opt.trace = QString::fromLocal8Bit(value);
+        else
+            return false;
+    }
+    return !opt.name.isEmpty();
+}
+
+// Set from the signal handler; the event loop polls it
+std::atomic<bool> g_stop{false};
+
+void requestStop(int)
+{
+    g_stop = true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("HinLIBS");   // same data folder as the app
+
+    Options opt;
+    if (!parseOptions(argc, argv, opt))
+    {
+        std::fprintf(stderr, "usage: %s [--name NAME] [--storage DIR] [--catalogue FILE] [--trace FILE]\n", argv[0]);
+        return 2;
+    }
+    if (opt.storage.isEmpty())
+        opt.storage = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    if (opt.catalogue.isEmpty() && QFile::exists(QDir(opt.storage).filePath("catalogue.hcat")))
+        opt.catalogue = QDir(opt.storage).filePath("catalogue.hcat");
+
+    DataStore &store = DataStore::instance();
+    if (!opt.catalogue.isEmpty())
+    {
+        if (auto err = store.openCatalogue(opt.catalogue))
+        {
+            std::fprintf(stderr, "%s\n", qPrintable(*err));
+            return 1;
+        }
+    }
+    // Unlike the app, refuse to serve changes that would not be saved
+    if (auto err = store.openStorage(opt.storage))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(*err));
+        return 1;
+    }
+
+    WorkloadTrace trace;
+    if (!opt.trace.isEmpty())
+    {
+        if (auto err = trace.open(opt.trace))
+        {
+            std::fprintf(stderr, "%s\n", qPrintable(*err));
+            return 1;
+        }
+        store.setTrace(&trace);
+    }
+
+    int result = 0;
+    {
+        StoreServer server(store);
+        if (auto err = server.listen(opt.name))
+        {
+            std::fprintf(stderr, "%s\n", qPrintable(*err));
+            store.setTrace(nullptr);
+            return 1;
+        }
+        std::printf("serving %d items from %s as \"%s\"\n", store.itemCount(), qPrintable(opt.storage),
+                    qPrintable(opt.name));
+        std::fflush(stdout);
+
+        QTimer clock;
+        QObject::connect(&clock, &QTimer::timeout, [&store] { store.advanceClock(QDate::currentDate()); });
+        clock.start(60 * 1000);
+
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+        QTimer stopPoll;
+        QObject::connect(&stopPoll, &QTimer::timeout, [&app] {
+            if (g_stop)
+                app.quit();
+        });
+        stopPoll.start(200);
+
+        result = app.exec();
+    }
+    store.setTrace(nullptr);
+    store.syncStorage();
+    return result;
+}
@@ -0,0 +1,17 @@
+QT       += core network
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = hinlibsd
+
+# Serves one DataStore to the terminals of a branch over a local socket.
+include(../core.pri)
+
+SOURCES += \
+    hinlibsd.cpp \
+    ../storeserver.cpp
+
+HEADERS += \
+    ../storeserver.hpp
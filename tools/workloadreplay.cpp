@@ -0,0 +1,342 @@
+// workloadreplay: play a captured DataStore workload back without the GUI
+//
+//   workloadreplay <trace.csv> [--sessions N] [--speed max|F]
+//                  [--catalogue FILE] [--start DIR] [--expect DIR]
+//
+// Capture a day by running the app with HINLIBS_TRACE=<trace.csv> (see
+// workloadtrace.hpp), copying its storage directory before the day
+// (--start) and after it (--expect). --catalogue names the .hcat file the
+// app served, if any. Without --start the store begins with the demo data,
+// as the app does on first run; both directories are copied to scratch
+// space first, so they are never modified.
+//
+// Events are dealt to N concurrent sessions (threads) by patron, so each
+// patron's calls keep their captured order; lookups without a patron go
+// round robin. --speed max (the default) replays as fast as possible, F
+// replays at F times the captured pace (1 = real time). Reports throughput
+// and p50/p95/p99/max latency per operation type, then compares the final
+// loans, hold shelf and hold queues with --expect and exits 1 on any
+// divergence. Due dates and pickup deadlines follow the day of the replay,
+// so they are not compared. With more than one session, patrons racing for
+// the same item may be served in a different order than captured.
+#include "datastore.hpp"
+#include "workloadtrace.hpp"
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Op = WorkloadTrace::Op;
+constexpr int OpCount = int(Op::Count);
+
+struct Options {
+    QString tracePath;
+    int sessions = 1;
+    double speed = 0;   // 0 = as fast as possible
+    QString catalogue;
+    QString start;
+    QString expect;
+};
+
+bool parseOptions(int argc, char **argv, Options &opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (arg[0] != '-')
+        {
+            if (!opt.tracePath.isEmpty())
+                return false;
+            opt.tracePath = QString::fromLocal8Bit(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+        const char *value = argv[++i];
+        if (!std::strcmp(arg, "--sessions"))
+            opt.sessions = std::max(1, std::atoi(value));
+        else if (!std::strcmp(arg, "--speed"))
+            opt.speed = std::strcmp(value, "max") ? std::max(0.0, std::atof(value)) : 0;
+        else if (!std::strcmp(arg, "--catalogue"))
+            opt.catalogue = QString::fromLocal8Bit(value);
+        else if (!std::strcmp(arg, "--start"))
+            opt.start = QString::fromLocal8Bit(value);
+        else if (!std::strcmp(arg, "--expect"))
+            opt.expect = QString::fromLocal8Bit(value);
+        else
+            return false;
+    }
+    return !opt.tracePath.isEmpty();
+}
+
+// ---------------------------------------------
+// Stores
+// ---------------------------------------------
+// A store as the app builds it: demo data, then the catalogue file, then
+// the loans and holds journalled in a scratch copy of `dir`
+std::optional<QString> openStore(DataStore &ds, const Options &opt, const QString &dir, QTemporaryDir &scratch)
+{
+    if (!opt.catalogue.isEmpty())
+    {
+        if (auto err = ds.openCatalogue(opt.catalogue))
+            return err;
+    }
+    if (dir.isEmpty())
+        return std::nullopt;
+    if (!scratch.isValid())
+        return QString("Cannot create a scratch directory.");
+    const QDir from(dir);
+    for (const QString &name : from.entryList(QDir::Files))
+    {
+        if (!QFile::copy(from.filePath(name), QDir(scratch.path()).filePath(name)))
+            return QString("Cannot copy %1 to scratch space.").arg(from.filePath(name));
+    }
+    return ds.openStorage(scratch.path());
+}
+
+// Everything about an item that is not "on the shelf", by item id
+struct ItemState {
+    int borrower = 0;
+    int readyFor = 0;
+    std::vector<int> queue;   // patron ids, head first
+
+    bool operator==(const ItemState &o) const
+    {
+        return borrower == o.borrower && readyFor == o.readyFor && queue == o.queue;
+    }
+};
+using StoreState = std::map<int, ItemState>;
+
+StoreState captureState(const DataStore &ds)
+{
+    StoreState state;
+    for (int slot = 0; slot < ds.itemCount(); ++slot)
+    {
+        const ItemStatus status = ds.statusAt(slot);
+        if (status.borrower || status.readyFor)
+        {
+            ItemState &item = state[ds.itemIdAt(slot)];
+            item.borrower = status.borrower;
+            item.readyFor = status.readyFor;
+        }
+    }
+
+    // Patron ids are dense, so walk them until the first unknown one and
+    // rebuild each queue from its members' positions
+    std::vector<int> holds;
+    for (int id = 1; ds.withUser(id, [&](const User &u) { holds.assign(u.holds.begin(), u.holds.end()); }); ++id)
+    {
+        for (int itemId : holds)
+        {
+            const int position = ds.holdPosition(id, itemId);
+            if (position < 1)
+                continue;
+            std::vector<int> &queue = state[itemId].queue;
+            if ((int)queue.size() < position)
+                queue.resize(position, 0);
+            queue[position - 1] = id;
+        }
+    }
+    return state;
+}
+
+QString describe(const ItemState *item)
+{
+    if (!item)
+        return "on the shelf";
+    QString text = item->borrower ? QString("on loan to %1").arg(item->borrower)
+                 : item->readyFor ? QString("held for %1").arg(item->readyFor)
+                                  : QString("on the shelf");
+    constexpr std::size_t MaxQueueShown = 8;
+    if (!item->queue.empty())
+    {
+        text += ", queue";
+        for (std::size_t i = 0; i < item->queue.size() && i < MaxQueueShown; ++i)
+            text += QString(" %1").arg(item->queue[i]);
+        if (item->queue.size() > MaxQueueShown)
+            text += QString(" ... (%1 waiting)").arg(int(item->queue.size()));
+    }
+    return text;
+}
+
+// Differences between the replayed and the expected state; prints the first few
+int compareStates(const StoreState &got, const StoreState &expected)
+{
+    constexpr int MaxShown = 20;
+    int differences = 0;
+    auto report = [&](int itemId, const ItemState *g, const ItemState *e) {
+        if (++differences <= MaxShown)
+            std::printf("  item %d: %s; expected %s\n", itemId, qPrintable(describe(g)), qPrintable(describe(e)));
+    };
+    for (const auto &[itemId, item] : got)
+    {
+        auto other = expected.find(itemId);
+        if (other == expected.end())
+            report(itemId, &item, nullptr);
+        else if (!(item == other->second))
+            report(itemId, &item, &other->second);
+    }
+    for (const auto &[itemId, item] : expected)
+        if (!got.count(itemId))
+            report(itemId, nullptr, &item);
+    if (differences > MaxShown)
+        std::printf("  ... and %d more\n", differences - MaxShown);
+    return differences;
+}
+
+// ---------------------------------------------
+// Replay
+// ---------------------------------------------
+struct OpStats {
+    std::vector<qint64> ns;   // latency of each call
+    long long ok = 0;         // calls that succeeded / found something
+};
+
+struct Session {
+    std::vector<const WorkloadTrace::Event *> events;
+    std::array<OpStats, OpCount> stats;
+};
+
+bool play(DataStore &ds, const WorkloadTrace::Event &e)
+{
+    switch (e.op)
+    {
+        case Op::Borrow:     return !ds.borrowItem(e.patronId, e.itemId);
+        case Op::Return:     return !ds.returnItem(e.patronId, e.itemId);
+        case Op::CheckIn:    return !ds.returnBin({e.itemId}).front();
+        case Op::PlaceHold:  return !ds.placeHold(e.patronId, e.itemId);
+        case Op::CancelHold: return !ds.cancelHold(e.patronId, e.itemId);
+        case Op::FindItem:   return ds.findItemById(e.itemId).has_value();
+        case Op::FindUser:   return ds.findUserId(e.text) != 0;
+        case Op::Search:     return !ds.searchCatalogue(e.text, e.itemId > 0 ? e.itemId : 50).empty();
+        case Op::Count:      break;
+    }
+    return false;
+}
+
+void runSession(DataStore &ds, Session &session, Clock::time_point start, qint64 firstMs, double speed)
+{
+    for (const WorkloadTrace::Event *e : session.events)
+    {
+        if (speed > 0)
+            std::this_thread::sleep_until(start + std::chrono::microseconds(qint64((e->atMs - firstMs) * 1000 / speed)));
+        const auto before = Clock::now();
+        const bool ok = play(ds, *e);
+        OpStats &stats = session.stats[int(e->op)];
+        stats.ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count());
+        stats.ok += ok;
+    }
+}
+
+// Nearest-rank percentile of sorted samples, in microseconds
+double percentileUs(const std::vector<qint64> &sorted, double p)
+{
+    const std::size_t rank = std::size_t(std::max(1.0, p * double(sorted.size()) + 0.999999));
+    return double(sorted[std::min(sorted.size(), rank) - 1]) / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    if (!parseOptions(argc, argv, opt))
+    {
+        std::fprintf(stderr,
+                     "usage: %s <trace.csv> [--sessions N] [--speed max|F] [--catalogue FILE] [--start DIR] [--expect DIR]\n",
+                     argv[0]);
+        return 2;
+    }
+
+    std::vector<WorkloadTrace::Event> events;
+    if (auto err = WorkloadTrace::read(opt.tracePath, events))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(*err));
+        return 1;
+    }
+    if (events.empty())
+    {
+        std::fprintf(stderr, "%s has no events\n", qPrintable(opt.tracePath));
+        return 1;
+    }
+
+    // Scratch copies outlive the stores journalling into them
+    QTemporaryDir startScratch, expectScratch;
+    DataStore ds(true);
+    if (auto err = openStore(ds, opt, opt.start, startScratch))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(*err));
+        return 1;
+    }
+
+    // Deal events to sessions: a patron always lands on the same one
+    std::vector<Session> sessions(opt.sessions);
+    std::size_t roundRobin = 0;
+    for (const WorkloadTrace::Event &e : events)
+    {
+        const std::size_t s = e.patronId > 0 ? std::size_t(e.patronId) % sessions.size() : roundRobin++ % sessions.size();
+        sessions[s].events.push_back(&e);
+    }
+
+    const qint64 firstMs = events.front().atMs;
+    const auto start = Clock::now();
+    {
+        std::vector<std::thread> threads;
+        for (Session &session : sessions)
+            threads.emplace_back([&] { runSession(ds, session, start, firstMs, opt.speed); });
+        for (std::thread &t : threads)
+            t.join();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::printf("replayed %zu events in %.3f s with %d session(s) at %s: %.0f ops/s\n", events.size(), seconds,
+                opt.sessions, opt.speed > 0 ? qPrintable(QString("%1x captured speed").arg(opt.speed)) : "max speed",
+                double(events.size()) / seconds);
+    std::printf("%-11s %9s %9s %10s %10s %10s %10s %10s\n", "op", "count", "ok", "ops/s", "p50 us", "p95 us", "p99 us",
+                "max us");
+    for (int op = 0; op < OpCount; ++op)
+    {
+        OpStats all;
+        for (Session &session : sessions)
+        {
+            OpStats &s = session.stats[op];
+            all.ns.insert(all.ns.end(), s.ns.begin(), s.ns.end());
+            all.ok += s.ok;
+        }
+        if (all.ns.empty())
+            continue;
+        std::sort(all.ns.begin(), all.ns.end());
+        std::printf("%-11s %9zu %9lld %10.0f %10.1f %10.1f %10.1f %10.1f\n", WorkloadTrace::opName(Op(op)), all.ns.size(),
+                    all.ok, double(all.ns.size()) / seconds, percentileUs(all.ns, 0.50), percentileUs(all.ns, 0.95),
+                    percentileUs(all.ns, 0.99), double(all.ns.back()) / 1000.0);
+    }
+
+    if (opt.expect.isEmpty())
+        return 0;
+    DataStore expected(true);
+    if (auto err = openStore(expected, opt, opt.expect, expectScratch))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(*err));
+        return 1;
+    }
+    const int differences = compareStates(captureState(ds), captureState(expected));
+    if (differences)
+    {
+        std::printf("final state DIVERGES from %s: %d item(s) differ\n", qPrintable(opt.expect), differences);
+        return 1;
+    }
+    std::printf("final state matches %s\n", qPrintable(opt.expect));
+    return 0;
+}
@@ -0,0 +1,13 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = workloadreplay
+
+# Replays a captured DataStore workload (see workloadtrace.hpp) headlessly.
+include(../core.pri)
+
+SOURCES += \
+    workloadreplay.cpp
@@ -0,0 +1,186 @@
+#include "transactionlog.hpp"
+#include "bytecodec.hpp"
+#include <algorithm>
+#include <chrono>
+#include <QtGlobal>
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+const char JournalMagic[4] = {'H', 'J', 'N', 'L'};
+constexpr quint32 JournalFormat = 1;
+}
+
+TransactionLog::~TransactionLog()
+{
+    close();
+}
+
+std::optional<QString> TransactionLog::open(const QString &path, quint64 generation)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return QString("Cannot open journal %1: %2").arg(path, m_file.errorString());
+
+    ByteWriter header;
+    header.putBytes(JournalMagic, sizeof JournalMagic);
+    header.putU32(JournalFormat);
+    header.putU64(generation);
+    if (m_file.write(header.data(), qint64(header.size())) != qint64(header.size()) || !syncToDisk(m_file))
+    {
+        m_file.close();
+        return QString("Cannot write journal %1: %2").arg(path, m_file.errorString());
+    }
+
+    m_appended = m_durable = 0;
+    m_stop = false;
+    m_syncRequested = false;
+    m_flusher = std::thread([this] { flusherLoop(); });
+    return std::nullopt;
+}
+
+void TransactionLog::append(const ByteWriter &record)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const bool wasIdle = m_group.empty();
+
+    // varint length prefix, then the body
+    std::size_t n = record.size();
+    while (n >= 0x80)
+    {
+        m_group.push_back(char(n | 0x80));
+        n >>= 7;
+    }
+    m_group.push_back(char(n));
+    m_group.insert(m_group.end(), record.data(), record.data() + record.size());
+    ++m_appended;
+
+    if (wasIdle || m_group.size() >= MaxGroupBytes)
+        m_wake.notify_one();
+}
+
+void TransactionLog::sync()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_flusher.joinable())
+        return;
+    const quint64 target = m_appended;
+    m_syncRequested = true;
+    m_wake.notify_one();
+    m_committed.wait(lock, [&] { return m_durable >= target || m_stop; });
+}
+
+void TransactionLog::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_flusher.joinable())
+            return;
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_flusher.join();   // the flusher commits the last group before exiting
+    m_file.close();
+}
+
+void TransactionLog::flusherLoop()
+{
+    // Two buffers trade places: writers fill m_group while the other one is
+    // on its way to disk, so neither is reallocated once warmed up
+    std::vector<char> group;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_wake.wait(lock, [&] { return m_stop || m_syncRequested || !m_group.empty(); });
+
+        // Group commit: give concurrent writers a moment to join this group
+        if (!m_stop && !m_syncRequested)
+            m_wake.wait_for(lock, std::chrono::milliseconds(FlushIntervalMs),
+                            [&] { return m_stop || m_syncRequested || m_group.size() >= MaxGroupBytes; });
+
+        group.clear();
+        group.swap(m_group);
+        const quint64 upTo = m_appended;
+        const bool stopping = m_stop;
+        m_syncRequested = false;
+
+        if (!group.empty())
+        {
+            lock.unlock();
+            const bool written = writeGroup(group);
+            lock.lock();
+            if (!written)
+                qWarning("HinLIBS journal: writing %s failed: %s",
+                         qPrintable(m_file.fileName()), qPrintable(m_file.errorString()));
+        }
+        // A failed write is not retried; waiters are released either way
+        m_durable = upTo;
+        m_committed.notify_all();
+
+        if (stopping && m_group.empty())
+            return;
+    }
+}
+
+bool TransactionLog::writeGroup(const std::vector<char> &records)
+{
+    ByteWriter frame;
+    frame.putU32(quint32(records.size()));
+    frame.putU32(crc32(records.data(), records.size()));
+    return m_file.write(frame.data(), qint64(frame.size())) == qint64(frame.size())
+        && m_file.write(records.data(), qint64(records.size())) == qint64(records.size())
+        && syncToDisk(m_file);
+}
+
+std::optional<QString> TransactionLog::replay(const QString &path, const RecordHandler &handler)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString("Cannot open journal %1: %2").arg(path, file.errorString());
+    const QByteArray bytes = file.readAll();
+
+    ByteReader in(bytes.constData(), std::size_t(bytes.size()));
+    const char *magic = in.bytes(sizeof JournalMagic);
+    if (!magic || !std::equal(magic, magic + sizeof JournalMagic, JournalMagic) || in.u32() != JournalFormat)
+        return QString("%1 is not a HinLIBS journal.").arg(path);
+    in.u64(); // generation, implied by the file name
+
+    while (in.remaining() >= 8)
+    {
+        const quint32 length = in.u32();
+        const quint32 crc = in.u32();
+        const char *group = in.bytes(length);
+        if (!group || crc32(group, length) != crc)
+            break; // torn tail from a crash mid-commit: everything before it stands
+
+        ByteReader records(group, length);
+        while (!records.atEnd())
+        {
+            const std::size_t size = std::size_t(records.varint());
+            const char *body = records.bytes(size);
+            if (!body)
+                return QString("Corrupt record in journal %1.").arg(path);
+            ByteReader record(body, size);
+            if (!handler(record))
+                return QString("Malformed record in journal %1.").arg(path);
+        }
+    }
+    return std::nullopt;
+}
+
+bool TransactionLog::syncToDisk(QFile &file)
+{
+    if (!file.flush())
+        return false;
+#if defined(Q_OS_WIN)
+    return ::_commit(file.handle()) == 0;
+#elif defined(Q_OS_MACOS)
+    return ::fsync(file.handle()) == 0;
+#else
+    return ::fdatasync(file.handle()) == 0;
+#endif
+}
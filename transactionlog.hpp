@@ -0,0 +1,66 @@
+#pragma once
+#include <QString>
+#include <QFile>
+#include <optional>
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+class ByteWriter;
+class ByteReader;
+
+// ---------------------------------------------
+// TransactionLog: append-only binary journal with group commit
+// ---------------------------------------------
+// append() only copies the record into the current group; a background
+// thread writes groups out and fdatasync()s them, so callers never wait
+// on the disk. A group is [u32 length][u32 crc32][records...] and each
+// record is a varint length plus body, which lets replay stop cleanly at
+// a torn tail after a crash.
+class TransactionLog
+{
+public:
+    static constexpr int FlushIntervalMs = 2;           // max time a record waits for commit
+    static constexpr std::size_t MaxGroupBytes = 64 * 1024;
+
+    TransactionLog() = default;
+    ~TransactionLog();
+    TransactionLog(const TransactionLog &) = delete;
+    TransactionLog &operator=(const TransactionLog &) = delete;
+
+    //Create a new journal file for the given generation and start committing
+    std::optional<QString> open(const QString &path, quint64 generation);
+
+    //Queue one record for the next group commit
+    void append(const ByteWriter &record);
+
+    //Block until everything appended so far is durable
+    void sync();
+
+    //Commit what is pending and stop the flusher
+    void close();
+
+    //Read back a journal; handler returns false on a malformed record
+    using RecordHandler = std::function<bool(ByteReader &)>;
+    static std::optional<QString> replay(const QString &path, const RecordHandler &handler);
+
+    //Flush Qt's buffer and force file contents to disk
+    static bool syncToDisk(QFile &file);
+
+private:
+    void flusherLoop();
+    bool writeGroup(const std::vector<char> &records);
+
+    QFile m_file;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;      // flusher: work or stop
+    std::condition_variable m_committed; // sync(): group made durable
+    std::vector<char> m_group;           // encoded records awaiting commit
+    quint64 m_appended = 0;              // records appended
+    quint64 m_durable = 0;               // records known to be on disk
+    bool m_syncRequested = false;
+    bool m_stop = false;
+    std::thread m_flusher;
+};
@@ -0,0 +1,126 @@
+#include "workloadtrace.hpp"
+#include "csvreader.hpp"
+
+namespace {
+const char *const OpNames[int(WorkloadTrace::Op::Count)] = {"borrow",     "return",   "checkin",  "placehold",
+                                                            "cancelhold", "finditem", "finduser", "search"};
+const char Header[] = "time_ms,op,patron,item,text\n";
+}
+
+const char *WorkloadTrace::opName(Op op)
+{
+    return OpNames[int(op)];
+}
+
+std::optional<WorkloadTrace::Op> WorkloadTrace::opFromName(const QString &name)
+{
+    for (int i = 0; i < int(Op::Count); ++i)
+        if (name == OpNames[i])
+            return Op(i);
+    return std::nullopt;
+}
+
+WorkloadTrace::~WorkloadTrace()
+{
+    flush();
+}
+
+std::optional<QString> WorkloadTrace::open(const QString &path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file.close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return QString("Cannot open trace %1: %2").arg(path, m_file.errorString());
+    m_buffer.assign(Header);
+    m_start = std::chrono::steady_clock::now();
+    return std::nullopt;
+}
+
+void WorkloadTrace::record(Op op, int patronId, int itemId, const QString &text)
+{
+    const qint64 atMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start).count();
+    std::string line = std::to_string(atMs);
+    line += ',';
+    line += OpNames[int(op)];
+    line += ',';
+    line += std::to_string(patronId);
+    line += ',';
+    line += std::to_string(itemId);
+    line += ',';
+    if (!text.isEmpty())
+    {
+        // Always quoted: names and queries may hold commas or quotes
+        line += '"';
+        for (char c : text.toStdString())
+        {
+            if (c == '"')
+                line += '"';
+            line += c;
+        }
+        line += '"';
+    }
+    line += '\n';
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.isOpen())
+        return;
+    m_buffer += line;
+    if (m_buffer.size() >= FlushBytes)
+        writeBuffer();
+}
+
+void WorkloadTrace::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.isOpen())
+        return;
+    writeBuffer();
+    m_file.flush();
+}
+
+void WorkloadTrace::writeBuffer()
+{
+    // A failed write loses those rows but never the circulation call itself
+    m_file.write(m_buffer.data(), qint64(m_buffer.size()));
+    m_buffer.clear();
+}
+
+std::optional<QString> WorkloadTrace::read(const QString &path, std::vector<Event> &events)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString("Cannot open trace %1: %2").arg(path, file.errorString());
+    const qint64 size = file.size();
+    const uchar *data = size > 0 ? file.map(0, size) : nullptr;
+    if (!data)
+        return QString("Trace %1 is empty or cannot be mapped.").arg(path);
+
+    CsvReader csv(reinterpret_cast<const char *>(data), std::size_t(size));
+    std::vector<QString> row;
+    if (!csv.next(row) || row.size() < 5 || row[0] != "time_ms")
+        return QString("Trace %1 has no time_ms,op,patron,item,text header.").arg(path);
+
+    events.clear();
+    while (csv.next(row))
+    {
+        if (row.size() == 1 && row[0].isEmpty())
+            continue; // blank line
+        Event e;
+        bool timeOk = false, patronOk = false, itemOk = false;
+        const std::optional<Op> op = row.size() >= 4 ? opFromName(row[1]) : std::nullopt;
+        if (op)
+        {
+            e.atMs = row[0].toLongLong(&timeOk);
+            e.op = *op;
+            e.patronId = row[2].toInt(&patronOk);
+            e.itemId = row[3].toInt(&itemOk);
+            if (row.size() >= 5)
+                e.text = row[4];
+        }
+        if (!op || !timeOk || !patronOk || !itemOk)
+            return QString("Trace %1, line %2: not a valid event.").arg(path).arg(csv.line());
+        events.push_back(std::move(e));
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <QString>
+#include <QFile>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------
+// WorkloadTrace: timestamped record of DataStore traffic
+// ---------------------------------------------
+// While a trace is attached (DataStore::setTrace) every circulation call
+// and lookup is appended as one CSV row:
+//
+//   time_ms,op,patron,item,text
+//
+// time_ms counts from when the trace was opened; text is the user name for
+// finduser and the query for search (whose item column is the result
+// limit). Batch calls are recorded item by item. tools/workloadreplay plays
+// a trace back against a store without the GUI.
+class WorkloadTrace
+{
+public:
+    enum class Op { Borrow, Return, CheckIn, PlaceHold, CancelHold, FindItem, FindUser, Search, Count };
+
+    struct Event {
+        qint64 atMs = 0;
+        Op op = Op::FindItem;
+        int patronId = 0;
+        int itemId = 0;
+        QString text;
+    };
+
+    static const char *opName(Op op);
+    static std::optional<Op> opFromName(const QString &name);
+
+    WorkloadTrace() = default;
+    ~WorkloadTrace();
+    WorkloadTrace(const WorkloadTrace &) = delete;
+    WorkloadTrace &operator=(const WorkloadTrace &) = delete;
+
+    //Start a new trace file (replacing any old one) and write the header
+    std::optional<QString> open(const QString &path);
+
+    //Append one call; safe from any thread. Rows are buffered and written
+    //in blocks, so recording costs a formatted line, not a write.
+    void record(Op op, int patronId, int itemId, const QString &text = QString());
+
+    //Write out buffered rows
+    void flush();
+
+    //Load a whole trace; on failure the error names the file and line
+    static std::optional<QString> read(const QString &path, std::vector<Event> &events);
+
+private:
+    static constexpr std::size_t FlushBytes = 64 * 1024;
+
+    void writeBuffer();
+
+    std::mutex m_mutex;
+    QFile m_file;
+    std::string m_buffer;
+    std::chrono::steady_clock::time_point m_start;
+};